@@ -8,6 +8,10 @@
     #include "TDAttribMgr.h"
 #endif
 
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -28,8 +32,7 @@ CTDAttribMgr::~CTDAttribMgr()
 //---------------------------------------------------------------------------
 bool CTDAttribMgr::readAttributes()
 {
-    cout << _T("Reading attributes...") << endl;
-	m_attributes.cleanup();
+    CStringArray hierarchyLines;
     try {
         CStdioFile attribFile;
         if (!attribFile.Open(m_attributesFile, CFile::modeRead)) {
@@ -37,12 +40,37 @@ bool CTDAttribMgr::readAttributes()
             return false;
         }
 
+        CString lineStr;
+        while (attribFile.ReadString(lineStr))
+            hierarchyLines.Add(lineStr);
+        attribFile.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read attributes file: ") << m_attributesFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return readAttributes(hierarchyLines);
+}
+
+//---------------------------------------------------------------------------
+// Build the concept hierarchies from the lines of an attribute hierarchy
+// file that is already in memory.
+//---------------------------------------------------------------------------
+bool CTDAttribMgr::readAttributes(const CStringArray& hierarchyLines)
+{
+    cout << _T("Reading attributes...") << endl;
+	m_attributes.cleanup();
+    m_numConAttrib = 0;
+    {
         // Parse each line       
         CString lineStr, attribName, attribType, attribValuesStr;
         int commentCharPos = -1, semiColonPos = -1;
         bool bMaskTypeSuppress = false;
         CTDAttrib* pClassAttribute = NULL;
-        while (attribFile.ReadString(lineStr)) {
+        int lineIdx = 0;
+        while (lineIdx < hierarchyLines.GetSize()) {
+            lineStr = hierarchyLines.GetAt(lineIdx++);
             CBFStrHelper::trim(lineStr);
             if (lineStr.IsEmpty())
                 continue;
@@ -121,12 +149,13 @@ bool CTDAttribMgr::readAttributes()
             }
 
             // Read the next line which contains the hierarchy
-            if (!attribFile.ReadString(attribValuesStr)) {
+            if (lineIdx >= hierarchyLines.GetSize()) {
                 cerr << _T("CTDAttribMgr: Invalid attribute: ") << attribName << endl;
                 ASSERT(false);
                 return false;
             }
 
+            attribValuesStr = hierarchyLines.GetAt(lineIdx++);
             CBFStrHelper::trim(attribValuesStr);
             if (attribValuesStr.IsEmpty()) {
                 cerr << _T("CTDAttribMgr: Invalid attribute: ") << attribName << endl;
@@ -169,9 +198,6 @@ bool CTDAttribMgr::readAttributes()
                     // Add the attribute to the attribute array
                     pNewAttribute->m_attribIdx = m_attributes.Add(pNewAttribute);
 					pNewAttribute->m_bVirtualAttrib = true;  
-
-					// Find the num of leaf concepts
-					pNewAttribute->getConceptRoot()->m_nLeafConcepts = pNewAttribute->getConceptRoot()->getNumLeafConcepts();
                 }
                 else {
                     ASSERT(!pClassAttribute);
@@ -187,12 +213,6 @@ bool CTDAttribMgr::readAttributes()
             return false;
         }
         pClassAttribute->m_attribIdx = m_attributes.Add(pClassAttribute);
-        attribFile.Close();
-    }
-    catch (CFileException&) {
-        cerr << _T("Failed to read attributes file: ") << m_attributesFile << endl;
-        ASSERT(false);
-        return false;
     }
     cout << m_attributes;
     cout << _T("Reading attributes succeeded.") << endl;
@@ -200,6 +220,28 @@ bool CTDAttribMgr::readAttributes()
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Replace the attributes by copies of those read by pSrcMgr, which are not
+// changed, e.g., the attributes of a CTDDataset.
+//---------------------------------------------------------------------------
+bool CTDAttribMgr::copyAttributes(CTDAttribMgr* pSrcMgr)
+{
+    cout << _T("Copying attributes...") << endl;
+	m_attributes.cleanup();
+    m_numConAttrib = pSrcMgr->m_numConAttrib;
+    for (int a = 0; a < pSrcMgr->getNumAttributes(); ++a) {
+        CTDAttrib* pNewAttribute = pSrcMgr->getAttribute(a)->clone();
+        if (!pNewAttribute) {
+            cerr << _T("CTDAttribMgr: Failed to copy attribute ") << pSrcMgr->getAttribute(a)->m_attribName << endl;
+            ASSERT(false);
+            return false;
+        }
+        m_attributes.Add(pNewAttribute);
+    }
+    cout << _T("Copying attributes succeeded.") << endl;
+    return true;
+}
+
 //---------------------------------------------------------------------------
 // Create a name file for C4.5.
 //---------------------------------------------------------------------------
@@ -219,19 +261,24 @@ bool CTDAttribMgr::writeNameFile()
         CTDAttrib* pAttrib = m_attributes.GetAt(nAttributes - 1);
         CTDConcepts* pFlattenConcepts = pAttrib->getFlattenConcepts();
         for (c = 1; c < pFlattenConcepts->GetSize(); ++c) {
-            nameFile.WriteString(pFlattenConcepts->GetAt(c)->m_conceptValue);
+            CTDOutputWriter::writeString(nameFile, pFlattenConcepts->GetAt(c)->m_conceptValue);
             if (c < pFlattenConcepts->GetSize() - 1)
-                nameFile.WriteString(CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
+                CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
             else {
-                nameFile.WriteString(CString(TD_NAMEFILE_TERMINATOR));
-                nameFile.WriteString(_T("\n\n"));
+                CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_TERMINATOR));
+                CTDOutputWriter::writeString(nameFile, _T("\n\n"));
             }
         }
 
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+        // Write the weight of each record.
+        CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_CASE_WEIGHT) + TD_NAMEFILE_ATTNAMESEP + _T(" ") + TD_NAMEFILE_CONTINUOUS + TD_NAMEFILE_TERMINATOR + _T("\n"));
+#endif
+
         // Write attributes
         for (int a = 0; a < nAttributes - 1; ++a) {
             pAttrib = m_attributes.GetAt(a);
-            nameFile.WriteString(pAttrib->m_attribName + TD_NAMEFILE_ATTNAMESEP + _T(" "));
+            CTDOutputWriter::writeString(nameFile, pAttrib->m_attribName + TD_NAMEFILE_ATTNAMESEP + _T(" "));
 
             pFlattenConcepts = pAttrib->getFlattenConcepts();
 #ifdef _TD_TREAT_CONT_AS_CONT
@@ -239,8 +286,8 @@ bool CTDAttribMgr::writeNameFile()
 #else
             if (pAttrib->isContinuous() && !pAttrib->m_bVirtualAttrib) {
 #endif         
-                nameFile.WriteString(TD_NAMEFILE_CONTINUOUS);
-                nameFile.WriteString(_T("\n"));
+                CTDOutputWriter::writeString(nameFile, TD_NAMEFILE_CONTINUOUS);
+                CTDOutputWriter::writeString(nameFile, _T("\n"));
             }
             else {
                 int nConcepts = 0;
@@ -250,17 +297,17 @@ bool CTDAttribMgr::writeNameFile()
                     nConcepts = pFlattenConcepts->GetSize();                  
 
                 for (c = 0; c < nConcepts; ++c) {
-                    nameFile.WriteString(pFlattenConcepts->GetAt(c)->m_conceptValue);
+                    CTDOutputWriter::writeString(nameFile, pFlattenConcepts->GetAt(c)->m_conceptValue);
                     if (c < nConcepts - 1)
-                        nameFile.WriteString(CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
+                        CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
                     else {
                         if (pFlattenConcepts->GetSize() == 1) {
                             // add a fake concept if there is only one concept.
-                            nameFile.WriteString(CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
-                            nameFile.WriteString(CString(TD_NAMEFILE_FAKE_CONT_CONCEPT));
+                            CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
+                            CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_FAKE_CONT_CONCEPT));
                         }
-                        nameFile.WriteString(CString(TD_NAMEFILE_TERMINATOR));
-                        nameFile.WriteString(_T("\n"));
+                        CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_TERMINATOR));
+                        CTDOutputWriter::writeString(nameFile, _T("\n"));
                     }
                 }
             }
@@ -276,6 +323,37 @@ bool CTDAttribMgr::writeNameFile()
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Collect the concepts of the leaf partitions that are written as distinct
+// attributes of the multidimensional output, and encode every concept by
+// them. Can be called again; the concepts are collected anew.
+//---------------------------------------------------------------------------
+bool CTDAttribMgr::buildMultiDimConcepts()
+{
+    int nAttributes = getNumAttributes();
+    for (int a = 0; a < nAttributes - 1; ++a) {
+        CTDAttrib* pAttrib = m_attributes.GetAt(a);
+        if (pAttrib->isContinuous())
+            continue;
+
+        CTDConcepts* pFlattenConcepts = pAttrib->getFlattenConcepts();
+        int nConcepts = 0;
+        if (pAttrib->isMaskTypeSup())
+            nConcepts = pAttrib->m_nOFlatConcepts;
+        else
+            nConcepts = pFlattenConcepts->GetSize();    
+
+        pAttrib->m_multiDimConcepts.RemoveAll();
+        for (int c = 0; c < nConcepts; ++c) {
+            if (pFlattenConcepts->GetAt(c)->m_bFileName)
+                pAttrib->m_multiDimConcepts.Add(pFlattenConcepts->GetAt(c));
+        }
+        if (!pAttrib->buildMultiDimBits())
+            return false;
+    }
+    return true;
+}
+
 //---------------------------------------------------------------------------
 // Create a name file for C4.5 taking into account the multidimensional anonymization.
 // This .names file has every categorical concept as a distrinct attribute,
@@ -285,6 +363,9 @@ bool CTDAttribMgr::writeNameFile()
 bool CTDAttribMgr::writeNameFileMultiDim()
 {
     cout << _T("Writing multidimensional name file...") << endl;
+    if (!buildMultiDimConcepts())
+        return false;
+
     try {
         CStdioFile nameFile;
         if (!nameFile.Open(m_nameFile, CFile::modeCreate | CFile::modeWrite)) {
@@ -298,15 +379,20 @@ bool CTDAttribMgr::writeNameFileMultiDim()
         CTDAttrib* pAttrib = m_attributes.GetAt(nAttributes - 1);
         CTDConcepts* pFlattenConcepts = pAttrib->getFlattenConcepts();
         for (c = 1; c < pFlattenConcepts->GetSize(); ++c) {
-            nameFile.WriteString(pFlattenConcepts->GetAt(c)->m_conceptValue);
+            CTDOutputWriter::writeString(nameFile, pFlattenConcepts->GetAt(c)->m_conceptValue);
             if (c < pFlattenConcepts->GetSize() - 1)
-                nameFile.WriteString(CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
+                CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_SEPARATOR) + _T(" "));
             else {
-                nameFile.WriteString(CString(TD_NAMEFILE_TERMINATOR));
-                nameFile.WriteString(_T("\n\n"));
+                CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_TERMINATOR));
+                CTDOutputWriter::writeString(nameFile, _T("\n\n"));
             }
         }
 
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+        // Write the weight of each record.
+        CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_CASE_WEIGHT) + TD_NAMEFILE_ATTNAMESEP + _T(" ") + TD_NAMEFILE_CONTINUOUS + TD_NAMEFILE_TERMINATOR + _T("\n"));
+#endif
+
         // Write attributes
         for (int a = 0; a < nAttributes - 1; ++a) {
             pAttrib = m_attributes.GetAt(a);
@@ -318,21 +404,18 @@ bool CTDAttribMgr::writeNameFileMultiDim()
                 nConcepts = pFlattenConcepts->GetSize();    
 
 			if (pAttrib->isContinuous()) {
-				nameFile.WriteString(pAttrib->m_attribName + TD_NAMEFILE_ATTNAMESEP + _T(" "));
-				nameFile.WriteString(CString(TD_NAMEFILE_CONTINUOUS));
-				nameFile.WriteString(CString(TD_NAMEFILE_TERMINATOR));
-                nameFile.WriteString(_T("\n"));
+				CTDOutputWriter::writeString(nameFile, pAttrib->m_attribName + TD_NAMEFILE_ATTNAMESEP + _T(" "));
+				CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_CONTINUOUS));
+				CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_TERMINATOR));
+                CTDOutputWriter::writeString(nameFile, _T("\n"));
 				continue;
 			}
 			else {
 				for (c = 0; c < nConcepts; ++c) {
 					if (pFlattenConcepts->GetAt(c)->m_bFileName) {
-						nameFile.WriteString(pFlattenConcepts->GetAt(c)->m_conceptValue + TD_NAMEFILE_ATTNAMESEP + _T(" 0, 1"));
-						nameFile.WriteString(CString(TD_NAMEFILE_TERMINATOR));
-						nameFile.WriteString(_T("\n"));
-
-						// Concept is a multidimensional attribute
-						pAttrib->m_multiDimConcepts.Add(pFlattenConcepts->GetAt(c));
+						CTDOutputWriter::writeString(nameFile, pFlattenConcepts->GetAt(c)->m_conceptValue + TD_NAMEFILE_ATTNAMESEP + _T(" 0, 1"));
+						CTDOutputWriter::writeString(nameFile, CString(TD_NAMEFILE_TERMINATOR));
+						CTDOutputWriter::writeString(nameFile, _T("\n"));
 					}
 				} 
 			}
@@ -17,7 +17,10 @@ public:
 
 // Operations
     bool readAttributes();
+    bool readAttributes(const CStringArray& hierarchyLines);
+    bool copyAttributes(CTDAttribMgr* pSrcMgr);
     bool writeNameFile();
+	bool buildMultiDimConcepts();
 	bool writeNameFileMultiDim();
 	bool writeNameFileSingle();
 
@@ -71,14 +71,123 @@ bool CTDAttrib::flattenHierarchy()
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Append a concept made after the hierarchy was built, e.g., a child of a
+// split continuous concept, to the flattened concepts and the NCP table.
+// Returns its flattened index.
+//---------------------------------------------------------------------------
+int CTDAttrib::addFlattenConcept(CTDConcept* pConcept)
+{
+    int flattenIdx = m_flattenConcepts.Add(pConcept);
+    m_conceptNCPs.SetAtGrow(flattenIdx, computeConceptNCP(pConcept));
+    return flattenIdx;
+}
 
 //---------------------------------------------------------------------------
-// Calculate the number of required bits
+// Compute the NCP of every flattened concept once, so that scoring and
+// evaluation look it up by flattened index.
+//---------------------------------------------------------------------------
+bool CTDAttrib::buildNCPTable()
+{
+    int nConcepts = m_flattenConcepts.GetSize();
+    m_conceptNCPs.SetSize(nConcepts);
+    for (int c = 0; c < nConcepts; ++c)
+        m_conceptNCPs[c] = computeConceptNCP(m_flattenConcepts.GetAt(c));
+    return true;
+}
+
+
+//---------------------------------------------------------------------------
+// Give every concept of the hierarchy the set of multidimensional concepts
+// that are the concept itself or one of its ancestors, i.e., the concepts
+// written as 1 in a one-hot output row.
+//---------------------------------------------------------------------------
+bool CTDAttrib::buildMultiDimBits()
+{
+    if (!m_pConceptRoot) {
+        ASSERT(false);
+        return false;
+    }
+    for (int w = 0; w < m_multiDimConcepts.GetSize(); ++w)
+        m_multiDimConcepts.GetAt(w)->m_multiDimIdx = w;
+
+    CTDBitValueArray rootBits;
+    rootBits.SetSize((m_multiDimConcepts.GetSize() + TD_BITVALUE_NUMBITS - 1) / TD_BITVALUE_NUMBITS);
+    for (int i = 0; i < rootBits.GetSize(); ++i)
+        rootBits[i] = 0;
+    buildMultiDimBitsHelper(m_pConceptRoot, rootBits);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDAttrib::buildMultiDimBitsHelper(CTDConcept* pConcept, const CTDBitValueArray& parentBits)
+{
+    pConcept->m_multiDimBits.Copy(parentBits);
+    int w = pConcept->m_multiDimIdx;
+    if (w >= 0)
+        pConcept->m_multiDimBits[w / TD_BITVALUE_NUMBITS] |= TDBitValue(1) << (w % TD_BITVALUE_NUMBITS);
+
+    for (int c = 0; c < pConcept->getNumChildConcepts(); ++c)
+        buildMultiDimBitsHelper(pConcept->getChildConcept(c), pConcept->m_multiDimBits);
+}
+
+//---------------------------------------------------------------------------
+// Make this attribute, which has no hierarchy yet, a copy of pSrcAttrib as
+// it was built by initHierarchy. The NCP table and the bits are copied;
+// flattening the copied tree gives the concepts the same indexes.
+//---------------------------------------------------------------------------
+bool CTDAttrib::copyHierarchy(CTDAttrib* pSrcAttrib)
+{
+    ASSERT(!m_pConceptRoot);
+    m_attribIdx = pSrcAttrib->m_attribIdx;
+    m_bVirtualAttrib = pSrcAttrib->m_bVirtualAttrib;
+    m_maxDepth = pSrcAttrib->m_maxDepth;
+    m_reqBits.Copy(pSrcAttrib->m_reqBits);
+    m_bitShifts.Copy(pSrcAttrib->m_bitShifts);
+    m_bitMasks.Copy(pSrcAttrib->m_bitMasks);
+
+    m_pConceptRoot = pSrcAttrib->m_pConceptRoot->cloneHierarchy(this);
+    if (!m_pConceptRoot)
+        return false;
+    if (!flattenHierarchy())
+        return false;
+    if (m_flattenConcepts.GetSize() != pSrcAttrib->m_flattenConcepts.GetSize()) {
+        ASSERT(false);
+        return false;
+    }
+    m_conceptNCPs.Copy(pSrcAttrib->m_conceptNCPs);
+    return initCutToRoot();
+}
+
+//---------------------------------------------------------------------------
+// Calculate the number of required bits, and the shift/mask of each level
+// so that the child index at any depth can be extracted in constant time.
 //---------------------------------------------------------------------------
 bool CTDAttrib::calBits()
 {
-    for (int i = 0; i < m_reqBits.GetSize(); ++i)
+    int nLevels = m_reqBits.GetSize();
+    m_bitShifts.SetSize(nLevels);
+    m_bitMasks.SetSize(nLevels);
+
+    int nShiftBits = 0;
+    for (int i = 0; i < nLevels; ++i) {
         m_reqBits[i] = (int) ceil(log2(m_reqBits[i])); 
+        m_bitShifts[i] = nShiftBits;
+        if (m_reqBits[i] == 0)
+            m_bitMasks[i] = 0;
+        else
+            m_bitMasks[i] = ~TDBitValue(0) >> (TD_BITVALUE_NUMBITS - m_reqBits[i]);
+        nShiftBits += m_reqBits[i];
+    }
+
+    if (nShiftBits > TD_BITVALUE_NUMBITS) {
+        cerr << _T("CTDAttrib: Hierarchy of ") << m_attribName << _T(" needs ") << nShiftBits
+             << _T(" bits to encode a path; at most ") << TD_BITVALUE_NUMBITS << _T(" are supported.") << endl;
+        ASSERT(false);
+        return false;
+    }
     return true;
 }
 
@@ -115,6 +224,8 @@ bool CTDDiscAttrib::initHierarchy(LPCTSTR conceptStr)
     }
     if (!flattenHierarchy())
         return false;
+    if (!buildNCPTable())
+        return false;
     if (!calBits())
         return false;
     if (!initCutToRoot())
@@ -129,6 +240,31 @@ bool CTDDiscAttrib::initHierarchy(LPCTSTR conceptStr)
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Copy of this attribute as read, for a run that changes its own hierarchy.
+//---------------------------------------------------------------------------
+CTDAttrib* CTDDiscAttrib::clone()
+{
+    CTDDiscAttrib* pNewAttrib = new CTDDiscAttrib(m_attribName, m_bMaskTypeSup);
+    if (!pNewAttrib->copyHierarchy(this)) {
+        delete pNewAttrib;
+        return NULL;
+    }
+    return pNewAttrib;
+}
+
+//---------------------------------------------------------------------------
+// NCP of a categorical concept: the fraction of the leaves of the hierarchy
+// under it, or 0 for a leaf. Please refer to our paper.
+//---------------------------------------------------------------------------
+float CTDDiscAttrib::computeConceptNCP(CTDConcept* pConcept)
+{
+    int nCurrLeafConcepts = pConcept->m_nLeafConcepts;
+    if (nCurrLeafConcepts == 1)
+        return 0.0f;
+    return float(nCurrLeafConcepts * 1.0 / m_pConceptRoot->m_nLeafConcepts);
+}
+
 //---------------------------------------------------------------------------
 // Reconstruct the hierarchy for categorical attributes.
 // For protected attribute, the hierachy should be flat, e.g.,
@@ -140,6 +276,7 @@ bool CTDDiscAttrib::reconstructHierarchy()
 {
     CTDConcept* pNewRootConcept = new CTDDiscConcept(m_pConceptRoot->getAttrib());
     pNewRootConcept->m_conceptValue = m_pConceptRoot->m_conceptValue;
+    pNewRootConcept->m_depth = 0;
     if (!reconstructHierarchyHelper(m_pConceptRoot, pNewRootConcept))
         return false;
     
@@ -147,8 +284,11 @@ bool CTDDiscAttrib::reconstructHierarchy()
     delete m_pConceptRoot;
     m_pConceptRoot = pNewRootConcept;
 
-    // Update the number of branches accordingly
+    // Update the number of branches accordingly. The flat hierarchy has
+    // only one level of branches, so drop those of the deeper levels.
+    m_reqBits.SetSize(1);
     m_reqBits[0] = pNewRootConcept->getNumChildConcepts();
+    pNewRootConcept->m_nLeafConcepts = pNewRootConcept->getNumChildConcepts();
     return true;
 }
 
@@ -161,6 +301,7 @@ bool CTDDiscAttrib::reconstructHierarchyHelper(const CTDConcept* pThisConcept, C
         CTDDiscConcept* pNewLeaf = new CTDDiscConcept(this);
         pNewLeaf->m_conceptValue = pThisConcept->m_conceptValue;
         pNewLeaf->m_depth = 1;
+        pNewLeaf->m_nLeafConcepts = 1;
         if (!pNewRootConcept->addChildConcept(pNewLeaf)) {            
             delete pNewLeaf;
             pNewLeaf = NULL;
@@ -203,9 +344,34 @@ bool CTDContAttrib::initHierarchy(LPCTSTR conceptStr)
         return false;
     if (!flattenHierarchy())
         return false;
+    if (!buildNCPTable())
+        return false;
     return initCutToRoot();
 }
 
+//---------------------------------------------------------------------------
+// Copy of this attribute as read, for a run that splits its own intervals.
+//---------------------------------------------------------------------------
+CTDAttrib* CTDContAttrib::clone()
+{
+    CTDContAttrib* pNewAttrib = new CTDContAttrib(m_attribName);
+    if (!pNewAttrib->copyHierarchy(this)) {
+        delete pNewAttrib;
+        return NULL;
+    }
+    return pNewAttrib;
+}
+
+//---------------------------------------------------------------------------
+// NCP of a continuous concept: |interval| / |rootInterval|.
+//---------------------------------------------------------------------------
+float CTDContAttrib::computeConceptNCP(CTDConcept* pConcept)
+{
+    CTDContConcept* pContConcept = static_cast<CTDContConcept*>(pConcept);
+    CTDContConcept* pRootConcept = static_cast<CTDContConcept*>(m_pConceptRoot);
+    return (pContConcept->m_upperBound - pContConcept->m_lowerBound) / (pRootConcept->m_upperBound - pRootConcept->m_lowerBound);
+}
+
 
 
 //*************
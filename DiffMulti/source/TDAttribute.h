@@ -25,13 +25,22 @@ public:
     virtual bool isContinuous() = 0;
 	virtual bool isMaskTypeSup() { return m_bMaskTypeSup; };
     virtual bool initHierarchy(LPCTSTR conStr) = 0;
+    virtual CTDAttrib* clone() = 0;
 	CTDConcepts* getMultiDimConcepts() { return &m_multiDimConcepts; };
+    bool buildMultiDimBits();
 
     CTDConcept* getConceptRoot() { return m_pConceptRoot; };	
     bool flattenHierarchy();
     CTDConcepts* getFlattenConcepts() { return &m_flattenConcepts; };
+    int addFlattenConcept(CTDConcept* pConcept);
+    bool buildNCPTable();
+    float getConceptNCP(const CTDConcept* pConcept) const { return m_conceptNCPs[pConcept->m_flattenIdx]; };
+    virtual float computeConceptNCP(CTDConcept* pConcept) = 0;
    	CTDIntArray& getReqBits() { return m_reqBits; };
     bool calBits();
+    int getNumBitLevels() const { return m_bitShifts.GetSize(); };
+    int getBitShift(int depth) const { return m_bitShifts.GetAt(depth); };
+    TDBitValue getBitMask(int depth) const { return m_bitMasks.GetAt(depth); };
 	int getMaxDepth() { return m_maxDepth; };
 
 // attributes
@@ -46,9 +55,14 @@ protected:
     bool        m_bMaskTypeSup;     // Mask type is suppression.
     CTDConcept* m_pConceptRoot;     // Root of concept hierarchy.
     CTDConcepts m_flattenConcepts;  
+    CTDFloatArray m_conceptNCPs;    // NCP of a concept, by flattened index.
     CTDIntArray m_reqBits;          // Maximum required bits for each level
+    CTDIntArray m_bitShifts;        // Bit offset of each level in a packed path.
+    CTDBitValueArray m_bitMasks;    // Mask of the child index bits of each level, after shifting.
 	int		    m_maxDepth;			// Height of concept hierarchy.
-	
+
+    bool copyHierarchy(CTDAttrib* pSrcAttrib);
+    static void buildMultiDimBitsHelper(CTDConcept* pConcept, const CTDBitValueArray& parentBits);
 };
 
 
@@ -59,6 +73,8 @@ public:
     virtual ~CTDDiscAttrib();
     virtual bool isContinuous() { return false; };
     virtual bool initHierarchy(LPCTSTR conceptStr); 
+    virtual CTDAttrib* clone();
+    virtual float computeConceptNCP(CTDConcept* pConcept);
     
 protected:
     bool reconstructHierarchy();
@@ -73,6 +89,8 @@ public:
     virtual ~CTDContAttrib();
     virtual bool isContinuous() { return true; };
     virtual bool initHierarchy(LPCTSTR conceptStr);
+    virtual CTDAttrib* clone();
+    virtual float computeConceptNCP(CTDConcept* pConcept);
 };
 
 
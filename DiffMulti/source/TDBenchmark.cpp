@@ -0,0 +1,496 @@
+// TDBenchmark.cpp: implementation of the CTDBenchmark class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDBENCHMARK_H)
+    #include "TDBenchmark.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDBenchmark::CTDBenchmark(const TDBenchParams& params)
+    : m_params(params),
+      m_attribMgr(_T(""), _T("")),
+      m_dataMgr(_T(""), _T(""), _T(""), -1, params.m_nRows)
+{
+}
+
+CTDBenchmark::~CTDBenchmark()
+{
+}
+
+//---------------------------------------------------------------------------
+// Generate the data set and time every kernel on it. convertRecord comes
+// last because it moves the current concepts of the records to their raw
+// concepts.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::run()
+{
+    if (m_params.m_nRows <= 0 || m_params.m_nAttribs <= 0 || m_params.m_fanOut < 2 ||
+        m_params.m_nClasses < 2 || m_params.m_nDistinct < 2 || m_params.m_nReps <= 0) {
+        cerr << _T("CTDBenchmark: Invalid parameters.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    m_results.RemoveAll();
+    if (!generate())
+        return false;
+
+    if (!m_dataMgr.initialize(&m_attribMgr))
+        return false;
+    if (!m_attribMgr.readAttributes(m_hierarchyLines))
+        return false;
+
+    // The sensitivity of the mechanisms depends on the number of records.
+    setnTrainingRecs(m_params.m_nRows);
+
+    srand(m_params.m_seed);
+    if (!benchReadRecords() ||
+        !benchBuildBitValue() ||
+        !benchSortByAttrib() ||
+        !benchConstructSupportMatrix() ||
+        !benchFindOptimalSplitPoint() ||
+        !benchExpoMech() ||
+        !benchLaplaceNoise() ||
+        !benchConvertRecord())
+        return false;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Hierarchy lines and raw records in the formats of the .hchy and .rawdata
+// files. One record more than m_nRows is made because a data set must
+// have a test record.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::generate()
+{
+    m_hierarchyLines.RemoveAll();
+    m_rawRecords.RemoveAll();
+    srand(m_params.m_seed);
+
+    CTDByteBuffer line;
+    m_hierarchyLines.Add(CString(TD_CLASSES_ATTRIB_NAME) + _T(":") + TD_DISCRETE_ATTRIB);
+    line.append(_T("{Any_class"));
+    for (int c = 0; c < m_params.m_nClasses; ++c) {
+        line.append(_T(" {c"));
+        line.appendInt(c);
+        line.append(TCHAR('}'));
+    }
+    line.append(TCHAR('}'));
+    m_hierarchyLines.Add(CString(line.getData(), line.getSize()));
+
+    for (int a = 0; a < m_params.m_nAttribs; ++a) {
+        line.reset();
+        line.append(TCHAR('a'));
+        line.appendInt(a);
+        line.append(TCHAR(':'));
+        if (a % 2 == 0) {
+            line.append(TD_DISCRETE_ATTRIB);
+            line.append(TCHAR(':'));
+            line.append(TD_MASKTYPE_GEN);
+            m_hierarchyLines.Add(CString(line.getData(), line.getSize()));
+            line.reset();
+            appendHierarchy(line, a, 0, m_params.m_nDistinct);
+        }
+        else {
+            line.append(TD_CONTINUOUS_ATTRIB);
+            m_hierarchyLines.Add(CString(line.getData(), line.getSize()));
+            line.reset();
+            line.append(_T("{0-"));
+            line.appendInt(m_params.m_nDistinct);
+            line.append(TCHAR('}'));
+        }
+        m_hierarchyLines.Add(CString(line.getData(), line.getSize()));
+    }
+
+    for (int r = 0; r <= m_params.m_nRows; ++r) {
+        line.reset();
+        for (int a = 0; a < m_params.m_nAttribs; ++a) {
+            if (a % 2 == 0)
+                appendLeafValue(line, a, rand() % m_params.m_nDistinct);
+            else
+                line.appendInt(rand() % m_params.m_nDistinct);
+            line.append(TD_RAWDATA_DELIMETER);
+            line.append(TCHAR(' '));
+        }
+        line.append(TCHAR('c'));
+        line.appendInt(rand() % m_params.m_nClasses);
+        line.append(TD_RAWDATA_TERMINATOR);
+        m_rawRecords.Add(CString(line.getData(), line.getSize()));
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Balanced subtree over the leaves [firstLeaf, firstLeaf + nLeaves), with
+// up to m_fanOut children per concept.
+//---------------------------------------------------------------------------
+void CTDBenchmark::appendHierarchy(CTDByteBuffer& line, int attribIdx, int firstLeaf, int nLeaves) const
+{
+    line.append(TCHAR('{'));
+    if (nLeaves == 1) {
+        appendLeafValue(line, attribIdx, firstLeaf);
+        line.append(TCHAR('}'));
+        return;
+    }
+
+    if (nLeaves == m_params.m_nDistinct)
+        line.append(_T("Any_"));
+    line.append(TCHAR('a'));
+    line.appendInt(attribIdx);
+    if (nLeaves != m_params.m_nDistinct) {
+        line.append(TCHAR('g'));
+        line.appendInt(firstLeaf);
+        line.append(TCHAR('_'));
+        line.appendInt(firstLeaf + nLeaves - 1);
+    }
+
+    int nChildren = min(m_params.m_fanOut, nLeaves);
+    for (int c = 0; c < nChildren; ++c) {
+        int childFirst = firstLeaf + c * nLeaves / nChildren;
+        int childEnd = firstLeaf + (c + 1) * nLeaves / nChildren;
+        line.append(TCHAR(' '));
+        appendHierarchy(line, attribIdx, childFirst, childEnd - childFirst);
+    }
+    line.append(TCHAR('}'));
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDBenchmark::appendLeafValue(CTDByteBuffer& line, int attribIdx, int leafIdx) const
+{
+    line.append(TCHAR('a'));
+    line.appendInt(attribIdx);
+    line.append(TCHAR('v'));
+    line.appendInt(leafIdx);
+}
+
+//---------------------------------------------------------------------------
+// Parse the raw records into CTDRecords.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchReadRecords()
+{
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        if (!m_dataMgr.readRecords(m_rawRecords))
+            return false;
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("readRecords"), _T("records"), m_rawRecords.GetSize(), bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Match raw categorical values to their leaf concepts and pack their
+// root-to-leaf paths.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchBuildBitValue()
+{
+    CTDAttrib* pAttrib = m_attribMgr.getAttribute(0);
+    CStringArray valueStrs;
+    CTDByteBuffer valueStr;
+    valueStrs.SetSize(m_params.m_nRows);
+    for (int r = 0; r < m_params.m_nRows; ++r) {
+        valueStr.reset();
+        appendLeafValue(valueStr, 0, rand() % m_params.m_nDistinct);
+        valueStrs[r] = CString(valueStr.getData(), valueStr.getSize());
+    }
+
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        for (int r = 0; r < m_params.m_nRows; ++r) {
+            CTDStringValue value;
+            if (!value.buildBitValue(valueStrs[r], pAttrib)) {
+                ASSERT(false);
+                return false;
+            }
+        }
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("buildBitValue"), _T("values"), m_params.m_nRows, bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Sort the records in input order by the first continuous attribute.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchSortByAttrib()
+{
+    if (m_params.m_nAttribs < 2)
+        return true;
+
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        CTDRecords recs;
+        recs.Copy(*m_dataMgr.getRecords());
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        if (!recs.sortByAttrib(1))
+            return false;
+        keepBest(bestNanos, startNanos);
+        recs.RemoveAll();
+    }
+    addResult(_T("sortByAttrib"), _T("records"), m_params.m_nRows, bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Support matrices of the root partition. The first call splits the root
+// concepts of the continuous attributes, which later calls reuse, so it is
+// not timed.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchConstructSupportMatrix()
+{
+    LONGLONG bestNanos = -1;
+    for (int rep = -1; rep < m_params.m_nReps; ++rep) {
+        CTDPartition* pPartition = makeRootPartition();
+        if (!pPartition)
+            return false;
+
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        bool bSucceeded = pPartition->constructSupportMatrix(TD_BENCH_EPSILON);
+        if (rep >= 0)
+            keepBest(bestNanos, startNanos);
+
+        pPartition->getGenRecords()->cleanup();
+        delete pPartition;
+        if (!bSucceeded)
+            return false;
+    }
+    addResult(_T("constructSupportMatrix"), _T("records"), m_params.m_nRows, bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Score the split points of the root concept of the first continuous
+// attribute.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchFindOptimalSplitPoint()
+{
+    if (m_params.m_nAttribs < 2)
+        return true;
+
+    CTDAttrib* pContAttrib = m_attribMgr.getAttribute(1);
+    CTDRecords* pRecs = m_dataMgr.getRecords();
+    if (!pRecs->sortByAttrib(pContAttrib->m_attribIdx))
+        return false;
+
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        CTDPartAttrib partAttrib(pContAttrib);
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        if (!partAttrib.findOptimalSplitPoint(*pRecs, m_params.m_nClasses, TD_BENCH_EPSILON, pContAttrib->getConceptRoot()))
+            return false;
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("findOptimalSplitPoint"), _T("records"), m_params.m_nRows, bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Draws of the exponential mechanisms from m_nDistinct candidates.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchExpoMech()
+{
+    CTDFloatArray weights, ranges;
+    weights.SetSize(m_params.m_nDistinct);
+    ranges.SetSize(m_params.m_nDistinct);
+    for (int i = 0; i < m_params.m_nDistinct; ++i) {
+        weights[i] = float(rand() % m_params.m_nRows);
+        ranges[i] = float(1 + rand() % m_params.m_nDistinct);
+    }
+
+    int sum = 0;
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        for (int i = 0; i < TD_BENCH_NUM_CALLS; ++i)
+            sum += expoMech(TD_BENCH_EPSILON, &weights);
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("expoMech"), _T("calls"), TD_BENCH_NUM_CALLS, bestNanos);
+
+    bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        for (int i = 0; i < TD_BENCH_NUM_CALLS; ++i)
+            sum += expoMechSplit(TD_BENCH_EPSILON, &weights, &ranges);
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("expoMechSplit"), _T("calls"), TD_BENCH_NUM_CALLS, bestNanos);
+    return sum >= 0;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchLaplaceNoise()
+{
+    double sum = 0;
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        for (int i = 0; i < TD_BENCH_NUM_CALLS; ++i)
+            sum += laplaceNoise(TD_BENCH_EPSILON);
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("laplaceNoise"), _T("calls"), TD_BENCH_NUM_CALLS, bestNanos);
+    return sum == sum;
+}
+
+//---------------------------------------------------------------------------
+// Output rows of the training records with every categorical concept as a
+// feature and the categorical values at their raw concepts.
+//---------------------------------------------------------------------------
+bool CTDBenchmark::benchConvertRecord()
+{
+    int a = 0, r = 0;
+    int nAttribs = m_attribMgr.getNumAttributes() - 1;
+    for (a = 0; a < nAttribs; ++a) {
+        CTDConcepts* pFlattenConcepts = m_attribMgr.getAttribute(a)->getFlattenConcepts();
+        for (int c = 0; c < pFlattenConcepts->GetSize(); ++c)
+            pFlattenConcepts->GetAt(c)->m_bFileName = true;
+    }
+    if (!m_attribMgr.buildMultiDimConcepts())
+        return false;
+
+    CTDRecords* pRecs = m_dataMgr.getRecords();
+    for (r = 0; r < pRecs->GetSize(); ++r) {
+        for (a = 0; a < nAttribs; ++a) {
+            if (m_attribMgr.getAttribute(a)->isContinuous())
+                continue;
+            CTDStringValue* pValue = static_cast<CTDStringValue*>(pRecs->GetAt(r)->getValue(a));
+            if (!pValue->setCurConcept(pValue->getRawConcept()))
+                return false;
+        }
+    }
+
+    CTDByteBuffer row;
+    LONGLONG bestNanos = -1;
+    for (int rep = 0; rep < m_params.m_nReps; ++rep) {
+        LONGLONG startNanos = CTDProfiler::getNanos();
+        for (r = 0; r < pRecs->GetSize(); ++r)
+            m_dataMgr.convertRecord(pRecs->GetAt(r), TD_bC45 != 0, row);
+        keepBest(bestNanos, startNanos);
+    }
+    addResult(_T("convertRecord"), _T("records"), pRecs->GetSize(), bestNanos);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// A partition of all training records, as CTDPartitioner::transformData
+// starts with.
+//---------------------------------------------------------------------------
+CTDPartition* CTDBenchmark::makeRootPartition()
+{
+    CTDPartition* pPartition = new CTDPartition(0, m_attribMgr.getAttributes());
+    CTDRecords* pRecs = m_dataMgr.getRecords();
+    for (int r = 0; r < pRecs->GetSize(); ++r) {
+        if (!pPartition->addRecord(pRecs->GetAt(r))) {
+            delete pPartition;
+            return NULL;
+        }
+    }
+    if (!pPartition->initGenRecords(m_attribMgr.getAttributes())) {
+        delete pPartition;
+        return NULL;
+    }
+    return pPartition;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDBenchmark::addResult(LPCTSTR kernel, LPCTSTR itemName, LONGLONG nItems, LONGLONG bestNanos)
+{
+    TDBenchResult result;
+    result.m_kernel = kernel;
+    result.m_itemName = itemName;
+    result.m_nItems = nItems;
+    result.m_bestNanos = bestNanos;
+    m_results.Add(result);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDBenchmark::keepBest(LONGLONG& bestNanos, LONGLONG startNanos)
+{
+    LONGLONG nanos = CTDProfiler::getNanos() - startNanos;
+    if (bestNanos < 0 || nanos < bestNanos)
+        bestNanos = nanos;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+double CTDBenchmark::getThroughput(const TDBenchResult& result)
+{
+    return result.m_bestNanos > 0 ? result.m_nItems * 1e9 / result.m_bestNanos : 0;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDBenchmark::printResults() const
+{
+    cout << _T("rows = ") << m_params.m_nRows
+         << _T(", attributes = ") << m_params.m_nAttribs
+         << _T(", fan-out = ") << m_params.m_fanOut
+         << _T(", classes = ") << m_params.m_nClasses
+         << _T(", distinct values = ") << m_params.m_nDistinct
+         << _T(", best of ") << m_params.m_nReps << endl;
+    for (int i = 0; i < m_results.GetSize(); ++i) {
+        const TDBenchResult& result = m_results[i];
+        cout << _T("    ") << result.m_kernel << _T(": ") << result.m_nItems << _T(" ") << result.m_itemName
+             << _T(" in ") << result.m_bestNanos / 1e6 << _T(" ms, ")
+             << getThroughput(result) << _T(" ") << result.m_itemName << _T("/s") << endl;
+    }
+    cout << endl;
+}
+
+//---------------------------------------------------------------------------
+// kernel,items,item,best_ns,items_per_s
+//---------------------------------------------------------------------------
+bool CTDBenchmark::writeResults(LPCTSTR resultFile) const
+{
+    CTDByteBuffer buffer;
+    buffer.append(_T("kernel,items,item,best_ns,items_per_s\n"));
+    for (int i = 0; i < m_results.GetSize(); ++i) {
+        const TDBenchResult& result = m_results[i];
+        buffer.append(result.m_kernel);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendFloat(double(result.m_nItems), 0);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.append(result.m_itemName);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendFloat(double(result.m_bestNanos), 0);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendFloat(getThroughput(result), 0);
+        buffer.append(TCHAR('\n'));
+    }
+
+    cout << _T("Writing ") << resultFile << _T("...") << endl;
+    try {
+        CFile file;
+        if (!file.Open(resultFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDBenchmark: Failed to open file ") << resultFile << endl;
+            return false;
+        }
+        file.Write(buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write benchmark results: ") << resultFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
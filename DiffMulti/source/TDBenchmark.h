@@ -0,0 +1,92 @@
+// TDBenchmark.h: interface for the CTDBenchmark class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDBENCHMARK_H)
+#define TDBENCHMARK_H
+
+#if !defined(TDDATAMGR_H)
+    #include "TDDataMgr.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Shape of the synthetic data set of a benchmark. Attributes alternate
+// between categorical and continuous, starting with categorical. A
+// categorical attribute has nDistinct leaf values under a balanced
+// hierarchy with the given fan-out; a continuous attribute takes nDistinct
+// integer values in [0, nDistinct).
+//---------------------------------------------------------------------------
+struct TDBenchParams
+{
+    int      m_nRows;
+    int      m_nAttribs;                // Excluding the class.
+    int      m_fanOut;
+    int      m_nClasses;
+    int      m_nDistinct;
+    int      m_nReps;
+    unsigned m_seed;
+};
+
+//---------------------------------------------------------------------------
+// Best time over the repetitions of a kernel and the number of items, e.g.,
+// records or calls, it processed each time.
+//---------------------------------------------------------------------------
+struct TDBenchResult
+{
+    CString  m_kernel;
+    CString  m_itemName;
+    LONGLONG m_nItems;
+    LONGLONG m_bestNanos;
+};
+
+typedef CArray<TDBenchResult, const TDBenchResult&> CTDBenchResultArray;
+
+//---------------------------------------------------------------------------
+// Micro-benchmarks of the kernels of the engine on a synthetic data set
+// held in memory. Each kernel runs m_nReps times on the same input and
+// reports its best time, so that engine changes can be compared by
+// throughput. Untimed setup, e.g., restoring the record order before a
+// sort, is done between the repetitions.
+//---------------------------------------------------------------------------
+class CTDBenchmark
+{
+public:
+    CTDBenchmark(const TDBenchParams& params);
+    virtual ~CTDBenchmark();
+
+// Operations
+    bool run();
+    void printResults() const;
+    bool writeResults(LPCTSTR resultFile) const;
+
+    int getNumResults() const { return m_results.GetSize(); };
+    const TDBenchResult& getResult(int resultIdx) const { return m_results[resultIdx]; };
+
+protected:
+    bool generate();
+    void appendHierarchy(CTDByteBuffer& line, int attribIdx, int firstLeaf, int nLeaves) const;
+    void appendLeafValue(CTDByteBuffer& line, int attribIdx, int leafIdx) const;
+    bool benchReadRecords();
+    bool benchBuildBitValue();
+    bool benchSortByAttrib();
+    bool benchConstructSupportMatrix();
+    bool benchFindOptimalSplitPoint();
+    bool benchExpoMech();
+    bool benchLaplaceNoise();
+    bool benchConvertRecord();
+    CTDPartition* makeRootPartition();
+    void addResult(LPCTSTR kernel, LPCTSTR itemName, LONGLONG nItems, LONGLONG bestNanos);
+
+    static void keepBest(LONGLONG& bestNanos, LONGLONG startNanos);
+    static double getThroughput(const TDBenchResult& result);
+
+// Attributes
+    TDBenchParams       m_params;
+    CStringArray        m_hierarchyLines;
+    CStringArray        m_rawRecords;
+    CTDAttribMgr        m_attribMgr;
+    CTDDataMgr          m_dataMgr;
+    CTDBenchResultArray m_results;
+};
+
+#endif
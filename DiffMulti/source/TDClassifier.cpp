@@ -0,0 +1,234 @@
+// TDClassifier.cpp: implementation of the CTDClassifier class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDCLASSIFIER_H)
+    #include "TDClassifier.h"
+#endif
+
+CTDClassifier::CTDClassifier()
+    : m_nFeatures(0),
+      m_nClasses(0),
+      m_nModels(0)
+{
+}
+
+CTDClassifier::~CTDClassifier()
+{
+}
+
+//---------------------------------------------------------------------------
+// Collect the features and noisy counts of the leaf partitions and train
+// the models. As in SVM-light, the cost is the inverse of the average
+// squared norm of the training records.
+//---------------------------------------------------------------------------
+bool CTDClassifier::train(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr, CTDPartitions* pLeafPartitions)
+{
+    cout << _T("Training classifier on the leaf partitions...") << endl;
+
+    // The multidimensional concepts are otherwise built with the .names file.
+    if (!pAttribMgr->buildMultiDimConcepts())
+        return false;
+
+    int nAttribs = pAttribMgr->getNumAttributes() - 1;
+    m_nFeatures = 1;
+    for (int a = 0; a < nAttribs; ++a) {
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(a);
+        m_nFeatures += pAttrib->isContinuous() ? 1 : pAttrib->getMultiDimConcepts()->GetSize();
+    }
+    m_nClasses = pAttribMgr->getNumClasses();
+    m_nModels = m_nClasses == 2 ? 1 : m_nClasses;
+
+    m_rowStarts.RemoveAll();
+    m_colIndices.RemoveAll();
+    m_values.RemoveAll();
+    m_rowCounts.RemoveAll();
+    CTDIntArray colIndices;
+    CTDFloatArray values;
+    double sumSqNorms = 0.0, nRecords = 0.0;
+    for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL;) {
+        CTDPartition* pPartition = pLeafPartitions->GetNext(pos);
+        pDataMgr->convertRecordSparse(pPartition->getGenRecords()->GetAt(0), colIndices, values);
+        colIndices.Add(m_nFeatures - 1);
+        values.Add(1.0f);
+
+        double sqNorm = 0.0;
+        m_rowStarts.Add(m_colIndices.GetSize());
+        for (int i = 0; i < colIndices.GetSize(); ++i) {
+            m_colIndices.Add(colIndices[i]);
+            m_values.Add(values[i]);
+            sqNorm += values[i] * values[i];
+        }
+
+        int total = 0;
+        for (int j = 0; j < m_nClasses; ++j) {
+            int count = j < pPartition->m_classNoisySums.GetSize() ? pPartition->m_classNoisySums[j] : 0;
+            m_rowCounts.Add(count);
+            total += count;
+        }
+        sumSqNorms += sqNorm * total;
+        nRecords += total;
+    }
+    m_rowStarts.Add(m_colIndices.GetSize());
+
+    if (nRecords <= 0.0 || sumSqNorms <= 0.0) {
+        cerr << _T("CTDClassifier: No training records.") << endl;
+        return false;
+    }
+
+    double cost = nRecords / sumSqNorms;
+    m_weights.SetSize(m_nModels * m_nFeatures);
+    for (int k = 0; k < m_nModels; ++k)
+        trainModel(k, cost);
+
+    cout << _T("Training classifier succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Train model k of class k against the rest. Each leaf is a positive
+// instance weighted by its count of class k and a negative instance
+// weighted by its other counts; the weight scales the upper bound of the
+// dual variable.
+//---------------------------------------------------------------------------
+void CTDClassifier::trainModel(int modelIdx, double cost)
+{
+    int nRows = m_rowStarts.GetSize() - 1;
+    double* pWeights = m_weights.GetData() + modelIdx * m_nFeatures;
+    for (int f = 0; f < m_nFeatures; ++f)
+        pWeights[f] = 0.0;
+
+    // Instance 2l is leaf l as positive, 2l + 1 as negative.
+    CTDDoubleArray upperBounds, alphas, sqNorms;
+    upperBounds.SetSize(2 * nRows);
+    alphas.SetSize(2 * nRows);
+    sqNorms.SetSize(nRows);
+    for (int l = 0; l < nRows; ++l) {
+        int nPositive = 0, nNegative = 0;
+        for (int j = 0; j < m_nClasses; ++j) {
+            if (j == modelIdx)
+                nPositive += m_rowCounts[l * m_nClasses + j];
+            else
+                nNegative += m_rowCounts[l * m_nClasses + j];
+        }
+        upperBounds[2 * l] = cost * nPositive;
+        upperBounds[2 * l + 1] = cost * nNegative;
+        alphas[2 * l] = alphas[2 * l + 1] = 0.0;
+
+        sqNorms[l] = 0.0;
+        for (int i = m_rowStarts[l]; i < m_rowStarts[l + 1]; ++i)
+            sqNorms[l] += m_values[i] * m_values[i];
+    }
+
+    const int* pColIndices = m_colIndices.GetData();
+    const float* pValues = m_values.GetData();
+    for (int iter = 0; iter < TD_CLASSIFIER_MAX_ITERS; ++iter) {
+        double maxPG = -DBL_MAX, minPG = DBL_MAX;
+        for (int inst = 0; inst < 2 * nRows; ++inst) {
+            double upperBound = upperBounds[inst];
+            if (upperBound <= 0.0)
+                continue;
+
+            int l = inst / 2;
+            double label = (inst % 2 == 0) ? 1.0 : -1.0;
+            int rowStart = m_rowStarts[l], nValues = m_rowStarts[l + 1] - rowStart;
+            double gradient = label * computeScore(modelIdx, pColIndices + rowStart, pValues + rowStart, nValues) - 1.0;
+
+            // Projected gradient
+            double alpha = alphas[inst];
+            double projGradient = gradient;
+            if (alpha <= 0.0)
+                projGradient = min(gradient, 0.0);
+            else if (alpha >= upperBound)
+                projGradient = max(gradient, 0.0);
+            maxPG = max(maxPG, projGradient);
+            minPG = min(minPG, projGradient);
+            if (projGradient == 0.0)
+                continue;
+
+            double newAlpha = min(max(alpha - gradient / sqNorms[l], 0.0), upperBound);
+            double delta = (newAlpha - alpha) * label;
+            alphas[inst] = newAlpha;
+            for (int i = 0; i < nValues; ++i)
+                pWeights[pColIndices[rowStart + i]] += delta * pValues[rowStart + i];
+        }
+
+        // Optimal when every projected gradient is 0.
+        if (max(maxPG, -minPG) <= TD_CLASSIFIER_EPSILON)
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// pColIndices may include the bias feature.
+//---------------------------------------------------------------------------
+double CTDClassifier::computeScore(int modelIdx, const int* pColIndices, const float* pValues, int nValues) const
+{
+    const double* pWeights = m_weights.GetData() + modelIdx * m_nFeatures;
+    double score = 0.0;
+    for (int i = 0; i < nValues; ++i)
+        score += pWeights[pColIndices[i]] * pValues[i];
+    return score;
+}
+
+//---------------------------------------------------------------------------
+// Predict the class of a multidimensional record without the bias feature.
+//---------------------------------------------------------------------------
+int CTDClassifier::predict(const CTDIntArray& colIndices, const CTDFloatArray& values) const
+{
+    if (m_nModels == 1) {
+        double score = computeScore(0, colIndices.GetData(), values.GetData(), colIndices.GetSize()) + m_weights[m_nFeatures - 1];
+        return score >= 0.0 ? 0 : 1;
+    }
+
+    int bestClass = 0;
+    double bestScore = -DBL_MAX;
+    for (int k = 0; k < m_nModels; ++k) {
+        double score = computeScore(k, colIndices.GetData(), values.GetData(), colIndices.GetSize()) + m_weights[(k + 1) * m_nFeatures - 1];
+        if (score > bestScore) {
+            bestScore = score;
+            bestClass = k;
+        }
+    }
+    return bestClass;
+}
+
+//---------------------------------------------------------------------------
+// Fraction of the test records whose class is predicted. The records of a
+// test leaf share its generalized values, so each leaf is predicted once.
+//---------------------------------------------------------------------------
+bool CTDClassifier::evaluate(CTDDataMgr* pDataMgr, CTDTestRouter* pTestRouter, double& accuracy) const
+{
+    if (m_weights.GetSize() == 0) {
+        ASSERT(false);
+        return false;
+    }
+
+    int nCorrect = 0, nTotal = 0;
+    CTDIntArray colIndices;
+    CTDFloatArray values;
+    for (int l = 0; l < pTestRouter->getNumLeaves(); ++l) {
+        int nLeafRecords = pTestRouter->getNumLeafRecords(l);
+        if (nLeafRecords == 0)
+            continue;
+
+        CTDRecord* pRec = pTestRouter->getLeafRecord(l, 0);
+        int classIdx = pRec->getNumValues() - 1;
+        pDataMgr->convertRecordSparse(pRec, colIndices, values);
+        int predictedClass = predict(colIndices, values);
+        for (int i = 0; i < nLeafRecords; ++i) {
+            if (pTestRouter->getLeafRecord(l, i)->getValue(classIdx)->getCurrentConcept()->m_childIdx == predictedClass)
+                ++nCorrect;
+        }
+        nTotal += nLeafRecords;
+    }
+
+    if (nTotal == 0) {
+        cerr << _T("CTDClassifier: No test records.") << endl;
+        return false;
+    }
+    accuracy = double(nCorrect) / nTotal;
+    return true;
+}
@@ -0,0 +1,49 @@
+// TDClassifier.h: interface for the CTDClassifier class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDCLASSIFIER_H)
+#define TDCLASSIFIER_H
+
+#if !defined(TDDATAMGR_H)
+    #include "TDDataMgr.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Linear SVM trained in memory on the leaf partitions, for measuring the
+// classification accuracy of a run without writing the data files and
+// running SVM-light. The features of a leaf are its multidimensional
+// record as in CTDDataMgr::convertRecordSparse, plus a bias feature. The
+// noisy count of each class is the weight of the leaf with that label.
+// Trained by dual coordinate descent; more than two classes are
+// classified one-vs-rest.
+//---------------------------------------------------------------------------
+class CTDClassifier
+{
+public:
+    CTDClassifier();
+    virtual ~CTDClassifier();
+
+// Operations
+    bool train(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr, CTDPartitions* pLeafPartitions);
+    int predict(const CTDIntArray& colIndices, const CTDFloatArray& values) const;
+    bool evaluate(CTDDataMgr* pDataMgr, CTDTestRouter* pTestRouter, double& accuracy) const;
+
+    int getNumFeatures() const { return m_nFeatures; };
+
+protected:
+    void trainModel(int modelIdx, double cost);
+    double computeScore(int modelIdx, const int* pColIndices, const float* pValues, int nValues) const;
+
+// Attributes
+    int            m_nFeatures;         // Including the bias feature, which is last.
+    int            m_nClasses;
+    int            m_nModels;           // One for two classes, otherwise one per class.
+    CTDIntArray    m_rowStarts;         // Features of leaf l are [m_rowStarts[l], m_rowStarts[l + 1]).
+    CTDIntArray    m_colIndices;
+    CTDFloatArray  m_values;
+    CTDIntArray    m_rowCounts;         // Noisy count of leaf l and class j at l * m_nClasses + j.
+    CTDDoubleArray m_weights;           // Weights of model k at k * m_nFeatures.
+};
+
+#endif
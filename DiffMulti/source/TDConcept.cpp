@@ -12,6 +12,10 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDMEMTRACKER_H)
+    #include "TDMemTracker.h"
+#endif
+
 //**************
 // CTDConcepts *
 //**************
@@ -55,7 +59,8 @@ CTDConcept::CTDConcept(CTDAttrib* pAttrib)
       m_bCutCandidate(true),
       m_cutPos(NULL),
 	  m_bFileName(false),
-	  m_nLeafConcepts(-1)
+	  m_nLeafConcepts(-1),
+	  m_multiDimIdx(-1)
      
 {
 }
@@ -112,10 +117,16 @@ int CTDConcept::getNumChildConcepts() const
 }
 
 //---------------------------------------------------------------------------
-// Return the number of leaf concepts of the tree rooted at the this concept
+// Return the number of leaf concepts of the tree rooted at the this concept.
+// A categorical hierarchy does not change after it is built, so its counts
+// are taken from m_nLeafConcepts; a continuous concept gains children when
+// it is split, so its leaves are counted.
 //---------------------------------------------------------------------------
 int CTDConcept::getNumLeafConcepts()
 { 
+	if (!isContinuous())
+		return m_nLeafConcepts;
+
 	int nLeaves = 0;
 	if (getNumChildConcepts() == 0)
 		return 1;
@@ -144,7 +155,7 @@ CTDConcept* CTDConcept::getParentConcept()
 }
 
 //---------------------------------------------------------------------------
-// Compute NCP for this concept.
+// NCP of this concept, from the table built with the hierarchy.
 // Please refer to our paper.
 //---------------------------------------------------------------------------
 bool CTDConcept::computeNCPHelper(float& ncp)
@@ -155,45 +166,180 @@ bool CTDConcept::computeNCPHelper(float& ncp)
         return false;
 	}
 
-	ncp = 0;
-	
-	int nCurrLeafConcepts = this->getNumLeafConcepts();	// Rooted at this concept.
-	int nTotalLeafConcepts = this->getAttrib()->getConceptRoot()->m_nLeafConcepts;
-	if (nCurrLeafConcepts == 1) 
-		ncp = 0;
-	else 
-		ncp = float (nCurrLeafConcepts * 1.0 / nTotalLeafConcepts);
+	ncp = m_pAttrib->getConceptNCP(this);
+    return true;
+}
 
+//---------------------------------------------------------------------------
+// Build the tree rooted at this concept from a hierarchy string.
+// {Any_Location {BC {Vancouver} {Surrey} {Richmond}} {AB {Calgary} {Edmonton}}}
+// The string is scanned once from left to right, so the cost is linear in
+// its length regardless of the size of the hierarchy.
+//---------------------------------------------------------------------------
+bool CTDConcept::initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth)
+{
+    LPCTSTR pCur = conceptStr;
+    if (!parseHierarchy(pCur, depth, maxBranches, maxDepth)) {
+        cerr << _T("CTDConcept: Failed to build hierarchy from ") << conceptStr << endl;
+        return false;
+    }
+
+    // Nothing but spaces may follow the closing tag of the root.
+    skipSpaces(pCur);
+    if (*pCur != TCHAR('\0')) {
+        cerr << _T("CTDConcept: Unexpected characters after hierarchy: ") << pCur << endl;
+        ASSERT(false);
+        return false;
+    }
     return true;
 }
 
 //---------------------------------------------------------------------------
+// Recursive-descent parser. pCur points at the opening tag of this concept
+// and is advanced past its closing tag. Depth, maximum branches per level
+// and the number of leaf concepts are computed in the same traversal.
 //---------------------------------------------------------------------------
-// static
-bool CTDConcept::parseFirstConcept(CString& firstConcept, CString& restStr)
+bool CTDConcept::parseHierarchy(LPCTSTR& pCur, int depth, CTDIntArray& maxBranches, int& maxDepth)
 {
-    firstConcept.Empty();
-    int len = restStr.GetLength();
-    if (len < 2 ||
-        restStr[0] !=  TD_CONHCHY_OPENTAG || 
-        restStr[len - 1] !=  TD_CONHCHY_CLOSETAG) {
-		ASSERT(false);
+    skipSpaces(pCur);
+    if (*pCur != TD_CONHCHY_OPENTAG) {
+        ASSERT(false);
+        return false;
+    }
+    ++pCur;
+
+    // Extract "Canada", which ends at the first child or at the closing tag.
+    LPCTSTR pValue = pCur;
+    while (*pCur != TCHAR('\0') && *pCur != TD_CONHCHY_OPENTAG && *pCur != TD_CONHCHY_CLOSETAG)
+        ++pCur;
+
+    CString valueStr(pValue, int(pCur - pValue));
+    CBFStrHelper::trim(valueStr);
+    if (valueStr.IsEmpty() || !assignConceptValue(valueStr)) {
+        ASSERT(false);
         return false;
     }
 
-    // Find the index number of the closing tag of the first concept
+    // A concept without its hierarchy, i.e., a continuous root, keeps depth -1.
+    if (isChildrenInHierarchy()) {
+        m_depth = depth;
+
+        // Update maxDepth
+        depth > maxDepth ? maxDepth = depth : maxDepth;
+    }
+
+    // Depth-first build
+    m_nLeafConcepts = 0;
+    while (true) {
+        skipSpaces(pCur);
+        if (*pCur == TD_CONHCHY_CLOSETAG) {
+            ++pCur;
+            break;
+        }
+        if (*pCur != TD_CONHCHY_OPENTAG) {
+            // Missing closing tag or garbage between child concepts.
+            ASSERT(false);
+            return false;
+        }
+
+        if (!isChildrenInHierarchy()) {
+            if (!skipConcept(pCur))
+                return false;
+            continue;
+        }
+
+        CTDConcept* pNewConcept = newChildConcept();
+        if (!pNewConcept)
+            return false;
+
+        if (!pNewConcept->parseHierarchy(pCur, depth + 1, maxBranches, maxDepth)) {
+            delete pNewConcept;
+            return false;
+        }
+
+        if (!addChildConcept(pNewConcept))
+            return false;
+
+        m_nLeafConcepts += pNewConcept->m_nLeafConcepts;
+    }
+
+    // Update the maximum # of branches at this level
+    int nChildren = getNumChildConcepts();
+    if (nChildren > 0) {
+        while (depth > maxBranches.GetUpperBound())	
+            maxBranches.Add(0);
+        if (nChildren > maxBranches[depth])			
+            maxBranches[depth] = nChildren;		 
+    }
+    else
+        m_nLeafConcepts = 1;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Copy the tree rooted at this concept for pAttrib, a copy of its
+// attribute. The copy is not in any cut.
+//---------------------------------------------------------------------------
+CTDConcept* CTDConcept::cloneHierarchy(CTDAttrib* pAttrib)
+{
+    CTDConcept* pNewConcept = copyConcept(pAttrib);
+    if (!pNewConcept) {
+        ASSERT(false);
+        return NULL;
+    }
+
+    for (int c = 0; c < getNumChildConcepts(); ++c) {
+        CTDConcept* pChildConcept = getChildConcept(c);
+        CTDConcept* pNewChildConcept = pChildConcept->cloneHierarchy(pAttrib);
+        if (!pNewChildConcept || !pNewConcept->addChildConcept(pNewChildConcept, pChildConcept->m_childIdx)) {
+            delete pNewChildConcept;
+            delete pNewConcept;
+            return NULL;
+        }
+    }
+    return pNewConcept;
+}
+
+//---------------------------------------------------------------------------
+// Copy the attributes of pSrcConcept except its place in the tree and in
+// the cut.
+//---------------------------------------------------------------------------
+void CTDConcept::copyFrom(const CTDConcept* pSrcConcept)
+{
+    m_conceptValue = pSrcConcept->m_conceptValue;
+    m_depth = pSrcConcept->m_depth;
+    m_flattenIdx = pSrcConcept->m_flattenIdx;
+    m_bCutCandidate = pSrcConcept->m_bCutCandidate;
+    m_bFileName = pSrcConcept->m_bFileName;
+    m_nLeafConcepts = pSrcConcept->m_nLeafConcepts;
+    m_multiDimIdx = pSrcConcept->m_multiDimIdx;
+    m_multiDimBits.Copy(pSrcConcept->m_multiDimBits);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDConcept::skipSpaces(LPCTSTR& pCur)
+{
+    while (*pCur == TCHAR(' ') || *pCur == TCHAR('\t') || *pCur == TCHAR('\r') || *pCur == TCHAR('\n'))
+        ++pCur;
+}
+
+//---------------------------------------------------------------------------
+// Advance pCur past the concept starting at pCur, including its sub-tree.
+//---------------------------------------------------------------------------
+// static
+bool CTDConcept::skipConcept(LPCTSTR& pCur)
+{
     int tagCount = 0;
-    for (int i = 0; i < len; ++i) {
-        if (restStr[i] == TD_CONHCHY_OPENTAG)
+    for (; *pCur != TCHAR('\0'); ++pCur) {
+        if (*pCur == TD_CONHCHY_OPENTAG)
             ++tagCount;
-        else if (restStr[i] == TD_CONHCHY_CLOSETAG) {
+        else if (*pCur == TD_CONHCHY_CLOSETAG) {
             --tagCount;
             ASSERT(tagCount >= 0);
             if (tagCount == 0) {
-                // Closing tag of first concept found
-                firstConcept = restStr.Left(i + 1);
-                restStr = restStr.Mid(i + 1);
-                CBFStrHelper::trim(restStr);
+                ++pCur;
                 return true;
             }
         }
@@ -211,59 +357,31 @@ bool CTDConcept::parseFirstConcept(CString& firstConcept, CString& restStr)
 CTDDiscConcept::CTDDiscConcept(CTDAttrib* pAttrib) 
     : CTDConcept(pAttrib), m_pSplitConcept(NULL)
 {
+    CTDMemTracker::add(TD_MEM_CONCEPTS, sizeof(CTDDiscConcept));
 }
 
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 CTDDiscConcept::~CTDDiscConcept() 
 {
+    CTDMemTracker::add(TD_MEM_CONCEPTS, -LONGLONG(sizeof(CTDDiscConcept)));
 }
 
 //---------------------------------------------------------------------------
-// {Any_Location {BC {Vancouver} {Surrey} {Richmond}} {AB {Calgary} {Edmonton}}}
+// A copy of this concept, without its children, for pAttrib.
 //---------------------------------------------------------------------------
-bool CTDDiscConcept::initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth)
+CTDConcept* CTDDiscConcept::copyConcept(CTDAttrib* pAttrib)
 {
-    // Parse the conceptValue and the rest of the string
-    CString restStr;
-    if (!parseConceptValue(conceptStr, m_conceptValue, restStr)) {
-        cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << conceptStr << endl;
-        return false;
-    }
-    m_depth = depth;
-
-	// Update maxDepth
-	depth > maxDepth ? maxDepth = depth : maxDepth;
-
-    // Depth-first build
-    CString firstConcept;
-    while (!restStr.IsEmpty()) {
-        if (!parseFirstConcept(firstConcept, restStr)) {
-            cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << restStr << endl;
-            return false;
-        }
-
-        CTDDiscConcept* pNewConcept = new CTDDiscConcept(m_pAttrib);
-        if (!pNewConcept)
-            return false;
-        
-        if (!pNewConcept->initHierarchy(firstConcept, depth + 1, maxBranches, maxDepth)) {
-            cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << firstConcept << endl;
-            return false;
-        }
-
-        if (!addChildConcept(pNewConcept))
-            return false;
-    }
+    CTDDiscConcept* pNewConcept = new CTDDiscConcept(pAttrib);
+    pNewConcept->copyFrom(this);
+    return pNewConcept;
+}
 
-    // Update the maximum # of branches at this level
-    int nChildren = getNumChildConcepts();
-    if (nChildren > 0) {
-        while (depth > maxBranches.GetUpperBound())	
-            maxBranches.Add(0);
-        if (nChildren > maxBranches[depth])			
-            maxBranches[depth] = nChildren;		 
-    }
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDDiscConcept::assignConceptValue(const CString& valueStr)
+{
+    m_conceptValue = valueStr;
     return true;
 }
 
@@ -298,51 +416,6 @@ bool CTDDiscConcept::isAncestor(CTDConcept* pTargetConcept)
 	return false;
 }
 
-//---------------------------------------------------------------------------
-//---------------------------------------------------------------------------
-// static
-bool CTDDiscConcept::parseConceptValue(LPCTSTR str, CString& conceptVal, CString& restStr)
-{
-    conceptVal.Empty();
-    restStr.Empty();
-
-    CString wrkStr = str;
-    if (wrkStr.GetLength() < 2 ||
-        wrkStr[0] !=  TD_CONHCHY_OPENTAG || 
-        wrkStr[wrkStr.GetLength() - 1] !=  TD_CONHCHY_CLOSETAG) {
-        ASSERT(false);
-        return false;
-    }
-
-    // Extract "Canada {BC {Vancouver} {Surrey} {Richmond}} {AB {Calgary} {Edmonton}}"
-    wrkStr = wrkStr.Mid(1, wrkStr.GetLength() - 2);
-    CBFStrHelper::trim(wrkStr);
-    if (wrkStr.IsEmpty()) {
-        ASSERT(false);
-        return false;
-    }
-
-    // Extract "Canada"
-    int openPos = wrkStr.Find(TD_CONHCHY_OPENTAG);
-    if (openPos < 0) {
-        // This is root value, e.g., "Vancouver"
-        conceptVal = wrkStr;
-        return true;
-    }
-    else {
-        conceptVal = wrkStr.Left(openPos);
-        CBFStrHelper::trim(conceptVal);
-        if (conceptVal.IsEmpty()) {
-            ASSERT(false);
-            return false;
-        }
-    }
-
-    // Extract "{BC {Vancouver} {Surrey} {Richmond}} {AB {Calgary} {Edmonton}}"
-    restStr = wrkStr.Mid(openPos);
-    return true;
-}
-
 //*****************
 // CTDContConcept *
 //*****************
@@ -352,55 +425,39 @@ CTDContConcept::CTDContConcept(CTDAttrib* pAttrib)
 		m_lowerBound(0.0f), 
 		m_upperBound(0.0f)	
 {
+    CTDMemTracker::add(TD_MEM_CONCEPTS, sizeof(CTDContConcept));
 }
 
 CTDContConcept::~CTDContConcept() 
 {
+    CTDMemTracker::add(TD_MEM_CONCEPTS, -LONGLONG(sizeof(CTDContConcept)));
 }
 
 //---------------------------------------------------------------------------
-// {0-100 {0-50 {<25} {25-50}} {50-100 {50-75} {75-100}}}
+// A copy of this interval, without its children, for pAttrib.
 //---------------------------------------------------------------------------
-bool CTDContConcept::initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth)
+CTDConcept* CTDContConcept::copyConcept(CTDAttrib* pAttrib)
 {
-    // Parse the conceptValue and the rest of the string.
-    CString restStr;
-    if (!parseConceptValue(conceptStr, m_conceptValue, restStr, m_lowerBound, m_upperBound)) {
-        cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << conceptStr << endl;
-        return false;
-    }
-
-#ifdef _TD_MANUAL_CONTHRCHY
+    CTDContConcept* pNewConcept = new CTDContConcept(pAttrib);
+    pNewConcept->copyFrom(this);
+    pNewConcept->m_lowerBound = m_lowerBound;
+    pNewConcept->m_upperBound = m_upperBound;
+    return pNewConcept;
+}
 
-	m_depth = depth;
-	
-	// Update maxDepth
-	depth > maxDepth ? maxDepth = depth : maxDepth;
-
-    // Depth-first build.
-    CString firstConcept;
-    while (!restStr.IsEmpty()) {
-        if (!parseFirstConcept(firstConcept, restStr)) {
-            cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << restStr << endl;
-            return false;
-        }
-		
-		
-        CTDContConcept* pNewConcept = new CTDContConcept(m_pAttrib);
-        if (!pNewConcept)
-            return false;
-        
-		
-		if (!pNewConcept->initHierarchy(firstConcept, depth + 1, maxBranches, maxDepth)) {
-            cerr << _T("CTDDiscConcept: Failed to build hierarchy from ") << firstConcept << endl;
-            return false;
-        }
+//---------------------------------------------------------------------------
+// Parse "0-100" into the bounds of this interval.
+//---------------------------------------------------------------------------
+bool CTDContConcept::assignConceptValue(const CString& valueStr)
+{
+    if (!parseLowerUpperBound(valueStr, m_lowerBound, m_upperBound))
+        return false;
 
-        if (!addChildConcept(pNewConcept))
-            return false;
+    // Convert again to make sure exact match for decimal places
+    if (!makeRange(m_lowerBound, m_upperBound, m_conceptValue)) {
+        ASSERT(false);
+        return false;
     }
-#endif
-
     return true;
 }
 
@@ -428,66 +485,6 @@ CString CTDContConcept::toString()
 #endif
 }
 
-//---------------------------------------------------------------------------
-//---------------------------------------------------------------------------
-// static
-bool CTDContConcept::parseConceptValue(LPCTSTR str, 
-                                       CString& conceptVal, 
-                                       CString& restStr, 
-                                       float& lowerBound, 
-                                       float& upperBound)
-{
-    conceptVal.Empty();
-    restStr.Empty();
-    lowerBound = 0.0f;
-    upperBound = 0.0f;
-
-    CString wrkStr = str;
-    if (wrkStr.GetLength() < 2 ||
-        wrkStr[0] !=  TD_CONHCHY_OPENTAG || 
-        wrkStr[wrkStr.GetLength() - 1] !=  TD_CONHCHY_CLOSETAG) {
-        ASSERT(false);
-        return false;
-    }
-
-    wrkStr = wrkStr.Mid(1, wrkStr.GetLength() - 2);
-    CBFStrHelper::trim(wrkStr);
-    if (wrkStr.IsEmpty()) {
-        ASSERT(false);
-        return false;
-    }
-
-    // Extract "0-100"
-    LPTSTR tempStr = NULL;
-    int openPos = wrkStr.Find(TD_CONHCHY_OPENTAG);
-    if (openPos < 0) {
-        // This is root value, e.g., "0-50"
-        conceptVal = wrkStr;
-        if (!parseLowerUpperBound(conceptVal, lowerBound, upperBound))
-            return false;
-    }
-    else {
-        conceptVal = wrkStr.Left(openPos);
-        CBFStrHelper::trim(conceptVal);
-        if (conceptVal.IsEmpty()) {
-            ASSERT(false);
-            return false;
-        }
-
-        if (!parseLowerUpperBound(conceptVal, lowerBound, upperBound))
-            return false;
-    }
-
-    // Convert again to make sure exact match for decimal places
-    if (!makeRange(lowerBound, upperBound, conceptVal)) {
-        ASSERT(false);
-        return false;
-    }
-
-    restStr = wrkStr.Mid(openPos);
-    return true;
-}
-
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 // static
@@ -563,7 +560,7 @@ bool CTDContConcept::makeChildConcepts(float splitPoint, CTDConcept*& pLChildCon
     pLeftConcept->m_upperBound = splitPoint;
 
 	try {
-		pLeftConcept->m_flattenIdx = m_pAttrib->getFlattenConcepts()->Add(pLeftConcept);
+		pLeftConcept->m_flattenIdx = m_pAttrib->addFlattenConcept(pLeftConcept);
 	}
 	catch (CException& exObj) {
 		char* errMsg = NULL;
@@ -596,7 +593,7 @@ bool CTDContConcept::makeChildConcepts(float splitPoint, CTDConcept*& pLChildCon
     pRightConcept->m_upperBound = m_upperBound;
 
 	try {
-		pRightConcept->m_flattenIdx = m_pAttrib->getFlattenConcepts()->Add(pRightConcept);
+		pRightConcept->m_flattenIdx = m_pAttrib->addFlattenConcept(pRightConcept);
 	}
 	catch (CException& exObj) {
 		char* errMsg;
@@ -28,7 +28,8 @@ public:
     virtual ~CTDConcept();
 
     virtual bool isContinuous() = 0;
-    virtual bool initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxChildren, int& maxDepth) = 0;
+    bool initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth);
+    CTDConcept* cloneHierarchy(CTDAttrib* pAttrib);
     virtual CString toString() = 0;
     
 	bool addChildConcept(CTDConcept* pConceptNode);
@@ -40,10 +41,12 @@ public:
     CTDConcept* getParentConcept();
     CTDAttrib* getAttrib() { return m_pAttrib; };
 	bool computeNCPHelper(float& ncp);
+    bool isMultiDimBitSet(int w) const { return ((m_multiDimBits.GetAt(w / TD_BITVALUE_NUMBITS) >> (w % TD_BITVALUE_NUMBITS)) & 1) != 0; };
+
+    static void skipSpaces(LPCTSTR& pCur);
+    static bool skipConcept(LPCTSTR& pCur);
 
-    static bool parseFirstConcept(CString& firstConcept, CString& restStr);
 
-        
 // Attributes
     CString        m_conceptValue;          // Actual value in string format.
     int            m_depth;                 // Depth of this concept.
@@ -52,11 +55,19 @@ public:
     bool           m_bCutCandidate;         // Can it be a cut candidate?
     POSITION       m_cutPos;                // Position of this concept in the cut.  
 	bool		   m_bFileName;				// If true, it will be written to the .names file as an attribute.
-	int			   m_nLeafConcepts;			// Number of leaf concepts of this entire hierarchy tree.
-	
+	int			   m_nLeafConcepts;			// Number of leaf concepts of the tree rooted at this concept.
+	int			   m_multiDimIdx;			// Index in the multidimensional concepts of the attribute, or -1.
+	CTDBitValueArray m_multiDimBits;		// Bit w is set if multidimensional concept w is this concept or an ancestor.
+
 protected:
 // Operations
     virtual bool makeChildConcepts(float splitPoint, CTDConcept*& pLChildCon, CTDConcept*& pRChildCon) = 0;
+    virtual CTDConcept* newChildConcept() = 0;
+    virtual CTDConcept* copyConcept(CTDAttrib* pAttrib) = 0;
+    virtual bool assignConceptValue(const CString& valueStr) = 0;
+    virtual bool isChildrenInHierarchy() { return true; };
+    bool parseHierarchy(LPCTSTR& pCur, int depth, CTDIntArray& maxBranches, int& maxDepth);
+    void copyFrom(const CTDConcept* pSrcConcept);
 
 // Attributes
     CTDAttrib*			m_pAttrib;					// Pointer to this attribute.
@@ -72,14 +83,15 @@ public:
     virtual ~CTDDiscConcept();
 
     virtual bool isContinuous() { return false; };
-    virtual bool initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth);
     virtual CString toString();
 	
 	bool isAncestor(CTDConcept* pTargetConcept);
-    static bool parseConceptValue(LPCTSTR str, CString& conceptVal, CString& restStr);
 
 protected:
 	virtual bool makeChildConcepts(float splitPoint, CTDConcept*& pLChildCon, CTDConcept*& pRChildCon) {return true;};
+    virtual CTDConcept* newChildConcept() { return new CTDDiscConcept(m_pAttrib); };
+    virtual CTDConcept* copyConcept(CTDAttrib* pAttrib);
+    virtual bool assignConceptValue(const CString& valueStr);
 
 // Attributes
     CTDConcept* m_pSplitConcept;            // Pointer to the winner concept.
@@ -92,16 +104,10 @@ public:
     CTDContConcept(CTDAttrib* pAttrib);
     virtual ~CTDContConcept();
     virtual bool isContinuous() { return true; };
-    virtual bool initHierarchy(LPCTSTR conceptStr, int depth, CTDIntArray& maxBranches, int& maxDepth);
     virtual CString toString();
 	virtual bool makeChildConcepts(float splitPoint, CTDConcept*& pLChildCon, CTDConcept*& pRChildCon);
   
     static bool makeRange(float lowerB, float upperB, CString& range);
-    static bool parseConceptValue(LPCTSTR  str, 
-                                  CString& conceptVal, 
-                                  CString& restStr,
-                                  float&   lowerBound,
-                                  float&   upperBound);
     static bool parseLowerUpperBound(const CString& str, 
                                      float& lowerB, 
                                      float& upperB);
@@ -116,6 +122,12 @@ public:
 protected:
 // Operations
     bool computeSplitEntropy(float& entropy);
+    virtual CTDConcept* newChildConcept() { return new CTDContConcept(m_pAttrib); };
+    virtual CTDConcept* copyConcept(CTDAttrib* pAttrib);
+    virtual bool assignConceptValue(const CString& valueStr);
+#ifndef _TD_MANUAL_CONTHRCHY
+    virtual bool isChildrenInHierarchy() { return false; };
+#endif
 
 // Attributes
   
@@ -17,26 +17,72 @@ CTDController::CTDController(LPCTSTR rawDataFile,
                              LPCTSTR nameFile,
                              LPCTSTR transformedDataFile, 
                              LPCTSTR transformedTestFile, 
+                             LPCTSTR modelFile, 
+                             LPCTSTR workloadFile, 
+                             LPCTSTR marginalFile, 
+                             LPCTSTR profileFile, 
+                             LPCTSTR traceFile, 
+                             LPCTSTR traceCSVFile, 
                              int nSpecialization,
 							 double pBudget,
                              int  nInputRecs,
                              int  nTraining)
     : m_attribMgr(attributesFile, nameFile), 
       m_dataMgr(rawDataFile, transformedDataFile, transformedTestFile, nInputRecs, nTraining),
-	  m_partitioner(nSpecialization, pBudget, nTraining)
+	  m_partitioner(nSpecialization, pBudget, nTraining),
+      m_modelFile(modelFile),
+      m_workloadFile(workloadFile),
+      m_marginalFile(marginalFile),
+      m_profileFile(profileFile),
+      m_traceFile(traceFile),
+      m_traceCSVFile(traceCSVFile),
+      m_nTraining(nTraining)
+{
+    initialize();
+}
+
+//---------------------------------------------------------------------------
+// For in-memory runs. Files are only written if asked for, under the
+// default names.
+//---------------------------------------------------------------------------
+CTDController::CTDController(int nSpecialization,
+							 double pBudget,
+                             int  nInputRecs,
+                             int  nTraining)
+    : m_attribMgr(_T(""), TD_DEFAULT_DATASET_NAME _T(".") TD_NAMEFILE_EXT), 
+      m_dataMgr(_T(""), 
+                TD_DEFAULT_DATASET_NAME _T(".") TD_TRANSFORM_DATAFILE_EXT, 
+                TD_DEFAULT_DATASET_NAME _T(".") TD_TRANSFORM_TESTFILE_EXT, 
+                nInputRecs, 
+                nTraining),
+	  m_partitioner(nSpecialization, pBudget, nTraining),
+      m_modelFile(TD_DEFAULT_DATASET_NAME _T(".") TD_MODELFILE_EXT),
+      m_workloadFile(TD_DEFAULT_DATASET_NAME _T(".") TD_WORKLOADFILE_EXT),
+      m_marginalFile(TD_DEFAULT_DATASET_NAME _T(".") TD_MARGINALFILE_EXT),
+      m_profileFile(TD_DEFAULT_DATASET_NAME _T(".") TD_PROFILEFILE_EXT),
+      m_traceFile(TD_DEFAULT_DATASET_NAME _T(".") TD_TRACEFILE_EXT),
+      m_traceCSVFile(TD_DEFAULT_DATASET_NAME _T(".") TD_TRACE_CSVFILE_EXT),
+      m_nTraining(nTraining)
+{
+    initialize();
+}
+
+CTDController::~CTDController()
+{
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDController::initialize()
 {
     if (!m_dataMgr.initialize(&m_attribMgr))
         ASSERT(false);
-    if (!m_partitioner.initialize(&m_attribMgr, &m_dataMgr))
+    if (!m_partitioner.initialize(&m_attribMgr, &m_dataMgr, &m_profiler))
         ASSERT(false);
     if (!m_evalMgr.initialize(&m_attribMgr, &m_partitioner))
         ASSERT(false);
 }
 
-CTDController::~CTDController()
-{
-}
-
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 bool CTDController::runDiffMulti()
@@ -45,25 +91,119 @@ bool CTDController::runDiffMulti()
     cout << _T("* Differentially-Private Multidimensional Generalization *") << endl;
     cout << _T("**********************************************************") << endl;
 
-	//printTime();
-	time_t time0;
-    time(&time0);
+    setnTrainingRecs(m_nTraining);
+	m_profiler.start();
 
 	// Read the configuration file for the taxonomy trees of the atrributes
+	m_profiler.startPhase(TD_PHASE_READ_ATTRIBUTES);
 	if (!m_attribMgr.readAttributes())
         return false;
+	m_profiler.stopPhase(TD_PHASE_READ_ATTRIBUTES);
 
 	
-    //printTime();
 	// Load the data from the file
+	m_profiler.startPhase(TD_PHASE_READ_RECORDS);
     if (!m_dataMgr.readRecords())
         return false;
-    
+	m_profiler.stopPhase(TD_PHASE_READ_RECORDS);
+
+    return runLoadedDiffMulti(NULL, true);
+}
+
+//---------------------------------------------------------------------------
+// Run on a hierarchy and raw records that are already in memory, one line
+// of the .hchy and .rawdata files per string. The leaf partitions and the
+// generalized test records are returned in pResults if it is not NULL.
+// Output files are written only if bWriteFiles is true.
+//---------------------------------------------------------------------------
+bool CTDController::runDiffMulti(const CStringArray& hierarchyLines, const CStringArray& rawRecords, CTDResults* pResults, bool bWriteFiles)
+{
+	cout << _T("**********************************************************") << endl;
+    cout << _T("* Differentially-Private Multidimensional Generalization *") << endl;
+    cout << _T("**********************************************************") << endl;
+
+    setnTrainingRecs(m_nTraining);
+	m_profiler.start();
+
+	m_profiler.startPhase(TD_PHASE_READ_ATTRIBUTES);
+	if (!m_attribMgr.readAttributes(hierarchyLines))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_ATTRIBUTES);
 
-	//printTime();
-	time_t time1;
-    time(&time1);
-	cout << _T("Time for reading attributes and records = ") << time1 - time0 << _T(" s") << endl;
+	m_profiler.startPhase(TD_PHASE_READ_RECORDS);
+    if (!m_dataMgr.readRecords(rawRecords))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_RECORDS);
+
+    return runLoadedDiffMulti(pResults, bWriteFiles);
+}
+
+//---------------------------------------------------------------------------
+// Same as above, with the records in caller-owned column buffers, see
+// CTDDataMgr::readColumns.
+//---------------------------------------------------------------------------
+bool CTDController::runDiffMulti(const CStringArray& hierarchyLines, const TDColumn* pColumns, int nColumns, int nRows, CTDResults* pResults, bool bWriteFiles)
+{
+	cout << _T("**********************************************************") << endl;
+    cout << _T("* Differentially-Private Multidimensional Generalization *") << endl;
+    cout << _T("**********************************************************") << endl;
+
+    setnTrainingRecs(m_nTraining);
+	m_profiler.start();
+
+	m_profiler.startPhase(TD_PHASE_READ_ATTRIBUTES);
+	if (!m_attribMgr.readAttributes(hierarchyLines))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_ATTRIBUTES);
+
+	m_profiler.startPhase(TD_PHASE_READ_RECORDS);
+    if (!m_dataMgr.readColumns(pColumns, nColumns, nRows))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_RECORDS);
+
+    return runLoadedDiffMulti(pResults, bWriteFiles);
+}
+
+//---------------------------------------------------------------------------
+// Same as above, on copies of the attributes and records of a data set
+// that is parsed once for many runs. The budget-independent counts of the
+// root partition are taken from the data set. pDataset is not changed.
+// The number of training records is not set here: runs on one data set
+// may share threads, so the caller sets it once, see CTDExperiment::run.
+//---------------------------------------------------------------------------
+bool CTDController::runDiffMulti(CTDDataset* pDataset, CTDResults* pResults, bool bWriteFiles)
+{
+	cout << _T("**********************************************************") << endl;
+    cout << _T("* Differentially-Private Multidimensional Generalization *") << endl;
+    cout << _T("**********************************************************") << endl;
+
+	m_profiler.start();
+
+	m_profiler.startPhase(TD_PHASE_READ_ATTRIBUTES);
+	if (!m_attribMgr.copyAttributes(pDataset->getAttribMgr()))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_ATTRIBUTES);
+
+	m_profiler.startPhase(TD_PHASE_READ_RECORDS);
+    if (!m_dataMgr.copyRecords(pDataset->getDataMgr()))
+        return false;
+	m_profiler.stopPhase(TD_PHASE_READ_RECORDS);
+
+    m_partitioner.setRootState(pDataset->getRootState());
+    bool bSucceeded = runLoadedDiffMulti(pResults, bWriteFiles);
+    m_partitioner.setRootState(NULL);
+    return bSucceeded;
+}
+
+//---------------------------------------------------------------------------
+// Anonymize the loaded records, then hand the leaf partitions to the
+// requested consumers.
+//---------------------------------------------------------------------------
+bool CTDController::runLoadedDiffMulti(CTDResults* pResults, bool bWriteFiles)
+{
+	cout << _T("Score function = ") << getScoreFunctionName(getScoreFunction()) << endl;
+	cout << _T("Time for reading attributes and records = ") 
+		 << m_profiler.getPhaseSeconds(TD_PHASE_READ_ATTRIBUTES) + m_profiler.getPhaseSeconds(TD_PHASE_READ_RECORDS) << _T(" s") << endl;
 
 	// Anonymize the whole data set
     if (!m_partitioner.transformData())
@@ -71,69 +211,238 @@ bool CTDController::runDiffMulti()
    
 
 	// Add noise to the "training" partitions
+	m_profiler.startPhase(TD_PHASE_NOISE);
 	if (!m_partitioner.addNoise())
         return false;
+	m_profiler.stopPhase(TD_PHASE_NOISE);
+
+	// Index the noisy leaf partitions for count queries
+	m_profiler.startPhase(TD_PHASE_INDEX);
+	if (!m_queryEngine.build(&m_attribMgr, m_partitioner.getLeafPartitions()))
+		return false;
+	m_profiler.stopPhase(TD_PHASE_INDEX);
     
 
-	//printTime();
-	time_t time2;
-    time(&time2);
-	cout << _T("Time for transformation and adding noise = ") << time2 - time1 << _T(" s") << endl << endl;
+	cout << _T("Time for transformation and adding noise = ") 
+		 << m_profiler.getPhaseSeconds(TD_PHASE_ROOT_SUPPORT) + m_profiler.getPhaseSeconds(TD_PHASE_SPECIALIZATION) 
+		  + m_profiler.getPhaseSeconds(TD_PHASE_NOISE) + m_profiler.getPhaseSeconds(TD_PHASE_INDEX) << _T(" s") << endl << endl;
 
 
+	// Return the partitions in memory
+	if (pResults) {
+		if (!m_dataMgr.makeResults(m_partitioner.getLeafPartitions(), m_partitioner.getTestRouter(), *pResults))
+			return false;
+	}
+
 	// Write the .names file for the C4.5 classifier
 	// Print the "training" partitions 
-#if defined(_TD_NAME_FILE_NORMAL) 
-	if (!m_attribMgr.writeNameFile())
-		return false;	
-	
-	if (!m_dataMgr.writeDiffRecords(m_partitioner.getLeafPartitions()))	
-		return false; 
+	m_profiler.startPhase(TD_PHASE_WRITE);
+	if (bWriteFiles) {
+#if TD_NAME_FILE == TD_NAME_FILE_BY_SCORE
+		bool bMultiDim = (getScoreFunction() == TD_SCORE_MAX || getScoreFunction() == TD_SCORE_INFOGAIN);
+#else
+		bool bMultiDim = (TD_NAME_FILE == TD_NAME_FILE_MULTIDIM);
 #endif
+		if (!bMultiDim) {
+			if (!m_attribMgr.writeNameFile())
+				return false;	
+	
+			if (!m_dataMgr.writeDiffRecords(m_partitioner.getLeafPartitions()))	
+				return false; 
+		}
+		else {
+			if (!m_attribMgr.writeNameFileMultiDim())
+				return false;	
+
+			if (!m_dataMgr.writeMultiDimRecords(m_partitioner.getLeafPartitions(), m_partitioner.getTestRouter(), TD_bC45))			
+				return false;
+
+	#if TD_bBINARY_OUTPUT
+			if (!m_dataMgr.writeBinaryRecords(m_partitioner.getLeafPartitions(), m_partitioner.getTestRouter()))
+				return false;
+	#endif
 
-#if defined(_TD_NAME_FILE_MULTIDIM) 
-		if (!m_attribMgr.writeNameFileMultiDim())
-			return false;	
+	#if TD_bSAVE_MODEL
+			if (!saveModel(m_modelFile))
+				return false;
+	#endif
+		}
 
-		if (!m_dataMgr.writeMultiDimRecords(m_partitioner.getLeafPartitions(), m_partitioner.getTestLeafPartitions(), TD_bC45))			
+#if TD_bWRITE_MARGINALS
+		if (!writeMarginals(m_marginalFile))
 			return false;
 #endif
+	}
 
+	m_profiler.stopPhase(TD_PHASE_WRITE);
+	cout << _T("Time for writing records = ") << m_profiler.getPhaseSeconds(TD_PHASE_WRITE) << _T(" s") << endl << endl;
 	
-    //printTime();
-	time_t time3;
-    time(&time3);
-	cout << _T("Time for writing records = ") << time3 - time2 << _T(" s") << endl << endl;
-	
+
+	m_profiler.startPhase(TD_PHASE_EVALUATION);
 
 	// Compute Discernibility from noisy leaf partitions
-#if defined(_TD_SCORE_FUNTION_DISCERNIBILITY)
-	long long catDiscern = 0LL;
-	if (!m_evalMgr.countNumDiscern(catDiscern))
+	if (getScoreFunction() == TD_SCORE_DISCERNIBILITY) {
+		long long catDiscern = 0LL;
+		if (!m_evalMgr.countNumDiscern(catDiscern))
+			return false;
+
+		cout << _T("Discernibility Penalty = ") << catDiscern << endl << endl;
+	}
+
+
+	// Compute NCP from noisy leaf partitions
+	if (getScoreFunction() == TD_SCORE_NCP) {
+		float totalNCP = 0.0f;
+		if (!m_evalMgr.countNumTotalNCP(totalNCP))
+			return false;
+
+		cout << _T("Total NCP = ") << totalNCP << endl << endl;
+	}
+
+
+	// Train a classifier on the noisy leaf partitions and test it on the routed test records
+#if TD_bEVAL_CLASSIFIER
+	double accuracy = 0.0;
+	if (!evaluateClassifier(accuracy))
 		return false;
 
-	cout << _T("Discernibility Penalty = ") << catDiscern << endl << endl;
+	cout << _T("Classification accuracy = ") << accuracy * 100.0 << _T("%") << endl << endl;
 #endif
 
 
-	// Compute NCP from noisy leaf partitions
-#if defined(_TD_SCORE_FUNCTION_NCP)
-	float totalNCP = 0.0f;
-	if (!m_evalMgr.countNumTotalNCP(totalNCP))
+	// Compare the answers of a query workload on the noisy leaf partitions to the raw records
+#if TD_bEVAL_WORKLOAD
+	TDWorkloadStats workloadStats;
+	if (!evaluateWorkload(m_workloadFile, workloadStats))
 		return false;
 
-	cout << _T("Total NCP = ") << totalNCP << endl << endl;
+	cout << _T("Queries = ") << workloadStats.m_nQueries << _T(", sanity bound = ") << workloadStats.m_sanityBound << endl;
+	cout << _T("Mean relative error = ") << workloadStats.m_meanRelError << endl;
+	cout << _T("Median relative error = ") << workloadStats.m_medianRelError << endl;
+	cout << _T("90th/95th percentile relative error = ") << workloadStats.m_p90RelError << _T(" / ") << workloadStats.m_p95RelError << endl;
+	cout << _T("Max relative error = ") << workloadStats.m_maxRelError << endl;
+	cout << _T("Mean absolute error = ") << workloadStats.m_meanAbsError << endl << endl;
 #endif
+	m_profiler.stopPhase(TD_PHASE_EVALUATION);
     
 
-	//printTime();
-	time_t time4;
-    time(&time4);
-	cout << _T("Total time = ") << time4 - time0 << _T(" s") << endl;
+	m_profiler.stop();
+	cout << _T("Total time = ") << m_profiler.getTotalNanos() / 1e9 << _T(" s") << endl;
+	m_profiler.printMemory();
+
+#if TD_bWRITE_PROFILE
+	if (bWriteFiles && !m_profiler.writeJSON(m_profileFile))
+		return false;
+#endif
+
+#if TD_bTRACE_PARTITIONS
+	if (bWriteFiles) {
+		if (!m_partitioner.getTrace()->writeChromeTrace(m_traceFile) || !m_partitioner.getTrace()->writeCSV(m_traceCSVFile))
+			return false;
+	}
+#endif
+
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Write the split decisions and noisy leaves of the last run, for
+// generalizing new records with CTDModel::apply.
+//---------------------------------------------------------------------------
+bool CTDController::saveModel(LPCTSTR modelFile)
+{
+    return CTDModel::save(modelFile, &m_attribMgr, &m_dataMgr, m_partitioner.getLeafPartitions(), m_partitioner.getTestRouter());
+}
+
+//---------------------------------------------------------------------------
+// Accuracy on the test records of a linear SVM trained on the noisy leaf
+// partitions of the last run, computed without writing the data files.
+//---------------------------------------------------------------------------
+bool CTDController::evaluateClassifier(double& accuracy)
+{
+    CTDClassifier classifier;
+    if (!classifier.train(&m_attribMgr, &m_dataMgr, m_partitioner.getLeafPartitions()))
+        return false;
+    return classifier.evaluate(&m_dataMgr, m_partitioner.getTestRouter(), accuracy);
+}
 
+//---------------------------------------------------------------------------
+// Discernibility, NCP and, if there are test records, classification
+// accuracy of the last run, whatever the score function.
+//---------------------------------------------------------------------------
+bool CTDController::evaluateRun(TDRunMetrics& metrics)
+{
+    metrics.m_nLeaves = m_partitioner.getLeafPartitions()->GetCount();
+    TDEvalResults evalResults;
+    if (!m_evalMgr.evaluate(TD_EVAL_DISCERN | TD_EVAL_NCP, evalResults))
+        return false;
+    metrics.m_discernibility = evalResults.m_discern;
+    metrics.m_totalNCP = evalResults.m_totalNCP;
+
+    metrics.m_bAccuracy = m_dataMgr.getTestRecords()->GetSize() > 0;
+    metrics.m_accuracy = 0.0;
+    if (metrics.m_bAccuracy && !evaluateClassifier(metrics.m_accuracy))
+        return false;
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Fill the marginals added to marginals from the noisy leaf partitions of
+// the last run.
+//---------------------------------------------------------------------------
+bool CTDController::computeMarginals(CTDMarginals& marginals)
+{
+    return marginals.compute(m_partitioner.getLeafPartitions());
+}
+
+//---------------------------------------------------------------------------
+// Write the marginals listed in marginalFile, one per line, to
+// <marginalFile>.csv.
+//---------------------------------------------------------------------------
+bool CTDController::writeMarginals(LPCTSTR marginalFile)
+{
+    CTDMarginals marginals;
+    if (!marginals.load(marginalFile, &m_attribMgr))
+        return false;
+    if (!computeMarginals(marginals))
+        return false;
+
+    CString resultFile = marginalFile;
+    resultFile += _T(".");
+    resultFile += TD_MARGINAL_RESULTFILE_EXT;
+    return marginals.write(resultFile);
+}
+
+//---------------------------------------------------------------------------
+// Answer the queries of workloadFile on the noisy leaf partitions and on
+// the raw training records. If the file does not exist, a random workload
+// is generated and written there, so that later runs can reuse it. The
+// answers of each query go to <workloadFile>.err.
+//---------------------------------------------------------------------------
+bool CTDController::evaluateWorkload(LPCTSTR workloadFile, TDWorkloadStats& stats)
+{
+    CTDWorkload workload;
+    CFileStatus fileStatus;
+    if (CFile::GetStatus(workloadFile, fileStatus)) {
+        if (!workload.load(workloadFile, &m_attribMgr))
+            return false;
+    }
+    else {
+        if (!workload.generate(TD_WORKLOAD_NUM_QUERIES, TD_WORKLOAD_MAX_PREDICATES, &m_attribMgr))
+            return false;
+        if (!workload.save(workloadFile))
+            return false;
+    }
+
+    if (!workload.encodeRecords(&m_attribMgr, m_dataMgr.getRecords()))
+        return false;
+
+    CString resultFile = workloadFile;
+    resultFile += _T(".");
+    resultFile += TD_WORKLOAD_RESULTFILE_EXT;
+    return workload.evaluate(&m_queryEngine, resultFile, stats);
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 bool CTDController::removeUnknowns()
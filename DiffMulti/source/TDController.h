@@ -13,6 +13,10 @@
     #include "TDDataMgr.h"
 #endif
 
+#if !defined(TDDATASET_H)
+    #include "TDDataset.h"
+#endif
+
 #if !defined(TDPARTITIONER_H)
     #include "TDPartitioner.h"
 #endif
@@ -21,6 +25,42 @@
     #include "TDEvalMgr.h"
 #endif
 
+#if !defined(TDMODEL_H)
+    #include "TDModel.h"
+#endif
+
+#if !defined(TDQUERY_H)
+    #include "TDQuery.h"
+#endif
+
+#if !defined(TDWORKLOAD_H)
+    #include "TDWorkload.h"
+#endif
+
+#if !defined(TDMARGINAL_H)
+    #include "TDMarginal.h"
+#endif
+
+#if !defined(TDCLASSIFIER_H)
+    #include "TDClassifier.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Utility of a run, computed from the noisy leaf partitions.
+//---------------------------------------------------------------------------
+struct TDRunMetrics
+{
+    int       m_nLeaves;
+    long long m_discernibility;
+    float     m_totalNCP;
+    bool      m_bAccuracy;          // False if there are no test records.
+    double    m_accuracy;
+};
+
 class CTDController  
 {
 public:
@@ -29,22 +69,57 @@ public:
                   LPCTSTR nameFile, 
                   LPCTSTR transformedDataFile, 
                   LPCTSTR transformedTestFile, 
+                  LPCTSTR modelFile, 
+                  LPCTSTR workloadFile, 
+                  LPCTSTR marginalFile, 
+                  LPCTSTR profileFile, 
+                  LPCTSTR traceFile, 
+                  LPCTSTR traceCSVFile, 
                   int nSpecialization,
 				  double pBudget,
                   int  nInputRecs,
                   int  nTraining);
+	CTDController(int nSpecialization,
+				  double pBudget,
+                  int  nInputRecs,
+                  int  nTraining);
     virtual ~CTDController();
 
 // Operations
     bool runDiffMulti();
+    bool runDiffMulti(const CStringArray& hierarchyLines, const CStringArray& rawRecords, CTDResults* pResults, bool bWriteFiles);
+    bool runDiffMulti(const CStringArray& hierarchyLines, const TDColumn* pColumns, int nColumns, int nRows, CTDResults* pResults, bool bWriteFiles);
+    bool runDiffMulti(CTDDataset* pDataset, CTDResults* pResults, bool bWriteFiles);
+    bool saveModel(LPCTSTR modelFile);
+    bool answerQuery(LPCTSTR queryStr, double& count) { return m_queryEngine.answer(queryStr, count); };
+    CTDQueryEngine* getQueryEngine() { return &m_queryEngine; };
+    bool evaluateWorkload(LPCTSTR workloadFile, TDWorkloadStats& stats);
+    bool computeMarginals(CTDMarginals& marginals);
+    bool writeMarginals(LPCTSTR marginalFile);
+    bool evaluateClassifier(double& accuracy);
+    bool evaluateRun(TDRunMetrics& metrics);
+    const CTDProfiler* getProfiler() const { return &m_profiler; };
+    void setNumEvalThreads(int nThreads) { m_evalMgr.setNumThreads(nThreads); };
     bool removeUnknowns();
     
 protected:
+    void initialize();
+    bool runLoadedDiffMulti(CTDResults* pResults, bool bWriteFiles);
+
 // Attributes
     CTDAttribMgr   m_attribMgr;
     CTDDataMgr     m_dataMgr;
     CTDPartitioner m_partitioner;
     CTDEvalMgr     m_evalMgr;
+    CTDQueryEngine m_queryEngine;
+    CTDProfiler    m_profiler;
+    CString        m_modelFile;
+    CString        m_workloadFile;
+    CString        m_marginalFile;
+    CString        m_profileFile;
+    CString        m_traceFile;
+    CString        m_traceCSVFile;
+    int            m_nTraining;
 };
 
 #endif
@@ -12,6 +12,10 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -22,13 +26,17 @@ CTDDataMgr::CTDDataMgr(LPCTSTR rawDataFile, LPCTSTR transformedDataFile, LPCTSTR
       m_transformedDataFile(transformedDataFile), 
       m_transformedTestFile(transformedTestFile), 
       m_nInputRecs(nInputRecs),
-      m_nTraining(nTraining)
+      m_nTraining(nTraining),
+      m_serializeMode(TD_SERIALIZE_DIFF),
+      m_bSerializeC45(false),
+      m_pSerializeRouter(NULL)
 {
 }
 
 CTDDataMgr::~CTDDataMgr() 
 {
     m_records.cleanup();
+    m_testRecords.cleanup();
 }
 
 //---------------------------------------------------------------------------
@@ -50,7 +58,7 @@ bool CTDDataMgr::readRecords()
 {
     cout << _T("Reading records...") << endl;
     m_records.cleanup();
-    CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+    m_testRecords.cleanup();
     try {
         CStdioFile rawFile;
         if (!rawFile.Open(m_rawDataFile, CFile::modeRead)) {
@@ -59,121 +67,327 @@ bool CTDDataMgr::readRecords()
         }
 
         // Parse each line
-        int commentCharPos = -1;
         CString lineStr;
-        while (rawFile.ReadString(lineStr)) {
-            CBFStrHelper::trim(lineStr);
-            if (lineStr.IsEmpty())
-                continue;
-
-            // Remove comments
-            commentCharPos = lineStr.Find(TD_CONHCHY_COMMENT);
-            if (commentCharPos != -1) {
-                lineStr = lineStr.Left(commentCharPos);
-                CBFStrHelper::trim(lineStr);
-                if (lineStr.IsEmpty())
-                    continue;
-            }
+        bool bDone = false;
+        while (!bDone && rawFile.ReadString(lineStr)) {
+            if (!addRawRecord(lineStr, bDone))
+                return false;
+        }
+        rawFile.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read raw data file: ") << m_rawDataFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return checkRecords();
+}
 
-            // Remove period at the end of the line
-            if (lineStr[lineStr.GetLength() - 1] == TD_RAWDATA_TERMINATOR) {
-                lineStr = lineStr.Left(lineStr.GetLength() - 1);
-                CBFStrHelper::trim(lineStr);
-                if (lineStr.IsEmpty())
-                    continue;
-            }
+//---------------------------------------------------------------------------
+// Read the records from raw data lines that are already in memory.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::readRecords(const CStringArray& rawRecords)
+{
+    cout << _T("Reading records...") << endl;
+    m_records.cleanup();
+    m_testRecords.cleanup();
+    bool bDone = false;
+    for (int i = 0; i < rawRecords.GetSize() && !bDone; ++i) {
+        if (!addRawRecord(rawRecords.GetAt(i), bDone))
+            return false;
+    }
+    return checkRecords();
+}
+
+//---------------------------------------------------------------------------
+// Parse one line of raw data and add the record to the training or test
+// records. bDone is set once the specified number of records is read.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::addRawRecord(CString lineStr, bool& bDone)
+{
+    CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+    int commentCharPos = -1;
+
+    CBFStrHelper::trim(lineStr);
+    if (lineStr.IsEmpty())
+        return true;
+
+    // Remove comments
+    commentCharPos = lineStr.Find(TD_CONHCHY_COMMENT);
+    if (commentCharPos != -1) {
+        lineStr = lineStr.Left(commentCharPos);
+        CBFStrHelper::trim(lineStr);
+        if (lineStr.IsEmpty())
+            return true;
+    }
+
+    // Remove period at the end of the line
+    if (lineStr[lineStr.GetLength() - 1] == TD_RAWDATA_TERMINATOR) {
+        lineStr = lineStr.Left(lineStr.GetLength() - 1);
+        CBFStrHelper::trim(lineStr);
+        if (lineStr.IsEmpty())
+            return true;
+    }
    
-            int attribID = 0;
-            CString valueStr;
-            CTDAttrib* pAttrib = NULL;
-            CTDValue* pNewValue = NULL;
-            CTDRecord* pNewRecord = new CTDRecord();                        
-            CBFStrParser strParser(lineStr, TD_RAWDATA_DELIMETER);
-            while (strParser.getNext(valueStr)) {
-                // Check unknown value
-				CBFStrHelper::trim(valueStr);
-				if (valueStr.IsEmpty()) {
-                    cerr << _T("CTDDataMgr: Empty value string in record: ") << lineStr << endl;
-                    ASSERT(false);
-                    return false;
-                }
-                if (valueStr == TD_UNKNOWN_VALUE) {
-                    // Discard this record
-                    delete pNewRecord;
-                    pNewRecord = NULL;
-                    break;
-                }
-
-                // Allocate a new value
-                pNewValue = NULL;
-                pAttrib = pAttribs->GetAt(attribID);
-
-                if (pAttrib->isContinuous())
-                    pNewValue = new CTDNumericValue((float) StrToFloat(valueStr));
-               	else
-                    pNewValue = new CTDStringValue();
-
-                if (!pNewValue) {
-                    ASSERT(false);
-                    return false;
-                }
-
-				
-                // Match the value to the lowest concept
-                // Then build the bit value in case of categorical attribute
-                if (!pNewValue->buildBitValue(valueStr, pAttrib)) {	
-                    cerr << _T("CTDDataMgr: Failed to build bit value: ") << valueStr
-                         << _T(" in attribute ") << pAttrib->m_attribName << endl;                    
-                    ASSERT(false);
-                    return false;
-                }
-
-                if (attribID == pAttribs->GetSize() - 1) {
-                    // Class attribute
-                    if (!pNewValue->initConceptToLevel1(pAttrib))
-                        return false;
-                }
-                else {
-                    // Ordinary attribute
-                    // Initialize the current concept to the root concept                  
-                    if (!pNewValue->initConceptToRoot(pAttrib))
-                        return false;
-                }
-
-                // Add the value to the record
-                if (!pNewRecord->addValue(pNewValue))
-                    return false;
-
-                ++attribID;
+    int attribID = 0;
+    CString valueStr;
+    CTDAttrib* pAttrib = NULL;
+    CTDValue* pNewValue = NULL;
+    CTDRecord* pNewRecord = new CTDRecord();                        
+    CBFStrParser strParser(lineStr, TD_RAWDATA_DELIMETER);
+    while (strParser.getNext(valueStr)) {
+        // Check unknown value
+		CBFStrHelper::trim(valueStr);
+		if (valueStr.IsEmpty()) {
+            cerr << _T("CTDDataMgr: Empty value string in record: ") << lineStr << endl;
+            ASSERT(false);
+            return false;
+        }
+        if (valueStr == TD_UNKNOWN_VALUE) {
+            // Discard this record
+            delete pNewRecord;
+            pNewRecord = NULL;
+            break;
+        }
+
+        // Allocate a new value
+        pNewValue = NULL;
+        pAttrib = pAttribs->GetAt(attribID);
+
+        if (pAttrib->isContinuous())
+            pNewValue = new CTDNumericValue((float) StrToFloat(valueStr));
+       	else
+            pNewValue = new CTDStringValue();
+
+        if (!pNewValue) {
+            ASSERT(false);
+            return false;
+        }
+
+		
+        // Match the value to the lowest concept
+        // Then build the bit value in case of categorical attribute
+        if (!pNewValue->buildBitValue(valueStr, pAttrib)) {	
+            cerr << _T("CTDDataMgr: Failed to build bit value: ") << valueStr
+                 << _T(" in attribute ") << pAttrib->m_attribName << endl;                    
+            ASSERT(false);
+            return false;
+        }
+
+        if (attribID == pAttribs->GetSize() - 1) {
+            // Class attribute
+            if (!pNewValue->initConceptToLevel1(pAttrib))
+                return false;
+        }
+        else {
+            // Ordinary attribute
+            // Initialize the current concept to the root concept                  
+            if (!pNewValue->initConceptToRoot(pAttrib))
+                return false;
+        }
+
+        // Add the value to the record
+        if (!pNewRecord->addValue(pNewValue))
+            return false;
+
+        ++attribID;
+    }
+
+    if (pNewRecord)
+        addInputRecord(pNewRecord, bDone);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Add a parsed record to the training records, or to the test records once
+// m_nTraining records are read. bDone is set once the specified number of
+// records is read.
+//---------------------------------------------------------------------------
+void CTDDataMgr::addInputRecord(CTDRecord* pNewRecord, bool& bDone)
+{
+	if (m_records.GetSize() >= m_nTraining)
+		pNewRecord->setRecordID(m_testRecords.Add(pNewRecord));
+	else
+		pNewRecord->setRecordID(m_records.Add(pNewRecord));
+
+    // Read in the specified number of records
+	if (m_nInputRecs >= 0 && (m_records.GetSize()+ m_testRecords.GetSize()) >= m_nInputRecs)
+        bDone = true;
+}
+
+//---------------------------------------------------------------------------
+// Read the records from caller-owned column buffers, one column per
+// attribute in the order of the hierarchy file, the class column last.
+// Continuous values are taken as they are and categorical values are
+// matched to their raw concepts directly; dictionary entries are matched
+// once. Rows with an unknown value are discarded.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::readColumns(const TDColumn* pColumns, int nColumns, int nRows)
+{
+    cout << _T("Reading records...") << endl;
+    m_records.cleanup();
+    m_testRecords.cleanup();
+    CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+    if (!pColumns || nColumns != pAttribs->GetSize() || nRows < 0) {
+        cerr << _T("CTDDataMgr: Number of columns does not match the number of attributes.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    // Match the dictionary entries to the raw concepts.
+    CTDConceptPtrArrays dictConcepts;
+    dictConcepts.SetSize(nColumns);
+    bool bSucceeded = true;
+    for (int c = 0; c < nColumns && bSucceeded; ++c) {
+        const TDColumn& column = pColumns[c];
+        CTDAttrib* pAttrib = pAttribs->GetAt(c);
+        dictConcepts[c] = NULL;
+        if (pAttrib->isContinuous() != (column.m_type == TD_COLUMN_FLOAT)) {
+            cerr << _T("CTDDataMgr: Column type does not match attribute ") << pAttrib->m_attribName << endl;
+            bSucceeded = false;
+            break;
+        }
+        if (column.m_type != TD_COLUMN_DICTIONARY)
+            continue;
+
+        dictConcepts[c] = new CTDConceptPtrArray();
+        dictConcepts[c]->SetSize(column.m_nDictionary);
+        for (int d = 0; d < column.m_nDictionary; ++d)
+            dictConcepts[c]->SetAt(d, CTDStringValue::matchRawConcept(column.m_pDictionary[d], pAttrib->getFlattenConcepts()));
+    }
+
+    bool bDone = false;
+    for (int r = 0; r < nRows && !bDone && bSucceeded; ++r) {
+        CTDRecord* pNewRecord = NULL;
+        if (!makeColumnRecord(pColumns, dictConcepts, r, pNewRecord)) {
+            bSucceeded = false;
+            break;
+        }
+        if (pNewRecord)
+            addInputRecord(pNewRecord, bDone);
+    }
+
+    for (int c = 0; c < nColumns; ++c)
+        delete dictConcepts[c];
+
+    if (!bSucceeded) {
+        ASSERT(false);
+        return false;
+    }
+    return checkRecords();
+}
+
+//---------------------------------------------------------------------------
+// Build the record of row r. pNewRecord is NULL if the row has an unknown
+// value.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::makeColumnRecord(const TDColumn* pColumns, const CTDConceptPtrArrays& dictConcepts, int r, CTDRecord*& pNewRecord)
+{
+    pNewRecord = NULL;
+    CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+    int nAttribs = pAttribs->GetSize();
+    for (int c = 0; c < nAttribs; ++c) {
+        if (!pColumns[c].isValid(r))
+            return true;
+    }
+
+    pNewRecord = new CTDRecord();
+    for (int c = 0; c < nAttribs; ++c) {
+        const TDColumn& column = pColumns[c];
+        CTDAttrib* pAttrib = pAttribs->GetAt(c);
+        CTDValue* pNewValue = NULL;
+        if (column.m_type == TD_COLUMN_FLOAT) {
+            pNewValue = new CTDNumericValue(column.m_pFloats[r]);
+        }
+        else {
+            CTDConcept* pRawConcept = NULL;
+            if (column.m_type == TD_COLUMN_DICTIONARY) {
+                int dictIdx = column.m_pIndices[r];
+                if (dictIdx >= 0 && dictIdx < column.m_nDictionary)
+                    pRawConcept = dictConcepts[c]->GetAt(dictIdx);
+            }
+            else {
+                pRawConcept = CTDStringValue::matchRawConcept(column.m_pStrings[r], pAttrib->getFlattenConcepts());
             }
 
-            if (pNewRecord) {
-				
-				if (m_records.GetSize() >= m_nTraining)
-					pNewRecord->setRecordID(m_testRecords.Add(pNewRecord));
-				else
-					pNewRecord->setRecordID(m_records.Add(pNewRecord));
+            CTDStringValue* pStringValue = new CTDStringValue();
+            pNewValue = pStringValue;
+            if (!pRawConcept || !pStringValue->buildBitValue(pRawConcept, pAttrib)) {
+                cerr << _T("CTDDataMgr: Failed to match value in row ") << r
+                     << _T(" of attribute ") << pAttrib->m_attribName << endl;
+                delete pNewValue;
+                delete pNewRecord;
+                pNewRecord = NULL;
+                return false;
             }
+        }
 
-            // Read in the specified number of records
-			if (m_nInputRecs >= 0 && (m_records.GetSize()+ m_testRecords.GetSize()) >= m_nInputRecs)
-                break;
+        bool bSucceeded = false;
+        if (c == nAttribs - 1) {
+            // Class attribute
+            bSucceeded = pNewValue->initConceptToLevel1(pAttrib);
+        }
+        else {
+            // Ordinary attribute
+            bSucceeded = pNewValue->initConceptToRoot(pAttrib);
         }
-        rawFile.Close();
 
-        if (m_records.GetSize() == 0) {
-            cerr << _T("CTDDataMgr: No records.") << endl;
+        // The record does not take the value if it fails to add it.
+        if (!bSucceeded || !pNewRecord->addValue(pNewValue)) {
+            delete pNewValue;
+            delete pNewRecord;
+            pNewRecord = NULL;
             return false;
         }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Replace the records by copies of those read by pSrcMgr, for the copies
+// of its attributes in m_pAttribMgr, see CTDAttribMgr::copyAttributes.
+// Copying skips parsing the raw values and matching them to concepts.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::copyRecords(CTDDataMgr* pSrcMgr)
+{
+    cout << _T("Copying records...") << endl;
+    m_records.cleanup();
+    m_testRecords.cleanup();
+    if (!copyRecords(pSrcMgr->getRecords(), m_records) || !copyRecords(pSrcMgr->getTestRecords(), m_testRecords))
+        return false;
+    return checkRecords();
+}
 
-		 if (m_testRecords.GetSize() == 0) {
-            cerr << _T("CTDDataMgr: No test records.") << endl;
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDDataMgr::copyRecords(CTDRecords* pSrcRecs, CTDRecords& recs)
+{
+    CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+    int nRecs = pSrcRecs->GetSize();
+    recs.SetSize(0, nRecs);
+    for (int r = 0; r < nRecs; ++r) {
+        CTDRecord* pNewRecord = pSrcRecs->GetAt(r)->clone(pAttribs);
+        if (!pNewRecord) {
+            cerr << _T("CTDDataMgr: Failed to copy record ") << pSrcRecs->GetAt(r)->getRecordID() << endl;
+            ASSERT(false);
             return false;
         }
+        recs.Add(pNewRecord);
     }
-    catch (CFileException&) {
-        cerr << _T("Failed to read raw data file: ") << m_rawDataFile << endl;
-        ASSERT(false);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDDataMgr::checkRecords()
+{
+    if (m_records.GetSize() == 0) {
+        cerr << _T("CTDDataMgr: No records.") << endl;
+        return false;
+    }
+
+    if (m_testRecords.GetSize() == 0) {
+        cerr << _T("CTDDataMgr: No test records.") << endl;
         return false;
     }
 
@@ -211,9 +425,9 @@ bool CTDDataMgr::writeRecords(bool bRawValue)
         }
         for (i = 0; i < m_nTraining; ++i) {
             if (bRawValue)
-                transDataFile.WriteString(m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
+                CTDOutputWriter::writeString(transDataFile, m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
             else
-                transDataFile.WriteString(m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
+                CTDOutputWriter::writeString(transDataFile, m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
         }
         transDataFile.Close();
 
@@ -226,9 +440,9 @@ bool CTDDataMgr::writeRecords(bool bRawValue)
 
         for (i = m_nTraining; i < nRecords; ++i) {
             if (bRawValue)
-                transTestFile.WriteString(m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
+                CTDOutputWriter::writeString(transTestFile, m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
             else
-                transTestFile.WriteString(m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
+                CTDOutputWriter::writeString(transTestFile, m_records.GetAt(i)->toString(bRawValue) + _T("\n"));
         }
         transTestFile.Close();
     }
@@ -258,43 +472,39 @@ bool CTDDataMgr::writeDiffRecords(CTDPartitions* pLeafPartitions)
             cerr << _T("CTDDataMgr: Failed to open file ") << m_transformedDataFile << endl;
             return false;
         }
-		CTDPartition* pLeafPartition = NULL;
-		for (POSITION childPos = pLeafPartitions->GetHeadPosition(); childPos != NULL;) {
-			pLeafPartition = pLeafPartitions->GetNext(childPos);
-
-			if ( pLeafPartition->getNumGenRecords() != pLeafPartition->getNumClasses()) {
-				cerr << _T("Number of generalized records is not same as the number of classes") << endl;
-				ASSERT(false);
-				return false;
-			}
-			CString str;
-			for (int j = 0; j < pLeafPartition->getNumClasses(); ++j){
-				str = pLeafPartition->getGenRecords()->GetAt(j)->toString(false) ;	// "false" returns m_pCurrConcept ("true" returns m_pRawConcept)
-				// Print the generalized records according to the noisyCount
-				for (int i = 0; i < pLeafPartition->m_classNoisySums[j]; ++i) 
-					transDataFile.WriteString(str + _T("\n"));
-			}
-
-#ifdef _DEBUG_PRT_INFO
-			printPath(pLeafPartition);
+#if TD_DATA_OUTPUT == TD_OUTPUT_CSV
+		CString headerStr;
+		makeCSVHeader(false, headerStr);
+		CTDOutputWriter::writeString(transDataFile, headerStr + _T("\n"));
 #endif
-
-			if (pLeafPartition->m_path.GetSize() > longestPath)
-				longestPath = pLeafPartition->m_path.GetSize() - 1; // Root-to-child has path length = 1.
-			
-		}
+		m_serializeMode = TD_SERIALIZE_DIFF;
+		CFile* pFiles[] = { &transDataFile };
+		CTDOutputWriter writer(TD_OUTPUT_NUM_THREADS);
+		setSerializePartitions(pLeafPartitions);
+		if (!writer.write(m_serializePartitions.GetSize(), this, pFiles, 1))
+			return false;
 		transDataFile.Close();
 
+		longestPath = getLongestPath(pLeafPartitions);
+
         // Write test file
         CStdioFile transTestFile;
         if (!transTestFile.Open(m_transformedTestFile, CFile::modeCreate | CFile::modeWrite)) {
             cerr << _T("CTDDataMgr: Failed to open file ") << m_transformedTestFile << endl;
             return false;
         }
+		CTDByteBuffer testBuffer;
 		int nRecords = m_testRecords.GetSize();
         for (int i = 0; i < nRecords; ++i) {
-			transTestFile.WriteString(m_testRecords.GetAt(i)->toString(false) + _T("\n"));
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+			// The .names file declares a case weight, so every test record has a weight of 1.
+			testBuffer.appendInt(1);
+			testBuffer.append(TD_RAWDATA_DELIMETER);
+#endif
+			testBuffer.append(m_testRecords.GetAt(i)->toString(false));
+			testBuffer.append(TCHAR('\n'));
         }
+		CTDOutputWriter::writeBytes(transTestFile, testBuffer.getData(), testBuffer.getSize() * sizeof(TCHAR));
         transTestFile.Close();
     }
     catch (CFileException&) {
@@ -323,10 +533,11 @@ bool CTDDataMgr::writeDiffRecords(CTDPartitions* pLeafPartitions)
 //		concept# should always be increasing.
 // class_label: the actual class label for C4.5, or +1 or -1 for SVM.
 //---------------------------------------------------------------------------
-bool CTDDataMgr::writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDPartitions* pTestLeafPartitions, bool isC45)
+bool CTDDataMgr::writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter, bool isC45)
 {
 	cout << _T("Writing multidimensional records with preprocessing for classifier...") << endl;
 	int longestPath = 0;
+	m_bSerializeC45 = isC45;
 
     try {
 	
@@ -336,51 +547,40 @@ bool CTDDataMgr::writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDPartiti
             cerr << _T("CTDDataMgr: Failed to open file ") << m_transformedDataFile << endl;
             return false;
         }
-
-		for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-			CTDPartition* pLeafPartition = NULL;
-			pLeafPartition = pLeafPartitions->GetNext(leafPos);
-			if ( pLeafPartition->getNumGenRecords() != pLeafPartition->getNumClasses()) {
-				cerr << _T("Number of generalized records is not same as the number of classes") << endl;
-				ASSERT(false);
+		CFile* pFiles[] = { &transDataFile, NULL };
+		int nFiles = 1;
+
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+		// SVM weights go to a separate file, line by line with the data file.
+		CStdioFile weightFile;
+		CString weightFileName = m_transformedDataFile + _T(".") + TD_WEIGHTFILE_EXT;
+		if (!isC45) {
+			if (!weightFile.Open(weightFileName, CFile::modeCreate | CFile::modeWrite)) {
+				cerr << _T("CTDDataMgr: Failed to open file ") << weightFileName << endl;
 				return false;
 			}
-
-			CString str;
-			str.Empty();
-			convertRecord(pLeafPartition, isC45, 0, str);
-
-			// Print the multidimensionally generalized records according to their pertinent noisyCounts in this leafPartition
-			CString classValue;
-			int nClasses = pLeafPartition->getNumClasses();
-			int classIdx = pLeafPartition->getPartAttribs()->GetSize();
-			for (int j = 0; j < nClasses; ++j){
-				// Obtain the class value
-				classValue = pLeafPartition->getGenRecords()->GetAt(j)->getValue(classIdx)->toString(true);
-				if (!isC45) {
-					if (classValue == ">50K")
-						classValue = "+1 ";
-					else
-						classValue = "-1 ";
-				}
-				for (int i = 0; i < pLeafPartition->m_classNoisySums[j]; ++i) {
-					if (isC45)
-						transDataFile.WriteString(str + classValue + TD_RAWDATA_TERMINATOR + _T("\n"));
-					else 
-						transDataFile.WriteString(classValue + str + _T("\n"));
-				}
-			}
-			
-#ifdef _DEBUG_PRT_INFO
-			printPath(pLeafPartition);
+			pFiles[nFiles++] = &weightFile;
+		}
+#elif TD_DATA_OUTPUT == TD_OUTPUT_CSV
+		CString headerStr;
+		makeCSVHeader(true, headerStr);
+		CTDOutputWriter::writeString(transDataFile, headerStr + _T("\n"));
 #endif
 
-			if (pLeafPartition->m_path.GetSize() > longestPath)
-				longestPath = pLeafPartition->m_path.GetSize() - 1;	// Root-to-child has path length = 1.
-		}
+		CTDOutputWriter writer(TD_OUTPUT_NUM_THREADS);
+		m_serializeMode = TD_SERIALIZE_MULTIDIM_DATA;
+		setSerializePartitions(pLeafPartitions);
+		if (!writer.write(m_serializePartitions.GetSize(), this, pFiles, nFiles))
+			return false;
 		transDataFile.Close();
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+		if (!isC45)
+			weightFile.Close();
+#endif
 		// Finish data file
 
+		longestPath = getLongestPath(pLeafPartitions);
+
         // Write test file
         CStdioFile transTestFile;
         if (!transTestFile.Open(m_transformedTestFile, CFile::modeCreate | CFile::modeWrite)) {
@@ -388,32 +588,11 @@ bool CTDDataMgr::writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDPartiti
             return false;
         }
 
-		for (POSITION leafPos = pTestLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-			CTDPartition* pTestLeafPartition = NULL;
-			pTestLeafPartition = pTestLeafPartitions->GetNext(leafPos);
-
-			CString str;
-			str.Empty();
-			convertRecord(pTestLeafPartition, isC45, 1, str);
-
-			// Print the multidimensionally generalized test records according to their raw counts in this testLeafPartition
-			CString classValue;
-			int nRecrods = pTestLeafPartition->getNumRecords();
-			int classIdx = pTestLeafPartition->getPartAttribs()->GetSize();
-			for (int j = 0; j < nRecrods; ++j) {
-				// obtain the class value
-				classValue = pTestLeafPartition->getRecord(j)->getValue(classIdx)->toString(true);
-				if (!isC45) {
-					if (classValue == ">50K")
-						classValue = "+1 ";
-					else
-						classValue = "-1 ";
-					transTestFile.WriteString(classValue + str + _T("\n"));
-				}
-				else 
-					transTestFile.WriteString(str + classValue + TD_RAWDATA_TERMINATOR + _T("\n"));
-			}
-		}
+		pFiles[0] = &transTestFile;
+		m_serializeMode = TD_SERIALIZE_MULTIDIM_TEST;
+		m_pSerializeRouter = pTestRouter;
+		if (!writer.write(pTestRouter->getNumLeaves(), this, pFiles, 1))
+			return false;
 		transTestFile.Close();
 		// Finsh test file
     }
@@ -431,174 +610,593 @@ bool CTDDataMgr::writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDPartiti
 }
 
 //---------------------------------------------------------------------------
-// Converts a generalized record to a C4.5 or SVM record format
 //---------------------------------------------------------------------------
-void CTDDataMgr::convertRecord(CTDPartition* pLeafPartition, bool isC45, bool isTestPartition, CString& str)
+void CTDDataMgr::setSerializePartitions(CTDPartitions* pPartitions)
+{
+	m_serializePartitions.RemoveAll();
+	m_serializePartitions.SetSize(0, pPartitions->GetCount());
+	for (POSITION pos = pPartitions->GetHeadPosition(); pos != NULL;)
+		m_serializePartitions.Add(pPartitions->GetNext(pos));
+}
+
+//---------------------------------------------------------------------------
+// Serialize the lines of one leaf partition, or of one test leaf, for the
+// output being written. Called from the output worker threads.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::serializeItem(int itemIdx, CTDByteBuffer* pBuffers)
+{
+	switch (m_serializeMode) {
+		case TD_SERIALIZE_DIFF:
+			return serializeDiffPartition(m_serializePartitions.GetAt(itemIdx), pBuffers);
+		case TD_SERIALIZE_MULTIDIM_DATA:
+			return serializeMultiDimPartition(m_serializePartitions.GetAt(itemIdx), pBuffers);
+		case TD_SERIALIZE_MULTIDIM_TEST:
+			return serializeMultiDimTestLeaf(itemIdx, pBuffers);
+	}
+	ASSERT(false);
+	return false;
+}
+
+//---------------------------------------------------------------------------
+// Generalized records of a leaf partition in the differential privacy format.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::serializeDiffPartition(CTDPartition* pLeafPartition, CTDByteBuffer* pBuffers)
+{
+	if ( pLeafPartition->getNumGenRecords() != pLeafPartition->getNumClasses()) {
+		cerr << _T("Number of generalized records is not same as the number of classes") << endl;
+		ASSERT(false);
+		return false;
+	}
+	CString str;
+	for (int j = 0; j < pLeafPartition->getNumClasses(); ++j){
+		str = pLeafPartition->getGenRecords()->GetAt(j)->toString(false) ;	// "false" returns m_pCurrConcept ("true" returns m_pRawConcept)
+#if TD_DATA_OUTPUT == TD_OUTPUT_REPEAT
+		// Print the generalized records according to the noisyCount
+		str += _T("\n");
+		pBuffers[0].appendRepeated(str, str.GetLength(), pLeafPartition->m_classNoisySums[j]);
+#else
+		// Print the generalized record once, weighted by the noisyCount
+		if (pLeafPartition->m_classNoisySums[j] <= 0)
+			continue;
+	#if TD_DATA_OUTPUT == TD_OUTPUT_CSV
+		str = str.Left(str.GetLength() - 1);	// Drop the terminator.
+	#endif
+		pBuffers[0].appendInt(pLeafPartition->m_classNoisySums[j]);
+		pBuffers[0].append(TD_RAWDATA_DELIMETER);
+		pBuffers[0].append(str);
+		pBuffers[0].append(TCHAR('\n'));
+#endif
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Multidimensionally generalized records of a leaf partition, according to
+// their pertinent noisyCounts.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::serializeMultiDimPartition(CTDPartition* pLeafPartition, CTDByteBuffer* pBuffers)
+{
+	bool isC45 = m_bSerializeC45;
+	if ( pLeafPartition->getNumGenRecords() != pLeafPartition->getNumClasses()) {
+		cerr << _T("Number of generalized records is not same as the number of classes") << endl;
+		ASSERT(false);
+		return false;
+	}
+
+	CTDByteBuffer row(TD_OUTPUT_MIN_LINE_SIZE), line(TD_OUTPUT_MIN_LINE_SIZE);
+#if TD_DATA_OUTPUT == TD_OUTPUT_CSV
+	convertRecord(pLeafPartition->getGenRecords()->GetAt(0), true, row);
+#else
+	convertRecord(pLeafPartition->getGenRecords()->GetAt(0), isC45, row);
+#endif
+
+	CString classValue;
+	int nClasses = pLeafPartition->getNumClasses();
+	int classIdx = pLeafPartition->getPartAttribs()->GetSize();
+	for (int j = 0; j < nClasses; ++j){
+		// Obtain the class value
+		classValue = pLeafPartition->getGenRecords()->GetAt(j)->getValue(classIdx)->toString(true);
+#if TD_DATA_OUTPUT == TD_OUTPUT_CSV
+		if (pLeafPartition->m_classNoisySums[j] <= 0)
+			continue;
+		pBuffers[0].appendInt(pLeafPartition->m_classNoisySums[j]);
+		pBuffers[0].append(TD_RAWDATA_DELIMETER);
+		pBuffers[0].append(row);
+		pBuffers[0].append(classValue);
+		pBuffers[0].append(TCHAR('\n'));
+#else
+		if (!isC45) {
+			if (classValue == ">50K")
+				classValue = "+1 ";
+			else
+				classValue = "-1 ";
+		}
+		line.reset();
+		if (isC45) {
+			line.append(row);
+			line.append(classValue);
+			line.append(TD_RAWDATA_TERMINATOR);
+		}
+		else {
+			line.append(classValue);
+			line.append(row);
+		}
+		line.append(TCHAR('\n'));
+	#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+		// Print the record once, weighted by its noisyCount
+		if (pLeafPartition->m_classNoisySums[j] <= 0)
+			continue;
+		if (isC45) {
+			pBuffers[0].appendInt(pLeafPartition->m_classNoisySums[j]);
+			pBuffers[0].append(TD_RAWDATA_DELIMETER);
+			pBuffers[0].append(line);
+		}
+		else {
+			pBuffers[0].append(line);
+			pBuffers[1].appendInt(pLeafPartition->m_classNoisySums[j]);
+			pBuffers[1].append(TCHAR('\n'));
+		}
+	#else
+		pBuffers[0].appendRepeated(line.getData(), line.getSize(), pLeafPartition->m_classNoisySums[j]);
+	#endif
+#endif
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Multidimensionally generalized test records routed to a leaf, according
+// to their raw counts.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::serializeMultiDimTestLeaf(int leafIdx, CTDByteBuffer* pBuffers)
+{
+	bool isC45 = m_bSerializeC45;
+	int nRecrods = m_pSerializeRouter->getNumLeafRecords(leafIdx);
+	if (nRecrods == 0)
+		return true;
+
+	CTDByteBuffer row(TD_OUTPUT_MIN_LINE_SIZE);
+	convertRecord(m_pSerializeRouter->getLeafRecord(leafIdx, 0), isC45, row);
+
+	CString classValue;
+	int classIdx = m_pAttribMgr->getNumAttributes() - 1;
+	for (int j = 0; j < nRecrods; ++j) {
+		// obtain the class value
+		classValue = m_pSerializeRouter->getLeafRecord(leafIdx, j)->getValue(classIdx)->toString(true);
+		if (!isC45) {
+			if (classValue == ">50K")
+				classValue = "+1 ";
+			else
+				classValue = "-1 ";
+			pBuffers[0].append(classValue);
+			pBuffers[0].append(row);
+		}
+		else {
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+			// The .names file declares a case weight, so every test record has a weight of 1.
+			pBuffers[0].appendInt(1);
+			pBuffers[0].append(TD_RAWDATA_DELIMETER);
+#endif
+			pBuffers[0].append(row);
+			pBuffers[0].append(classValue);
+			pBuffers[0].append(TD_RAWDATA_TERMINATOR);
+		}
+		pBuffers[0].append(TCHAR('\n'));
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Longest root-to-leaf path among the leaf partitions.
+//---------------------------------------------------------------------------
+int CTDDataMgr::getLongestPath(CTDPartitions* pLeafPartitions)
+{
+	int longestPath = 0;
+	CTDPartition* pLeafPartition = NULL;
+	for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
+		pLeafPartition = pLeafPartitions->GetNext(leafPos);
+		if (pLeafPartition->m_path.GetSize() > longestPath)
+			longestPath = pLeafPartition->m_path.GetSize() - 1;	// Root-to-child has path length = 1.
+	}
+	return longestPath;
+}
+
+//---------------------------------------------------------------------------
+// Converts a generalized record to a C4.5 or SVM record format.
+// A categorical value is written from the multidimensional bits of its
+// current concept: concept w is 1 if it is the current concept or one of
+// its ancestors, otherwise 0 (omitted in SVM).
+//---------------------------------------------------------------------------
+void CTDDataMgr::convertRecord(CTDRecord* pRec, bool isC45, CTDByteBuffer& row)
 {
-	str.Empty();
-	bool flag = false;
-	CTDRecord * pRec = NULL;
+	row.reset();
 	CTDContConcept* pRootContConcept = NULL;
 	CTDContConcept* pCurrContConcept = NULL;
-	CTDDiscConcept* pCurrDiscConcept = NULL;
+	CTDConcept* pCurrDiscConcept = NULL;
 
-	int aIdx = 0;	// Attribute index
 	int cIdx = 1;	// Concept index
-	CTDPartAttrib* pPartAttrib=  NULL;
-
-	if (isTestPartition)
-		pRec = pLeafPartition->getRecord(0);	// Contains at least 1 record
-	else
-		pRec = pLeafPartition->getGenRecords()->GetAt(0);
+	CTDAttrib* pAttrib = NULL;
 
 	// Iterate through pRec.
-	// partAttribs does not contain the class attribute. Will append later.
-	for (POSITION pos = pLeafPartition->getPartAttribs()->GetHeadPosition(); pos != NULL; ++aIdx) {
-		pPartAttrib = pLeafPartition->getPartAttribs()->GetNext(pos);
-				
-		flag = false;
+	// The class attribute is not converted. Will append later.
+	int nAttribs = m_pAttribMgr->getNumAttributes() - 1;
+	for (int aIdx = 0; aIdx < nAttribs; ++aIdx) {
+		pAttrib = m_pAttribMgr->getAttribute(aIdx);
 
 		// Current value belongs to a continuous attribte
-		if (pPartAttrib->getActualAttrib()->isContinuous()) {
-			LPTSTR tempStr = NULL;
+		if (pAttrib->isContinuous()) {
 			pCurrContConcept = static_cast <CTDContConcept*> (pRec->getValue(aIdx)->getCurrentConcept());
 			if (isC45) {
 				// C4.5 classifier
 				// Write midpoint
 				float midpoint = ((pCurrContConcept->m_upperBound + pCurrContConcept->m_lowerBound) / 2);
-				tempStr = pCurrContConcept->FloatToStr(midpoint, TD_CONTVALUE_NUMDEC);
-				str += tempStr;
-				str += TD_RAWDATA_DELIMETER;
-				delete [] tempStr;
-				tempStr = NULL;
-				flag = true;
-				continue;
+				row.appendFloat(midpoint, TD_CONTVALUE_NUMDEC);
+				row.append(TD_RAWDATA_DELIMETER);
 			}
 			else {
 				// SVM classifier
 				// Write normalized interval value [0-1]
 				pRootContConcept = static_cast <CTDContConcept*> (pCurrContConcept->getAttrib()->getConceptRoot());
 				float normValue = (pCurrContConcept->m_upperBound - pCurrContConcept->m_lowerBound) / (pRootContConcept->m_upperBound - pRootContConcept->m_lowerBound);
-				tempStr = pCurrContConcept->FloatToStr(normValue, TD_CONTVALUE_NUMDEC);
-				str += pCurrContConcept->FloatToStr(cIdx);
-				str += ":";
-				str += tempStr;
-				str += " ";
-				delete [] tempStr;
-				tempStr = NULL;
+				row.appendInt(cIdx);
+				row.append(TCHAR(':'));
+				row.appendFloat(normValue, TD_CONTVALUE_NUMDEC);
+				row.append(TCHAR(' '));
 				cIdx += 1;
-				flag = true;
-				continue;
 			}
+			continue;
 		}
 
-		CTDConcepts* pTargetConcepts = pPartAttrib->getActualAttrib()->getMultiDimConcepts();
-		CTDConcept*	pTargetConcept = NULL;
-		int nConcepts = pTargetConcepts->GetSize();
-		pCurrDiscConcept = static_cast <CTDDiscConcept*> (pRec->getValue(aIdx)->getCurrentConcept());				
+		int nConcepts = pAttrib->getMultiDimConcepts()->GetSize();
+		pCurrDiscConcept = pRec->getValue(aIdx)->getCurrentConcept();
 		for (int w = 0; w < nConcepts; ++w) {
-			pTargetConcept = pTargetConcepts->GetAt(w);
-
-			// Target concept is the root. Write 1
-			if (pTargetConcept->m_depth == 0) {
-				if (isC45) {
-					str += "1";
-					str += TD_RAWDATA_DELIMETER;
-					flag = true;
-					continue;
-				}
-				else {
-					str += CTDContConcept::FloatToStr(cIdx + w);
-					str += ":1 ";
-					flag = true;
-					continue;
-				}
+			if (isC45) {
+				row.append(pCurrDiscConcept->isMultiDimBitSet(w) ? TCHAR('1') : TCHAR('0'));
+				row.append(TD_RAWDATA_DELIMETER);
 			}
-					
-			// Target concept is not current concept and has same or higher depth in hierarchy tree
-			// Write 0
-			if ((pCurrDiscConcept->m_conceptValue != pTargetConcept->m_conceptValue) && (pCurrDiscConcept->m_depth <= pTargetConcept->m_depth)) {
-				if (isC45) {
-					str += "0";	
-					str += TD_RAWDATA_DELIMETER;
-					flag = true;
-					continue;
-				}
-				else
-					continue;
+			else if (pCurrDiscConcept->isMultiDimBitSet(w)) {
+				row.appendInt(cIdx + w);
+				row.append(_T(":1 "), 3);
 			}
+		}
 
-			// Target concept is current concept
-			// Write 1
-			if (pCurrDiscConcept->m_conceptValue == pTargetConcept->m_conceptValue) {
-				if (isC45) {
-					str += "1";
-					str += TD_RAWDATA_DELIMETER;
-					flag = true;
-					continue;
-				}
-				else {
-					str += CTDContConcept::FloatToStr(cIdx + w);
-					str += ":1 ";
-					flag = true;
-					continue;
-				}
-			}
-					
-			// Target concept is an ancestor
-			// Write 1, else, write 0
-			if (pCurrDiscConcept->isAncestor(pTargetConcept)) {
-				if (isC45) {
-					str += "1";
-					str += TD_RAWDATA_DELIMETER;
-					flag = true;
-					continue;
-				}
-				else {
-					str += CTDContConcept::FloatToStr(cIdx + w);
-					str += ":1 ";
-					flag = true;
-					continue;
-				}
+		cIdx += nConcepts;
+	}
+
+	return;
+}
+
+//---------------------------------------------------------------------------
+// Same features as the SVM format of convertRecord, as 0-based column
+// indices and values.
+//---------------------------------------------------------------------------
+void CTDDataMgr::convertRecordSparse(CTDRecord* pRec, CTDIntArray& colIndices, CTDFloatArray& values)
+{
+	colIndices.RemoveAll();
+	values.RemoveAll();
+	CTDContConcept* pRootContConcept = NULL;
+	CTDContConcept* pCurrContConcept = NULL;
+	CTDConcept* pCurrDiscConcept = NULL;
+
+	int cIdx = 0;	// Column index
+	CTDAttrib* pAttrib = NULL;
+
+	int nAttribs = m_pAttribMgr->getNumAttributes() - 1;
+	for (int aIdx = 0; aIdx < nAttribs; ++aIdx) {
+		pAttrib = m_pAttribMgr->getAttribute(aIdx);
+
+		// Normalized interval value [0-1]
+		if (pAttrib->isContinuous()) {
+			pCurrContConcept = static_cast <CTDContConcept*> (pRec->getValue(aIdx)->getCurrentConcept());
+			pRootContConcept = static_cast <CTDContConcept*> (pCurrContConcept->getAttrib()->getConceptRoot());
+			colIndices.Add(cIdx);
+			values.Add((pCurrContConcept->m_upperBound - pCurrContConcept->m_lowerBound) / (pRootContConcept->m_upperBound - pRootContConcept->m_lowerBound));
+			cIdx += 1;
+			continue;
+		}
+
+		int nConcepts = pAttrib->getMultiDimConcepts()->GetSize();
+		pCurrDiscConcept = pRec->getValue(aIdx)->getCurrentConcept();
+		for (int w = 0; w < nConcepts; ++w) {
+			if (pCurrDiscConcept->isMultiDimBitSet(w)) {
+				colIndices.Add(cIdx + w);
+				values.Add(1.0f);
 			}
-			else {
-				if (isC45) {
-					str += "0";	
-					str += TD_RAWDATA_DELIMETER;
-					flag = true;
-					continue;
-				}
-				else 
-					continue;
+		}
+		cIdx += nConcepts;
+	}
+}
+
+//---------------------------------------------------------------------------
+// Collect the leaf partitions and the generalized test records in memory.
+// Each test record refers to its test leaf by index.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::makeResults(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter, CTDResults& results)
+{
+	results.cleanup();
+	CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+	int classIdx = pAttribs->GetSize() - 1;
+	for (int i = 0; i < classIdx; ++i)
+		results.m_attribNames.Add(pAttribs->GetAt(i)->m_attribName);
+
+	CTDConcept* pClassRoot = pAttribs->GetAt(classIdx)->getConceptRoot();
+	int nClasses = pClassRoot->getNumChildConcepts();
+	for (int j = 0; j < nClasses; ++j)
+		results.m_classValues.Add(pClassRoot->getChildConcept(j)->m_conceptValue);
+
+	// Training leaves with the noisy class counts.
+	CTDPartition* pPartition = NULL;
+	results.m_leaves.SetSize(0, pLeafPartitions->GetCount());
+	for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL;) {
+		pPartition = pLeafPartitions->GetNext(pos);
+		CTDLeafResult* pLeaf = new CTDLeafResult();
+		results.m_leaves.Add(pLeaf);
+		makeGenValues(pPartition->getGenRecords()->GetAt(0), classIdx, pLeaf->m_genValues);
+		pLeaf->m_classCounts.Copy(pPartition->m_classNoisySums);
+	}
+
+	// Test leaves with the raw class counts.
+	results.m_testRowLeaves.SetSize(m_testRecords.GetSize());
+	results.m_testRowClasses.SetSize(m_testRecords.GetSize());
+	for (int r = 0; r < m_testRecords.GetSize(); ++r) {
+		results.m_testRowLeaves[r] = -1;
+		results.m_testRowClasses[r] = m_testRecords.GetAt(r)->getValue(classIdx)->getCurrentConcept()->m_childIdx;
+	}
+
+	// Only the test leaves with records are kept.
+	for (int l = 0; l < pTestRouter->getNumLeaves(); ++l) {
+		int nRecs = pTestRouter->getNumLeafRecords(l);
+		if (nRecs == 0)
+			continue;
+
+		CTDLeafResult* pLeaf = new CTDLeafResult();
+		int leafIdx = results.m_testLeaves.Add(pLeaf);
+		makeGenValues(pTestRouter->getLeafRecord(l, 0), classIdx, pLeaf->m_genValues);
+
+		pLeaf->m_classCounts.SetSize(nClasses);
+		for (int j = 0; j < nClasses; ++j)
+			pLeaf->m_classCounts[j] = 0;
+		for (int r = 0; r < nRecs; ++r) {
+			int recordID = pTestRouter->getLeafRecord(l, r)->getRecordID();
+			if (recordID < 0 || recordID >= m_testRecords.GetSize()) {
+				cerr << _T("CTDDataMgr: Invalid test record ID: ") << recordID << endl;
+				ASSERT(false);
+				return false;
 			}
+			results.m_testRowLeaves[recordID] = leafIdx;
+			++pLeaf->m_classCounts[results.m_testRowClasses[recordID]];
+		}
+	}
+	return true;
+}
 
-			ASSERT(flag);
+//---------------------------------------------------------------------------
+// Current concepts of the first nAttribs values of pRec.
+//---------------------------------------------------------------------------
+void CTDDataMgr::makeGenValues(CTDRecord* pRec, int nAttribs, CTDGenValueArray& genValues)
+{
+	genValues.SetSize(nAttribs);
+	for (int i = 0; i < nAttribs; ++i) {
+		CTDConcept* pConcept = pRec->getValue(i)->getCurrentConcept();
+		CTDGenValue& genValue = genValues[i];
+		genValue.m_conceptValue = pConcept->m_conceptValue;
+		genValue.m_flattenIdx = pConcept->m_flattenIdx;
+		genValue.m_bContinuous = pConcept->isContinuous();
+		if (genValue.m_bContinuous) {
+			CTDContConcept* pContConcept = static_cast<CTDContConcept*> (pConcept);
+			genValue.m_lowerBound = pContConcept->m_lowerBound;
+			genValue.m_upperBound = pContConcept->m_upperBound;
 		}
+	}
+}
 
-		cIdx += nConcepts;
+//---------------------------------------------------------------------------
+// Write the training and test records as binary CSR matrices, see TDCSRHeader.
+// Must be called after CTDAttribMgr::writeNameFileMultiDim.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::writeBinaryRecords(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter)
+{
+	cout << _T("Writing binary sparse records...") << endl;
+	try {
+		if (!writeCSRFile(m_transformedDataFile + _T(".") + TD_CSRFILE_EXT, pLeafPartitions, NULL))
+			return false;
+		if (!writeCSRFile(m_transformedTestFile + _T(".") + TD_CSRFILE_EXT, NULL, pTestRouter))
+			return false;
+	}
+	catch (CFileException&) {
+		cerr << _T("Failed to write binary sparse records.") << endl;
+		ASSERT(false);
+		return false;
 	}
+	cout << _T("Writing binary sparse records succeeded.") << endl << endl;
+	return true;
+}
 
-	return;
+//---------------------------------------------------------------------------
+// One row per (leaf, class) with a positive count, weighted by the count.
+// The leaves are the leaf partitions with their noisy counts, or the test
+// leaves of pTestRouter with their raw counts if it is not NULL.
+//---------------------------------------------------------------------------
+bool CTDDataMgr::writeCSRFile(const CString& fileName, CTDPartitions* pPartitions, CTDTestRouter* pTestRouter)
+{
+	CArray<__int64, __int64> rowPtrs;
+	CTDIntArray colIndices, labels, leafColIndices, classCounts;
+	CTDFloatArray values, weights, leafValues;
+	CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+	int nClasses = pAttribs->GetAt(pAttribs->GetSize() - 1)->getConceptRoot()->getNumChildConcepts();
+
+	rowPtrs.Add(0);
+	int classIdx = pAttribs->GetSize() - 1;
+	int nLeaves = pTestRouter ? pTestRouter->getNumLeaves() : pPartitions->GetCount();
+	POSITION pos = pTestRouter ? NULL : pPartitions->GetHeadPosition();
+	CTDRecord* pGenRec = NULL;
+	for (int l = 0; l < nLeaves; ++l) {
+		if (pTestRouter) {
+			int nRecs = pTestRouter->getNumLeafRecords(l);
+			if (nRecs == 0)
+				continue;
+			pGenRec = pTestRouter->getLeafRecord(l, 0);
+			classCounts.SetSize(nClasses);
+			for (int j = 0; j < nClasses; ++j)
+				classCounts[j] = 0;
+			for (int r = 0; r < nRecs; ++r)
+				++classCounts[pTestRouter->getLeafRecord(l, r)->getValue(classIdx)->getCurrentConcept()->m_childIdx];
+		}
+		else {
+			// The generalized record of class j is the j-th one.
+			CTDPartition* pPartition = pPartitions->GetNext(pos);
+			pGenRec = pPartition->getGenRecords()->GetAt(0);
+			classCounts.Copy(pPartition->m_classNoisySums);
+		}
+		convertRecordSparse(pGenRec, leafColIndices, leafValues);
+
+		for (int j = 0; j < classCounts.GetSize(); ++j) {
+			if (classCounts[j] <= 0)
+				continue;
+			colIndices.Append(leafColIndices);
+			values.Append(leafValues);
+			rowPtrs.Add(colIndices.GetSize());
+			labels.Add(j);
+			weights.Add(float(classCounts[j]));
+		}
+	}
+
+	CFile csrFile;
+	if (!csrFile.Open(fileName, CFile::modeCreate | CFile::modeWrite | CFile::typeBinary)) {
+		cerr << _T("CTDDataMgr: Failed to open file ") << fileName << endl;
+		return false;
+	}
+
+	TDCSRHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.m_magic, TD_CSR_MAGIC, sizeof(header.m_magic));
+	header.m_version = TD_CSR_VERSION;
+	header.m_nRows = labels.GetSize();
+	header.m_nNonZeros = colIndices.GetSize();
+	csrFile.Write(&header, sizeof(header));
+	__int64 nBytes = sizeof(header);
+
+	header.m_featureOffset = nBytes;
+	writeCSRFeatures(csrFile, nBytes, header.m_nFeatures, header.m_nClasses);
+
+	writeCSRPadding(csrFile, nBytes);
+	header.m_rowPtrOffset = nBytes;
+	csrFile.Write(rowPtrs.GetData(), UINT(rowPtrs.GetSize() * sizeof(__int64)));
+	nBytes += rowPtrs.GetSize() * sizeof(__int64);
+
+	writeCSRPadding(csrFile, nBytes);
+	header.m_colIdxOffset = nBytes;
+	if (colIndices.GetSize() > 0)
+		csrFile.Write(colIndices.GetData(), UINT(colIndices.GetSize() * sizeof(int)));
+	nBytes += colIndices.GetSize() * sizeof(int);
+
+	writeCSRPadding(csrFile, nBytes);
+	header.m_valueOffset = nBytes;
+	if (values.GetSize() > 0)
+		csrFile.Write(values.GetData(), UINT(values.GetSize() * sizeof(float)));
+	nBytes += values.GetSize() * sizeof(float);
+
+	writeCSRPadding(csrFile, nBytes);
+	header.m_labelOffset = nBytes;
+	if (labels.GetSize() > 0)
+		csrFile.Write(labels.GetData(), UINT(labels.GetSize() * sizeof(int)));
+	nBytes += labels.GetSize() * sizeof(int);
+
+	writeCSRPadding(csrFile, nBytes);
+	header.m_weightOffset = nBytes;
+	if (weights.GetSize() > 0)
+		csrFile.Write(weights.GetData(), UINT(weights.GetSize() * sizeof(float)));
+	nBytes += weights.GetSize() * sizeof(float);
+
+	// Now that the offsets are known, rewrite the header.
+	csrFile.SeekToBegin();
+	csrFile.Write(&header, sizeof(header));
+	csrFile.Close();
+	CTDProfiler::addCount(TD_COUNTER_BYTES_WRITTEN, nBytes);
+	return true;
 }
 
 //---------------------------------------------------------------------------
-// Prints out the root-to-leaf path
+// Feature-to-concept mapping in the column order of convertRecordSparse,
+// followed by the class values.
 //---------------------------------------------------------------------------
-void CTDDataMgr::printPath(CTDPartition* pLeafPartition)
+void CTDDataMgr::writeCSRFeatures(CFile& file, __int64& nBytes, int& nFeatures, int& nClasses)
 {
-	// Info 
-	cout << "--> PartitionIdx: " << pLeafPartition->getPartitionIdx() << ". "
-		 << "m_path length: " << pLeafPartition->m_path.GetSize() - 1 << ". "
-		 << "# of records: " << pLeafPartition->getNumRecords() << endl;
+	CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+	int nAttributes = pAttribs->GetSize();
+	CTDAttrib* pAttrib = NULL;
+	CString name;
+	__int32 entry[3];
+	nFeatures = 0;
+	for (int a = 0; a < nAttributes - 1; ++a) {
+		pAttrib = pAttribs->GetAt(a);
+		int nConcepts = pAttrib->isContinuous() ? 1 : pAttrib->getMultiDimConcepts()->GetSize();
+		for (int c = 0; c < nConcepts; ++c) {
+			if (pAttrib->isContinuous())
+				name = pAttrib->m_attribName;
+			else
+				name = pAttrib->getMultiDimConcepts()->GetAt(c)->m_conceptValue;
+			entry[0] = a;
+			entry[1] = pAttrib->isContinuous() ? 1 : 0;
+			entry[2] = name.GetLength();
+			file.Write(entry, sizeof(entry));
+			file.Write((LPCTSTR) name, name.GetLength() * sizeof(TCHAR));
+			nBytes += sizeof(entry) + name.GetLength() * sizeof(TCHAR);
+			++nFeatures;
+		}
+	}
 
-	// Path
-	cout << "Root-to-leaf path: " << endl;
-	for (int q = 0; q < pLeafPartition->m_path.GetSize(); ++q) 
-		cout << pLeafPartition->m_path.GetAt(q) << " ";
+	CTDConcept* pClassRoot = pAttribs->GetAt(nAttributes - 1)->getConceptRoot();
+	nClasses = pClassRoot->getNumChildConcepts();
+	for (int j = 0; j < nClasses; ++j) {
+		name = pClassRoot->getChildConcept(j)->m_conceptValue;
+		entry[0] = name.GetLength();
+		file.Write(entry, sizeof(entry[0]));
+		file.Write((LPCTSTR) name, name.GetLength() * sizeof(TCHAR));
+		nBytes += sizeof(entry[0]) + name.GetLength() * sizeof(TCHAR);
+	}
+}
 
-	cout << endl << endl;
+//---------------------------------------------------------------------------
+// Pad the file with zeros to the next 8-byte boundary.
+//---------------------------------------------------------------------------
+// static
+void CTDDataMgr::writeCSRPadding(CFile& file, __int64& nBytes)
+{
+	static const char zeros[8] = { 0 };
+	int nPadding = int((8 - nBytes % 8) % 8);
+	if (nPadding > 0) {
+		file.Write(zeros, nPadding);
+		nBytes += nPadding;
+	}
+}
 
-	return;
+//---------------------------------------------------------------------------
+// Header row of the CSV training data: count,<columns>,<class attribute>
+// bMultiDim: columns are the multidimensional concepts as in the .names file,
+// otherwise the original attributes.
+//---------------------------------------------------------------------------
+void CTDDataMgr::makeCSVHeader(bool bMultiDim, CString& str)
+{
+	str = TD_CSV_COUNT_COLUMN;
+	CTDAttribs* pAttribs = m_pAttribMgr->getAttributes();
+	int nAttributes = pAttribs->GetSize();
+	CTDAttrib* pAttrib = NULL;
+	for (int a = 0; a < nAttributes - 1; ++a) {
+		pAttrib = pAttribs->GetAt(a);
+		if (!bMultiDim || pAttrib->isContinuous()) {
+			str += TD_RAWDATA_DELIMETER;
+			str += pAttrib->m_attribName;
+			continue;
+		}
+		CTDConcepts* pMultiDimConcepts = pAttrib->getMultiDimConcepts();
+		for (int c = 0; c < pMultiDimConcepts->GetSize(); ++c) {
+			str += TD_RAWDATA_DELIMETER;
+			str += pMultiDimConcepts->GetAt(c)->m_conceptValue;
+		}
+	}
+	str += TD_RAWDATA_DELIMETER;
+	str += pAttribs->GetAt(nAttributes - 1)->m_attribName;
 }
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
@@ -19,9 +19,81 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+#if !defined(TDRESULT_H)
+    #include "TDResult.h"
+#endif
+
+#if !defined(TDTESTROUTER_H)
+    #include "TDTestRouter.h"
+#endif
+
 //Class CTDPartitions;
 
-class CTDDataMgr  
+//---------------------------------------------------------------------------
+// Header of a binary CSR file. All sections are little-endian and start at
+// 8-byte aligned offsets from the beginning of the file.
+// Features: nFeatures entries in column order, each
+//     __int32 attribIdx, __int32 bContinuous, __int32 len, len chars
+//     (concept value, or attribute name for a continuous attribute),
+//     followed by nClasses entries: __int32 len, len chars (class value).
+// Row pointers: __int64[nRows + 1], row r has nonzeros [rowPtr[r], rowPtr[r+1]).
+// Column indices: __int32[nNonZeros], 0-based, i.e., SVM concept# - 1.
+// Values: float[nNonZeros], 1 for categorical concepts, normalized interval
+//     length for continuous attributes.
+// Labels: __int32[nRows], index of the class value.
+// Weights: float[nRows], number of records the row stands for; the noisy
+//     count for training data, the raw count for test data.
+//---------------------------------------------------------------------------
+#define TD_CSR_MAGIC                        "TDCSR\0\0\0"
+#define TD_CSR_VERSION                      1
+
+struct TDCSRHeader
+{
+    char    m_magic[8];
+    __int32 m_version;
+    __int32 m_nRows;
+    __int32 m_nFeatures;
+    __int32 m_nClasses;
+    __int64 m_nNonZeros;
+    __int64 m_featureOffset;
+    __int64 m_rowPtrOffset;
+    __int64 m_colIdxOffset;
+    __int64 m_valueOffset;
+    __int64 m_labelOffset;
+    __int64 m_weightOffset;
+};
+
+//---------------------------------------------------------------------------
+// Caller-owned column of input records for CTDDataMgr::readColumns. The
+// buffers are read in place and hold one entry per row. Float columns are
+// for continuous attributes; string and dictionary columns for categorical
+// attributes and the class. Bit r of m_pValidity, least significant bit
+// first, is 0 if the value in row r is unknown. NULL means all are known.
+//---------------------------------------------------------------------------
+enum TDColumnType { TD_COLUMN_FLOAT, TD_COLUMN_STRING, TD_COLUMN_DICTIONARY };
+
+struct TDColumn
+{
+    TDColumnType   m_type;
+    const float*   m_pFloats;           // TD_COLUMN_FLOAT.
+    const LPCTSTR* m_pStrings;          // TD_COLUMN_STRING.
+    const int*     m_pIndices;          // TD_COLUMN_DICTIONARY. Indices into m_pDictionary.
+    const LPCTSTR* m_pDictionary;
+    int            m_nDictionary;
+    const BYTE*    m_pValidity;
+
+    TDColumn() : m_type(TD_COLUMN_FLOAT), m_pFloats(NULL), m_pStrings(NULL), m_pIndices(NULL), 
+                 m_pDictionary(NULL), m_nDictionary(0), m_pValidity(NULL) {};
+    bool isValid(int r) const { return !m_pValidity || ((m_pValidity[r >> 3] >> (r & 7)) & 1) != 0; };
+};
+
+typedef CTypedPtrArray<CPtrArray, CTDConceptPtrArray*> CTDConceptPtrArrays;
+
+class CTDDataMgr : public CTDOutputSerializer
 {
 public:
     CTDDataMgr(LPCTSTR rawDataFile, LPCTSTR transformedDataFile, LPCTSTR transformedTestFile, int nInputRecs, int nTraining);
@@ -30,18 +102,41 @@ public:
 // Operations
     bool initialize(CTDAttribMgr* pAttribMgr);
     bool readRecords();
+    bool readRecords(const CStringArray& rawRecords);
+    bool readColumns(const TDColumn* pColumns, int nColumns, int nRows);
+    bool copyRecords(CTDDataMgr* pSrcMgr);
     bool writeRecords(bool bRawValue);
     bool writeDiffRecords(CTDPartitions* pLeafPartitions);
-	bool writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDPartitions* pTestLeafPartitions, bool isC45);
+	bool writeMultiDimRecords(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter, bool isC45);
+	bool writeBinaryRecords(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter);
+	bool makeResults(CTDPartitions* pLeafPartitions, CTDTestRouter* pTestRouter, CTDResults& results);
     CTDRecords* getRecords() { return &m_records; };
 	CTDRecords* getTestRecords() { return &m_testRecords; };
-	void convertRecord(CTDPartition* pLeafPartition, bool isC45, bool isTestPartition, CString& str);
-	void printPath(CTDPartition* pLeafPartition);
+	void convertRecord(CTDRecord* pRec, bool isC45, CTDByteBuffer& row);
+	void convertRecordSparse(CTDRecord* pRec, CTDIntArray& colIndices, CTDFloatArray& values);
+	void makeCSVHeader(bool bMultiDim, CString& str);
+	virtual bool serializeItem(int itemIdx, CTDByteBuffer* pBuffers);
 
 	//double StrToFloat (const char * string);
     
 protected:
     bool addRecord(CTDRecord* pRecord);
+    bool addRawRecord(CString lineStr, bool& bDone);
+    void addInputRecord(CTDRecord* pNewRecord, bool& bDone);
+    bool makeColumnRecord(const TDColumn* pColumns, const CTDConceptPtrArrays& dictConcepts, int r, CTDRecord*& pNewRecord);
+    bool checkRecords();
+    bool copyRecords(CTDRecords* pSrcRecs, CTDRecords& recs);
+    static void makeGenValues(CTDRecord* pRec, int nAttribs, CTDGenValueArray& genValues);
+    bool serializeDiffPartition(CTDPartition* pLeafPartition, CTDByteBuffer* pBuffers);
+    bool serializeMultiDimPartition(CTDPartition* pLeafPartition, CTDByteBuffer* pBuffers);
+    bool serializeMultiDimTestLeaf(int leafIdx, CTDByteBuffer* pBuffers);
+    void setSerializePartitions(CTDPartitions* pPartitions);
+    int getLongestPath(CTDPartitions* pLeafPartitions);
+    bool writeCSRFile(const CString& fileName, CTDPartitions* pPartitions, CTDTestRouter* pTestRouter);
+    void writeCSRFeatures(CFile& file, __int64& nBytes, int& nFeatures, int& nClasses);
+    static void writeCSRPadding(CFile& file, __int64& nBytes);
+
+    enum TDSerializeMode { TD_SERIALIZE_DIFF, TD_SERIALIZE_MULTIDIM_DATA, TD_SERIALIZE_MULTIDIM_TEST };
 
 // Attributes
     CString         m_rawDataFile;
@@ -52,6 +147,10 @@ protected:
     CTDAttribMgr*   m_pAttribMgr;
 	int             m_nInputRecs;	// Number of all records in input data set.
     int             m_nTraining;
+    TDSerializeMode m_serializeMode;    // Output being serialized by the output writer.
+    bool            m_bSerializeC45;
+    CTDPartitionPtrArray m_serializePartitions; // Leaf partitions being serialized.
+    CTDTestRouter*  m_pSerializeRouter;     // Test leaves being serialized.
 };
 
 #endif
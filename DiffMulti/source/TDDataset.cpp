@@ -0,0 +1,49 @@
+// TDDataset.cpp: implementation of the CTDDataset class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDDATASET_H)
+    #include "TDDataset.h"
+#endif
+
+CTDDataset::CTDDataset(int nInputRecs, int nTraining)
+    : m_attribMgr(_T(""), _T("")),
+      m_dataMgr(_T(""), _T(""), _T(""), nInputRecs, nTraining),
+      m_bLoaded(false)
+{
+    if (!m_dataMgr.initialize(&m_attribMgr))
+        ASSERT(false);
+}
+
+CTDDataset::~CTDDataset()
+{
+}
+
+//---------------------------------------------------------------------------
+// Parse the lines of the .hchy and .rawdata files, and count the root
+// partition of the training records.
+//---------------------------------------------------------------------------
+bool CTDDataset::load(const CStringArray& hierarchyLines, const CStringArray& rawRecords)
+{
+    m_bLoaded = false;
+    if (!m_attribMgr.readAttributes(hierarchyLines))
+        return false;
+    if (!m_dataMgr.readRecords(rawRecords))
+        return false;
+
+    cout << _T("Counting root partition...") << endl;
+    CTDPartition rootPartition(0, m_attribMgr.getAttributes());
+    CTDRecords* pRecs = m_dataMgr.getRecords();
+    for (int r = 0; r < pRecs->GetSize(); ++r) {
+        if (!rootPartition.addRecord(pRecs->GetAt(r)))
+            return false;
+    }
+    if (!rootPartition.buildRootState(m_rootState))
+        return false;
+    cout << _T("Counting root partition succeeded.") << endl;
+
+    m_bLoaded = true;
+    return true;
+}
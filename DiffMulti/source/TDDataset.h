@@ -0,0 +1,49 @@
+// TDDataset.h: interface for the CTDDataset class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDDATASET_H)
+#define TDDATASET_H
+
+#if !defined(TDATTRIBMGR_H)
+    #include "TDAttribMgr.h"
+#endif
+
+#if !defined(TDDATAMGR_H)
+    #include "TDDataMgr.h"
+#endif
+
+#if !defined(TDPARTITION_H)
+    #include "TDPartition.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Attribute hierarchies and records parsed once, and the counts and record
+// orders of their root partition, see CTDRootState. None of them is
+// changed after load. A run specializes the concepts of its records and
+// grows the continuous hierarchies in place, so it works on copies, see
+// CTDController::runDiffMulti(CTDDataset*, ...). Copies may be made
+// concurrently.
+//---------------------------------------------------------------------------
+class CTDDataset
+{
+public:
+    CTDDataset(int nInputRecs, int nTraining);
+    virtual ~CTDDataset();
+
+// Operations
+    bool load(const CStringArray& hierarchyLines, const CStringArray& rawRecords);
+    bool isLoaded() const { return m_bLoaded; };
+    CTDAttribMgr* getAttribMgr() { return &m_attribMgr; };
+    CTDDataMgr* getDataMgr() { return &m_dataMgr; };
+    const CTDRootState* getRootState() const { return &m_rootState; };
+
+protected:
+// Attributes
+    CTDAttribMgr m_attribMgr;
+    CTDDataMgr   m_dataMgr;
+    CTDRootState m_rootState;
+    bool         m_bLoaded;
+};
+
+#endif
@@ -19,22 +19,108 @@
 //#define _TD_TREAT_CONT_AS_CONT		// Treat continuous attributes as continuous attributes in C4.5
 
 
-// Score functions
-//#define _TD_SCORE_FUNCTION_INFOGAIN	// Change the name file below to _TD_NAME_FILE_MULTIDIM
-#define _TD_SCORE_FUNTION_MAX			// Change the name file below to _TD_NAME_FILE_MULTIDIM
-//#define _TD_SCORE_FUNTION_DISCERNIBILITY
-//#define _TD_SCORE_FUNCTION_NCP
+// Score functions, chosen at runtime, see setScoreFunction.
+enum TDScoreFunction
+{
+	TD_SCORE_MAX,
+	TD_SCORE_INFOGAIN,
+	TD_SCORE_DISCERNIBILITY,
+	TD_SCORE_NCP,
+	TD_NUM_SCORE_FUNCTIONS
+};
+#define TD_DEFAULT_SCORE_FUNCTION			TD_SCORE_MAX	// Used if none is given on the command line.
+#define TD_bSCORE_ALL_METRICS				0	// Insert a boolean value. 1 to compute all four scores of every candidate concept,
+												// not only the one of the chosen score function. For diagnostics; NCP is costly.
 
 
 // Name file
-//#define _TD_NAME_FILE_NORMAL			// Original attributes with generalized domain values.
-#define _TD_NAME_FILE_MULTIDIM			// Any generalized concept is considered an attribute with domain values = {0, 1}, except numerical attributes.
-										// Used for classifying a multidimensionally-generalized data set.
-										// Activate for _TD_SCORE_FUNCTION_INFOGAIN or _TD_SCORE_FUNTION_MAX.
+#define TD_NAME_FILE_NORMAL					0	// Original attributes with generalized domain values.
+#define TD_NAME_FILE_MULTIDIM				1	// Any generalized concept is considered an attribute with domain values = {0, 1}, except numerical attributes.
+												// Used for classifying a multidimensionally-generalized data set.
+#define TD_NAME_FILE_BY_SCORE				2	// Multidimensional for Max and InfoGain, normal for Discernibility and NCP.
+#define TD_NAME_FILE						TD_NAME_FILE_BY_SCORE
 
 // Classifier type: C.45 or SVM-light
 #define TD_bC45								0	// Insert a boolean value. 0 for SVM data format.
-												// Used only when _TD_NAME_FILE_MULTIDIM.
+												// Used only with the multidimensional name file.
+
+// Training data output: how the noisy count of each (leaf partition, class) is written.
+#define TD_OUTPUT_REPEAT					0	// Repeat the generalized record noisy count times.
+#define TD_OUTPUT_WEIGHTED					1	// Write the generalized record once with its noisy count as weight:
+												// C4.5: leading "case weight" attribute (See5 convention), declared in the .names file.
+												// SVM:  one weight per line in <data file>.wgt (LIBSVM-weights format).
+#define TD_OUTPUT_CSV						2	// Write the generalized record once in CSV with a header row:
+												// count,<attribute or concept>,...,<class attribute>
+												// Multidimensional values are written as for C4.5. The test file is not affected.
+#define TD_DATA_OUTPUT						TD_OUTPUT_REPEAT
+
+// Output files are serialized by worker threads and written in order by the calling thread.
+#define TD_OUTPUT_NUM_THREADS				0		// 0: one thread per processor.
+#define TD_OUTPUT_CHUNK_PARTITIONS			64		// Leaf partitions serialized into one output buffer.
+#define TD_OUTPUT_MIN_BUFFER_SIZE			65536	// Initial size of an output buffer in characters.
+#define TD_OUTPUT_MIN_LINE_SIZE				1024	// Initial size of a single line buffer in characters.
+
+// Binary sparse-matrix (CSR) output of the multidimensional records, see TDCSRHeader.
+#define TD_bBINARY_OUTPUT					0	// Insert a boolean value. 1 to write <data file>.csr and <test file>.csr.
+												// Used only with the multidimensional name file.
+
+// Model of the split decisions and noisy leaves, see TDModelHeader, for generalizing new records with CTDModel::apply.
+#define TD_bSAVE_MODEL						0	// Insert a boolean value. 1 to write <dataSetName>.model after a run.
+												// Used only with the multidimensional name file.
+#define TD_APPLY_WINDOW_SIZE				(64 * 1024 * 1024)	// Input characters read at a time.
+#define TD_APPLY_BLOCK_SIZE					16384	// Input characters generalized as one output item, extended to a whole line.
+#define TD_APPLY_MAX_VALUE_LEN				256		// Longest value of an input record in characters.
+#define TD_APPLY_MAX_ATTRIBS				1024	// Most attributes of a model, including the class.
+
+// Utility of a run measured on a workload of count queries, see CTDWorkload.
+#define TD_bEVAL_WORKLOAD					0	// Insert a boolean value. 1 to evaluate <dataSetName>.queries after a run.
+												// A random workload is generated and written there if the file does not exist.
+#define TD_WORKLOAD_NUM_QUERIES				10000	// Queries of a generated workload.
+#define TD_WORKLOAD_MAX_PREDICATES			3		// Most predicates of a generated query, excluding the class.
+#define TD_WORKLOAD_SANITY_BOUND			0.001	// Fraction of the records; smaller true answers count as this in the relative error.
+#define TD_WORKLOAD_ROW_BLOCK				4096	// Records filtered at a time by the columnar scan.
+
+// Marginals computed from the noisy leaf partitions, see CTDMarginal.
+#define TD_bWRITE_MARGINALS					0	// Insert a boolean value. 1 to write the marginals listed in <dataSetName>.margins
+												// to <dataSetName>.margins.csv after a run.
+#define TD_MARGINAL_MAX_CELLS				(64 * 1024 * 1024)	// Most cells of a dense marginal.
+
+// Phase timers and hot-path counters of a run, see CTDProfiler.
+#define TD_bWRITE_PROFILE					1	// Insert a boolean value. 1 to write them to <dataSetName>.profile.json after a run.
+
+// Bytes held by the main data structures, see CTDMemTracker. Reported with the profile.
+#define TD_bTRACK_MEMORY					1	// Insert a boolean value. 1 to count the bytes of records, values, concepts,
+												// support matrices and partition records as they are allocated and freed.
+#define TD_MEM_MAX_DEPTH					64	// Depths of the partition tree reported separately; deeper partitions count as the last.
+#define TD_MEM_SAMPLE_INTERVAL				0	// Milliseconds between samples of the resident set size during a run. 0: no sampling.
+
+// Trace of the partition tree, see CTDPartitionTrace.
+#define TD_bTRACE_PARTITIONS				0	// Insert a boolean value. 1 to time every partition and write the tree to
+												// <dataSetName>.trace.json (Chrome trace events) and <dataSetName>.trace.csv after a run.
+
+// Utility metrics of the leaf partitions, see CTDEvalMgr::evaluate.
+#define TD_EVAL_NUM_THREADS					0		// 0: one thread per processor.
+#define TD_EVAL_BLOCK_LEAVES				1024	// Leaf partitions evaluated as one block.
+
+// Classification accuracy measured in memory, see CTDClassifier.
+#define TD_bEVAL_CLASSIFIER					0	// Insert a boolean value. 1 to train a linear SVM on the leaf partitions and
+												// report its accuracy on the test records after a run.
+#define TD_CLASSIFIER_MAX_ITERS				1000	// Most passes over the training instances.
+#define TD_CLASSIFIER_EPSILON				0.1		// Stop when no projected gradient is farther than this from 0.
+
+// Repeated trials of one or more configurations on data loaded once, see CTDExperiment.
+#define TD_EXPERIMENT_NUM_THREADS			0	// 0: one thread per processor. Each running trial holds its own copy of the records.
+#define TD_EXP_NUM_DEC						4	// Decimals of the metrics in the report.
+
+// Micro-benchmarks of the kernels on synthetic data, see CTDBenchmark.
+#define TD_BENCH_SEED						12345	// Seed of rand() for the synthetic records and the mechanisms.
+#define TD_BENCH_EPSILON					0.1		// Privacy budget passed to the benchmarked kernels.
+#define TD_BENCH_NUM_CALLS					10000	// Calls of the noise and exponential mechanisms per repetition.
+
+// Synthetic raw records generated from a hierarchy file, see CTDGenerator.
+#define TD_GENERATOR_SEED					1		// Default seed; the records depend only on the seed.
+#define TD_GENERATOR_BLOCK_RECORDS			4096	// Records generated as one output item.
+#define TD_GENERATOR_CONTVALUE_NUMDEC		0		// Decimals of a generated continuous value.
 
 
 #define P_ASSERT(p) if (!p) { ASSERT(false); return false; }
@@ -42,10 +128,17 @@
 // Common types
 typedef CArray<int, int>			CTDIntArray;
 typedef CArray<float, float>		CTDFloatArray;
+typedef CArray<double, double>		CTDDoubleArray;
 typedef CArray<bool, bool>			CTDBoolArray;
 typedef CArray<POSITION, POSITION>	CTDPosArray;	
 typedef CBFMultiDimArray<int> CTDMDIntArray;
 
+// Packed root-to-leaf path of a categorical value. Every level takes
+// ceil(log2(max branches)) bits, starting from depth 1 at the low end.
+typedef unsigned __int64					TDBitValue;
+typedef CArray<TDBitValue, TDBitValue>	CTDBitValueArray;
+#define TD_BITVALUE_NUMBITS				int(sizeof(TDBitValue) * CHAR_BIT)
+
 
 // Constants
 #define TD_RAWDATAFILE_EXT                  _T("rawdata")
@@ -53,6 +146,19 @@ typedef CBFMultiDimArray<int> CTDMDIntArray;
 #define TD_NAMEFILE_EXT                     _T("names")
 #define TD_TRANSFORM_DATAFILE_EXT           _T("data")
 #define TD_TRANSFORM_TESTFILE_EXT           _T("test")
+#define TD_WEIGHTFILE_EXT                   _T("wgt")
+#define TD_CSRFILE_EXT                      _T("csr")
+#define TD_MODELFILE_EXT                    _T("model")
+#define TD_WORKLOADFILE_EXT                 _T("queries")
+#define TD_WORKLOAD_RESULTFILE_EXT          _T("err")
+#define TD_MARGINALFILE_EXT                 _T("margins")
+#define TD_MARGINAL_RESULTFILE_EXT          _T("csv")
+#define TD_EXPERIMENT_TRIALFILE_EXT         _T("trials")
+#define TD_EXPERIMENT_SUMMARYFILE_EXT       _T("summary")
+#define TD_PROFILEFILE_EXT                  _T("profile.json")
+#define TD_TRACEFILE_EXT                    _T("trace.json")
+#define TD_TRACE_CSVFILE_EXT                _T("trace.csv")
+#define TD_DEFAULT_DATASET_NAME             _T("diffmulti")     // File names of in-memory runs.
 
 #define TD_VID_ATTRIB_NAME                  _T("vid")
 #define TD_CLASSES_ATTRIB_NAME              _T("classes")
@@ -69,6 +175,7 @@ typedef CBFMultiDimArray<int> CTDMDIntArray;
 #define TD_CONHCHY_COMMENT                  TCHAR('|')
 #define TD_RAWDATA_DELIMETER                TCHAR(',')
 #define TD_SETVALUE_DELIMETER               TCHAR('>')
+#define TD_QUERY_ATTRIBSEP                  TCHAR(':')
 #define TD_RAWDATA_TERMINATOR               TCHAR('.')
 #define TD_UNKNOWN_VALUE                    TCHAR('?')
 
@@ -77,6 +184,8 @@ typedef CBFMultiDimArray<int> CTDMDIntArray;
 #define TD_NAMEFILE_TERMINATOR              TCHAR('.')
 #define TD_NAMEFILE_CONTINUOUS              _T("continuous")
 #define TD_NAMEFILE_FAKE_CONT_CONCEPT       _T("fake")
+#define TD_NAMEFILE_CASE_WEIGHT             _T("case weight")
+#define TD_CSV_COUNT_COLUMN                 _T("count")
 
 #define TD_CONTVALUE_NUMDEC                 2
 
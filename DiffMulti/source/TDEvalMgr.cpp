@@ -9,6 +9,7 @@
 #endif
 
 CTDEvalMgr::CTDEvalMgr() 
+    : m_nThreads(TD_EVAL_NUM_THREADS)
 {
 }
 
@@ -30,64 +31,211 @@ bool CTDEvalMgr::initialize(CTDAttribMgr* pAttribMgr, CTDPartitioner* pPartition
 }
 
 //---------------------------------------------------------------------------
-// Count the number of distortions.
-// Each time a record is generalized from a child value to a parent value, 
-// we charge 1 unit of distortion.  
+// Compute the requested metrics in one pass over the leaf partitions,
+// with the blocks of leaves spread over worker threads. All records of a
+// leaf share its generalized values, so each metric is a sum over the
+// leaves of its noisy or raw count times a per-concept cost. Only the
+// raw depths of distortion and precision need the records of the leaves.
 //---------------------------------------------------------------------------
-bool CTDEvalMgr::countNumDistortions(int& catDistortion, float& contDistortion)
+bool CTDEvalMgr::evaluate(int metrics, TDEvalResults& results)
 {
-    cout << _T("Counting number of distortions...") << endl;
-    catDistortion = 0;
-    contDistortion = 0.0f;
-    int nRecs = 0, nValues = 0;    
-    CTDRecord* pRec = NULL;
-    CTDAttrib* pAttrib = NULL;
-    CTDPartition* pPartition = NULL;
-    CTDValue* pValue = NULL;
-    CTDConcept* pCurrentConcept = NULL;
-    CTDConcept* pRawConcept = NULL;
+    m_metrics = metrics;
+    m_attribIdxs.RemoveAll();
+    for (int a = 0; a < m_pAttribMgr->getNumAttributes() - 1; ++a) {
+        if (m_pAttribMgr->getAttribute(a)->m_bVirtualAttrib)
+            m_attribIdxs.Add(a);
+    }
+
     CTDPartitions* pLeafPartitions = m_pPartitioner->getLeafPartitions();
+    m_leaves.SetSize(0, pLeafPartitions->GetCount());
+    for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;)
+        m_leaves.Add(pLeafPartitions->GetNext(leafPos));
+
+    int nBlocks = (m_leaves.GetSize() + TD_EVAL_BLOCK_LEAVES - 1) / TD_EVAL_BLOCK_LEAVES;
+    m_blockSums.SetSize(nBlocks);
+    m_nextBlock = 0;
+
+    int nThreads = m_nThreads;
+    if (nThreads <= 0) {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        nThreads = max(int(sysInfo.dwNumberOfProcessors), 1);
+    }
+    nThreads = min(nThreads, nBlocks);
+
+    if (nThreads <= 1)
+        runWorker();
+    else {
+        CWinThread** pThreads = new CWinThread*[nThreads];
+        for (int t = 0; t < nThreads; ++t) {
+            pThreads[t] = AfxBeginThread(workerThreadProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+            pThreads[t]->m_bAutoDelete = FALSE;
+            pThreads[t]->ResumeThread();
+        }
+        for (int t = 0; t < nThreads; ++t) {
+            ::WaitForSingleObject(pThreads[t]->m_hThread, INFINITE);
+            delete pThreads[t];
+        }
+        delete [] pThreads;
+    }
+
+    // Add up the blocks in order, so that the result does not depend on the threads.
+    TDEvalSums total;
+    memset(&total, 0, sizeof(total));
+    for (int b = 0; b < nBlocks; ++b) {
+        const TDEvalSums& sums = m_blockSums[b];
+        if (!sums.m_bSucceeded)
+            return false;
+        total.m_discern += sums.m_discern;
+        total.m_ncpNumerator += sums.m_ncpNumerator;
+        total.m_nNCPValues += sums.m_nNCPValues;
+        total.m_catDistortion += sums.m_catDistortion;
+        total.m_catHeight += sums.m_catHeight;
+        total.m_contDistortion += sums.m_contDistortion;
+        total.m_rawDepth += sums.m_rawDepth;
+    }
+    m_leaves.RemoveAll();
+    m_blockSums.RemoveAll();
+
+    if (metrics & TD_EVAL_DISCERN)
+        results.m_discern = total.m_discern;
+    if (metrics & TD_EVAL_NCP)
+        results.m_totalNCP = float(total.m_ncpNumerator / total.m_nNCPValues);
+    if (metrics & TD_EVAL_DISTORTION) {
+        results.m_catDistortion = int(total.m_catDistortion);
+        results.m_contDistortion = float(total.m_contDistortion);
+    }
+    if (metrics & TD_EVAL_PRECISION)
+        results.m_precision = 1 - float(double(total.m_catHeight) / total.m_rawDepth);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+UINT AFX_CDECL CTDEvalMgr::workerThreadProc(LPVOID pParam)
+{
+    static_cast<CTDEvalMgr*>(pParam)->runWorker();
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Claim and evaluate blocks until none is left.
+//---------------------------------------------------------------------------
+void CTDEvalMgr::runWorker()
+{
+    while (true) {
+        int blockIdx = InterlockedIncrement(&m_nextBlock) - 1;
+        if (blockIdx >= m_blockSums.GetSize())
+            return;
+
+        TDEvalSums& sums = m_blockSums.GetData()[blockIdx];
+        sums.m_bSucceeded = evaluateBlock(blockIdx, sums);
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDEvalMgr::evaluateBlock(int blockIdx, TDEvalSums& sums)
+{
+    memset(&sums, 0, sizeof(sums));
+    int firstLeaf = blockIdx * TD_EVAL_BLOCK_LEAVES;
+    int lastLeaf = min(firstLeaf + TD_EVAL_BLOCK_LEAVES, m_leaves.GetSize());
+    for (int l = firstLeaf; l < lastLeaf; ++l) {
+        if (!evaluateLeaf(m_leaves[l], sums))
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Discernibility: square of the noisy count.
+// NCP: each value of the generalized record, weighted by the noisy count.
+// Distortion: one unit per level a raw categorical value is generalized,
+// and the fraction of the root interval for continuous values.
+// Precision: the categorical distortion over the depth of the raw values.
+//---------------------------------------------------------------------------
+bool CTDEvalMgr::evaluateLeaf(CTDPartition* pPartition, TDEvalSums& sums)
+{
+    CTDRecord* pGenRec = pPartition->getGenRecords()->GetAt(0);
+    int nNoisyRecs = 0;
+    for (int j = 0; j < pPartition->getNumClasses(); ++j)
+        nNoisyRecs += pPartition->m_classNoisySums[j];
 
-    // For each partition
-    for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-        pPartition = pLeafPartitions->GetNext(leafPos);
-        nRecs = pPartition->getNumRecords();
+    if (m_metrics & TD_EVAL_DISCERN)
+        sums.m_discern += square(nNoisyRecs);
 
-        // For each record
+    bool bNCP = (m_metrics & TD_EVAL_NCP) != 0;
+    bool bRawDepth = (m_metrics & (TD_EVAL_DISTORTION | TD_EVAL_PRECISION)) != 0;
+    if (!bNCP && !bRawDepth)
+        return true;
+
+    int nRecs = pPartition->getNumRecords();
+    double ncpRecSum = 0.0;
+    for (int i = 0; i < m_attribIdxs.GetSize(); ++i) {
+        int a = m_attribIdxs[i];
+        CTDAttrib* pAttrib = m_pAttribMgr->getAttribute(a);
+        CTDConcept* pCurrentConcept = pGenRec->getValue(a)->getCurrentConcept();
+
+        // Numerical value
+        if (pAttrib->isContinuous()) {
+            float numNCP = pAttrib->getConceptNCP(pCurrentConcept);
+            ncpRecSum += numNCP;
+            sums.m_contDistortion += double(nRecs) * numNCP;
+            continue;
+        }
+
+        // Categorical value
+        if (bNCP) {
+            ncpRecSum += pAttrib->getConceptNCP(pCurrentConcept);
+        }
+        if (!bRawDepth)
+            continue;
+
+        if (pCurrentConcept->m_depth < 0) {
+            cout << _T("CTDEvalMgr::evaluateLeaf: Negative depth.") << endl;
+            ASSERT(false);
+            return false;
+        }
         for (int r = 0; r < nRecs; ++r) {
-            pRec = pPartition->getRecord(r);
-            nValues = pRec->getNumValues();
-
-            // For each value
-            for (int v = 0; v < nValues; ++v) {
-                pAttrib = m_pAttribMgr->getAttribute(v);
-                if (!pAttrib->m_bVirtualAttrib)
-                    continue;
-
-                pValue = pRec->getValue(v);
-                pCurrentConcept = pValue->getCurrentConcept();
-                if (pAttrib->isContinuous()) {
-                    CTDContConcept* pContConcept = (CTDContConcept*) pCurrentConcept;
-                    CTDContConcept* pRoot = (CTDContConcept*) pAttrib->getConceptRoot();
-                    contDistortion += (pContConcept->m_upperBound - pContConcept->m_lowerBound) / (pRoot->m_upperBound - pRoot->m_lowerBound);
-                }
-                else {
-                    pRawConcept = ((CTDStringValue*) pValue)->getRawConcept();
+            CTDConcept* pRawConcept = ((CTDStringValue*) pPartition->getRecord(r)->getValue(a))->getRawConcept();
+            if (pRawConcept->m_depth < 0) {
+                cout << _T("CTDEvalMgr::evaluateLeaf: Negative depth.") << endl;
+                ASSERT(false);
+                return false;
+            }
+            sums.m_rawDepth += pRawConcept->m_depth;
+            sums.m_catHeight += pRawConcept->m_depth - pCurrentConcept->m_depth;
 #if defined(_TD_SCORE_FUNTION_TRANSACTION)
-                    // In case of transaction data, count a distortion only if suppressing "1".
-                    if (pRawConcept->m_conceptValue.CompareNoCase(TD_TRANSACTION_ITEM_PRESENT) != 0)
-                        continue;
+            // In case of transaction data, count a distortion only if suppressing "1".
+            if (pRawConcept->m_conceptValue.CompareNoCase(TD_TRANSACTION_ITEM_PRESENT) != 0)
+                continue;
 #endif
-                    if (pRawConcept->m_depth < 0 || pCurrentConcept->m_depth < 0) {
-                        cout << _T("CSAEvalMgr::countNumDistortions: Negative depth.") << endl;
-                        ASSERT(false);
-                        return false;
-                    }
-                    catDistortion += pRawConcept->m_depth - pCurrentConcept->m_depth;
-                }
-            }
+            sums.m_catDistortion += pRawConcept->m_depth - pCurrentConcept->m_depth;
         }
     }
+
+    if (bNCP) {
+        int nValues = pGenRec->getNumValues();
+        sums.m_ncpNumerator += ncpRecSum * nNoisyRecs;
+        sums.m_nNCPValues += double(nValues - 1) * nNoisyRecs;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Count the number of distortions.
+// Each time a record is generalized from a child value to a parent value, 
+// we charge 1 unit of distortion.  
+//---------------------------------------------------------------------------
+bool CTDEvalMgr::countNumDistortions(int& catDistortion, float& contDistortion)
+{
+    cout << _T("Counting number of distortions...") << endl;
+    TDEvalResults results;
+    if (!evaluate(TD_EVAL_DISTORTION, results))
+        return false;
+    catDistortion = results.m_catDistortion;
+    contDistortion = results.m_contDistortion;
     cout << _T("Counting number of distortions succeeded.") << endl;
     return true;
 }
@@ -97,22 +245,10 @@ bool CTDEvalMgr::countNumDistortions(int& catDistortion, float& contDistortion)
 bool CTDEvalMgr::countNumDiscern(long long& catDiscern)
 {
     cout << _T("Counting discernibility...") << endl;
-    catDiscern = 0;
-    int nNoisyRecs = 0;    
-    CTDPartition* pPartition = NULL;
-    CTDPartitions* pLeafPartitions = m_pPartitioner->getLeafPartitions();
-
-    // For each partition.
-    for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-        pPartition = pLeafPartitions->GetNext(leafPos);
-		for (int j = 0; j < pPartition->getNumClasses(); ++j) {
-			nNoisyRecs += pPartition->m_classNoisySums[j];
-		}
-		
-        catDiscern += square(nNoisyRecs);
-		nNoisyRecs = 0;
-    }
-
+    TDEvalResults results;
+    if (!evaluate(TD_EVAL_DISCERN, results))
+        return false;
+    catDiscern = results.m_discern;
     cout << _T("Counting discernibility succeeded.") << endl << endl;
     return true;
 }
@@ -126,57 +262,10 @@ bool CTDEvalMgr::countNumDiscern(long long& catDiscern)
 bool CTDEvalMgr::countNumTotalNCP(float& ncp)	
 {
 	cout << _T("Counting Normalized Certainty Penalty NCP for the entire data set...") << endl;
-	ncp = 0.0f;
-	float ncpRecSum = 0.0;
-	float numerator = 0.0f;	// ncp's of all items in data set.
-	int nTotalSupp = 0;	// Number of all items in data set.
-
-	// For each leaf partition
-    CTDPartitions* pLeafPartitions = m_pPartitioner->getLeafPartitions();
-    for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-        CTDPartition* pPartition = pLeafPartitions->GetNext(leafPos);		
-		CTDRecord* pGenRec = pPartition->getGenRecords()->GetAt(0);
-		int nValues = pGenRec->getNumValues();
-
-		// For each value
-		for (int v = 0; v < nValues - 1; ++v) {
-			CTDAttrib* pAttrib = m_pAttribMgr->getAttribute(v);
-			CTDValue* pValue = pGenRec->getValue(v);
-			CTDConcept* pCurrentConcept = pValue->getCurrentConcept();
-
-			if (!pAttrib->m_bVirtualAttrib)
-                continue;
-								
-			// Numerical value
-			if (pAttrib->isContinuous()) {
-				float numNCP;
-				CTDContConcept* pCurrentNumConcept = (CTDContConcept*) pCurrentConcept;
-				CTDContConcept* pNumRootConcept = (CTDContConcept*) pAttrib->getConceptRoot();
-				numNCP = (pCurrentNumConcept->m_upperBound - pCurrentNumConcept->m_lowerBound) / (pNumRootConcept->m_upperBound - pNumRootConcept->m_lowerBound);
-				ncpRecSum += numNCP;
-				continue;
-			}
-
-			// Categorical value
-			else {
-				float discNCP;
-				pCurrentConcept->computeNCPHelper(discNCP);
-				ncpRecSum += discNCP;
-				continue;
-			}
-		}
-		
-		// For each general recrod
-		for (int j = 0; j < pPartition->getNumClasses(); ++j) {
-			numerator = numerator + (ncpRecSum * pPartition->m_classNoisySums[j]);
-			nTotalSupp = nTotalSupp + ((nValues - 1) * pPartition->m_classNoisySums[j]);
-		}
-
-		ncpRecSum = 0;
-    }
-
-	ncp = numerator / nTotalSupp;
-
+    TDEvalResults results;
+    if (!evaluate(TD_EVAL_NCP, results))
+        return false;
+    ncp = results.m_totalNCP;
 	cout << _T("Counting NCP succeeded.") << endl << endl;
 	return true;
 }
@@ -187,40 +276,10 @@ bool CTDEvalMgr::countNumTotalNCP(float& ncp)
 bool CTDEvalMgr::calPrecision(float& precision)
 {
     cout << _T("Calculating precision...") << endl;
-    precision = 0.0f;    
-    int totalHeight = 0;
-    int totalPathLength = 0;
-
-    // For each partition
-    CTDPartitions* pLeafPartitions = m_pPartitioner->getLeafPartitions();
-    for (POSITION leafPos = pLeafPartitions->GetHeadPosition(); leafPos != NULL;) {
-        CTDPartition* pPartition = pLeafPartitions->GetNext(leafPos);
-
-        // For each record
-        for (int r = 0; r < pPartition->getNumRecords(); ++r) {
-            CTDRecord* pRec = pPartition->getRecord(r);
-
-            // For each value
-            for (int v = 0; v < pRec->getNumValues(); ++v) {
-                CTDAttrib* pAttrib = m_pAttribMgr->getAttribute(v);
-                if (!pAttrib->m_bVirtualAttrib || pAttrib->isContinuous())
-                    continue;
-
-                CTDValue* pValue = pRec->getValue(v);
-                CTDConcept* pCurrentConcept = pValue->getCurrentConcept();
-                CTDConcept* pRawConcept = ((CTDStringValue*) pValue)->getRawConcept();
-                if (pRawConcept->m_depth < 0 || pCurrentConcept->m_depth < 0) {
-                    cout << _T("CTDEvalMgr::calPrecision: Negative depth.") << endl;
-                    ASSERT(false);
-                    return false;
-                }
-
-                totalHeight += pRawConcept->m_depth - pCurrentConcept->m_depth;
-                totalPathLength += pRawConcept->m_depth;
-            }
-        }
-    }
-    precision = 1 - ((float) totalHeight / totalPathLength);
+    TDEvalResults results;
+    if (!evaluate(TD_EVAL_PRECISION, results))
+        return false;
+    precision = results.m_precision;
     cout << _T("Calculating precision succeeded.") << endl;
     return true;
 }
\ No newline at end of file
@@ -9,6 +9,21 @@
     #include "TDPartitioner.h"
 #endif
 
+// Metrics computed by CTDEvalMgr::evaluate, combined with |.
+enum TDEvalMetric { TD_EVAL_DISCERN = 1, TD_EVAL_NCP = 2, TD_EVAL_DISTORTION = 4, TD_EVAL_PRECISION = 8 };
+
+//---------------------------------------------------------------------------
+// Results of CTDEvalMgr::evaluate. Only the requested metrics are set.
+//---------------------------------------------------------------------------
+struct TDEvalResults
+{
+    long long m_discern;
+    float     m_totalNCP;
+    int       m_catDistortion;
+    float     m_contDistortion;
+    float     m_precision;
+};
+
 class CTDEvalMgr
 {
 public:
@@ -17,15 +32,43 @@ public:
 
 // Operations
     bool initialize(CTDAttribMgr* pAttribMgr, CTDPartitioner* pPartitioner);
+    void setNumThreads(int nThreads) { m_nThreads = nThreads; };
+    bool evaluate(int metrics, TDEvalResults& results);
     bool countNumDistortions(int& catDistortion, float& contDistortion);
     bool countNumDiscern(long long& catDiscern);
 	bool countNumTotalNCP(float& ncp);
     bool calPrecision(float& precision);
 
 protected:
+    // Sums over a block of leaf partitions.
+    struct TDEvalSums
+    {
+        long long m_discern;
+        double    m_ncpNumerator;           // NCP of the generalized values, weighted by the noisy counts.
+        double    m_nNCPValues;             // Number of noisy values.
+        long long m_catDistortion;
+        long long m_catHeight;              // Categorical distortion, including the values it skips.
+        double    m_contDistortion;
+        long long m_rawDepth;               // Depth of the raw categorical values.
+        bool      m_bSucceeded;
+    };
+
+    static UINT AFX_CDECL workerThreadProc(LPVOID pParam);
+    void runWorker();
+    bool evaluateBlock(int blockIdx, TDEvalSums& sums);
+    bool evaluateLeaf(CTDPartition* pPartition, TDEvalSums& sums);
+
 // Attributes
     CTDAttribMgr* m_pAttribMgr;
     CTDPartitioner* m_pPartitioner;
+    int m_nThreads;                             // 0: one thread per processor.
+
+    // State of the running evaluation.
+    int                  m_metrics;
+    CTDIntArray          m_attribIdxs;          // Virtual attributes, excluding the class.
+    CTDPartitionPtrArray m_leaves;
+    CArray<TDEvalSums, const TDEvalSums&> m_blockSums;
+    volatile LONG        m_nextBlock;           // Next block to be claimed by a worker.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+// TDExperiment.cpp: implementation of the CTDExperiment class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDEXPERIMENT_H)
+    #include "TDExperiment.h"
+#endif
+
+// Two-sided 95% critical values of Student's t distribution by degrees of
+// freedom 1..30. Larger samples use the normal value.
+static const double gTCritical95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+#define TD_TCRITICAL_NORMAL     1.960
+
+// A trial and the number of specializations it performs, for ordering.
+struct TDExpJob
+{
+    int m_nSpecialization;
+    int m_trialIdx;
+};
+
+// Discards whatever is written to it, to mute cout while trials run.
+class CTDNullStreamBuf : public streambuf
+{
+protected:
+    virtual int_type overflow(int_type c) { return traits_type::not_eof(c); };
+};
+
+CTDExperiment::CTDExperiment(int nInputRecs, int nTraining)
+    : m_nInputRecs(nInputRecs),
+      m_nTraining(nTraining),
+      m_dataset(nInputRecs, nTraining),
+      m_nextJob(0)
+{
+}
+
+CTDExperiment::~CTDExperiment()
+{
+}
+
+//---------------------------------------------------------------------------
+// Parse the attribute hierarchies and the raw records once for all trials.
+//---------------------------------------------------------------------------
+bool CTDExperiment::load(LPCTSTR attributesFile, LPCTSTR rawDataFile)
+{
+    cout << _T("Loading experiment data...") << endl;
+    CStringArray hierarchyLines, rawRecords;
+    if (!readLines(attributesFile, hierarchyLines))
+        return false;
+    if (!readLines(rawDataFile, rawRecords))
+        return false;
+    if (!m_dataset.load(hierarchyLines, rawRecords))
+        return false;
+    cout << _T("Loading experiment data succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+bool CTDExperiment::readLines(LPCTSTR fileName, CStringArray& lines)
+{
+    lines.RemoveAll();
+    try {
+        CStdioFile file;
+        if (!file.Open(fileName, CFile::modeRead)) {
+            cerr << _T("CTDExperiment: Failed to open file ") << fileName << endl;
+            return false;
+        }
+
+        CString lineStr;
+        while (file.ReadString(lineStr))
+            lines.Add(lineStr);
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read file: ") << fileName << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDExperiment::addConfig(int nSpecialization, double pBudget)
+{
+    TDExpConfig config;
+    config.m_nSpecialization = nSpecialization;
+    config.m_pBudget = pBudget;
+    m_configs.Add(config);
+}
+
+//---------------------------------------------------------------------------
+// Add every pair of the values in two lists separated by
+// TD_RAWDATA_DELIMETER, e.g., "1000, 10000" and "0.1, 1".
+//---------------------------------------------------------------------------
+bool CTDExperiment::addGrid(LPCTSTR nSpecializationsStr, LPCTSTR pBudgetsStr)
+{
+    CTDIntArray nSpecializations;
+    CTDDoubleArray pBudgets;
+    CString valueStr;
+    CBFStrParser specParser(nSpecializationsStr, TD_RAWDATA_DELIMETER);
+    while (specParser.getNext(valueStr)) {
+        CBFStrHelper::trim(valueStr);
+        if (valueStr.IsEmpty())
+            continue;
+        int nSpecialization = int(StrToInt(valueStr));
+        if (nSpecialization <= 0) {
+            cerr << _T("CTDExperiment: Invalid nSpecialization ") << valueStr << endl;
+            return false;
+        }
+        nSpecializations.Add(nSpecialization);
+    }
+
+    CBFStrParser budgetParser(pBudgetsStr, TD_RAWDATA_DELIMETER);
+    while (budgetParser.getNext(valueStr)) {
+        CBFStrHelper::trim(valueStr);
+        if (valueStr.IsEmpty())
+            continue;
+        double pBudget = StrToFloat(valueStr);
+        if (pBudget <= 0.0) {
+            cerr << _T("CTDExperiment: Invalid privacy budget ") << valueStr << endl;
+            return false;
+        }
+        pBudgets.Add(pBudget);
+    }
+
+    if (nSpecializations.GetSize() == 0 || pBudgets.GetSize() == 0) {
+        cerr << _T("CTDExperiment: Empty parameter grid.") << endl;
+        return false;
+    }
+
+    for (int s = 0; s < nSpecializations.GetSize(); ++s) {
+        for (int b = 0; b < pBudgets.GetSize(); ++b)
+            addConfig(nSpecializations[s], pBudgets[b]);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Run nTrials trials of every configuration. Trial i of m_trials is
+// seeded with firstSeed + i. The trials with the most specializations are
+// claimed first, so that the long ones do not trail at the end.
+//---------------------------------------------------------------------------
+bool CTDExperiment::run(int nTrials, unsigned firstSeed)
+{
+    int nConfigs = m_configs.GetSize();
+    if (nTrials <= 0 || nConfigs == 0 || !m_dataset.isLoaded()) {
+        cerr << _T("CTDExperiment: No trials or no data loaded.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    int nJobs = nConfigs * nTrials;
+    m_trials.SetSize(nJobs);
+    TDExpJob* pJobs = new TDExpJob[nJobs];
+    for (int i = 0; i < nJobs; ++i) {
+        m_trials[i].m_configIdx = i / nTrials;
+        m_trials[i].m_seed = firstSeed + unsigned(i);
+        m_trials[i].m_bSucceeded = false;
+        pJobs[i].m_nSpecialization = m_configs[i / nTrials].m_nSpecialization;
+        pJobs[i].m_trialIdx = i;
+    }
+    qsort(pJobs, nJobs, sizeof(TDExpJob), compareJobs);
+    m_jobOrder.SetSize(nJobs);
+    for (int i = 0; i < nJobs; ++i)
+        m_jobOrder[i] = pJobs[i].m_trialIdx;
+    delete [] pJobs;
+    m_nextJob = 0;
+
+    int nThreads = TD_EXPERIMENT_NUM_THREADS;
+    if (nThreads <= 0) {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        nThreads = max(int(sysInfo.dwNumberOfProcessors), 1);
+    }
+    nThreads = min(nThreads, nJobs);
+
+    setnTrainingRecs(m_nTraining);
+    cout << _T("Running ") << nJobs << _T(" trials on ") << nThreads << _T(" threads...") << endl;
+    CTDNullStreamBuf nullBuf;
+    streambuf* pCoutBuf = cout.rdbuf(&nullBuf);
+    CWinThread** pThreads = new CWinThread*[nThreads];
+    for (int t = 0; t < nThreads; ++t) {
+        pThreads[t] = AfxBeginThread(workerThreadProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+        pThreads[t]->m_bAutoDelete = FALSE;
+        pThreads[t]->ResumeThread();
+    }
+    for (int t = 0; t < nThreads; ++t) {
+        ::WaitForSingleObject(pThreads[t]->m_hThread, INFINITE);
+        delete pThreads[t];
+    }
+    delete [] pThreads;
+    cout.rdbuf(pCoutBuf);
+
+    bool bSucceeded = true;
+    for (int i = 0; i < nJobs; ++i) {
+        if (!m_trials[i].m_bSucceeded) {
+            cerr << _T("CTDExperiment: Trial ") << i << _T(" with seed ") << m_trials[i].m_seed << _T(" failed.") << endl;
+            bSucceeded = false;
+        }
+    }
+    if (bSucceeded)
+        cout << _T("Running trials succeeded.") << endl << endl;
+    return bSucceeded;
+}
+
+//---------------------------------------------------------------------------
+// Most specializations first, then in trial order.
+//---------------------------------------------------------------------------
+// static
+int CTDExperiment::compareJobs(const void* pJob1, const void* pJob2)
+{
+    const TDExpJob* pJ1 = static_cast<const TDExpJob*> (pJob1);
+    const TDExpJob* pJ2 = static_cast<const TDExpJob*> (pJob2);
+    if (pJ1->m_nSpecialization != pJ2->m_nSpecialization)
+        return pJ1->m_nSpecialization > pJ2->m_nSpecialization ? -1 : 1;
+    return pJ1->m_trialIdx - pJ2->m_trialIdx;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+UINT AFX_CDECL CTDExperiment::workerThreadProc(LPVOID pParam)
+{
+    static_cast<CTDExperiment*>(pParam)->runWorker();
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Claim and run trials until none is left. m_trials is not resized while
+// the workers run, so each worker only touches the trials it claimed.
+//---------------------------------------------------------------------------
+void CTDExperiment::runWorker()
+{
+    while (true) {
+        int jobIdx = InterlockedIncrement(&m_nextJob) - 1;
+        if (jobIdx >= m_jobOrder.GetSize())
+            return;
+
+        TDTrialResult& trial = m_trials.GetData()[m_jobOrder[jobIdx]];
+        trial.m_bSucceeded = runTrial(trial);
+    }
+}
+
+//---------------------------------------------------------------------------
+// The budget schedule of the trial is set up by its own partitioner, on
+// copies of the shared data set. The trials already keep the processors
+// busy, so each one is evaluated on its own thread.
+//---------------------------------------------------------------------------
+bool CTDExperiment::runTrial(TDTrialResult& trial)
+{
+    const TDExpConfig& config = m_configs[trial.m_configIdx];
+    srand(trial.m_seed);
+    CTDController controller(config.m_nSpecialization, config.m_pBudget, m_nInputRecs, m_nTraining);
+    controller.setNumEvalThreads(1);
+    if (!controller.runDiffMulti(&m_dataset, NULL, false))
+        return false;
+    return controller.evaluateRun(trial.m_metrics);
+}
+
+//---------------------------------------------------------------------------
+// False if the trial failed or has no such metric.
+//---------------------------------------------------------------------------
+// static
+bool CTDExperiment::getMetric(const TDTrialResult& trial, TDExpMetric metric, double& value)
+{
+    if (!trial.m_bSucceeded)
+        return false;
+
+    switch (metric) {
+    case TD_EXP_LEAVES:
+        value = trial.m_metrics.m_nLeaves;
+        return true;
+    case TD_EXP_DISCERNIBILITY:
+        value = double(trial.m_metrics.m_discernibility);
+        return true;
+    case TD_EXP_NCP:
+        value = trial.m_metrics.m_totalNCP;
+        return true;
+    case TD_EXP_ACCURACY:
+        value = trial.m_metrics.m_accuracy;
+        return trial.m_metrics.m_bAccuracy;
+    default:
+        ASSERT(false);
+        return false;
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+LPCTSTR CTDExperiment::getMetricName(TDExpMetric metric)
+{
+    switch (metric) {
+    case TD_EXP_LEAVES:
+        return _T("leaves");
+    case TD_EXP_DISCERNIBILITY:
+        return _T("discernibility");
+    case TD_EXP_NCP:
+        return _T("ncp");
+    case TD_EXP_ACCURACY:
+        return _T("accuracy");
+    default:
+        ASSERT(false);
+        return _T("");
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDExperiment::summarize(int configIdx, TDExpMetric metric, TDMetricSummary& summary) const
+{
+    CTDDoubleArray values;
+    double value = 0.0;
+    for (int i = 0; i < m_trials.GetSize(); ++i) {
+        if (m_trials[i].m_configIdx == configIdx && getMetric(m_trials[i], metric, value))
+            values.Add(value);
+    }
+    summarize(values, summary);
+}
+
+//---------------------------------------------------------------------------
+// The interval is the mean itself for fewer than two values.
+//---------------------------------------------------------------------------
+// static
+void CTDExperiment::summarize(const CTDDoubleArray& values, TDMetricSummary& summary)
+{
+    int n = values.GetSize();
+    summary.m_nValues = n;
+    summary.m_mean = 0.0;
+    summary.m_stdDev = 0.0;
+    for (int i = 0; i < n; ++i)
+        summary.m_mean += values[i];
+    if (n > 0)
+        summary.m_mean /= n;
+
+    double halfWidth = 0.0;
+    if (n > 1) {
+        double sqSum = 0.0;
+        for (int i = 0; i < n; ++i)
+            sqSum += (values[i] - summary.m_mean) * (values[i] - summary.m_mean);
+        summary.m_stdDev = sqrt(sqSum / (n - 1));
+
+        int nCritical = sizeof(gTCritical95) / sizeof(gTCritical95[0]);
+        double tCritical = n - 1 <= nCritical ? gTCritical95[n - 2] : TD_TCRITICAL_NORMAL;
+        halfWidth = tCritical * summary.m_stdDev / sqrt(double(n));
+    }
+    summary.m_ciLow = summary.m_mean - halfWidth;
+    summary.m_ciHigh = summary.m_mean + halfWidth;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDExperiment::appendConfig(CTDByteBuffer& buffer, int configIdx) const
+{
+    const TDExpConfig& config = m_configs[configIdx];
+    buffer.appendInt(config.m_nSpecialization);
+    buffer.append(TD_RAWDATA_DELIMETER);
+    buffer.appendFloat(config.m_pBudget, TD_EXP_NUM_DEC);
+}
+
+//---------------------------------------------------------------------------
+// One CSV line per trial.
+//---------------------------------------------------------------------------
+bool CTDExperiment::writeTrials(LPCTSTR resultFile) const
+{
+    CTDByteBuffer buffer;
+    buffer.append(_T("nSpecialization,privacyB,trial,seed"));
+    for (int m = 0; m < TD_EXP_NUM_METRICS; ++m) {
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.append(getMetricName(TDExpMetric(m)));
+    }
+    buffer.append(TCHAR('\n'));
+
+    int nTrials = m_trials.GetSize() / max(m_configs.GetSize(), 1);
+    double value = 0.0;
+    for (int i = 0; i < m_trials.GetSize(); ++i) {
+        appendConfig(buffer, m_trials[i].m_configIdx);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendInt(i % nTrials);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendFloat(m_trials[i].m_seed, 0);
+        for (int m = 0; m < TD_EXP_NUM_METRICS; ++m) {
+            buffer.append(TD_RAWDATA_DELIMETER);
+            if (getMetric(m_trials[i], TDExpMetric(m), value))
+                buffer.appendFloat(value, TD_EXP_NUM_DEC);
+        }
+        buffer.append(TCHAR('\n'));
+    }
+    return writeFile(resultFile, buffer);
+}
+
+//---------------------------------------------------------------------------
+// One CSV line per configuration with the mean, standard deviation and
+// confidence interval of each metric over its trials.
+//---------------------------------------------------------------------------
+bool CTDExperiment::writeSummary(LPCTSTR resultFile) const
+{
+    LPCTSTR statNames[] = { _T("mean"), _T("stddev"), _T("ci95 low"), _T("ci95 high") };
+    CTDByteBuffer buffer;
+    buffer.append(_T("nSpecialization,privacyB,trials"));
+    for (int m = 0; m < TD_EXP_NUM_METRICS; ++m) {
+        for (int s = 0; s < 4; ++s) {
+            buffer.append(TD_RAWDATA_DELIMETER);
+            buffer.append(getMetricName(TDExpMetric(m)));
+            buffer.append(TCHAR(' '));
+            buffer.append(statNames[s]);
+        }
+    }
+    buffer.append(TCHAR('\n'));
+
+    for (int c = 0; c < m_configs.GetSize(); ++c) {
+        appendConfig(buffer, c);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.appendInt(m_trials.GetSize() / m_configs.GetSize());
+        for (int m = 0; m < TD_EXP_NUM_METRICS; ++m) {
+            TDMetricSummary summary;
+            summarize(c, TDExpMetric(m), summary);
+            double stats[] = { summary.m_mean, summary.m_stdDev, summary.m_ciLow, summary.m_ciHigh };
+            for (int s = 0; s < 4; ++s) {
+                buffer.append(TD_RAWDATA_DELIMETER);
+                if (summary.m_nValues > 0)
+                    buffer.appendFloat(stats[s], TD_EXP_NUM_DEC);
+            }
+        }
+        buffer.append(TCHAR('\n'));
+    }
+    return writeFile(resultFile, buffer);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDExperiment::writeFile(LPCTSTR resultFile, const CTDByteBuffer& buffer) const
+{
+    cout << _T("Writing ") << resultFile << _T("...") << endl;
+    try {
+        CFile file;
+        if (!file.Open(resultFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDExperiment: Failed to open file ") << resultFile << endl;
+            return false;
+        }
+        file.Write(buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write experiment results: ") << resultFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDExperiment::printSummary() const
+{
+    for (int c = 0; c < m_configs.GetSize(); ++c) {
+        cout << _T("nSpecialization = ") << m_configs[c].m_nSpecialization
+             << _T(", privacyB = ") << m_configs[c].m_pBudget
+             << _T(", trials = ") << m_trials.GetSize() / m_configs.GetSize() << endl;
+        for (int m = 0; m < TD_EXP_NUM_METRICS; ++m) {
+            TDMetricSummary summary;
+            summarize(c, TDExpMetric(m), summary);
+            if (summary.m_nValues == 0)
+                continue;
+            cout << _T("    ") << getMetricName(TDExpMetric(m)) << _T(" = ") << summary.m_mean
+                 << _T(", stddev = ") << summary.m_stdDev
+                 << _T(", 95% CI = [") << summary.m_ciLow << _T(", ") << summary.m_ciHigh << _T("]") << endl;
+        }
+    }
+    cout << endl;
+}
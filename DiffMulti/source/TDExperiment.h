@@ -0,0 +1,110 @@
+// TDExperiment.h: interface for the CTDExperiment class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDEXPERIMENT_H)
+#define TDEXPERIMENT_H
+
+#if !defined(TDCONTROLLER_H)
+    #include "TDController.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+enum TDExpMetric { TD_EXP_LEAVES, TD_EXP_DISCERNIBILITY, TD_EXP_NCP, TD_EXP_ACCURACY, TD_EXP_NUM_METRICS };
+
+//---------------------------------------------------------------------------
+// Parameters of the runs of one grid point.
+//---------------------------------------------------------------------------
+struct TDExpConfig
+{
+    int    m_nSpecialization;
+    double m_pBudget;
+};
+
+typedef CArray<TDExpConfig, const TDExpConfig&> CTDExpConfigArray;
+
+//---------------------------------------------------------------------------
+// Outcome of one trial of an experiment.
+//---------------------------------------------------------------------------
+struct TDTrialResult
+{
+    int          m_configIdx;
+    unsigned     m_seed;
+    bool         m_bSucceeded;
+    TDRunMetrics m_metrics;
+};
+
+typedef CArray<TDTrialResult, const TDTrialResult&> CTDTrialResultArray;
+
+//---------------------------------------------------------------------------
+// Mean of a metric over the trials, with the 95% confidence interval of
+// the mean from Student's t distribution.
+//---------------------------------------------------------------------------
+struct TDMetricSummary
+{
+    int    m_nValues;
+    double m_mean;
+    double m_stdDev;                // Sample standard deviation.
+    double m_ciLow;
+    double m_ciHigh;
+};
+
+//---------------------------------------------------------------------------
+// Independent trials of DiffMulti on one data set, for one or more
+// configurations, e.g., a grid of nSpecialization by privacy budget. The
+// .hchy and .rawdata files are parsed once into a CTDDataset, and every
+// trial runs a controller of its own on copies of it. Trials run
+// concurrently on worker threads, the longest configurations first, and
+// each seeds rand() before it starts. The C runtime keeps the rand()
+// state per thread, so the seed of a trial reproduces it. The profile and
+// memory counts of a trial are bound to its thread, see CTDProfiler. The
+// console output of the trials is muted, since it would interleave.
+//---------------------------------------------------------------------------
+class CTDExperiment
+{
+public:
+    CTDExperiment(int nInputRecs, int nTraining);
+    virtual ~CTDExperiment();
+
+// Operations
+    bool load(LPCTSTR attributesFile, LPCTSTR rawDataFile);
+    void addConfig(int nSpecialization, double pBudget);
+    bool addGrid(LPCTSTR nSpecializationsStr, LPCTSTR pBudgetsStr);
+    bool run(int nTrials, unsigned firstSeed);
+    bool writeTrials(LPCTSTR resultFile) const;
+    bool writeSummary(LPCTSTR resultFile) const;
+    void printSummary() const;
+
+    int getNumConfigs() const { return m_configs.GetSize(); };
+    const TDExpConfig& getConfig(int configIdx) const { return m_configs[configIdx]; };
+    int getNumTrials() const { return m_trials.GetSize(); };
+    const TDTrialResult& getTrial(int trialIdx) const { return m_trials[trialIdx]; };
+    void summarize(int configIdx, TDExpMetric metric, TDMetricSummary& summary) const;
+
+    static bool readLines(LPCTSTR fileName, CStringArray& lines);
+    static bool getMetric(const TDTrialResult& trial, TDExpMetric metric, double& value);
+    static LPCTSTR getMetricName(TDExpMetric metric);
+    static void summarize(const CTDDoubleArray& values, TDMetricSummary& summary);
+
+protected:
+    static UINT AFX_CDECL workerThreadProc(LPVOID pParam);
+    void runWorker();
+    bool runTrial(TDTrialResult& trial);
+    void appendConfig(CTDByteBuffer& buffer, int configIdx) const;
+    bool writeFile(LPCTSTR resultFile, const CTDByteBuffer& buffer) const;
+    static int compareJobs(const void* pJob1, const void* pJob2);
+
+// Attributes
+    int                 m_nInputRecs;
+    int                 m_nTraining;
+    CTDDataset          m_dataset;
+    CTDExpConfigArray   m_configs;
+    CTDTrialResultArray m_trials;           // Trial t of configuration c at c * nTrials + t.
+    CTDIntArray         m_jobOrder;         // Trials in the order they are claimed.
+    volatile LONG       m_nextJob;          // Next position of m_jobOrder to be claimed by a worker.
+};
+
+#endif
@@ -0,0 +1,241 @@
+// TDGenerator.cpp: implementation of the CTDGenerator class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDGENERATOR_H)
+    #include "TDGenerator.h"
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDGenerator::CTDGenerator(LPCTSTR attributesFile, double skew, double classCorrelation, unsigned seed)
+    : m_attribMgr(attributesFile, _T("")),
+      m_skew(skew),
+      m_classCorrelation(classCorrelation),
+      m_seed(seed),
+      m_nRecords(0)
+{
+}
+
+CTDGenerator::~CTDGenerator()
+{
+}
+
+//---------------------------------------------------------------------------
+// Read the hierarchies and build the value distributions.
+//---------------------------------------------------------------------------
+bool CTDGenerator::initialize()
+{
+    if (m_skew < 0 || m_classCorrelation < 0 || m_classCorrelation > 1) {
+        cerr << _T("CTDGenerator: Invalid skew or class correlation.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    if (!m_attribMgr.readAttributes())
+        return false;
+
+    m_values.RemoveAll();
+    m_cumWeights.RemoveAll();
+    m_valueStarts.RemoveAll();
+    m_lowerBounds.RemoveAll();
+    m_upperBounds.RemoveAll();
+
+    int nAttribs = m_attribMgr.getNumAttributes();
+    for (int a = 0; a < nAttribs; ++a) {
+        CTDAttrib* pAttrib = m_attribMgr.getAttribute(a);
+        m_valueStarts.Add(m_values.GetSize());
+        if (pAttrib->isContinuous()) {
+            CTDContConcept* pRootConcept = static_cast<CTDContConcept*>(pAttrib->getConceptRoot());
+            m_lowerBounds.Add(pRootConcept->m_lowerBound);
+            m_upperBounds.Add(pRootConcept->m_upperBound);
+        }
+        else {
+            m_lowerBounds.Add(0.0f);
+            m_upperBounds.Add(0.0f);
+            addValues(pAttrib);
+        }
+    }
+    m_valueStarts.Add(m_values.GetSize());
+
+    if (m_valueStarts[nAttribs] - m_valueStarts[nAttribs - 1] <= 0) {
+        cerr << _T("CTDGenerator: No class values.") << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// The leaf concepts of a categorical attribute in preorder, or the level-1
+// concepts of the class attribute, with their cumulative weights.
+//---------------------------------------------------------------------------
+void CTDGenerator::addValues(CTDAttrib* pAttrib)
+{
+    int firstValue = m_values.GetSize();
+    bool bClass = (pAttrib->m_attribIdx == m_attribMgr.getNumAttributes() - 1);
+    if (bClass) {
+        CTDConcept* pRootConcept = pAttrib->getConceptRoot();
+        for (int c = 0; c < pRootConcept->getNumChildConcepts(); ++c)
+            addValue(pRootConcept->getChildConcept(c)->m_conceptValue, pow(double(c + 1), -m_skew));
+    }
+    else {
+        CTDConcepts* pFlattenConcepts = pAttrib->getFlattenConcepts();
+        for (int c = 0; c < pFlattenConcepts->GetSize(); ++c) {
+            CTDConcept* pConcept = pFlattenConcepts->GetAt(c);
+            if (pConcept->getNumChildConcepts() == 0)
+                addValue(pConcept->m_conceptValue, pow(double(m_values.GetSize() - firstValue + 1), -m_skew));
+        }
+    }
+
+    int nValues = m_values.GetSize();
+    double total = m_cumWeights[nValues - 1];
+    for (int v = firstValue; v < nValues; ++v)
+        m_cumWeights[v] /= total;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDGenerator::addValue(const CString& value, double weight)
+{
+    int nValues = m_values.GetSize();
+    bool bFirst = (nValues == m_valueStarts[m_valueStarts.GetSize() - 1]);
+    m_values.Add(value);
+    m_cumWeights.Add(bFirst ? weight : m_cumWeights[nValues - 1] + weight);
+}
+
+//---------------------------------------------------------------------------
+// Value index of categorical attribute attribIdx for a uniform u.
+//---------------------------------------------------------------------------
+int CTDGenerator::drawValue(int attribIdx, double u) const
+{
+    int lower = m_valueStarts[attribIdx];
+    int upper = m_valueStarts[attribIdx + 1] - 1;
+    while (lower < upper) {
+        int mid = (lower + upper) / 2;
+        if (m_cumWeights[mid] <= u)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return lower;
+}
+
+//---------------------------------------------------------------------------
+// Write nRecords records to rawDataFile.
+//---------------------------------------------------------------------------
+bool CTDGenerator::generate(int nRecords, LPCTSTR rawDataFile)
+{
+    cout << _T("Generating ") << nRecords << _T(" records...") << endl;
+    if (nRecords <= 0) {
+        cerr << _T("CTDGenerator: Invalid number of records.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    m_nRecords = nRecords;
+    try {
+        CFile file;
+        if (!file.Open(rawDataFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDGenerator: Failed to open file ") << rawDataFile << endl;
+            return false;
+        }
+
+        CFile* pFiles[] = { &file };
+        CTDOutputWriter writer(TD_OUTPUT_NUM_THREADS);
+        int nBlocks = int(((__int64) nRecords + TD_GENERATOR_BLOCK_RECORDS - 1) / TD_GENERATOR_BLOCK_RECORDS);
+        if (!writer.write(nBlocks, this, pFiles, 1))
+            return false;
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write raw data file: ") << rawDataFile << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    cout << _T("Generating records succeeded.") << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// One block of TD_GENERATOR_BLOCK_RECORDS records.
+//---------------------------------------------------------------------------
+bool CTDGenerator::serializeItem(int itemIdx, CTDByteBuffer* pBuffers)
+{
+    CTDByteBuffer& buffer = pBuffers[0];
+    unsigned __int64 state = seedStream(m_seed, itemIdx);
+    int nAttribs = m_attribMgr.getNumAttributes();
+    int classIdx = nAttribs - 1;
+    int nClasses = m_valueStarts[nAttribs] - m_valueStarts[classIdx];
+    double scale = pow(10.0, TD_GENERATOR_CONTVALUE_NUMDEC);
+
+    __int64 firstRec = (__int64) itemIdx * TD_GENERATOR_BLOCK_RECORDS;
+    int nRecs = int(min((__int64) TD_GENERATOR_BLOCK_RECORDS, m_nRecords - firstRec));
+    for (int r = 0; r < nRecs; ++r) {
+        int classValue = drawValue(classIdx, nextUniform(state));
+        int classRank = classValue - m_valueStarts[classIdx];
+
+        for (int a = 0; a < classIdx; ++a) {
+            bool bCorrelated = nextUniform(state) < m_classCorrelation;
+            double u = nextUniform(state);
+            if (m_valueStarts[a + 1] > m_valueStarts[a]) {
+                int valueIdx = drawValue(a, u);
+                if (bCorrelated) {
+                    int nValues = m_valueStarts[a + 1] - m_valueStarts[a];
+                    int rank = valueIdx - m_valueStarts[a];
+                    valueIdx = m_valueStarts[a] + (rank + classRank * nValues / nClasses) % nValues;
+                }
+                buffer.append(m_values[valueIdx]);
+            }
+            else {
+                double position = pow(u, 1.0 + m_skew);
+                if (bCorrelated)
+                    position = fmod(position + double(classRank) / nClasses, 1.0);
+
+                // Truncated, so that rounding cannot reach the exclusive upper bound.
+                double value = m_lowerBounds[a] + position * (m_upperBounds[a] - m_lowerBounds[a]);
+                value = floor(value * scale) / scale;
+                buffer.appendFloat(value, TD_GENERATOR_CONTVALUE_NUMDEC);
+            }
+            buffer.append(TD_RAWDATA_DELIMETER);
+            buffer.append(TCHAR(' '));
+        }
+        buffer.append(m_values[classValue]);
+        buffer.append(TD_RAWDATA_TERMINATOR);
+        buffer.append(TCHAR('\n'));
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Initial state of the random stream of a block (SplitMix64 of the seed
+// and the block index).
+//---------------------------------------------------------------------------
+// static
+unsigned __int64 CTDGenerator::seedStream(unsigned seed, int blockIdx)
+{
+    unsigned __int64 z = ((unsigned __int64) seed << 32) + unsigned(blockIdx) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    return z != 0 ? z : 1;
+}
+
+//---------------------------------------------------------------------------
+// Uniform in [0, 1) from an xorshift64* stream. rand() is not used since
+// its sequence would depend on which worker thread serializes a block, and
+// the output must be the same for a seed whatever the thread schedule.
+//---------------------------------------------------------------------------
+// static
+double CTDGenerator::nextUniform(unsigned __int64& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,62 @@
+// TDGenerator.h: interface for the CTDGenerator class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDGENERATOR_H)
+#define TDGENERATOR_H
+
+#if !defined(TDATTRIBMGR_H)
+    #include "TDAttribMgr.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Synthetic raw records for the attributes of a hierarchy file, in the
+// format of the .rawdata file. The class is drawn first. A categorical
+// value is a leaf concept drawn with probability proportional to
+// 1 / rank^skew, rank being its preorder position among the leaves; a
+// continuous value is lower + u^(1 + skew) * (upper - lower) over the
+// interval of the root concept, u uniform in [0, 1). With probability
+// classCorrelation a value is shifted by class c, by c / nClasses of the
+// leaves or of the interval, so that the class depends on the attributes.
+// The records are generated in blocks on all processors; every block has
+// its own random stream derived from the seed, so the output depends only
+// on the seed, not on the number of threads.
+//---------------------------------------------------------------------------
+class CTDGenerator : public CTDOutputSerializer
+{
+public:
+    CTDGenerator(LPCTSTR attributesFile, double skew, double classCorrelation, unsigned seed);
+    virtual ~CTDGenerator();
+
+// Operations
+    bool initialize();
+    bool generate(int nRecords, LPCTSTR rawDataFile);
+    virtual bool serializeItem(int itemIdx, CTDByteBuffer* pBuffers);
+
+protected:
+    void addValues(CTDAttrib* pAttrib);
+    void addValue(const CString& value, double weight);
+    int drawValue(int attribIdx, double u) const;
+    static unsigned __int64 seedStream(unsigned seed, int blockIdx);
+    static double nextUniform(unsigned __int64& state);
+
+// Attributes
+    CTDAttribMgr    m_attribMgr;
+    double          m_skew;
+    double          m_classCorrelation;
+    unsigned        m_seed;
+    int             m_nRecords;
+
+    // Values of the categorical attributes and the class, by attribute.
+    CStringArray    m_values;
+    CTDDoubleArray  m_cumWeights;       // Cumulative weight of value v among the values of its attribute, normalized to 1.
+    CTDIntArray     m_valueStarts;      // Values of attribute a are [m_valueStarts[a], m_valueStarts[a + 1]).
+    CTDFloatArray   m_lowerBounds;      // Interval of a continuous attribute.
+    CTDFloatArray   m_upperBounds;
+};
+
+#endif
@@ -7,6 +7,18 @@
     #include "TDController.h"
 #endif
 
+#if !defined(TDEXPERIMENT_H)
+    #include "TDExperiment.h"
+#endif
+
+#if !defined(TDBENCHMARK_H)
+    #include "TDBenchmark.h"
+#endif
+
+#if !defined(TDGENERATOR_H)
+    #include "TDGenerator.h"
+#endif
+
 #ifdef _DEBUG
 #define new DEBUG_NEW
 #undef THIS_FILE
@@ -22,11 +34,13 @@ CWinApp theApp;
 using namespace System;
 
 int g_main_nTrainRecs;
+TDScoreFunction g_main_scoreFunction = TD_DEFAULT_SCORE_FUNCTION;
 
 
 //---------------------------------------------------------------------------
-// Command Arguments: C:\\Users\\...\\...\\exp\\adult FALSE 10 1 -1 30162
+// Command Arguments: C:\\Users\\...\\...\\exp\\adult FALSE 10 1 -1 30162 [MAX]
 // If nInputRecs == -1, read all records in input dataset.
+// The score function is MAX, INFOGAIN, DISCERNIBILITY or NCP.
 //---------------------------------------------------------------------------
 bool parseArgs(int      nArgs, 
                TCHAR*   argv[], 
@@ -37,11 +51,14 @@ bool parseArgs(int      nArgs,
                int&     nInputRecs,
                int&     nTraining)
 {
-    if (nArgs != 7 || !argv) {
-        cout << _T("Usage: DiffMulti <dataSetName> <bRemoveUnknownOnly> <nSpecialization> <privacyB> <nInputRecs> <nTraining>") << endl;
+    if ((nArgs != 7 && nArgs != 8) || !argv) {
+        cout << _T("Usage: DiffMulti <dataSetName> <bRemoveUnknownOnly> <nSpecialization> <privacyB> <nInputRecs> <nTraining> [scoreFunction]") << endl;
         return false;
     }
 
+    if (nArgs == 8 && !parseScoreFunction(argv[7]))
+        return false;
+
     dataSetName = argv[1];
 	
 	if (_tcsicmp(argv[2], _T("TRUE")) == 0)
@@ -58,6 +75,124 @@ bool parseArgs(int      nArgs,
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Command Arguments: apply C:\\Users\\...\\exp\\adult.model new.rawdata new.test FALSE
+// Generalizes the records of new.rawdata with the model of an earlier run.
+//---------------------------------------------------------------------------
+bool parseApplyArgs(int      nArgs, 
+                    TCHAR*   argv[], 
+                    CString& modelFile,
+                    CString& recordFile,
+                    CString& outputFile,
+                    bool&    bC45)
+{
+    if (nArgs != 6 || !argv) {
+        cout << _T("Usage: DiffMulti apply <modelFile> <recordFile> <outputFile> <bC45>") << endl;
+        return false;
+    }
+
+    modelFile = argv[2];
+    recordFile = argv[3];
+    outputFile = argv[4];
+
+	if (_tcsicmp(argv[5], _T("TRUE")) == 0)
+	    bC45 = true;
+	else if (_tcsicmp(argv[5], _T("FALSE")) == 0)
+		bC45 = false;
+	else
+        return false;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Command Arguments: experiment C:\\Users\\...\\exp\\adult 20 "1000,10000" "0.1,1" -1 30162 [MAX]
+// Runs 20 trials of every pair of nSpecialization and privacyB on the
+// data read once. A single value is a single configuration.
+//---------------------------------------------------------------------------
+bool parseExperimentArgs(int      nArgs, 
+                         TCHAR*   argv[], 
+                         CString& dataSetName,
+                         int&     nTrials,
+                         CString& nSpecializationsStr,
+                         CString& pBudgetsStr,
+                         int&     nInputRecs,
+                         int&     nTraining)
+{
+    if ((nArgs != 8 && nArgs != 9) || !argv) {
+        cout << _T("Usage: DiffMulti experiment <dataSetName> <nTrials> <nSpecialization,...> <privacyB,...> <nInputRecs> <nTraining> [scoreFunction]") << endl;
+        return false;
+    }
+
+    if (nArgs == 9 && !parseScoreFunction(argv[8]))
+        return false;
+
+    dataSetName = argv[2];
+    nTrials = int(StrToInt(argv[3]));
+    nSpecializationsStr = argv[4];
+    pBudgetsStr = argv[5];
+    nInputRecs = int(StrToFloat(argv[6]));
+    nTraining = int(StrToFloat(argv[7]));
+    return nTrials > 0;
+}
+
+//---------------------------------------------------------------------------
+// Command Arguments: bench 100000 8 4 2 100 5 bench.csv
+// Times the kernels on 100000 synthetic records of 8 attributes, each
+// categorical hierarchy with fan-out 4, 2 classes and 100 distinct values
+// per attribute, taking the best of 5 repetitions. The result file is
+// optional.
+//---------------------------------------------------------------------------
+bool parseBenchmarkArgs(int            nArgs, 
+                        TCHAR*         argv[], 
+                        TDBenchParams& params,
+                        CString&       resultFile)
+{
+    if ((nArgs != 8 && nArgs != 9) || !argv) {
+        cout << _T("Usage: DiffMulti bench <nRows> <nAttributes> <fanOut> <nClasses> <nDistinctValues> <nRepetitions> [resultFile]") << endl;
+        return false;
+    }
+
+    params.m_nRows = int(StrToInt(argv[2]));
+    params.m_nAttribs = int(StrToInt(argv[3]));
+    params.m_fanOut = int(StrToInt(argv[4]));
+    params.m_nClasses = int(StrToInt(argv[5]));
+    params.m_nDistinct = int(StrToInt(argv[6]));
+    params.m_nReps = int(StrToInt(argv[7]));
+    params.m_seed = TD_BENCH_SEED;
+    if (nArgs == 9)
+        resultFile = argv[8];
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Command Arguments: generate C:\\Users\\...\\exp\\adult.hchy big.rawdata 1e8 1.2 0.5 7
+// Writes 1e8 synthetic records of the attributes of adult.hchy to
+// big.rawdata with skew 1.2 and class correlation 0.5. The seed is
+// optional.
+//---------------------------------------------------------------------------
+bool parseGenerateArgs(int       nArgs, 
+                       TCHAR*    argv[], 
+                       CString&  attributesFile,
+                       CString&  rawDataFile,
+                       int&      nRecords,
+                       double&   skew,
+                       double&   classCorrelation,
+                       unsigned& seed)
+{
+    if ((nArgs != 7 && nArgs != 8) || !argv) {
+        cout << _T("Usage: DiffMulti generate <hierarchyFile> <rawDataFile> <nRecords> <skew> <classCorrelation> [seed]") << endl;
+        return false;
+    }
+
+    attributesFile = argv[2];
+    rawDataFile = argv[3];
+    nRecords = int(StrToFloat(argv[4]));
+    skew = StrToFloat(argv[5]);
+    classCorrelation = StrToFloat(argv[6]);
+    seed = (nArgs == 8) ? unsigned(StrToInt(argv[7])) : TD_GENERATOR_SEED;
+    return true;
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 void debugPrint(LPCTSTR str)
@@ -121,6 +256,87 @@ int _tmain(int argc, TCHAR* argv[], TCHAR* envp[])
 		CString strHello;
 		strHello.LoadString(IDS_HELLO);
 		
+        if (argc > 1 && _tcsicmp(argv[1], _T("apply")) == 0) {
+            CString modelFile, recordFile, outputFile;
+            bool bC45 = false;
+            if (!parseApplyArgs(argc, argv, modelFile, recordFile, outputFile, bC45)) {
+                cerr << _T("Input Error: invalid arguments") << endl;
+                return 1;
+            }
+
+            CTDModel model;
+            if (!model.load(modelFile) || !model.apply(recordFile, outputFile, bC45)) {
+                cerr << _T("Error occured.") << endl;
+                return 1;
+            }
+            cout << _T("Bye!") << endl;
+            return nRetCode;
+        }
+
+        if (argc > 1 && _tcsicmp(argv[1], _T("experiment")) == 0) {
+            CString dataSetName, nSpecializationsStr, pBudgetsStr;
+            int nTrials = 0, nTraining = 0, nInputRecs = 0;
+            if (!parseExperimentArgs(argc, argv, dataSetName, nTrials, nSpecializationsStr, pBudgetsStr, nInputRecs, nTraining)) {
+                cerr << _T("Input Error: invalid arguments") << endl;
+                return 1;
+            }
+
+            g_main_nTrainRecs = nTraining;
+            CTDExperiment experiment(nInputRecs, nTraining);
+            CString attributesFile = dataSetName + _T(".") + TD_ATTRBFILE_EXT;
+            CString rawDataFile = dataSetName + _T(".") + TD_RAWDATAFILE_EXT;
+            CString trialFile = dataSetName + _T(".") + TD_EXPERIMENT_TRIALFILE_EXT;
+            CString summaryFile = dataSetName + _T(".") + TD_EXPERIMENT_SUMMARYFILE_EXT;
+            if (!experiment.addGrid(nSpecializationsStr, pBudgetsStr) ||
+                !experiment.load(attributesFile, rawDataFile) || 
+                !experiment.run(nTrials, unsigned(time(NULL))) ||
+                !experiment.writeTrials(trialFile) ||
+                !experiment.writeSummary(summaryFile)) {
+                cerr << _T("Error occured.") << endl;
+                return 1;
+            }
+            experiment.printSummary();
+            cout << _T("Bye!") << endl;
+            return nRetCode;
+        }
+
+        if (argc > 1 && _tcsicmp(argv[1], _T("generate")) == 0) {
+            CString attributesFile, rawDataFile;
+            int nRecords = 0;
+            double skew = 0, classCorrelation = 0;
+            unsigned seed = 0;
+            if (!parseGenerateArgs(argc, argv, attributesFile, rawDataFile, nRecords, skew, classCorrelation, seed)) {
+                cerr << _T("Input Error: invalid arguments") << endl;
+                return 1;
+            }
+
+            CTDGenerator generator(attributesFile, skew, classCorrelation, seed);
+            if (!generator.initialize() || !generator.generate(nRecords, rawDataFile)) {
+                cerr << _T("Error occured.") << endl;
+                return 1;
+            }
+            cout << _T("Bye!") << endl;
+            return nRetCode;
+        }
+
+        if (argc > 1 && _tcsicmp(argv[1], _T("bench")) == 0) {
+            TDBenchParams params;
+            CString resultFile;
+            if (!parseBenchmarkArgs(argc, argv, params, resultFile)) {
+                cerr << _T("Input Error: invalid arguments") << endl;
+                return 1;
+            }
+
+            CTDBenchmark benchmark(params);
+            if (!benchmark.run() ||
+                (!resultFile.IsEmpty() && !benchmark.writeResults(resultFile))) {
+                cerr << _T("Error occured.") << endl;
+                return 1;
+            }
+            benchmark.printResults();
+            cout << _T("Bye!") << endl;
+            return nRetCode;
+        }
 
 
         CString dataSetName;
@@ -136,7 +352,7 @@ int _tmain(int argc, TCHAR* argv[], TCHAR* envp[])
 		g_main_nTrainRecs = nTraining;
         
         // Construct the filenames
-        CString rawDataFile, attributesFile, nameFile, supFile, transformedDataFile, transformedTestFile, transformedSVMDataFile, transformedSVMTestFile;
+        CString rawDataFile, attributesFile, nameFile, supFile, transformedDataFile, transformedTestFile, transformedSVMDataFile, transformedSVMTestFile, modelFile, workloadFile, marginalFile, profileFile, traceFile, traceCSVFile;
         rawDataFile = dataSetName;
         rawDataFile += _T(".");
         rawDataFile += TD_RAWDATAFILE_EXT;
@@ -152,12 +368,36 @@ int _tmain(int argc, TCHAR* argv[], TCHAR* envp[])
         transformedTestFile = dataSetName;
         transformedTestFile += _T(".");
         transformedTestFile += TD_TRANSFORM_TESTFILE_EXT;
+        modelFile = dataSetName;
+        modelFile += _T(".");
+        modelFile += TD_MODELFILE_EXT;
+        workloadFile = dataSetName;
+        workloadFile += _T(".");
+        workloadFile += TD_WORKLOADFILE_EXT;
+        marginalFile = dataSetName;
+        marginalFile += _T(".");
+        marginalFile += TD_MARGINALFILE_EXT;
+        profileFile = dataSetName;
+        profileFile += _T(".");
+        profileFile += TD_PROFILEFILE_EXT;
+        traceFile = dataSetName;
+        traceFile += _T(".");
+        traceFile += TD_TRACEFILE_EXT;
+        traceCSVFile = dataSetName;
+        traceCSVFile += _T(".");
+        traceCSVFile += TD_TRACE_CSVFILE_EXT;
 
         CTDController controller(rawDataFile, 
                                  attributesFile,
                                  nameFile,
                                  transformedDataFile, 
                                  transformedTestFile,
+                                 modelFile,
+                                 workloadFile,
+                                 marginalFile,
+                                 profileFile,
+                                 traceFile,
+                                 traceCSVFile,
 								 nSpecialization,
 								 pBudget,
                                  nInputRecs,
@@ -353,21 +593,67 @@ int expoMechSplit(double epsilon, CTDFloatArray* weights,  CTDFloatArray* ranges
 
 float getSensitivity()
 {
-#if defined(_TD_SCORE_FUNCTION_INFOGAIN)
-	return 1;	//log(#class_labels)
-#endif
+	switch (g_main_scoreFunction) {
+	case TD_SCORE_INFOGAIN:
+		return 1;	//log(#class_labels)
+	case TD_SCORE_MAX:
+		return 1;
+	case TD_SCORE_DISCERNIBILITY:
+		return (2 * g_main_nTrainRecs) + 1;
+	case TD_SCORE_NCP:
+		return 1;
+	default:
+		ASSERT(false);
+		return 1;
+	}
+}
 
-#if defined(_TD_SCORE_FUNTION_MAX)
-	return 1;
-#endif
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+TDScoreFunction getScoreFunction()
+{
+	return g_main_scoreFunction;
+}
 
-#if defined(_TD_SCORE_FUNTION_DISCERNIBILITY)
-	return (2 * g_main_nTrainRecs) + 1;
-#endif
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void setScoreFunction(TDScoreFunction scoreFunction)
+{
+	g_main_scoreFunction = scoreFunction;
+}
 
-#if defined(_TD_SCORE_FUNCTION_NCP)
-	return 1;
-#endif
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+LPCTSTR getScoreFunctionName(TDScoreFunction scoreFunction)
+{
+	switch (scoreFunction) {
+	case TD_SCORE_MAX:
+		return _T("MAX");
+	case TD_SCORE_INFOGAIN:
+		return _T("INFOGAIN");
+	case TD_SCORE_DISCERNIBILITY:
+		return _T("DISCERNIBILITY");
+	case TD_SCORE_NCP:
+		return _T("NCP");
+	default:
+		ASSERT(false);
+		return _T("");
+	}
+}
+
+//---------------------------------------------------------------------------
+// Select the score function by its name, case-insensitive.
+//---------------------------------------------------------------------------
+bool parseScoreFunction(LPCTSTR name)
+{
+	for (int s = 0; s < TD_NUM_SCORE_FUNCTIONS; ++s) {
+		if (_tcsicmp(name, getScoreFunctionName(TDScoreFunction(s))) == 0) {
+			setScoreFunction(TDScoreFunction(s));
+			return true;
+		}
+	}
+	cerr << _T("Unknown score function: ") << name << _T(". Use MAX, INFOGAIN, DISCERNIBILITY or NCP.") << endl;
+	return false;
 }
 
 //---------------------------------------------------------------------------
@@ -376,3 +662,10 @@ int getnTrainingRecs()
 {
 	return g_main_nTrainRecs;
 }
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void setnTrainingRecs(int nTraining)
+{
+	g_main_nTrainRecs = nTraining;
+}
@@ -21,5 +21,10 @@ double laplaceNoise(double epsilon);
 int expoMech(double epsilon, CTDFloatArray* weights);
 int expoMechSplit(double epsilon, CTDFloatArray* weights, CTDFloatArray* ranges);
 float getSensitivity();
+TDScoreFunction getScoreFunction();
+void setScoreFunction(TDScoreFunction scoreFunction);
+LPCTSTR getScoreFunctionName(TDScoreFunction scoreFunction);
+bool parseScoreFunction(LPCTSTR name);
 int getnTrainingRecs();
+void setnTrainingRecs(int nTraining);
 #endif
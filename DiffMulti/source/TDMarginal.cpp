@@ -0,0 +1,515 @@
+// TDMarginal.cpp: implementation of the CTDMarginal class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDMARGINAL_H)
+    #include "TDMarginal.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+//*************
+// CTDMarginalAxis
+//*************
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+CString CTDMarginalAxis::getCellLabel(int cellIdx) const
+{
+    if (!m_bContinuous)
+        return m_cells.GetAt(cellIdx)->m_conceptValue;
+
+    CString rangeStr;
+    CTDContConcept::makeRange(m_bounds[cellIdx], m_bounds[cellIdx + 1], rangeStr);
+    return rangeStr;
+}
+
+
+//*************
+// CTDMarginal
+//*************
+
+CTDMarginal::CTDMarginal()
+    : m_pAttribMgr(NULL)
+{
+}
+
+CTDMarginal::~CTDMarginal()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDMarginal::cleanup()
+{
+    for (int i = 0; i < m_axes.GetSize(); ++i)
+        delete m_axes.GetAt(i);
+    m_axes.RemoveAll();
+    m_strides.RemoveAll();
+    m_counts.RemoveAll();
+}
+
+//---------------------------------------------------------------------------
+// Parse the attributes and levels of a marginal.
+//---------------------------------------------------------------------------
+bool CTDMarginal::parse(LPCTSTR specStr, CTDAttribMgr* pAttribMgr)
+{
+    cleanup();
+    m_specStr = specStr;
+    m_pAttribMgr = pAttribMgr;
+    int nAttribs = pAttribMgr->getNumAttributes();
+    CString axisStr, attribName, depthStr;
+    CBFStrParser strParser(specStr, TD_RAWDATA_DELIMETER);
+    while (strParser.getNext(axisStr)) {
+        CBFStrHelper::trim(axisStr);
+        if (axisStr.IsEmpty())
+            continue;
+
+        int depth = -1;
+        int sepPos = axisStr.Find(TD_QUERY_ATTRIBSEP);
+        attribName = sepPos < 0 ? axisStr : axisStr.Left(sepPos);
+        CBFStrHelper::trim(attribName);
+        if (sepPos >= 0) {
+            depthStr = axisStr.Mid(sepPos + 1);
+            CBFStrHelper::trim(depthStr);
+            bool bValid = !depthStr.IsEmpty();
+            for (int i = 0; i < depthStr.GetLength(); ++i)
+                bValid = bValid && depthStr[i] >= TCHAR('0') && depthStr[i] <= TCHAR('9');
+            if (!bValid) {
+                cerr << _T("CTDMarginal: Invalid level ") << depthStr << _T(" of attribute ") << attribName << endl;
+                return false;
+            }
+            depth = int(StrToInt(depthStr));
+        }
+
+        int attribIdx = 0;
+        while (attribIdx < nAttribs && pAttribMgr->getAttribute(attribIdx)->m_attribName.CompareNoCase(attribName) != 0)
+            ++attribIdx;
+        if (attribIdx == nAttribs) {
+            cerr << _T("CTDMarginal: Unknown attribute ") << attribName << endl;
+            return false;
+        }
+        for (int a = 0; a < m_axes.GetSize(); ++a) {
+            if (m_axes.GetAt(a)->m_attribIdx == attribIdx) {
+                cerr << _T("CTDMarginal: Attribute ") << attribName << _T(" is in marginal ") << specStr << _T(" more than once") << endl;
+                return false;
+            }
+        }
+
+        CTDMarginalAxis* pAxis = new CTDMarginalAxis();
+        pAxis->m_attribIdx = attribIdx;
+        pAxis->m_depth = depth;
+        pAxis->m_bContinuous = pAttribMgr->getAttribute(attribIdx)->isContinuous();
+        pAxis->m_bClass = attribIdx == nAttribs - 1;
+        m_axes.Add(pAxis);
+    }
+
+    if (m_axes.GetSize() == 0) {
+        cerr << _T("CTDMarginal: No attributes in marginal ") << specStr << endl;
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Find the cells of each axis and allocate the zeroed table.
+//---------------------------------------------------------------------------
+bool CTDMarginal::prepare(CTDPartitions* pLeafPartitions)
+{
+    for (int a = 0; a < m_axes.GetSize(); ++a) {
+        CTDMarginalAxis* pAxis = m_axes.GetAt(a);
+        CTDAttrib* pAttrib = m_pAttribMgr->getAttribute(pAxis->m_attribIdx);
+        pAxis->m_cells.RemoveAll();
+        pAxis->m_bounds.RemoveAll();
+        if (pAxis->m_bClass) {
+            CTDConcept* pClassRoot = pAttrib->getConceptRoot();
+            if (pAxis->m_depth == 0)
+                pAxis->m_cells.Add(pClassRoot);
+            else {
+                for (int j = 0; j < pClassRoot->getNumChildConcepts(); ++j)
+                    pAxis->m_cells.Add(pClassRoot->getChildConcept(j));
+            }
+        }
+        else if (pAxis->m_bContinuous) {
+            buildContinuousAxis(pAxis, pLeafPartitions);
+        }
+        else {
+            pAxis->m_conceptCells.SetSize(pAttrib->getFlattenConcepts()->GetSize());
+            buildCategoricalAxis(pAxis, pAttrib->getConceptRoot(), -1);
+        }
+    }
+
+    // Row-major: the last axis varies fastest.
+    m_strides.SetSize(m_axes.GetSize());
+    double nCells = 1.0;
+    for (int a = m_axes.GetSize() - 1; a >= 0; --a) {
+        m_strides[a] = int(nCells);
+        nCells *= m_axes.GetAt(a)->getNumCells();
+    }
+    if (nCells > TD_MARGINAL_MAX_CELLS) {
+        cerr << _T("CTDMarginal: Marginal ") << m_specStr << _T(" has ") << nCells << _T(" cells; at most ")
+             << TD_MARGINAL_MAX_CELLS << _T(" are supported.") << endl;
+        return false;
+    }
+
+    m_counts.SetSize(int(nCells));
+    for (int c = 0; c < m_counts.GetSize(); ++c)
+        m_counts[c] = 0.0;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Cut the hierarchy at the depth of the axis. cellIdx is the cell of the
+// parent concept, or -1 if the parent is above the cut.
+//---------------------------------------------------------------------------
+void CTDMarginal::buildCategoricalAxis(CTDMarginalAxis* pAxis, CTDConcept* pConcept, int cellIdx)
+{
+    if (cellIdx < 0 && (pConcept->m_depth == pAxis->m_depth || pConcept->getNumChildConcepts() == 0))
+        cellIdx = pAxis->m_cells.Add(pConcept);
+
+    pAxis->m_conceptCells[pConcept->m_flattenIdx] = cellIdx;
+    for (int c = 0; c < pConcept->getNumChildConcepts(); ++c)
+        buildCategoricalAxis(pAxis, pConcept->getChildConcept(c), cellIdx);
+}
+
+//---------------------------------------------------------------------------
+// The intervals of a continuous attribute are made by the splits, so its
+// cells come from the leaf partitions. The ancestors of a leaf interval
+// are the intervals it was split from.
+//---------------------------------------------------------------------------
+void CTDMarginal::buildContinuousAxis(CTDMarginalAxis* pAxis, CTDPartitions* pLeafPartitions)
+{
+    CTDFloatArray bounds;
+    for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL;) {
+        CTDPartition* pPartition = pLeafPartitions->GetNext(pos);
+        CTDConcept* pConcept = pPartition->getGenRecords()->GetAt(0)->getValue(pAxis->m_attribIdx)->getCurrentConcept();
+        if (pAxis->m_depth >= 0) {
+            int depth = 0;
+            for (CTDConcept* pAncestor = pConcept->getParentConcept(); pAncestor; pAncestor = pAncestor->getParentConcept())
+                ++depth;
+            for (; depth > pAxis->m_depth; --depth)
+                pConcept = pConcept->getParentConcept();
+        }
+        bounds.Add(static_cast<CTDContConcept*> (pConcept)->m_lowerBound);
+        bounds.Add(static_cast<CTDContConcept*> (pConcept)->m_upperBound);
+    }
+
+    qsort(bounds.GetData(), bounds.GetSize(), sizeof(float), compareBounds);
+    for (int i = 0; i < bounds.GetSize(); ++i) {
+        if (i == 0 || bounds[i] != bounds[i - 1])
+            pAxis->m_bounds.Add(bounds[i]);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Add the counts of a leaf partition to the cells it intersects. The cells
+// and fractions of each axis are collected first; the table is then
+// updated for every combination of them.
+//---------------------------------------------------------------------------
+void CTDMarginal::addLeaf(CTDPartition* pPartition)
+{
+    CTDRecord* pGenRec = pPartition->getGenRecords()->GetAt(0);
+    int nClasses = m_pAttribMgr->getNumClasses();
+    double total = 0.0;
+    for (int j = 0; j < nClasses && j < pPartition->m_classNoisySums.GetSize(); ++j)
+        total += pPartition->m_classNoisySums[j];
+
+    bool bClassAxis = false;
+    m_leafCells.RemoveAll();
+    m_leafFractions.RemoveAll();
+    m_leafCellStarts.SetSize(m_axes.GetSize() + 1);
+    for (int a = 0; a < m_axes.GetSize(); ++a) {
+        const CTDMarginalAxis* pAxis = m_axes.GetAt(a);
+        m_leafCellStarts[a] = m_leafCells.GetSize();
+        if (pAxis->m_bClass) {
+            // The class cells carry the counts; the other axes only fractions.
+            bClassAxis = true;
+            for (int j = 0; j < nClasses && j < pPartition->m_classNoisySums.GetSize(); ++j) {
+                m_leafCells.Add(pAxis->getNumCells() == 1 ? 0 : j);
+                m_leafFractions.Add(pPartition->m_classNoisySums[j]);
+            }
+        }
+        else if (pAxis->m_bContinuous)
+            addContinuousCells(pAxis, static_cast<CTDContConcept*> (pGenRec->getValue(pAxis->m_attribIdx)->getCurrentConcept()));
+        else
+            addCategoricalCells(pAxis, pGenRec->getValue(pAxis->m_attribIdx)->getCurrentConcept());
+
+        if (m_leafCells.GetSize() == m_leafCellStarts[a])
+            return;
+    }
+    m_leafCellStarts[m_axes.GetSize()] = m_leafCells.GetSize();
+
+    int nAxes = m_axes.GetSize();
+    m_positions.SetSize(nAxes);
+    for (int a = 0; a < nAxes; ++a)
+        m_positions[a] = m_leafCellStarts[a];
+
+    double weight = bClassAxis ? 1.0 : total;
+    while (true) {
+        int cellIdx = 0;
+        double fraction = weight;
+        for (int a = 0; a < nAxes; ++a) {
+            cellIdx += m_leafCells[m_positions[a]] * m_strides[a];
+            fraction *= m_leafFractions[m_positions[a]];
+        }
+        m_counts[cellIdx] += fraction;
+
+        int a = nAxes - 1;
+        while (a >= 0 && ++m_positions[a] == m_leafCellStarts[a + 1]) {
+            m_positions[a] = m_leafCellStarts[a];
+            --a;
+        }
+        if (a < 0)
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDMarginal::addCategoricalCells(const CTDMarginalAxis* pAxis, CTDConcept* pLeafConcept)
+{
+    int cellIdx = pAxis->m_conceptCells[pLeafConcept->m_flattenIdx];
+    if (cellIdx >= 0) {
+        m_leafCells.Add(cellIdx);
+        m_leafFractions.Add(1.0);
+        return;
+    }
+    addSubtreeCells(pAxis, pLeafConcept, pLeafConcept->m_nLeafConcepts);
+}
+
+//---------------------------------------------------------------------------
+// Spread a leaf concept above the cut over the cells below it.
+//---------------------------------------------------------------------------
+void CTDMarginal::addSubtreeCells(const CTDMarginalAxis* pAxis, CTDConcept* pConcept, double nLeafConcepts)
+{
+    for (int c = 0; c < pConcept->getNumChildConcepts(); ++c) {
+        CTDConcept* pChildConcept = pConcept->getChildConcept(c);
+        int cellIdx = pAxis->m_conceptCells[pChildConcept->m_flattenIdx];
+        if (cellIdx < 0) {
+            addSubtreeCells(pAxis, pChildConcept, nLeafConcepts);
+            continue;
+        }
+        m_leafCells.Add(cellIdx);
+        m_leafFractions.Add(pChildConcept->m_nLeafConcepts / nLeafConcepts);
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDMarginal::addContinuousCells(const CTDMarginalAxis* pAxis, CTDContConcept* pLeafConcept)
+{
+    const CTDFloatArray& bounds = pAxis->m_bounds;
+    float lowerB = pLeafConcept->m_lowerBound, upperB = pLeafConcept->m_upperBound;
+
+    // First cell that ends after the lower bound.
+    int lo = 0, hi = bounds.GetSize() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (bounds[mid + 1] > lowerB)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    if (upperB <= lowerB) {
+        if (lo < bounds.GetSize() - 1) {
+            m_leafCells.Add(lo);
+            m_leafFractions.Add(1.0);
+        }
+        return;
+    }
+    for (int c = lo; c < bounds.GetSize() - 1 && bounds[c] < upperB; ++c) {
+        double overlap = min(upperB, bounds[c + 1]) - max(lowerB, bounds[c]);
+        if (overlap <= 0.0)
+            continue;
+        m_leafCells.Add(c);
+        m_leafFractions.Add(overlap / (upperB - lowerB));
+    }
+}
+
+//---------------------------------------------------------------------------
+// One CSV line per cell, count first as in TD_OUTPUT_CSV, preceded by the
+// marginal as a comment and a header line.
+//---------------------------------------------------------------------------
+bool CTDMarginal::write(CFile& file) const
+{
+    int nAxes = m_axes.GetSize();
+    CTypedPtrArray<CPtrArray, CStringArray*> labels;
+    labels.SetSize(nAxes);
+    CTDByteBuffer buffer;
+    buffer.append(TD_CONHCHY_COMMENT);
+    buffer.append(_T(" "));
+    buffer.append(m_specStr);
+    buffer.append(TCHAR('\n'));
+    buffer.append(TD_CSV_COUNT_COLUMN);
+    for (int a = 0; a < nAxes; ++a) {
+        const CTDMarginalAxis* pAxis = m_axes.GetAt(a);
+        buffer.append(TD_RAWDATA_DELIMETER);
+        buffer.append(m_pAttribMgr->getAttribute(pAxis->m_attribIdx)->m_attribName);
+        labels[a] = new CStringArray();
+        for (int c = 0; c < pAxis->getNumCells(); ++c)
+            labels[a]->Add(pAxis->getCellLabel(c));
+    }
+    buffer.append(TCHAR('\n'));
+
+    CTDIntArray cells;
+    cells.SetSize(nAxes);
+    for (int a = 0; a < nAxes; ++a)
+        cells[a] = 0;
+    for (int cellIdx = 0; cellIdx < m_counts.GetSize(); ++cellIdx) {
+        buffer.appendFloat(m_counts[cellIdx], TD_CONTVALUE_NUMDEC);
+        for (int a = 0; a < nAxes; ++a) {
+            buffer.append(TD_RAWDATA_DELIMETER);
+            buffer.append(labels[a]->GetAt(cells[a]));
+        }
+        buffer.append(TCHAR('\n'));
+        if (buffer.getSize() >= TD_OUTPUT_MIN_BUFFER_SIZE) {
+            CTDOutputWriter::writeBytes(file, buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+            buffer.reset();
+        }
+
+        int a = nAxes - 1;
+        while (a >= 0 && ++cells[a] == labels[a]->GetSize()) {
+            cells[a] = 0;
+            --a;
+        }
+    }
+    buffer.append(TCHAR('\n'));
+    CTDOutputWriter::writeBytes(file, buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+
+    for (int a = 0; a < nAxes; ++a)
+        delete labels[a];
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+int CTDMarginal::compareBounds(const void* pBound1, const void* pBound2)
+{
+    float bound1 = *static_cast<const float*> (pBound1);
+    float bound2 = *static_cast<const float*> (pBound2);
+    if (bound1 < bound2)
+        return -1;
+    return bound1 > bound2 ? 1 : 0;
+}
+
+
+//*************
+// CTDMarginals
+//*************
+
+CTDMarginals::CTDMarginals()
+{
+}
+
+CTDMarginals::~CTDMarginals()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDMarginals::cleanup()
+{
+    for (int i = 0; i < m_marginals.GetSize(); ++i)
+        delete m_marginals.GetAt(i);
+    m_marginals.RemoveAll();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDMarginals::add(LPCTSTR specStr, CTDAttribMgr* pAttribMgr)
+{
+    CTDMarginal* pMarginal = new CTDMarginal();
+    if (!pMarginal->parse(specStr, pAttribMgr)) {
+        delete pMarginal;
+        return false;
+    }
+    m_marginals.Add(pMarginal);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Read one marginal per line. Empty lines and comments are skipped.
+//---------------------------------------------------------------------------
+bool CTDMarginals::load(LPCTSTR marginalFile, CTDAttribMgr* pAttribMgr)
+{
+    cleanup();
+    try {
+        CStdioFile file;
+        if (!file.Open(marginalFile, CFile::modeRead)) {
+            cerr << _T("CTDMarginals: Failed to open file ") << marginalFile << endl;
+            return false;
+        }
+
+        CString lineStr;
+        while (file.ReadString(lineStr)) {
+            int commentCharPos = lineStr.Find(TD_CONHCHY_COMMENT);
+            if (commentCharPos >= 0)
+                lineStr = lineStr.Left(commentCharPos);
+            CBFStrHelper::trim(lineStr);
+            if (lineStr.IsEmpty())
+                continue;
+
+            if (!add(lineStr, pAttribMgr))
+                return false;
+        }
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read marginal file: ") << marginalFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Fill all marginals in one pass over the leaf partitions.
+//---------------------------------------------------------------------------
+bool CTDMarginals::compute(CTDPartitions* pLeafPartitions)
+{
+    for (int i = 0; i < m_marginals.GetSize(); ++i) {
+        if (!m_marginals.GetAt(i)->prepare(pLeafPartitions))
+            return false;
+    }
+
+    for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL;) {
+        CTDPartition* pPartition = pLeafPartitions->GetNext(pos);
+        for (int i = 0; i < m_marginals.GetSize(); ++i)
+            m_marginals.GetAt(i)->addLeaf(pPartition);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDMarginals::write(LPCTSTR resultFile) const
+{
+    cout << _T("Writing marginals...") << endl;
+    try {
+        CStdioFile file;
+        if (!file.Open(resultFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDMarginals: Failed to open file ") << resultFile << endl;
+            return false;
+        }
+        for (int i = 0; i < m_marginals.GetSize(); ++i) {
+            if (!m_marginals.GetAt(i)->write(file))
+                return false;
+        }
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write marginal file: ") << resultFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    cout << _T("Writing marginals succeeded.") << endl << endl;
+    return true;
+}
@@ -0,0 +1,121 @@
+// TDMarginal.h: interface for the CTDMarginal class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDMARGINAL_H)
+#define TDMARGINAL_H
+
+#if !defined(TDATTRIBMGR_H)
+    #include "TDAttribMgr.h"
+#endif
+
+#if !defined(TDPARTITION_H)
+    #include "TDPartition.h"
+#endif
+
+//---------------------------------------------------------------------------
+// One attribute of a marginal, cut at a level of its hierarchy.
+// Categorical: the cells are the concepts at depth m_depth, and the leaf
+// concepts above it. Continuous: the cells are the intervals between the
+// bounds of the leaf intervals, or of their ancestors at depth m_depth.
+// Class: the cells are the class values, or the root at depth 0.
+//---------------------------------------------------------------------------
+class CTDMarginalAxis
+{
+public:
+    CTDMarginalAxis() : m_attribIdx(-1), m_depth(-1), m_bContinuous(false), m_bClass(false) {};
+    virtual ~CTDMarginalAxis() {};
+
+    int getNumCells() const { return m_bContinuous ? m_bounds.GetSize() - 1 : m_cells.GetSize(); };
+    CString getCellLabel(int cellIdx) const;
+
+// Attributes
+    int                m_attribIdx;
+    int                m_depth;             // -1 for the deepest level.
+    bool               m_bContinuous;
+    bool               m_bClass;
+    CTDConceptPtrArray m_cells;             // Categorical and class: concept of each cell.
+    CTDIntArray        m_conceptCells;      // Categorical: cell of each concept by flattened index, -1 above the cut.
+    CTDFloatArray      m_bounds;            // Continuous: cell c is [m_bounds[c], m_bounds[c + 1]).
+};
+
+typedef CTypedPtrArray<CPtrArray, CTDMarginalAxis*> CTDMarginalAxisArray;
+
+//---------------------------------------------------------------------------
+// Dense contingency table of the noisy counts over one or more attributes,
+// e.g., "education:1, occupation, classes" for education at depth 1 by
+// leaf occupation by class. Attributes are separated by
+// TD_RAWDATA_DELIMETER; TD_QUERY_ATTRIBSEP and a depth select the level.
+// A leaf partition whose concept spans several cells is spread over them
+// like in CTDQueryEngine: by number of leaf concepts, or by interval length.
+//---------------------------------------------------------------------------
+class CTDMarginal
+{
+public:
+    CTDMarginal();
+    virtual ~CTDMarginal();
+
+// Operations
+    bool parse(LPCTSTR specStr, CTDAttribMgr* pAttribMgr);
+    bool prepare(CTDPartitions* pLeafPartitions);
+    void addLeaf(CTDPartition* pPartition);
+    bool write(CFile& file) const;
+
+    const CString& getSpec() const { return m_specStr; };
+    int getNumAxes() const { return m_axes.GetSize(); };
+    const CTDMarginalAxis* getAxis(int axisIdx) const { return m_axes.GetAt(axisIdx); };
+    int getNumCells() const { return m_counts.GetSize(); };
+    double getCount(int cellIdx) const { return m_counts[cellIdx]; };
+
+protected:
+    void cleanup();
+    void buildCategoricalAxis(CTDMarginalAxis* pAxis, CTDConcept* pConcept, int cellIdx);
+    void buildContinuousAxis(CTDMarginalAxis* pAxis, CTDPartitions* pLeafPartitions);
+    void addCategoricalCells(const CTDMarginalAxis* pAxis, CTDConcept* pLeafConcept);
+    void addSubtreeCells(const CTDMarginalAxis* pAxis, CTDConcept* pConcept, double nLeafConcepts);
+    void addContinuousCells(const CTDMarginalAxis* pAxis, CTDContConcept* pLeafConcept);
+    static int compareBounds(const void* pBound1, const void* pBound2);
+
+// Attributes
+    CString              m_specStr;
+    CTDAttribMgr*        m_pAttribMgr;
+    CTDMarginalAxisArray m_axes;
+    CTDIntArray          m_strides;         // Cell c of axis a adds c * m_strides[a] to the table index.
+    CTDDoubleArray       m_counts;          // Row-major in axis order.
+
+    // Cells of the leaf being added. The cells of axis a are
+    // [m_leafCellStarts[a], m_leafCellStarts[a + 1]).
+    CTDIntArray          m_leafCells;
+    CTDDoubleArray       m_leafFractions;
+    CTDIntArray          m_leafCellStarts;
+    CTDIntArray          m_positions;
+};
+
+typedef CTypedPtrArray<CPtrArray, CTDMarginal*> CTDMarginalArray;
+
+//---------------------------------------------------------------------------
+// Marginals of a run, computed in one pass over the noisy leaf partitions
+// instead of aggregating the expanded records of the data file.
+//---------------------------------------------------------------------------
+class CTDMarginals
+{
+public:
+    CTDMarginals();
+    virtual ~CTDMarginals();
+
+// Operations
+    bool load(LPCTSTR marginalFile, CTDAttribMgr* pAttribMgr);
+    bool add(LPCTSTR specStr, CTDAttribMgr* pAttribMgr);
+    bool compute(CTDPartitions* pLeafPartitions);
+    bool write(LPCTSTR resultFile) const;
+    void cleanup();
+
+    int getNumMarginals() const { return m_marginals.GetSize(); };
+    CTDMarginal* getMarginal(int idx) const { return m_marginals.GetAt(idx); };
+
+protected:
+// Attributes
+    CTDMarginalArray m_marginals;
+};
+
+#endif
@@ -0,0 +1,183 @@
+// TDMemTracker.cpp: implementation of the CTDMemTracker class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+#include <psapi.h>
+
+#if !defined(TDMEMTRACKER_H)
+    #include "TDMemTracker.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+#pragma comment(lib, "psapi.lib")
+
+__declspec(thread) TDMemCounts* CTDMemTracker::m_pCounts = NULL;
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDMemTracker::CTDMemTracker()
+    : m_intervalMillis(0),
+      m_pSamplerThread(NULL),
+      m_stopEvent(FALSE, TRUE),
+      m_startNanos(0)
+{
+}
+
+CTDMemTracker::~CTDMemTracker()
+{
+    stopSampling();
+}
+
+//---------------------------------------------------------------------------
+// Start sampling the resident set size every intervalMillis milliseconds.
+//---------------------------------------------------------------------------
+bool CTDMemTracker::startSampling(int intervalMillis)
+{
+    stopSampling();
+    if (intervalMillis <= 0) {
+        ASSERT(false);
+        return false;
+    }
+
+    m_intervalMillis = intervalMillis;
+    m_sampleNanos.RemoveAll();
+    m_sampleRSS.RemoveAll();
+    m_stopEvent.ResetEvent();
+    m_startNanos = CTDProfiler::getNanos();
+
+    m_pSamplerThread = AfxBeginThread(samplerThreadProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+    if (!m_pSamplerThread) {
+        cerr << _T("CTDMemTracker: Failed to start the sampler thread.") << endl;
+        ASSERT(false);
+        return false;
+    }
+    m_pSamplerThread->m_bAutoDelete = FALSE;
+    m_pSamplerThread->ResumeThread();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Stop the sampler thread, if any, after its last sample.
+//---------------------------------------------------------------------------
+void CTDMemTracker::stopSampling()
+{
+    if (!m_pSamplerThread)
+        return;
+
+    m_stopEvent.SetEvent();
+    ::WaitForSingleObject(m_pSamplerThread->m_hThread, INFINITE);
+    delete m_pSamplerThread;
+    m_pSamplerThread = NULL;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+UINT AFX_CDECL CTDMemTracker::samplerThreadProc(LPVOID pParam)
+{
+    static_cast<CTDMemTracker*>(pParam)->runSampler();
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDMemTracker::runSampler()
+{
+    do {
+        m_sampleNanos.Add(CTDProfiler::getNanos() - m_startNanos);
+        m_sampleRSS.Add(getCurrentRSS());
+    } while (::WaitForSingleObject(m_stopEvent.m_hObject, m_intervalMillis) == WAIT_TIMEOUT);
+}
+
+//---------------------------------------------------------------------------
+// Bytes of the partitions at a depth of the partition tree.
+//---------------------------------------------------------------------------
+// static
+void CTDMemTracker::addAtDepth(int depth, LONGLONG nBytes)
+{
+    if (!TD_bTRACK_MEMORY || !m_pCounts)
+        return;
+    if (depth >= TD_MEM_MAX_DEPTH)
+        depth = TD_MEM_MAX_DEPTH - 1;
+    update(m_pCounts->m_depthCurrentBytes[depth], m_pCounts->m_depthPeakBytes[depth], nBytes);
+}
+
+//---------------------------------------------------------------------------
+// Add nBytes to a current count and raise its peak if it is exceeded. The
+// counts are only touched by the thread they are bound to.
+//---------------------------------------------------------------------------
+// static
+void CTDMemTracker::update(LONGLONG& current, LONGLONG& peak, LONGLONG nBytes)
+{
+    current += nBytes;
+    if (current > peak)
+        peak = current;
+}
+
+//---------------------------------------------------------------------------
+// Zero the counts, e.g., at the start of a run.
+//---------------------------------------------------------------------------
+// static
+void CTDMemTracker::resetCounts(TDMemCounts& counts)
+{
+    for (int c = 0; c < TD_NUM_MEM_CATEGORIES; ++c) {
+        counts.m_currentBytes[c] = 0;
+        counts.m_peakBytes[c] = 0;
+    }
+    for (int d = 0; d < TD_MEM_MAX_DEPTH; ++d) {
+        counts.m_depthCurrentBytes[d] = 0;
+        counts.m_depthPeakBytes[d] = 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Working set of the process.
+//---------------------------------------------------------------------------
+// static
+LONGLONG CTDMemTracker::getCurrentRSS()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return LONGLONG(counters.WorkingSetSize);
+}
+
+//---------------------------------------------------------------------------
+// Peak working set of the process since it started.
+//---------------------------------------------------------------------------
+// static
+LONGLONG CTDMemTracker::getPeakRSS()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return LONGLONG(counters.PeakWorkingSetSize);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+LPCTSTR CTDMemTracker::getCategoryName(TDMemCategory category)
+{
+    switch (category) {
+    case TD_MEM_RECORDS:
+        return _T("records");
+    case TD_MEM_VALUES:
+        return _T("values");
+    case TD_MEM_CONCEPTS:
+        return _T("concepts");
+    case TD_MEM_SUPPORT_MATRICES:
+        return _T("support_matrices");
+    case TD_MEM_PARTITION_RECORDS:
+        return _T("partition_records");
+    default:
+        ASSERT(false);
+        return _T("");
+    }
+}
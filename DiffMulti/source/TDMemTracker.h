@@ -0,0 +1,79 @@
+// TDMemTracker.h: interface for the CTDMemTracker class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDMEMTRACKER_H)
+#define TDMEMTRACKER_H
+
+enum TDMemCategory
+{
+    TD_MEM_RECORDS,                     // CTDRecord objects and their value pointers.
+    TD_MEM_VALUES,                      // CTDValue objects.
+    TD_MEM_CONCEPTS,                    // Concepts, including those added by makeChildConcepts.
+    TD_MEM_SUPPORT_MATRICES,            // Support and split matrices of CTDPartAttrib.
+    TD_MEM_PARTITION_RECORDS,           // Record pointers of the partitions, retained by the leaves.
+    TD_NUM_MEM_CATEGORIES
+};
+
+//---------------------------------------------------------------------------
+// Current and peak bytes of one run, by category and by depth of the
+// partition tree.
+//---------------------------------------------------------------------------
+struct TDMemCounts
+{
+    LONGLONG m_currentBytes[TD_NUM_MEM_CATEGORIES];
+    LONGLONG m_peakBytes[TD_NUM_MEM_CATEGORIES];
+    LONGLONG m_depthCurrentBytes[TD_MEM_MAX_DEPTH];
+    LONGLONG m_depthPeakBytes[TD_MEM_MAX_DEPTH];
+};
+
+//---------------------------------------------------------------------------
+// Current and peak bytes of the main data structures, by category and by
+// depth of the partition tree. The engine reports allocations and frees
+// through add and addAtDepth. They are added to the counts bound to the
+// calling thread by bind, i.e., those of the run on the thread, and are
+// not counted if none are bound. Concurrent runs on different threads
+// thus count separately. The counts cover the object sizes and the arrays
+// named above, not the overhead of the heap. Partitions at a depth count
+// their record pointers and support matrices.
+// An instance samples the resident set size of the process on its own
+// thread between startSampling and stopSampling.
+//---------------------------------------------------------------------------
+class CTDMemTracker
+{
+public:
+    CTDMemTracker();
+    virtual ~CTDMemTracker();
+
+// Operations
+    bool startSampling(int intervalMillis);
+    void stopSampling();
+    int getNumSamples() const { return m_sampleNanos.GetSize(); };
+    LONGLONG getSampleNanos(int sampleIdx) const { return m_sampleNanos[sampleIdx]; };   // Since startSampling.
+    LONGLONG getSampleRSS(int sampleIdx) const { return m_sampleRSS[sampleIdx]; };
+
+    static void add(TDMemCategory category, LONGLONG nBytes) { if (TD_bTRACK_MEMORY && m_pCounts) update(m_pCounts->m_currentBytes[category], m_pCounts->m_peakBytes[category], nBytes); };
+    static void addAtDepth(int depth, LONGLONG nBytes);
+    static void bind(TDMemCounts* pCounts) { m_pCounts = pCounts; };
+    static void resetCounts(TDMemCounts& counts);
+    static LONGLONG getCurrentRSS();
+    static LONGLONG getPeakRSS();
+    static LPCTSTR getCategoryName(TDMemCategory category);
+
+protected:
+    static void update(LONGLONG& current, LONGLONG& peak, LONGLONG nBytes);
+    static UINT AFX_CDECL samplerThreadProc(LPVOID pParam);
+    void runSampler();
+
+// Attributes
+    int                         m_intervalMillis;
+    CWinThread*                 m_pSamplerThread;
+    CEvent                      m_stopEvent;        // Set to stop the sampler thread.
+    LONGLONG                    m_startNanos;
+    CArray<LONGLONG, LONGLONG>  m_sampleNanos;
+    CArray<LONGLONG, LONGLONG>  m_sampleRSS;
+
+    static __declspec(thread) TDMemCounts* m_pCounts;   // Counts of the run on the calling thread, or NULL.
+};
+
+#endif
@@ -0,0 +1,735 @@
+// TDModel.cpp: implementation of the CTDModel class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDMODEL_H)
+    #include "TDModel.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDModel::CTDModel()
+    : m_pData(NULL),
+      m_pHeader(NULL),
+      m_pAttribs(NULL),
+      m_pDepths(NULL),
+      m_pValues(NULL),
+      m_pNodes(NULL),
+      m_pLeaves(NULL),
+      m_pCounts(NULL),
+      m_pStrings(NULL),
+      m_bApplyC45(false),
+      m_pWindow(NULL),
+      m_nApplied(0),
+      m_nDiscarded(0)
+{
+}
+
+CTDModel::~CTDModel()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDModel::cleanup()
+{
+    for (int i = 0; i < m_valueMaps.GetSize(); ++i)
+        delete m_valueMaps.GetAt(i);
+    m_valueMaps.RemoveAll();
+    m_svmClassLabels.RemoveAll();
+    m_blockStarts.RemoveAll();
+
+    delete [] m_pData;
+    m_pData = NULL;
+    m_pHeader = NULL;
+    m_pAttribs = NULL;
+    m_pDepths = NULL;
+    m_pValues = NULL;
+    m_pNodes = NULL;
+    m_pLeaves = NULL;
+    m_pCounts = NULL;
+    m_pStrings = NULL;
+    m_pWindow = NULL;
+}
+
+//---------------------------------------------------------------------------
+// Write the split decisions recorded by pRouter and the noisy leaf
+// partitions to a model file. The generalized record of every leaf is
+// converted once here, in both output formats.
+//---------------------------------------------------------------------------
+// static
+bool CTDModel::save(LPCTSTR modelFile,
+                    CTDAttribMgr* pAttribMgr,
+                    CTDDataMgr* pDataMgr,
+                    CTDPartitions* pLeafPartitions,
+                    CTDTestRouter* pRouter)
+{
+    cout << _T("Writing model...") << endl;
+    if (pRouter->getNumNodes() == 0) {
+        cerr << _T("CTDModel: No split decisions to write.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    // The leaf records are converted with the multidimensional concepts.
+    if (!pAttribMgr->buildMultiDimConcepts())
+        return false;
+
+    CString strings;
+    CArray<TDModelAttrib, const TDModelAttrib&> attribs;
+    CArray<TDModelDepth, const TDModelDepth&> depths;
+    CArray<TDModelValue, const TDModelValue&> values;
+    CArray<TDModelNode, const TDModelNode&> nodes;
+    CArray<TDModelLeaf, const TDModelLeaf&> leaves;
+    CTDIntArray counts;
+
+    // Attributes, with the concepts their raw values are matched to.
+    int nAttribs = pAttribMgr->getNumAttributes();
+    int classAttribIdx = nAttribs - 1;
+    for (int a = 0; a < nAttribs; ++a) {
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(a);
+        TDModelAttrib attrib;
+        memset(&attrib, 0, sizeof(attrib));
+        attrib.m_bContinuous = pAttrib->isContinuous() ? 1 : 0;
+        attrib.m_nameLen = pAttrib->m_attribName.GetLength();
+        attrib.m_nameOffset = addString(strings, pAttrib->m_attribName, attrib.m_nameLen);
+        attrib.m_firstDepth = depths.GetSize();
+        attrib.m_firstValue = values.GetSize();
+
+        if (!pAttrib->isContinuous()) {
+            TDModelDepth depth;
+            memset(&depth, 0, sizeof(depth));
+            for (int d = 0; d < pAttrib->getNumBitLevels(); ++d) {
+                depth.m_shift = pAttrib->getBitShift(d);
+                depth.m_mask = pAttrib->getBitMask(d);
+                depths.Add(depth);
+            }
+
+            TDModelValue value;
+            memset(&value, 0, sizeof(value));
+            CTDStringValue rawValue;
+            CTDConcepts* pFlattenConcepts = pAttrib->getFlattenConcepts();
+            for (int c = 0; c < pFlattenConcepts->GetSize(); ++c) {
+                CTDConcept* pConcept = pFlattenConcepts->GetAt(c);
+                if (a == classAttribIdx) {
+                    // The class of a value is its concept at level 1.
+                    if (pConcept->m_depth < 1)
+                        continue;
+                    CTDConcept* pClassConcept = pConcept;
+                    while (pClassConcept->m_depth > 1)
+                        pClassConcept = pClassConcept->getParentConcept();
+                    value.m_bitValue = TDBitValue(pClassConcept->m_childIdx);
+                }
+                else {
+                    if (!rawValue.buildBitValue(pConcept, pAttrib))
+                        return false;
+                    value.m_bitValue = rawValue.getBitValue();
+                }
+                value.m_strLen = pConcept->m_conceptValue.GetLength();
+                value.m_strOffset = addString(strings, pConcept->m_conceptValue, value.m_strLen);
+                values.Add(value);
+            }
+        }
+        attrib.m_nDepths = depths.GetSize() - attrib.m_firstDepth;
+        attrib.m_nValues = values.GetSize() - attrib.m_firstValue;
+        attribs.Add(attrib);
+    }
+
+    // Split decisions.
+    TDModelNode node;
+    memset(&node, 0, sizeof(node));
+    for (int n = 0; n < pRouter->getNumNodes(); ++n) {
+        const TDRouteNode& routeNode = pRouter->getNode(n);
+        node.m_splitAttribIdx = routeNode.m_splitAttribIdx;
+        node.m_splitDepth = routeNode.m_splitDepth;
+        node.m_firstChild = routeNode.m_firstChild;
+        node.m_nChildren = routeNode.m_nChildren;
+        node.m_leafIdx = routeNode.m_leafIdx;
+        node.m_lowerBound = node.m_upperBound = 0.0f;
+        if (routeNode.m_pLChildCon) {
+            CTDContConcept* pLConcept = static_cast<CTDContConcept*> (routeNode.m_pLChildCon);
+            node.m_lowerBound = pLConcept->m_lowerBound;
+            node.m_upperBound = pLConcept->m_upperBound;
+        }
+        nodes.Add(node);
+    }
+
+    // Leaves. The generalized record of class j is the j-th one; they only
+    // differ in the class.
+    int nClasses = pAttribMgr->getNumClasses();
+    TDModelLeaf leaf;
+    memset(&leaf, 0, sizeof(leaf));
+    CTDByteBuffer row(TD_OUTPUT_MIN_LINE_SIZE);
+    for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL;) {
+        CTDPartition* pPartition = pLeafPartitions->GetNext(pos);
+        CTDRecord* pGenRec = pPartition->getGenRecords()->GetAt(0);
+        pDataMgr->convertRecord(pGenRec, true, row);
+        leaf.m_c45Len = row.getSize();
+        leaf.m_c45Offset = addString(strings, row.getData(), leaf.m_c45Len);
+        pDataMgr->convertRecord(pGenRec, false, row);
+        leaf.m_svmLen = row.getSize();
+        leaf.m_svmOffset = addString(strings, row.getData(), leaf.m_svmLen);
+        leaves.Add(leaf);
+
+        for (int j = 0; j < nClasses; ++j)
+            counts.Add(j < pPartition->m_classNoisySums.GetSize() ? pPartition->m_classNoisySums[j] : 0);
+    }
+
+    try {
+        CFile file;
+        if (!file.Open(modelFile, CFile::modeCreate | CFile::modeWrite | CFile::typeBinary)) {
+            cerr << _T("CTDModel: Failed to open file ") << modelFile << endl;
+            return false;
+        }
+
+        TDModelHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.m_magic, TD_MODEL_MAGIC, sizeof(header.m_magic));
+        header.m_version = TD_MODEL_VERSION;
+        header.m_nAttribs = attribs.GetSize();
+        header.m_nDepths = depths.GetSize();
+        header.m_nValues = values.GetSize();
+        header.m_nNodes = nodes.GetSize();
+        header.m_nLeaves = leaves.GetSize();
+        header.m_nClasses = nClasses;
+        header.m_nStringChars = strings.GetLength();
+        file.Write(&header, sizeof(header));
+        __int64 nBytes = sizeof(header);
+
+        writePadding(file, nBytes);
+        header.m_attribOffset = nBytes;
+        file.Write(attribs.GetData(), UINT(attribs.GetSize() * sizeof(TDModelAttrib)));
+        nBytes += attribs.GetSize() * sizeof(TDModelAttrib);
+
+        writePadding(file, nBytes);
+        header.m_depthOffset = nBytes;
+        if (depths.GetSize() > 0)
+            file.Write(depths.GetData(), UINT(depths.GetSize() * sizeof(TDModelDepth)));
+        nBytes += depths.GetSize() * sizeof(TDModelDepth);
+
+        writePadding(file, nBytes);
+        header.m_valueOffset = nBytes;
+        if (values.GetSize() > 0)
+            file.Write(values.GetData(), UINT(values.GetSize() * sizeof(TDModelValue)));
+        nBytes += values.GetSize() * sizeof(TDModelValue);
+
+        writePadding(file, nBytes);
+        header.m_nodeOffset = nBytes;
+        file.Write(nodes.GetData(), UINT(nodes.GetSize() * sizeof(TDModelNode)));
+        nBytes += nodes.GetSize() * sizeof(TDModelNode);
+
+        writePadding(file, nBytes);
+        header.m_leafOffset = nBytes;
+        if (leaves.GetSize() > 0)
+            file.Write(leaves.GetData(), UINT(leaves.GetSize() * sizeof(TDModelLeaf)));
+        nBytes += leaves.GetSize() * sizeof(TDModelLeaf);
+
+        writePadding(file, nBytes);
+        header.m_countOffset = nBytes;
+        if (counts.GetSize() > 0)
+            file.Write(counts.GetData(), UINT(counts.GetSize() * sizeof(__int32)));
+        nBytes += counts.GetSize() * sizeof(__int32);
+
+        writePadding(file, nBytes);
+        header.m_stringOffset = nBytes;
+        if (strings.GetLength() > 0)
+            file.Write((LPCTSTR) strings, UINT(strings.GetLength() * sizeof(TCHAR)));
+        nBytes += strings.GetLength() * sizeof(TCHAR);
+
+        // Now that the offsets are known, rewrite the header.
+        file.SeekToBegin();
+        file.Write(&header, sizeof(header));
+        file.Close();
+        CTDProfiler::addCount(TD_COUNTER_BYTES_WRITTEN, nBytes);
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write model file: ") << modelFile << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    cout << _T("Writing model succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Read a model file in one piece and use its sections in place.
+//---------------------------------------------------------------------------
+bool CTDModel::load(LPCTSTR modelFile)
+{
+    cout << _T("Reading model...") << endl;
+    cleanup();
+
+    __int64 nBytes = 0;
+    try {
+        CFile file;
+        if (!file.Open(modelFile, CFile::modeRead | CFile::shareDenyWrite | CFile::typeBinary)) {
+            cerr << _T("CTDModel: Failed to open file ") << modelFile << endl;
+            return false;
+        }
+        nBytes = (__int64) file.GetLength();
+        if (nBytes < (__int64) sizeof(TDModelHeader) || nBytes > UINT_MAX) {
+            cerr << _T("CTDModel: Invalid model file ") << modelFile << endl;
+            return false;
+        }
+        m_pData = new BYTE[(size_t) nBytes];
+        if (file.Read(m_pData, UINT(nBytes)) != UINT(nBytes)) {
+            cerr << _T("CTDModel: Failed to read file ") << modelFile << endl;
+            cleanup();
+            return false;
+        }
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read model file: ") << modelFile << endl;
+        cleanup();
+        ASSERT(false);
+        return false;
+    }
+
+    if (!checkModel(nBytes)) {
+        cerr << _T("CTDModel: Invalid model file ") << modelFile << endl;
+        cleanup();
+        return false;
+    }
+    if (!buildValueMaps()) {
+        cleanup();
+        return false;
+    }
+
+    cout << _T("Number of split nodes: ") << m_pHeader->m_nNodes << endl;
+    cout << _T("Number of leaves: ") << m_pHeader->m_nLeaves << endl;
+    cout << _T("Reading model succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Locate the sections and check every index once, so that routing a record
+// only has to check the child index taken from the record.
+//---------------------------------------------------------------------------
+bool CTDModel::checkModel(__int64 nBytes)
+{
+    const TDModelHeader* pHeader = (const TDModelHeader*) m_pData;
+    if (memcmp(pHeader->m_magic, TD_MODEL_MAGIC, sizeof(pHeader->m_magic)) != 0 || pHeader->m_version != TD_MODEL_VERSION)
+        return false;
+    if (pHeader->m_nAttribs < 1 || pHeader->m_nAttribs > TD_APPLY_MAX_ATTRIBS || pHeader->m_nNodes < 1 ||
+        pHeader->m_nDepths < 0 || pHeader->m_nValues < 0 || pHeader->m_nLeaves < 0 || pHeader->m_nClasses < 1 ||
+        pHeader->m_nStringChars < 0 || pHeader->m_nStringChars > INT_MAX)
+        return false;
+
+    __int64 offsets[] = { pHeader->m_attribOffset, pHeader->m_depthOffset, pHeader->m_valueOffset, pHeader->m_nodeOffset,
+                          pHeader->m_leafOffset, pHeader->m_countOffset, pHeader->m_stringOffset };
+    __int64 sizes[] = { pHeader->m_nAttribs * (__int64) sizeof(TDModelAttrib),
+                        pHeader->m_nDepths * (__int64) sizeof(TDModelDepth),
+                        pHeader->m_nValues * (__int64) sizeof(TDModelValue),
+                        pHeader->m_nNodes * (__int64) sizeof(TDModelNode),
+                        pHeader->m_nLeaves * (__int64) sizeof(TDModelLeaf),
+                        (__int64) pHeader->m_nLeaves * pHeader->m_nClasses * (__int64) sizeof(__int32),
+                        pHeader->m_nStringChars * (__int64) sizeof(TCHAR) };
+    int nOffsets = int(sizeof(offsets) / sizeof(offsets[0]));
+    for (int s = 0; s < nOffsets; ++s) {
+        if (offsets[s] < (__int64) sizeof(TDModelHeader) || offsets[s] % 8 != 0 || offsets[s] + sizes[s] > nBytes)
+            return false;
+    }
+
+    m_pHeader = pHeader;
+    m_pAttribs = (const TDModelAttrib*) (m_pData + pHeader->m_attribOffset);
+    m_pDepths = (const TDModelDepth*) (m_pData + pHeader->m_depthOffset);
+    m_pValues = (const TDModelValue*) (m_pData + pHeader->m_valueOffset);
+    m_pNodes = (const TDModelNode*) (m_pData + pHeader->m_nodeOffset);
+    m_pLeaves = (const TDModelLeaf*) (m_pData + pHeader->m_leafOffset);
+    m_pCounts = (const __int32*) (m_pData + pHeader->m_countOffset);
+    m_pStrings = (LPCTSTR) (m_pData + pHeader->m_stringOffset);
+
+    __int64 nStringChars = pHeader->m_nStringChars;
+    for (int a = 0; a < pHeader->m_nAttribs; ++a) {
+        const TDModelAttrib& attrib = m_pAttribs[a];
+        if (attrib.m_firstDepth < 0 || attrib.m_nDepths < 0 || attrib.m_firstDepth + attrib.m_nDepths > pHeader->m_nDepths ||
+            attrib.m_firstValue < 0 || attrib.m_nValues < 0 || attrib.m_firstValue + attrib.m_nValues > pHeader->m_nValues ||
+            attrib.m_nameOffset < 0 || attrib.m_nameLen < 0 || attrib.m_nameOffset + attrib.m_nameLen > nStringChars)
+            return false;
+    }
+    if (m_pAttribs[pHeader->m_nAttribs - 1].m_bContinuous)
+        return false;
+    for (int d = 0; d < pHeader->m_nDepths; ++d) {
+        if (m_pDepths[d].m_shift < 0 || m_pDepths[d].m_shift >= TD_BITVALUE_NUMBITS)
+            return false;
+    }
+    for (int v = 0; v < pHeader->m_nValues; ++v) {
+        if (m_pValues[v].m_strOffset < 0 || m_pValues[v].m_strLen < 0 || m_pValues[v].m_strOffset + m_pValues[v].m_strLen > nStringChars)
+            return false;
+    }
+    const TDModelAttrib& classAttrib = m_pAttribs[pHeader->m_nAttribs - 1];
+    for (int v = classAttrib.m_firstValue; v < classAttrib.m_firstValue + classAttrib.m_nValues; ++v) {
+        if (m_pValues[v].m_bitValue >= TDBitValue(pHeader->m_nClasses))
+            return false;
+    }
+    for (int n = 0; n < pHeader->m_nNodes; ++n) {
+        const TDModelNode& node = m_pNodes[n];
+        if (node.m_splitAttribIdx < 0) {
+            if (node.m_leafIdx < 0 || node.m_leafIdx >= pHeader->m_nLeaves)
+                return false;
+            continue;
+        }
+        if (node.m_splitAttribIdx >= pHeader->m_nAttribs - 1 || node.m_firstChild <= n || node.m_nChildren < 1 ||
+            node.m_firstChild + node.m_nChildren > pHeader->m_nNodes)
+            return false;
+        if (m_pAttribs[node.m_splitAttribIdx].m_bContinuous) {
+            if (node.m_nChildren != 2)
+                return false;
+        }
+        else if (node.m_splitDepth < 0 || node.m_splitDepth >= m_pAttribs[node.m_splitAttribIdx].m_nDepths)
+            return false;
+    }
+    for (int l = 0; l < pHeader->m_nLeaves; ++l) {
+        const TDModelLeaf& leaf = m_pLeaves[l];
+        if (leaf.m_c45Offset < 0 || leaf.m_c45Len < 0 || leaf.m_c45Offset + leaf.m_c45Len > nStringChars ||
+            leaf.m_svmOffset < 0 || leaf.m_svmLen < 0 || leaf.m_svmOffset + leaf.m_svmLen > nStringChars)
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Raw values are matched case-insensitively. If several concepts have the
+// same value, the last one is taken, as in CTDStringValue::matchRawConcept.
+//---------------------------------------------------------------------------
+bool CTDModel::buildValueMaps()
+{
+    int nAttribs = m_pHeader->m_nAttribs;
+    int classAttribIdx = nAttribs - 1;
+    CString key;
+    for (int a = 0; a < nAttribs; ++a) {
+        const TDModelAttrib& attrib = m_pAttribs[a];
+        if (attrib.m_bContinuous) {
+            m_valueMaps.Add(NULL);
+            continue;
+        }
+
+        CMapStringToPtr* pValueMap = new CMapStringToPtr();
+        m_valueMaps.Add(pValueMap);
+        pValueMap->InitHashTable(UINT(attrib.m_nValues * 2 + 17));
+        for (int v = attrib.m_firstValue; v < attrib.m_firstValue + attrib.m_nValues; ++v) {
+            key = CString(m_pStrings + m_pValues[v].m_strOffset, m_pValues[v].m_strLen);
+            key.MakeLower();
+            pValueMap->SetAt(key, (void*) INT_PTR(v));
+
+            if (a == classAttribIdx) {
+                key = CString(m_pStrings + m_pValues[v].m_strOffset, m_pValues[v].m_strLen);
+                m_svmClassLabels.Add(key == ">50K" ? _T("+1 ") : _T("-1 "));
+            }
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Generalize one line of a record file. leafIdx is -1 if the line holds no
+// record, or if the record is discarded for an unknown value.
+//---------------------------------------------------------------------------
+bool CTDModel::applyRecord(LPCTSTR pLine, int lineLen, int& leafIdx, int& classValueIdx, bool& bDiscarded) const
+{
+    leafIdx = -1;
+    classValueIdx = -1;
+    bDiscarded = false;
+
+    // Remove comments
+    LPCTSTR pCur = pLine;
+    LPCTSTR pEnd = pLine + lineLen;
+    for (LPCTSTR p = pCur; p < pEnd; ++p) {
+        if (*p == TD_CONHCHY_COMMENT) {
+            pEnd = p;
+            break;
+        }
+    }
+    trimRange(pCur, pEnd);
+    if (pCur == pEnd)
+        return true;
+
+    // Remove period at the end of the line
+    if (*(pEnd - 1) == TD_RAWDATA_TERMINATOR) {
+        --pEnd;
+        trimRange(pCur, pEnd);
+        if (pCur == pEnd)
+            return true;
+    }
+
+    int nAttribs = m_pHeader->m_nAttribs;
+    int classAttribIdx = nAttribs - 1;
+    TDBitValue bitValues[TD_APPLY_MAX_ATTRIBS];
+    float numValues[TD_APPLY_MAX_ATTRIBS];
+    TCHAR valueStr[TD_APPLY_MAX_VALUE_LEN + 1];
+    int attribIdx = 0;
+    for (LPCTSTR pValue = pCur; ; ++pValue) {
+        LPCTSTR pValueEnd = pValue;
+        while (pValueEnd < pEnd && *pValueEnd != TD_RAWDATA_DELIMETER)
+            ++pValueEnd;
+        LPCTSTR pNext = pValueEnd;
+
+        // Check unknown value
+        trimRange(pValue, pValueEnd);
+        int valueLen = int(pValueEnd - pValue);
+        if (valueLen == 0) {
+            cerr << _T("CTDModel: Empty value string in record: ") << CString(pLine, lineLen) << endl;
+            return false;
+        }
+        if (valueLen == 1 && *pValue == TD_UNKNOWN_VALUE) {
+            // Discard this record
+            bDiscarded = true;
+            return true;
+        }
+        if (attribIdx >= nAttribs || valueLen > TD_APPLY_MAX_VALUE_LEN) {
+            cerr << _T("CTDModel: Invalid record: ") << CString(pLine, lineLen) << endl;
+            return false;
+        }
+        memcpy(valueStr, pValue, valueLen * sizeof(TCHAR));
+        valueStr[valueLen] = 0;
+
+        if (m_pAttribs[attribIdx].m_bContinuous)
+            numValues[attribIdx] = (float) StrToFloat(valueStr);
+        else {
+            void* pValueIdx = NULL;
+            _tcslwr_s(valueStr, valueLen + 1);
+            if (!m_valueMaps.GetAt(attribIdx)->Lookup(valueStr, pValueIdx)) {
+                cerr << _T("CTDModel: Failed to match concept path: ") << CString(pValue, valueLen)
+                     << _T(" in attribute ") << CString(m_pStrings + m_pAttribs[attribIdx].m_nameOffset, m_pAttribs[attribIdx].m_nameLen) << endl;
+                return false;
+            }
+            int valueIdx = int(INT_PTR(pValueIdx));
+            bitValues[attribIdx] = m_pValues[valueIdx].m_bitValue;
+            if (attribIdx == classAttribIdx)
+                classValueIdx = valueIdx;
+        }
+
+        ++attribIdx;
+        if (pNext == pEnd)
+            break;
+        pValue = pNext;
+    }
+
+    if (attribIdx != nAttribs) {
+        cerr << _T("CTDModel: Invalid record: ") << CString(pLine, lineLen) << endl;
+        return false;
+    }
+    return routeRecord(bitValues, numValues, leafIdx);
+}
+
+//---------------------------------------------------------------------------
+// Follow the split decisions from the root, as CTDTestRouter::routeRecord.
+//---------------------------------------------------------------------------
+bool CTDModel::routeRecord(const TDBitValue* pBitValues, const float* pNumValues, int& leafIdx) const
+{
+    const TDModelNode* pNode = m_pNodes;
+    while (pNode->m_splitAttribIdx >= 0) {
+        int attribIdx = pNode->m_splitAttribIdx;
+        const TDModelAttrib& attrib = m_pAttribs[attribIdx];
+        int childIdx = 0;
+        if (attrib.m_bContinuous) {
+            float numValue = pNumValues[attribIdx];
+            childIdx = (numValue >= pNode->m_lowerBound && numValue < pNode->m_upperBound) ? 0 : 1;
+        }
+        else {
+            // Shift the bits of this level to the end and mask out the deeper levels.
+            const TDModelDepth& depth = m_pDepths[attrib.m_firstDepth + pNode->m_splitDepth];
+            childIdx = int((pBitValues[attribIdx] >> depth.m_shift) & depth.m_mask);
+        }
+
+        if (childIdx >= pNode->m_nChildren) {
+            cerr << _T("CTDModel: Record routed to an invalid child: ") << childIdx << endl;
+            ASSERT(false);
+            return false;
+        }
+        pNode = m_pNodes + pNode->m_firstChild + childIdx;
+    }
+    leafIdx = pNode->m_leafIdx;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Generalize the records of recordFile, in the format of the training data,
+// to outputFile in the multidimensional C4.5 or SVM format.
+//---------------------------------------------------------------------------
+bool CTDModel::apply(LPCTSTR recordFile, LPCTSTR outputFile, bool isC45)
+{
+    cout << _T("Generalizing records...") << endl;
+    if (!m_pHeader) {
+        cerr << _T("CTDModel: No model is loaded.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    m_bApplyC45 = isC45;
+    m_nApplied = 0;
+    m_nDiscarded = 0;
+    try {
+        CFile recFile;
+        if (!recFile.Open(recordFile, CFile::modeRead | CFile::shareDenyWrite | CFile::typeBinary)) {
+            cerr << _T("CTDModel: Failed to open file ") << recordFile << endl;
+            return false;
+        }
+        CStdioFile outFile;
+        if (!outFile.Open(outputFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDModel: Failed to open file ") << outputFile << endl;
+            return false;
+        }
+        CFile* pFiles[] = { &outFile, NULL };
+
+        CArray<TCHAR, TCHAR> window;
+        window.SetSize(TD_APPLY_WINDOW_SIZE);
+        TCHAR* pWindow = window.GetData();
+        CTDOutputWriter writer(TD_OUTPUT_NUM_THREADS);
+        int nCarried = 0;
+        bool bEndOfFile = false;
+        while (!bEndOfFile) {
+            UINT nRead = recFile.Read(pWindow + nCarried, UINT((TD_APPLY_WINDOW_SIZE - nCarried) * sizeof(TCHAR)));
+            int nChars = nCarried + int(nRead / sizeof(TCHAR));
+            bEndOfFile = (nChars < TD_APPLY_WINDOW_SIZE);
+
+            // Only whole lines are generalized; the rest is carried to the next window.
+            int nLineChars = nChars;
+            if (!bEndOfFile) {
+                while (nLineChars > 0 && pWindow[nLineChars - 1] != TCHAR('\n'))
+                    --nLineChars;
+                if (nLineChars == 0) {
+                    cerr << _T("CTDModel: Record longer than ") << TD_APPLY_WINDOW_SIZE << _T(" characters in file ") << recordFile << endl;
+                    return false;
+                }
+            }
+
+            m_pWindow = pWindow;
+            m_blockStarts.RemoveAll();
+            for (int start = 0; start < nLineChars;) {
+                m_blockStarts.Add(start);
+                start += TD_APPLY_BLOCK_SIZE;
+                if (start >= nLineChars)
+                    start = nLineChars;
+                else {
+                    while (start < nLineChars && pWindow[start - 1] != TCHAR('\n'))
+                        ++start;
+                }
+            }
+            m_blockStarts.Add(nLineChars);
+            if (!writer.write(m_blockStarts.GetSize() - 1, this, pFiles, 1))
+                return false;
+
+            nCarried = nChars - nLineChars;
+            memmove(pWindow, pWindow + nLineChars, nCarried * sizeof(TCHAR));
+        }
+        m_pWindow = NULL;
+        outFile.Close();
+        recFile.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to generalize records: ") << recordFile << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    cout << _T("Number of generalized records: ") << m_nApplied << endl;
+    cout << _T("Number of discarded records: ") << m_nDiscarded << endl;
+    cout << _T("Generalizing records succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Generalize one block of lines of the current window.
+//---------------------------------------------------------------------------
+bool CTDModel::serializeItem(int itemIdx, CTDByteBuffer* pBuffers)
+{
+    int nApplied = 0, nDiscarded = 0;
+    if (!serializeBlock(m_pWindow + m_blockStarts[itemIdx], m_pWindow + m_blockStarts[itemIdx + 1], pBuffers[0], nApplied, nDiscarded))
+        return false;
+
+    InterlockedExchangeAdd(&m_nApplied, nApplied);
+    InterlockedExchangeAdd(&m_nDiscarded, nDiscarded);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Write each record as the generalized record of its leaf, as
+// CTDDataMgr::serializeMultiDimTestLeaf.
+//---------------------------------------------------------------------------
+bool CTDModel::serializeBlock(LPCTSTR pBegin, LPCTSTR pEnd, CTDByteBuffer& buffer, int& nApplied, int& nDiscarded)
+{
+    int classFirstValue = m_pAttribs[m_pHeader->m_nAttribs - 1].m_firstValue;
+    int leafIdx = -1, classValueIdx = -1;
+    bool bDiscarded = false;
+    for (LPCTSTR pLine = pBegin; pLine < pEnd;) {
+        LPCTSTR pLineEnd = pLine;
+        while (pLineEnd < pEnd && *pLineEnd != TCHAR('\n'))
+            ++pLineEnd;
+
+        if (!applyRecord(pLine, int(pLineEnd - pLine), leafIdx, classValueIdx, bDiscarded))
+            return false;
+        pLine = pLineEnd + 1;
+
+        if (bDiscarded)
+            ++nDiscarded;
+        if (leafIdx < 0)
+            continue;
+        ++nApplied;
+
+        const TDModelLeaf& leaf = m_pLeaves[leafIdx];
+        const TDModelValue& classValue = m_pValues[classValueIdx];
+        if (!m_bApplyC45) {
+            buffer.append(m_svmClassLabels[classValueIdx - classFirstValue]);
+            buffer.append(m_pStrings + leaf.m_svmOffset, leaf.m_svmLen);
+        }
+        else {
+#if TD_DATA_OUTPUT == TD_OUTPUT_WEIGHTED
+            // Weight of 1, as the test records of CTDDataMgr.
+            buffer.appendInt(1);
+            buffer.append(TD_RAWDATA_DELIMETER);
+#endif
+            buffer.append(m_pStrings + leaf.m_c45Offset, leaf.m_c45Len);
+            buffer.append(m_pStrings + classValue.m_strOffset, classValue.m_strLen);
+            buffer.append(TD_RAWDATA_TERMINATOR);
+        }
+        buffer.append(TCHAR('\n'));
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDModel::trimRange(LPCTSTR& pBegin, LPCTSTR& pEnd)
+{
+    while (pBegin < pEnd && _istspace((_TUCHAR) *pBegin))
+        ++pBegin;
+    while (pEnd > pBegin && _istspace((_TUCHAR) *(pEnd - 1)))
+        --pEnd;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDModel::writePadding(CFile& file, __int64& nBytes)
+{
+    static const char zeros[8] = { 0 };
+    int nPadding = int((8 - nBytes % 8) % 8);
+    if (nPadding > 0) {
+        file.Write(zeros, nPadding);
+        nBytes += nPadding;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Append str to the string section. Returns its offset.
+//---------------------------------------------------------------------------
+// static
+int CTDModel::addString(CString& strings, LPCTSTR str, int len)
+{
+    int offset = strings.GetLength();
+    strings.Append(str, len);
+    return offset;
+}
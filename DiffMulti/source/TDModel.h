@@ -0,0 +1,161 @@
+// TDModel.h: interface for the CTDModel class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDMODEL_H)
+#define TDMODEL_H
+
+#if !defined(TDDATAMGR_H)
+    #include "TDDataMgr.h"
+#endif
+
+//---------------------------------------------------------------------------
+// Header of a model file: the split decisions of a run and its noisy leaf
+// partitions. All sections are little-endian, start at 8-byte aligned
+// offsets from the beginning of the file and hold no pointers, so the file
+// can be used in place once it is in memory.
+// Attributes: TDModelAttrib[nAttribs], in input order; the class is last.
+// Depths: TDModelDepth[nDepths], bit shift and mask of each level of the
+//     categorical attributes, see CTDAttrib::calBits.
+// Values: TDModelValue[nValues], the concepts a raw categorical value or
+//     class value is matched to.
+// Nodes: TDModelNode[nNodes], root is node 0, see TDRouteNode.
+// Leaves: TDModelLeaf[nLeaves], in the order of the leaf partitions.
+// Counts: __int32[nLeaves * nClasses], noisy count of each leaf and class.
+// Strings: TCHAR[nStringChars], not terminated.
+//---------------------------------------------------------------------------
+#define TD_MODEL_MAGIC                      "TDMODEL\0"
+#define TD_MODEL_VERSION                    1
+
+struct TDModelHeader
+{
+    char    m_magic[8];
+    __int32 m_version;
+    __int32 m_nAttribs;
+    __int32 m_nDepths;
+    __int32 m_nValues;
+    __int32 m_nNodes;
+    __int32 m_nLeaves;
+    __int32 m_nClasses;
+    __int32 m_reserved;
+    __int64 m_attribOffset;
+    __int64 m_depthOffset;
+    __int64 m_valueOffset;
+    __int64 m_nodeOffset;
+    __int64 m_leafOffset;
+    __int64 m_countOffset;
+    __int64 m_stringOffset;
+    __int64 m_nStringChars;
+};
+
+struct TDModelAttrib
+{
+    __int32 m_bContinuous;
+    __int32 m_firstDepth;
+    __int32 m_nDepths;
+    __int32 m_firstValue;
+    __int32 m_nValues;
+    __int32 m_nameOffset;
+    __int32 m_nameLen;
+    __int32 m_reserved;
+};
+
+struct TDModelDepth
+{
+    TDBitValue m_mask;
+    __int32    m_shift;
+    __int32    m_reserved;
+};
+
+struct TDModelValue
+{
+    TDBitValue m_bitValue;      // Packed path of the concept; the class index for the class attribute.
+    __int32    m_strOffset;
+    __int32    m_strLen;
+};
+
+struct TDModelNode
+{
+    __int32 m_splitAttribIdx;   // -1 for a leaf.
+    __int32 m_splitDepth;       // Categorical split only.
+    __int32 m_firstChild;
+    __int32 m_nChildren;
+    __int32 m_leafIdx;          // Leaf only.
+    float   m_lowerBound;       // Inclusive. Left child of a continuous split; the right child is 1.
+    float   m_upperBound;       // Exclusive.
+    __int32 m_reserved;
+};
+
+struct TDModelLeaf
+{
+    __int32 m_c45Offset;        // Generalized record in the C4.5 format, without the class.
+    __int32 m_c45Len;
+    __int32 m_svmOffset;        // Generalized record in the SVM format, without the class.
+    __int32 m_svmLen;
+};
+
+typedef CTypedPtrArray<CPtrArray, CMapStringToPtr*> CTDValueMapArray;
+
+//---------------------------------------------------------------------------
+// Generalizes new records with the split decisions of an earlier run,
+// without the training records or the hierarchy file. Records are routed
+// from the root to a leaf and written as the generalized record of the leaf
+// in the multidimensional C4.5 or SVM format, as the test file of the run.
+// The records are read in windows; the output writer generalizes blocks of
+// lines of a window on all processors.
+//---------------------------------------------------------------------------
+class CTDModel : public CTDOutputSerializer
+{
+public:
+    CTDModel();
+    virtual ~CTDModel();
+
+// Operations
+    static bool save(LPCTSTR modelFile,
+                     CTDAttribMgr* pAttribMgr,
+                     CTDDataMgr* pDataMgr,
+                     CTDPartitions* pLeafPartitions,
+                     CTDTestRouter* pRouter);
+    bool load(LPCTSTR modelFile);
+    bool apply(LPCTSTR recordFile, LPCTSTR outputFile, bool isC45);
+    bool applyRecord(LPCTSTR pLine, int lineLen, int& leafIdx, int& classValueIdx, bool& bDiscarded) const;
+    virtual bool serializeItem(int itemIdx, CTDByteBuffer* pBuffers);
+
+    int getNumLeaves() const { return m_pHeader ? m_pHeader->m_nLeaves : 0; };
+    int getNumClasses() const { return m_pHeader ? m_pHeader->m_nClasses : 0; };
+    int getLeafCount(int leafIdx, int classIdx) const { return m_pCounts[leafIdx * m_pHeader->m_nClasses + classIdx]; };
+    int getClassIdx(int classValueIdx) const { return (int) m_pValues[classValueIdx].m_bitValue; };
+    LPCTSTR getString(int offset) const { return m_pStrings + offset; };
+
+protected:
+    void cleanup();
+    bool checkModel(__int64 nBytes);
+    bool buildValueMaps();
+    bool routeRecord(const TDBitValue* pBitValues, const float* pNumValues, int& leafIdx) const;
+    bool serializeBlock(LPCTSTR pBegin, LPCTSTR pEnd, CTDByteBuffer& buffer, int& nApplied, int& nDiscarded);
+    static void trimRange(LPCTSTR& pBegin, LPCTSTR& pEnd);
+    static void writePadding(CFile& file, __int64& nBytes);
+    static int addString(CString& strings, LPCTSTR str, int len);
+
+// Attributes
+    BYTE*                   m_pData;            // The whole model file.
+    const TDModelHeader*    m_pHeader;
+    const TDModelAttrib*    m_pAttribs;
+    const TDModelDepth*     m_pDepths;
+    const TDModelValue*     m_pValues;
+    const TDModelNode*      m_pNodes;
+    const TDModelLeaf*      m_pLeaves;
+    const __int32*          m_pCounts;
+    LPCTSTR                 m_pStrings;
+    CTDValueMapArray        m_valueMaps;        // Lowercase value to value index, per categorical attribute and the class.
+    CStringArray            m_svmClassLabels;   // SVM label of each class value.
+
+    // State of the window being generalized.
+    bool                    m_bApplyC45;
+    LPCTSTR                 m_pWindow;
+    CTDIntArray             m_blockStarts;      // Block b is [m_blockStarts[b], m_blockStarts[b + 1]) of the window.
+    volatile LONG           m_nApplied;
+    volatile LONG           m_nDiscarded;
+};
+
+#endif
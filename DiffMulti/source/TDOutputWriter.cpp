@@ -0,0 +1,296 @@
+// TDOutputWriter.cpp: implementation of the CTDOutputWriter class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+//*************
+// CTDByteBuffer
+//*************
+
+CTDByteBuffer::CTDByteBuffer(int minCapacity)
+    : m_pData(NULL), m_size(0), m_capacity(0), m_minCapacity(minCapacity)
+{
+}
+
+CTDByteBuffer::~CTDByteBuffer()
+{
+    delete [] m_pData;
+    m_pData = NULL;
+}
+
+//---------------------------------------------------------------------------
+// Make room for nChars more characters. Capacity grows geometrically.
+//---------------------------------------------------------------------------
+void CTDByteBuffer::reserve(int nChars)
+{
+    if (m_size + nChars <= m_capacity)
+        return;
+
+    int newCapacity = max(m_capacity * 2, m_minCapacity);
+    while (newCapacity < m_size + nChars)
+        newCapacity *= 2;
+
+    TCHAR* pNewData = new TCHAR[newCapacity];
+    if (m_size > 0)
+        memcpy(pNewData, m_pData, m_size * sizeof(TCHAR));
+    delete [] m_pData;
+    m_pData = pNewData;
+    m_capacity = newCapacity;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDByteBuffer::append(LPCTSTR str, int len)
+{
+    reserve(len);
+    memcpy(m_pData + m_size, str, len * sizeof(TCHAR));
+    m_size += len;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDByteBuffer::appendInt(int value)
+{
+    TCHAR numStr[16];
+    int len = _stprintf_s(numStr, _T("%d"), value);
+    append(numStr, len);
+}
+
+//---------------------------------------------------------------------------
+// Same format as CTDContConcept::FloatToStr.
+//---------------------------------------------------------------------------
+void CTDByteBuffer::appendFloat(double value, int nDecimals)
+{
+    TCHAR numStr[100];
+    int len = _stprintf_s(numStr, _T("%.*f"), nDecimals, value);
+    append(numStr, len);
+}
+
+//---------------------------------------------------------------------------
+// Append str nTimes. The first copy is appended as usual; the others are
+// replicated from the buffer itself, doubling the copied block each time.
+//---------------------------------------------------------------------------
+void CTDByteBuffer::appendRepeated(LPCTSTR str, int len, int nTimes)
+{
+    if (nTimes <= 0 || len <= 0)
+        return;
+
+    reserve(len * nTimes);
+    TCHAR* pStart = m_pData + m_size;
+    memcpy(pStart, str, len * sizeof(TCHAR));
+    int nCopied = len;
+    int nTotal = len * nTimes;
+    while (nCopied < nTotal) {
+        int nChunk = min(nCopied, nTotal - nCopied);
+        memcpy(pStart + nCopied, pStart, nChunk * sizeof(TCHAR));
+        nCopied += nChunk;
+    }
+    m_size += nTotal;
+}
+
+
+//*************
+// CTDOutputWriter
+//*************
+
+CTDOutputWriter::CTDOutputWriter(int nThreads)
+    : m_nThreads(nThreads),
+      m_nItems(0),
+      m_pSerializer(NULL),
+      m_nFiles(0),
+      m_nChunks(0),
+      m_nextChunk(0),
+      m_bAbort(FALSE),
+      m_pFreeBuffers(NULL),
+      m_pChunks(NULL)
+{
+    if (m_nThreads <= 0) {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        m_nThreads = max(int(sysInfo.dwNumberOfProcessors), 1);
+    }
+    m_nBuffers = m_nThreads * 2;
+}
+
+CTDOutputWriter::~CTDOutputWriter()
+{
+    delete m_pFreeBuffers;
+    m_pFreeBuffers = NULL;
+    delete [] m_pChunks;
+    m_pChunks = NULL;
+}
+
+//---------------------------------------------------------------------------
+// Serialize items 0..nItems-1 with the worker threads and write them to
+// the files in item order.
+//---------------------------------------------------------------------------
+bool CTDOutputWriter::write(int nItems, CTDOutputSerializer* pSerializer, CFile** pFiles, int nFiles)
+{
+    if (nFiles <= 0 || nFiles > TD_OUTPUT_MAX_FILES || nItems < 0) {
+        ASSERT(false);
+        return false;
+    }
+
+    m_nItems = nItems;
+    m_pSerializer = pSerializer;
+    m_nFiles = nFiles;
+    m_nChunks = (m_nItems + TD_OUTPUT_CHUNK_PARTITIONS - 1) / TD_OUTPUT_CHUNK_PARTITIONS;
+    m_nextChunk = 0;
+    m_bAbort = FALSE;
+    if (m_nChunks == 0)
+        return true;
+
+    delete m_pFreeBuffers;
+    m_pFreeBuffers = new CSemaphore(m_nBuffers, m_nBuffers);
+    delete [] m_pChunks;
+    m_pChunks = new CTDOutputChunk[m_nBuffers];
+
+    int nThreads = min(m_nThreads, m_nChunks);
+    CWinThread** pThreads = new CWinThread*[nThreads];
+    for (int t = 0; t < nThreads; ++t) {
+        pThreads[t] = AfxBeginThread(workerThreadProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+        pThreads[t]->m_bAutoDelete = FALSE;
+        pThreads[t]->ResumeThread();
+    }
+
+    // Write the chunks in order as they become ready. The bytes written are
+    // taken from the file positions, which include the carriage returns
+    // added by text mode files.
+    ULONGLONG startPos[TD_OUTPUT_MAX_FILES];
+    bool bSucceeded = true;
+    try {
+        for (int f = 0; f < m_nFiles; ++f)
+            startPos[f] = pFiles[f]->GetPosition();
+        for (int c = 0; c < m_nChunks; ++c) {
+            CTDOutputChunk* pChunk = &m_pChunks[c % m_nBuffers];
+            ::WaitForSingleObject(pChunk->m_readyEvent.m_hObject, INFINITE);
+            pChunk->m_readyEvent.ResetEvent();
+            if (!pChunk->m_bSucceeded) {
+                bSucceeded = false;
+                break;
+            }
+
+            for (int f = 0; f < m_nFiles; ++f) {
+                CTDByteBuffer& buffer = pChunk->m_buffers[f];
+                if (buffer.getSize() > 0)
+                    pFiles[f]->Write(buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+                buffer.reset();
+            }
+            m_pFreeBuffers->Unlock(1);
+        }
+        for (int f = 0; f < m_nFiles; ++f)
+            CTDProfiler::addCount(TD_COUNTER_BYTES_WRITTEN, LONGLONG(pFiles[f]->GetPosition() - startPos[f]));
+    }
+    catch (CFileException&) {
+        stopWorkers(pThreads, nThreads, true);
+        delete [] pThreads;
+        throw;
+    }
+
+    stopWorkers(pThreads, nThreads, !bSucceeded);
+    delete [] pThreads;
+    return bSucceeded;
+}
+
+//---------------------------------------------------------------------------
+// Write a string that is not serialized by write, e.g., a header line, and
+// count it in TD_COUNTER_BYTES_WRITTEN like the chunks.
+//---------------------------------------------------------------------------
+// static
+void CTDOutputWriter::writeString(CStdioFile& file, const CString& str)
+{
+    ULONGLONG startPos = file.GetPosition();
+    file.WriteString(str);
+    CTDProfiler::addCount(TD_COUNTER_BYTES_WRITTEN, LONGLONG(file.GetPosition() - startPos));
+}
+
+//---------------------------------------------------------------------------
+// Write a buffer that is not serialized by write and count it.
+//---------------------------------------------------------------------------
+// static
+void CTDOutputWriter::writeBytes(CFile& file, const void* pData, UINT nBytes)
+{
+    file.Write(pData, nBytes);
+    CTDProfiler::addCount(TD_COUNTER_BYTES_WRITTEN, nBytes);
+}
+
+//---------------------------------------------------------------------------
+// Wait for the worker threads to finish. If the writing stopped early,
+// release the blocked workers first.
+//---------------------------------------------------------------------------
+void CTDOutputWriter::stopWorkers(CWinThread** pThreads, int nThreads, bool bAbort)
+{
+    if (bAbort) {
+        InterlockedExchange(&m_bAbort, TRUE);
+        m_pFreeBuffers->Unlock(nThreads);
+    }
+
+    for (int t = 0; t < nThreads; ++t) {
+        ::WaitForSingleObject(pThreads[t]->m_hThread, INFINITE);
+        delete pThreads[t];
+        pThreads[t] = NULL;
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+UINT AFX_CDECL CTDOutputWriter::workerThreadProc(LPVOID pParam)
+{
+    static_cast<CTDOutputWriter*>(pParam)->runWorker();
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Claim the next chunk once a slot is free, serialize it and signal the
+// writer. Chunks are claimed in order, so the claimed but unwritten chunks
+// always fit in the ring of slots.
+//---------------------------------------------------------------------------
+void CTDOutputWriter::runWorker()
+{
+    while (true) {
+        m_pFreeBuffers->Lock();
+        int chunkIdx = InterlockedIncrement(&m_nextChunk) - 1;
+        if (m_bAbort || chunkIdx >= m_nChunks)
+            return;
+
+        // The slot may be reused as soon as it is signaled, so keep the result.
+        CTDOutputChunk* pChunk = &m_pChunks[chunkIdx % m_nBuffers];
+        bool bSucceeded = serializeChunk(chunkIdx, pChunk);
+        pChunk->m_bSucceeded = bSucceeded;
+        pChunk->m_readyEvent.SetEvent();
+        if (!bSucceeded)
+            return;
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDOutputWriter::serializeChunk(int chunkIdx, CTDOutputChunk* pChunk)
+{
+    try {
+        int first = chunkIdx * TD_OUTPUT_CHUNK_PARTITIONS;
+        int last = min(first + TD_OUTPUT_CHUNK_PARTITIONS, m_nItems);
+        for (int i = first; i < last; ++i) {
+            if (m_bAbort)
+                return false;
+            if (!m_pSerializer->serializeItem(i, pChunk->m_buffers))
+                return false;
+        }
+        return true;
+    }
+    catch (CMemoryException&) {
+        cerr << _T("CTDOutputWriter: Failed to allocate output buffer.") << endl;
+        ASSERT(false);
+        return false;
+    }
+}
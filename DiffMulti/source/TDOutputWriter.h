@@ -0,0 +1,96 @@
+// TDOutputWriter.h: interface for the CTDOutputWriter class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDOUTPUTWRITER_H)
+#define TDOUTPUTWRITER_H
+
+#define TD_OUTPUT_MAX_FILES                 2   // Output files written per item, e.g., data and weight files.
+
+//---------------------------------------------------------------------------
+// Growable byte buffer holding serialized output lines.
+//---------------------------------------------------------------------------
+class CTDByteBuffer
+{
+public:
+    CTDByteBuffer(int minCapacity = TD_OUTPUT_MIN_BUFFER_SIZE);
+    virtual ~CTDByteBuffer();
+
+    void append(LPCTSTR str, int len);
+    void append(const CString& str) { append((LPCTSTR) str, str.GetLength()); };
+    void append(const CTDByteBuffer& buffer) { append(buffer.m_pData, buffer.m_size); };
+    void append(TCHAR ch) { append(&ch, 1); };
+    void appendInt(int value);
+    void appendFloat(double value, int nDecimals);
+    void appendRepeated(LPCTSTR str, int len, int nTimes);
+    void reset() { m_size = 0; };
+
+    LPCTSTR getData() const { return m_pData; };
+    int getSize() const { return m_size; };
+
+protected:
+    void reserve(int nChars);
+
+// Attributes
+    TCHAR* m_pData;
+    int    m_size;                      // Number of characters in use.
+    int    m_capacity;                  // Number of characters allocated.
+    int    m_minCapacity;               // Capacity of the first allocation.
+};
+
+//---------------------------------------------------------------------------
+// Serializes one output item, e.g., a leaf partition, into the buffers of
+// the output files. Called concurrently from the worker threads, so it must
+// not modify any shared state.
+//---------------------------------------------------------------------------
+class CTDOutputSerializer
+{
+public:
+    virtual bool serializeItem(int itemIdx, CTDByteBuffer* pBuffers) = 0;
+};
+
+//---------------------------------------------------------------------------
+// Worker threads serialize consecutive chunks of items into buffers.
+// The calling thread writes the buffers in item order with one large
+// write per chunk and file. At most m_nBuffers chunks are in flight.
+//---------------------------------------------------------------------------
+class CTDOutputWriter
+{
+public:
+    CTDOutputWriter(int nThreads);
+    virtual ~CTDOutputWriter();
+
+    bool write(int nItems, CTDOutputSerializer* pSerializer, CFile** pFiles, int nFiles);
+
+    static void writeString(CStdioFile& file, const CString& str);
+    static void writeBytes(CFile& file, const void* pData, UINT nBytes);
+
+protected:
+    struct CTDOutputChunk
+    {
+        CTDByteBuffer m_buffers[TD_OUTPUT_MAX_FILES];
+        CEvent        m_readyEvent;     // Manual-reset. Set when the chunk is serialized.
+        bool          m_bSucceeded;
+
+        CTDOutputChunk() : m_readyEvent(FALSE, TRUE), m_bSucceeded(false) {};
+    };
+
+    static UINT AFX_CDECL workerThreadProc(LPVOID pParam);
+    void runWorker();
+    bool serializeChunk(int chunkIdx, CTDOutputChunk* pChunk);
+    void stopWorkers(CWinThread** pThreads, int nThreads, bool bAbort);
+
+// Attributes
+    int                     m_nThreads;
+    int                     m_nBuffers;
+    int                     m_nItems;
+    CTDOutputSerializer*    m_pSerializer;
+    int                     m_nFiles;
+    int                     m_nChunks;
+    volatile LONG           m_nextChunk;        // Next chunk to be claimed by a worker.
+    volatile LONG           m_bAbort;
+    CSemaphore*             m_pFreeBuffers;     // Counts the chunk slots that may be filled.
+    CTDOutputChunk*         m_pChunks;          // Ring of m_nBuffers slots.
+};
+
+#endif
@@ -12,6 +12,10 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
 //****************
 // CTDPartAttrib *
 //****************
@@ -20,6 +24,7 @@ CTDPartAttrib::CTDPartAttrib(CTDAttrib* pActualAttrib)
     : m_pActualAttrib(pActualAttrib), 
       m_pSupportMatrix(NULL), 
       m_bCandidate(true),
+	  m_bScored(false),
 	  m_infoGain(-1.0f), 
 	  m_max(-1.0f),
 	  m_discern(0LL),
@@ -28,7 +33,9 @@ CTDPartAttrib::CTDPartAttrib(CTDAttrib* pActualAttrib)
 	  m_splitPoint(FLT_MAX),
 	  m_pLeftChildCon(NULL),
 	  m_pRightChildCon(NULL),
-	  m_pSplitSupMatrix(NULL)
+	  m_pSplitSupMatrix(NULL),
+	  m_supportBytes(0),
+	  m_splitBytes(0)
 {
 }
 
@@ -38,6 +45,7 @@ CTDPartAttrib::~CTDPartAttrib()
 
 	delete m_pSplitSupMatrix;
     m_pSplitSupMatrix = NULL;
+    CTDMemTracker::add(TD_MEM_SUPPORT_MATRICES, -getMatrixBytes());
 }
 
 //---------------------------------------------------------------------------
@@ -52,11 +60,15 @@ bool CTDPartAttrib::initSupportMatrix(CTDConcept* pCurrCon, int nClasses)
 
     // Allocate the matrix
     int dims[] = {nChildConcepts, nClasses};
+    delete m_pSupportMatrix;
     m_pSupportMatrix = new CTDMDIntArray(sizeof(dims) / sizeof(int), dims);
     if (!m_pSupportMatrix) {
         ASSERT(false);
         return false;
     }
+    LONGLONG nBytes = (LONGLONG(nChildConcepts) * nClasses + nChildConcepts + nClasses) * sizeof(int);
+    CTDMemTracker::add(TD_MEM_SUPPORT_MATRICES, nBytes - m_supportBytes);
+    m_supportBytes = nBytes;
 
     // Allocate support sums
     m_supportSums.SetSize(nChildConcepts);
@@ -74,19 +86,69 @@ bool CTDPartAttrib::initSupportMatrix(CTDConcept* pCurrCon, int nClasses)
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Add counts laid out as [child * nClasses + class] to the support matrix
+// allocated by initSupportMatrix, see CTDRootState.
+//---------------------------------------------------------------------------
+bool CTDPartAttrib::addSupportCounts(const CTDIntArray& counts)
+{
+    int nChildConcepts = m_supportSums.GetSize();
+    int nClasses = m_classSums.GetSize();
+    if (!m_pSupportMatrix || counts.GetSize() != nChildConcepts * nClasses) {
+        cerr << _T("CTDPartAttrib: Support counts do not match the support matrix of ") << m_pActualAttrib->m_attribName << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    int n = 0;
+    for (int i = 0; i < nChildConcepts; ++i) {
+        for (int j = 0; j < nClasses; ++j) {
+            n = counts[i * nClasses + j];
+            (*m_pSupportMatrix)[i][j] += n;
+            m_supportSums[i] += n;
+            m_classSums[j] += n;
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Compute one score of the current concept from the support matrix.
+//---------------------------------------------------------------------------
+template <>
+bool CTDPartAttrib::computeScoreBy<TD_SCORE_MAX>(CTDConcept* pCurrCon)
+{
+	return computeMaxHelper(*getSupportSums(), *getClassSums(), *getSupportMatrix(), m_max);
+}
+
+template <>
+bool CTDPartAttrib::computeScoreBy<TD_SCORE_INFOGAIN>(CTDConcept* pCurrCon)
+{
+	return computeInfoGainHelper(computeEntropy(getClassSums()), *getSupportSums(), *getClassSums(), *getSupportMatrix(), m_infoGain);
+}
+
+template <>
+bool CTDPartAttrib::computeScoreBy<TD_SCORE_DISCERNIBILITY>(CTDConcept* pCurrCon)
+{
+	return computeDiscernHelper(*getSupportSums(), m_discern);
+}
+
+template <>
+bool CTDPartAttrib::computeScoreBy<TD_SCORE_NCP>(CTDConcept* pCurrCon)
+{
+	return computeNCPHelper(*getSupportSums(), m_ncp, pCurrCon);
+}
+
 //---------------------------------------------------------------------------
 // Compute the score of current concept in this partAttrib
 //---------------------------------------------------------------------------
 bool CTDPartAttrib::computeScore(int nClasses, CTDConcept* pCurrCon)
 {
 
-	if (m_infoGain != -1.0f || !pCurrCon->m_bCutCandidate)
+	if (m_bScored || !pCurrCon->m_bCutCandidate)
 		return true;
 
 	if (!m_bCandidate) {
-#ifdef _DEBUG_PRT_INFO
-		cout << pCurrCon->m_conceptValue << " is not m_bCandidate" << endl << endl;
-#endif
 		if (!pCurrCon->isContinuous()) 
 			pCurrCon->m_bCutCandidate = false;
 		return true;
@@ -100,23 +162,39 @@ bool CTDPartAttrib::computeScore(int nClasses, CTDConcept* pCurrCon)
 		nChildConcepts = pCurrCon->getNumChildConcepts();
 
 	ASSERT(getSupportSums()->GetSize() == nChildConcepts);  
-	if (!computeMaxHelper(*getSupportSums(), *getClassSums(), *getSupportMatrix(), m_max)) {
-		ASSERT(false);
-		return false;
-	}
-	if (!computeInfoGainHelper(computeEntropy(getClassSums()), *getSupportSums(), *getClassSums(), *getSupportMatrix(), m_infoGain)) {
+
+	// pickSpecializeConcept reads only the score of the chosen score function.
+#if TD_bSCORE_ALL_METRICS
+	if (!computeScoreBy<TD_SCORE_MAX>(pCurrCon) ||
+		!computeScoreBy<TD_SCORE_INFOGAIN>(pCurrCon) ||
+		!computeScoreBy<TD_SCORE_DISCERNIBILITY>(pCurrCon) ||
+		!computeScoreBy<TD_SCORE_NCP>(pCurrCon)) {
 		ASSERT(false);
 		return false;
 	}
-	if (!computeDiscernHelper(*getSupportSums(), m_discern)) {
-		ASSERT(false);
-		return false;
+#else
+	bool bSucceeded = false;
+	switch (getScoreFunction()) {
+	case TD_SCORE_MAX:
+		bSucceeded = computeScoreBy<TD_SCORE_MAX>(pCurrCon);
+		break;
+	case TD_SCORE_INFOGAIN:
+		bSucceeded = computeScoreBy<TD_SCORE_INFOGAIN>(pCurrCon);
+		break;
+	case TD_SCORE_DISCERNIBILITY:
+		bSucceeded = computeScoreBy<TD_SCORE_DISCERNIBILITY>(pCurrCon);
+		break;
+	case TD_SCORE_NCP:
+		bSucceeded = computeScoreBy<TD_SCORE_NCP>(pCurrCon);
+		break;
 	}
-	if (!computeNCPHelper(*getSupportSums(), m_ncp, pCurrCon)) {
+	if (!bSucceeded) {
 		ASSERT(false);
 		return false;
 	}
-	
+#endif
+
+	m_bScored = true;
     return true;
 }
 
@@ -263,83 +341,36 @@ bool CTDPartAttrib::computeNCPHelper(const CTDIntArray& supSums, float& ncp, CTD
 	}
 	else {
 		if (this->getActualAttrib()->isContinuous()) {
-			CTDContConcept*  pCurrConcept = static_cast<CTDContConcept*> (pCurrCon);
-#ifdef _DEBUG_PRT_INFO
-			cout << pCurrCon->getAttrib()->m_attribName << endl;
-			cout << "Parent interval     : [" << pCurrConcept->m_lowerBound << "-" << pCurrConcept->m_upperBound << "]" << endl;
-			cout << "Split point         : " << m_splitPoint << endl;
-#endif
 			CTDConcept* pChildConcept = NULL;
 			float childNCP = 0;
 			computeNCPHelperHelper(childNCP, this->m_pLeftChildCon);
 			ncp += (supSums.GetAt(0) * childNCP);
-#ifdef _DEBUG_PRT_INFO
-			cout << "      (" << supSums.GetAt(0) << " * " << childNCP << ")" << endl;
-#endif
 			childNCP = 0;
 			computeNCPHelperHelper(childNCP, this->m_pRightChildCon);
 			ncp += (supSums.GetAt(1) * childNCP);
-#ifdef _DEBUG_PRT_INFO
-			cout << " +    (" << supSums.GetAt(1) << " * " << childNCP << ") = " << ncp << endl;
-#endif
 			
 		}
 		else {
-#ifdef _DEBUG_PRT_INFO
-			cout << pCurrCon->getAttrib()->m_attribName << endl;
-			cout << "Parent concept      : " << pCurrCon->m_conceptValue << endl;
-#endif
 			CTDConcept* pChildConcept = NULL;
 			for (int i = 0; i < pCurrCon->getNumChildConcepts(); ++i) {
 				float childNCP = 0;
 				computeNCPHelperHelper(childNCP, pCurrCon->getChildConcept(i));
 				ncp += (supSums.GetAt(i) * childNCP);
-#ifdef _DEBUG_PRT_INFO
-				cout << " +    (" << supSums.GetAt(i) << " * " << childNCP << ")" << endl;
-#endif
 			}
-#ifdef _DEBUG_PRT_INFO
-			cout << " = " << ncp << endl;
-#endif
 		}
-#ifdef _DEBUG_PRT_INFO
-		cout << endl;
-#endif
 	}
 
 	return true;
 }
 
 //---------------------------------------------------------------------------
-// Compute NCP of pCurrCon.
+// Look up NCP of pCurrCon in the NCP table of the attribute.
 // If the concept is continuous: ncp = |interval| / |rootInterval|
 // If categorical, please refer to the paper.
 //---------------------------------------------------------------------------
 bool CTDPartAttrib::computeNCPHelperHelper(float& ncp, CTDConcept* pCurrCon)
 {
-	ncp = 0;
-
-	if (this->getActualAttrib()->isContinuous()) {
-		CTDContConcept*  pCurrConcept = static_cast<CTDContConcept*> (pCurrCon);
-		CTDContConcept* pNumRootConcept = static_cast <CTDContConcept*> (pCurrConcept->getAttrib()->getConceptRoot());
-#ifdef _DEBUG_PRT_INFO
-		cout << "Child interval      : [" << pCurrConcept->m_lowerBound << "-" << pCurrConcept->m_upperBound << "]" << endl;
-#endif
-		ncp = (pCurrConcept->m_upperBound - pCurrConcept->m_lowerBound) / (pNumRootConcept->m_upperBound - pNumRootConcept->m_lowerBound);
-	}
-
-	else {
-#ifdef _DEBUG_PRT_INFO
-		cout << "Child concept       : " << pCurrCon->m_conceptValue << endl;
-#endif
-		int nTotalLeafConcepts = this->getActualAttrib()->getConceptRoot()->m_nLeafConcepts;
-		int nCurrLeafConcepts = pCurrCon->getNumLeafConcepts();	// Number of leaves under this concept.
-		if (nCurrLeafConcepts == 1) 
-			ncp = 0;
-		else 
-			ncp = float (nCurrLeafConcepts * 1.0 / nTotalLeafConcepts);
-	}
-	
+	ncp = this->getActualAttrib()->getConceptNCP(pCurrCon);
     return true;
 }
 
@@ -348,8 +379,10 @@ bool CTDPartAttrib::computeNCPHelperHelper(float& ncp, CTDConcept* pCurrCon)
 // 1) Sort partRecords based on raw values of the continuous attribute.
 // 2) Find the optimal split point.
 // 3) Add the child concepts to this concept.
+// If pSortedRecordIDs is not NULL, the records are put in that order
+// instead of being sorted, see CTDRootState.
 //---------------------------------------------------------------------------
-bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCurrConcept, CTDPartition* pCurrPartition)
+bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCurrConcept, CTDPartition* pCurrPartition, const CTDIntArray* pSortedRecordIDs)
 {
    #ifdef _TD_MANUAL_CONTHRCHY
 		
@@ -367,15 +400,6 @@ bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCur
 	// Child nodes created in a previous iteration
 	// No need to divide again
 	if (m_splitPoint != FLT_MAX) {
-#ifdef _DEBUG_PRT_INFO
-		cout << "PartAttrib			: " << m_pActualAttrib->m_attribName << endl;
-		cout << "pCurrConcept			: " << pCurrConcept->m_conceptValue << endl;
-		cout << "# of child concepts		: " << pCurrConcept->getNumChildConcepts() << endl;
-		cout << "# of partition records		: " << pCurrPartition->getNumRecords() << endl;
-		cout << "m_splitPoint			: " << m_splitPoint << endl;
-		cout << "m_pLeftChildCon			: " << m_pLeftChildCon->m_conceptValue << endl;
-		cout << "m_pRightChildCon		: " << m_pRightChildCon->m_conceptValue << endl << endl;
-#endif
         return true;
 	}
 
@@ -386,14 +410,6 @@ bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCur
 	if (pParentContConcept->getNumChildConcepts() != 0) { 
 		pLChildContConcept = static_cast<CTDContConcept*> (pParentContConcept->getChildConcept(0));
 		m_splitPoint = pLChildContConcept->m_upperBound;
-#ifdef _DEBUG_PRT_INFO
-		cout << "A split point already exists." << endl;
-		cout << "PartAttrib			: " << m_pActualAttrib->m_attribName << endl;
-		cout << "pCurrConcept			: " << pCurrConcept->m_conceptValue << endl;
-		cout << "m_splitPoint			: " << m_splitPoint << endl;
-		cout << "Left child			: " << pParentContConcept->getChildConcept(0)->m_conceptValue << endl;
-		cout << "Right child			: " << pParentContConcept->getChildConcept(1)->m_conceptValue << endl << endl;
-#endif
 		m_pLeftChildCon = pParentContConcept->getChildConcept(0);
 		m_pRightChildCon = pParentContConcept->getChildConcept(1);
 		return true;
@@ -407,8 +423,15 @@ bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCur
 	}
 	else {
 		 // Sort the recrods according to their raw values of this attribute
-         if (!Recs->sortByAttrib(m_pActualAttrib->m_attribIdx))
+         LONGLONG sortStart = TD_bTRACE_PARTITIONS ? CTDProfiler::getNanos() : 0;
+         if (pSortedRecordIDs) {
+             if (!Recs->arrangeByRecordIDs(*pSortedRecordIDs))
+                 return false;
+         }
+         else if (!Recs->sortByAttrib(m_pActualAttrib->m_attribIdx))
              return false;
+         if (TD_bTRACE_PARTITIONS)
+             pCurrPartition->m_sortNanos += CTDProfiler::getNanos() - sortStart;
 
          // Find optimal split point
          if (!findOptimalSplitPoint(*Recs, nClasses, epsilon, pCurrConcept))
@@ -423,8 +446,89 @@ bool CTDPartAttrib::divideConcept(double epsilon, int nClasses, CTDConcept* pCur
 }
 
 //---------------------------------------------------------------------------
+// Discernibility mapped to [TD_NORM_LOWER_BOUND, TD_NORM_UPPER_BOUND].
+// A large discern value maps to a low normalized value, so that lower
+// discern values (better results) are favored.
+//---------------------------------------------------------------------------
+// static
+float CTDPartAttrib::normalizeDiscern(long long discern)
+{
+	long double A = TD_DISCERN_UPPER_BOUND * 1.0;	
+	long double B = TD_DISCERN_LOWER_BOUND * 1.0;
+	long long   z = (discern - A) * (TD_NORM_UPPER_BOUND - TD_NORM_LOWER_BOUND);
+	long double norm_discern = TD_NORM_LOWER_BOUND + z / (B - A);
+	return norm_discern;
+}
+
+//---------------------------------------------------------------------------
+// We want to favor lower NCP values.
+//---------------------------------------------------------------------------
+// static
+float CTDPartAttrib::normalizeNCP(float ncp)
+{
+	return (ncp * -1) + getnTrainingRecs();
+}
+
+//---------------------------------------------------------------------------
+// Weight of the split between pCurrValue and pNextValue, computed from
+// m_splitSupSums, m_splitClassSums and m_pSplitSupMatrix.
+//---------------------------------------------------------------------------
+template <>
+bool CTDPartAttrib::computeSplitWeight<TD_SCORE_MAX>(CTDNumericValue* pCurrValue, CTDNumericValue* pNextValue, CTDContConcept* pCurrConcept, float& weight)
+{
+	return computeMaxHelper(m_splitSupSums, m_splitClassSums, *m_pSplitSupMatrix, weight);
+}
+
+template <>
+bool CTDPartAttrib::computeSplitWeight<TD_SCORE_INFOGAIN>(CTDNumericValue* pCurrValue, CTDNumericValue* pNextValue, CTDContConcept* pCurrConcept, float& weight)
+{
+	return computeInfoGainHelper(computeEntropy(&m_splitClassSums), m_splitSupSums, m_splitClassSums, *m_pSplitSupMatrix, weight);
+}
+
+template <>
+bool CTDPartAttrib::computeSplitWeight<TD_SCORE_DISCERNIBILITY>(CTDNumericValue* pCurrValue, CTDNumericValue* pNextValue, CTDContConcept* pCurrConcept, float& weight)
+{
+	long long discern = 0;
+	if (!computeDiscernHelper(m_splitSupSums, discern))
+		return false;
+	weight = normalizeDiscern(discern);
+	return true;
+}
+
+template <>
+bool CTDPartAttrib::computeSplitWeight<TD_SCORE_NCP>(CTDNumericValue* pCurrValue, CTDNumericValue* pNextValue, CTDContConcept* pCurrConcept, float& weight)
+{
+	float ncp = 0.0f;
+	if (!computeNCPSplitHelper(m_splitSupSums, ncp, pCurrValue, pNextValue, pCurrConcept))	// Compute ncp of the midpoint.
+		return false;
+	weight = normalizeNCP(ncp);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Instantiate the split scan for the score function of the run.
 //---------------------------------------------------------------------------
 bool CTDPartAttrib::findOptimalSplitPoint(CTDRecords& recs, int nClasses, double epsilon, CTDConcept* pCurrConcept)
+{
+	switch (getScoreFunction()) {
+	case TD_SCORE_MAX:
+		return findOptimalSplitPointBy<TD_SCORE_MAX>(recs, nClasses, epsilon, pCurrConcept);
+	case TD_SCORE_INFOGAIN:
+		return findOptimalSplitPointBy<TD_SCORE_INFOGAIN>(recs, nClasses, epsilon, pCurrConcept);
+	case TD_SCORE_DISCERNIBILITY:
+		return findOptimalSplitPointBy<TD_SCORE_DISCERNIBILITY>(recs, nClasses, epsilon, pCurrConcept);
+	case TD_SCORE_NCP:
+		return findOptimalSplitPointBy<TD_SCORE_NCP>(recs, nClasses, epsilon, pCurrConcept);
+	default:
+		ASSERT(false);
+		return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+template <TDScoreFunction scoreFunction>
+bool CTDPartAttrib::findOptimalSplitPointBy(CTDRecords& recs, int nClasses, double epsilon, CTDConcept* pCurrConcept)
 {
 	// Initializing m_pSplitSupMatrix: # of dimensions.
 	// All indexes are set to 0
@@ -460,11 +564,7 @@ bool CTDPartAttrib::findOptimalSplitPoint(CTDRecords& recs, int nClasses, double
 	CTDFloatArray ranges;
 
 	int idx = 0;
-	float entropy = 0.0f;
-    float infoGain = 0.0f;
-	float max = 0.0f;
-	long long discern = 0;
-	float ncp = 0.0f;
+	float weight = 0.0f;
     bool FLAG = false;
     
 	CTDNumericValue* pCurrValue		= NULL;
@@ -502,70 +602,38 @@ bool CTDPartAttrib::findOptimalSplitPoint(CTDRecords& recs, int nClasses, double
 
         // Compare with next value. If different, then compute score
         if (pCurrValue->getRawValue() != pNextValue->getRawValue()) {
-            if (!computeMaxHelper(m_splitSupSums, m_splitClassSums, *m_pSplitSupMatrix, max))
-                return false;
-
-			if (!computeInfoGainHelper(computeEntropy(&m_splitClassSums), m_splitSupSums, m_splitClassSums, *m_pSplitSupMatrix, infoGain))
+            if (!computeSplitWeight<scoreFunction>(pCurrValue, pNextValue, pContConcept, weight))
                 return false;
-
-			if (!computeDiscernHelper(m_splitSupSums, discern))
-				return false;
-
-			if (!computeNCPSplitHelper(m_splitSupSums, ncp, pCurrValue, pNextValue, pContConcept))	// Compute ncp of the midpoint.
-				return false;
 			
 			cRanges.Add(new CTDRange(pNextValue->getRawValue(), pCurrValue->getRawValue()));  
 			ranges.Add(pNextValue->getRawValue()- pCurrValue->getRawValue());
-		
-#if defined(_TD_SCORE_FUNTION_MAX) 
-			weights.Add(max);
-#endif
-
-#if defined(_TD_SCORE_FUNCTION_INFOGAIN) 
-			weights.Add(infoGain);
-#endif
-
-#if defined(_TD_SCORE_FUNTION_DISCERNIBILITY)
-			long double A = TD_DISCERN_UPPER_BOUND * 1.0;	
-			long double B = TD_DISCERN_LOWER_BOUND * 1.0;
-			long long   z = (discern - A) * (TD_NORM_UPPER_BOUND - TD_NORM_LOWER_BOUND);
-			long double norm_discern = TD_NORM_LOWER_BOUND + z / (B - A);
-
-			weights.Add(norm_discern);
-#endif
-
-#if defined(_TD_SCORE_FUNCTION_NCP)				
-			// We want to favor lower values
-			float normNCP = (ncp * -1) + getnTrainingRecs();
-			weights.Add(normNCP);
-#endif
-
+			weights.Add(weight);
             FLAG = true;
         }
     }
 
+	CTDProfiler::addCount(TD_COUNTER_SPLIT_CANDIDATES, weights.GetSize());
 	if (FLAG){
         // srand( (unsigned)time( NULL ) );
 	    idx = expoMechSplit(epsilon, &weights, &ranges); 
 
-#if defined(_TD_SCORE_FUNCTION_NCP)
-		// Not all values have the same ncp within the same interval.
-		// We estimate the ncp of the interval by being the ncp of the midpoint.
-		m_splitPoint = (cRanges.GetAt(idx)->m_upperValue + cRanges.GetAt(idx)->m_lowerValue) / 2;
-#else
-		// Randomly pick a value from the range of the selected interval, since all the values in the interval have the same score.
-	    m_splitPoint = (float) (rand() % (int)(cRanges.GetAt(idx)->m_upperValue - cRanges.GetAt(idx)->m_lowerValue + 1) + cRanges.GetAt(idx)->m_lowerValue); 
-
-#endif
+		if (scoreFunction == TD_SCORE_NCP) {
+			// Not all values have the same ncp within the same interval.
+			// We estimate the ncp of the interval by being the ncp of the midpoint.
+			m_splitPoint = (cRanges.GetAt(idx)->m_upperValue + cRanges.GetAt(idx)->m_lowerValue) / 2;
+		}
+		else {
+			// Randomly pick a value from the range of the selected interval, since all the values in the interval have the same score.
+			m_splitPoint = (float) (rand() % (int)(cRanges.GetAt(idx)->m_upperValue - cRanges.GetAt(idx)->m_lowerValue + 1) + cRanges.GetAt(idx)->m_lowerValue); 
+		}
 	}
 	else {
 		// All the raw vlaues are same. 
 		// m_splitPoint is chosen uniformly from the domian or midpoint (for NCP).
-#if defined(_TD_SCORE_FUNCTION_NCP)
-		m_splitPoint = (pContConcept->m_upperBound + pContConcept->m_lowerBound) / 2;
-#else
-		m_splitPoint = (float) (rand() % (int)(pContConcept->m_upperBound - pContConcept->m_lowerBound + 1) + pContConcept->m_lowerBound); 
-#endif
+		if (scoreFunction == TD_SCORE_NCP)
+			m_splitPoint = (pContConcept->m_upperBound + pContConcept->m_lowerBound) / 2;
+		else
+			m_splitPoint = (float) (rand() % (int)(pContConcept->m_upperBound - pContConcept->m_lowerBound + 1) + pContConcept->m_lowerBound); 
     }
     return true;
 }
@@ -576,11 +644,15 @@ bool CTDPartAttrib::initSplitMatrix(int nConcepts, int nClasses)
 {
     // Allocate the matrix
     int dims[] = {nConcepts, nClasses};
+    delete m_pSplitSupMatrix;
     m_pSplitSupMatrix = new CTDMDIntArray(sizeof(dims) / sizeof(int), dims);
     if (!m_pSplitSupMatrix) {
         ASSERT(false);
         return false;
     }
+    LONGLONG nBytes = (LONGLONG(nConcepts) * nClasses + nConcepts + nClasses) * sizeof(int);
+    CTDMemTracker::add(TD_MEM_SUPPORT_MATRICES, nBytes - m_splitBytes);
+    m_splitBytes = nBytes;
 
     // Allocate support sums
     m_splitSupSums.SetSize(nConcepts);
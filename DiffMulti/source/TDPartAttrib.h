@@ -25,6 +25,7 @@ public:
 
 // operations
     bool initSupportMatrix(CTDConcept* pCurrCon, int nClasses);
+    bool addSupportCounts(const CTDIntArray& counts);
     
     CTDMDIntArray* getSupportMatrix() { return m_pSupportMatrix; };
     CTDIntArray* getSupportSums() { return &m_supportSums; };
@@ -33,6 +34,7 @@ public:
 
 
 	bool computeScore(int nClasses, CTDConcept* pCurrCon);
+	template <TDScoreFunction scoreFunction> bool computeScoreBy(CTDConcept* pCurrCon);
 	bool computeMaxHelper(const CTDIntArray& supSums, 
                                  const CTDIntArray& classSums,
 								 CTDMDIntArray& supMatrix,
@@ -55,13 +57,20 @@ public:
 
     static float computeEntropy(CTDIntArray* pClassSums);
 	inline float log2f(float x) { return log10f(x) / log10f(2); };
-	bool divideConcept(double epsilon, int nClasses, CTDConcept* pCurrConcept, CTDPartition* pCurrPartition);
+	bool divideConcept(double epsilon, int nClasses, CTDConcept* pCurrConcept, CTDPartition* pCurrPartition, const CTDIntArray* pSortedRecordIDs = NULL);
 	bool findOptimalSplitPoint(CTDRecords& recs, int nClasses, double epsilon, CTDConcept* pCurrConcept = NULL);
+	template <TDScoreFunction scoreFunction> bool findOptimalSplitPointBy(CTDRecords& recs, int nClasses, double epsilon, CTDConcept* pCurrConcept);
+	template <TDScoreFunction scoreFunction> bool computeSplitWeight(CTDNumericValue* pCurrValue, CTDNumericValue* pNextValue, CTDContConcept* pCurrConcept, float& weight);
+	template <TDScoreFunction scoreFunction> float getCandidateWeight() const;
+	static float normalizeDiscern(long long discern);
+	static float normalizeNCP(float ncp);
 	bool initSplitMatrix(int nConcepts, int nClasses);
 	float getSplitPoint() { return m_splitPoint; };
+	LONGLONG getMatrixBytes() const { return m_supportBytes + m_splitBytes; };
 
 // attributes
     bool           m_bCandidate;
+	bool		   m_bScored;			// computeScore has computed the score of the current concept.
 	float		   m_splitPoint;		// Split point of the concept of this partAttrib.
 	float          m_infoGain;          // Information gain (Score)
 	float		   m_max;				// Max (Score)
@@ -85,6 +94,10 @@ protected:
 	CTDMDIntArray* m_pSplitSupMatrix;   // raw count of supports
     CTDIntArray    m_splitSupSums;      // sum of supports of each child concept
     CTDIntArray    m_splitClassSums;    // sum of classes
+
+	// Bytes of the matrices above, see CTDMemTracker.
+	LONGLONG       m_supportBytes;
+	LONGLONG       m_splitBytes;
 };
 
 
@@ -96,6 +109,14 @@ public:
     virtual ~CTDPartAttribs();
 };
 
+//---------------------------------------------------------------------------
+// Weight of a candidate in the exponential mechanism, by score function.
+//---------------------------------------------------------------------------
+template <> inline float CTDPartAttrib::getCandidateWeight<TD_SCORE_MAX>() const { return m_max; }
+template <> inline float CTDPartAttrib::getCandidateWeight<TD_SCORE_INFOGAIN>() const { return m_infoGain; }
+template <> inline float CTDPartAttrib::getCandidateWeight<TD_SCORE_DISCERNIBILITY>() const { return normalizeDiscern(m_discern); }
+template <> inline float CTDPartAttrib::getCandidateWeight<TD_SCORE_NCP>() const { return normalizeNCP(m_ncp); }
+
 
 //------------------------------------------------------------------------------------
 
@@ -8,6 +8,10 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
 //***************
 // CTDPartition *
 //***************
@@ -17,7 +21,11 @@ CTDPartition::CTDPartition(int partitionIdx, CTDAttribs* pAttribs)
 	  m_leafPos(NULL),
 	  m_nBudgetCount(0),
 	  m_nLevelCount(0),
-	  m_nLocalSpecializations(0)
+	  m_nLocalSpecializations(0),
+	  m_routeNodeIdx(-1),
+	  m_sortNanos(0),
+	  m_recordBytes(0),
+	  m_matrixBytes(0)
 {
     // Add each attribute
     int nAttribs = pAttribs->GetSize();
@@ -27,11 +35,16 @@ CTDPartition::CTDPartition(int partitionIdx, CTDAttribs* pAttribs)
 
     // Number of classes
     m_nClasses = pAttribs->GetAt(nAttribs - 1)->getConceptRoot()->getNumChildConcepts();
+    CTDProfiler::addCount(TD_COUNTER_PARTITIONS, 1);
 }
 
 CTDPartition::CTDPartition(int partitionIdx, CTDAttribs* pAttribs, CTDPartition* pParentPartition, int const splitIdx)
 	: m_partitionIdx(partitionIdx),
-	  m_leafPos(NULL)
+	  m_leafPos(NULL),
+	  m_routeNodeIdx(-1),
+	  m_sortNanos(0),
+	  m_recordBytes(0),
+	  m_matrixBytes(0)
 {
     // Add each attribute
     int nAttribs = pAttribs->GetSize();
@@ -40,6 +53,7 @@ CTDPartition::CTDPartition(int partitionIdx, CTDAttribs* pAttribs, CTDPartition*
 
     // Number of classes
     m_nClasses = pAttribs->GetAt(nAttribs - 1)->getConceptRoot()->getNumChildConcepts();
+    CTDProfiler::addCount(TD_COUNTER_PARTITIONS, 1);
 
 	// Budget usage
 	m_nBudgetCount = pParentPartition->m_nBudgetCount;
@@ -72,6 +86,9 @@ CTDPartition::~CTDPartition()
 {
     while (!m_partAttribs.IsEmpty())
         delete m_partAttribs.RemoveHead();
+
+    CTDMemTracker::add(TD_MEM_PARTITION_RECORDS, -m_recordBytes);
+    CTDMemTracker::addAtDepth(m_nLevelCount, -(m_recordBytes + m_matrixBytes));
 }
 //---------------------------------------------------------------------------
 // m_genRecords contains one generalized record for every class value
@@ -219,8 +236,12 @@ bool CTDPartition::addRecord(CTDRecord* pRecord)
 
 
 //---------------------------------------------------------------------------
+// Count the records of this partition by the child concepts of the current
+// concept of each candidate and by class. The counts of the root that do
+// not depend on the budget are taken from pRootState if it is not NULL,
+// see buildRootState.
 //---------------------------------------------------------------------------
-bool CTDPartition::constructSupportMatrix(double epsilon)
+bool CTDPartition::constructSupportMatrix(double epsilon, const CTDRootState* pRootState)
 {
     CTDRecord* pFirstRec = NULL;
 
@@ -237,26 +258,33 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
 		}
 	}
 
+	if (pRootState && (pRootState->m_nRecords != getNumRecords() || pRootState->m_classSums.GetSize() != m_nClasses ||
+                       pRootState->m_supportCounts.GetSize() != m_partAttribs.GetCount())) {
+        cerr << _T("CTDPartition: Root state does not match the partition.") << endl;
+        ASSERT(false);
+        return false;
+	}
+
 	// Initialize m_pSupportMatrix of every pPartAttrib in this partition to 0
     int a = 0;
 	POSITION partAttribPos;
     CTDPartAttrib* pPartAttrib = NULL;
     CTDConcept* pCurrentConcept = NULL;
+    CTDBoolArray bCounted;          // Support counts taken from pRootState.
+    bCounted.SetSize(m_partAttribs.GetCount());
+    bool bScanRecords = !pRootState;
 
     for (POSITION pos = m_partAttribs.GetHeadPosition(); pos != NULL; ++a) {
         partAttribPos = pos;
 		pPartAttrib = m_partAttribs.GetNext(pos);
 
+		bCounted.SetAt(a, false);
+
 		// m_bCandidate is inherited from the parent partition.
 		// Otherwise, m_bCandidate is true by default 
 		if (!pPartAttrib->m_bCandidate) {
 			pCurrentConcept = pFirstRec->getValue(a)->getCurrentConcept();
 			if (pCurrentConcept->isContinuous()) {
-#ifdef _DEBUG_PRT_INFO
-				cout << "PartAttrib	: " << pPartAttrib->m_pActualAttrib->m_attribName << " is !m_bCandidate" << endl;
-				CTDContConcept*  pCurrContConcept = static_cast<CTDContConcept*> (pCurrentConcept);
-				cout << "Concept	: [" << pCurrContConcept->m_lowerBound << "-" << pCurrContConcept->m_upperBound << "]" << endl << endl;
-#endif
 				continue;
 			}
 		}
@@ -271,16 +299,14 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
 			if (pCurrContConcept->m_upperBound - pCurrContConcept->m_lowerBound <= 1) {
 				pCurrentConcept->m_bCutCandidate = false;
 				pPartAttrib->m_bCandidate = false;
-#ifdef _DEBUG_PRT_INFO
-				cout << "==> Current cont concept [" << pCurrContConcept->m_lowerBound << "-" << pCurrContConcept->m_upperBound << "] interval size <= 1." << endl << endl;
-#endif
 				continue;
 			}
 		}
 
         // Need to find a split point
         if (pPartAttrib->getActualAttrib()->m_bVirtualAttrib) {
-            if (!pPartAttrib->divideConcept(epsilon, m_nClasses, pCurrentConcept, this)) {	// Will return true if categorical attrib.
+            const CTDIntArray* pSortedRecordIDs = pRootState ? pRootState->m_sortedRecordIDs[a] : NULL;
+            if (!pPartAttrib->divideConcept(epsilon, m_nClasses, pCurrentConcept, this, pSortedRecordIDs)) {	// Will return true if categorical attrib.
                 ASSERT(false);																	
                 return false;
             }
@@ -288,16 +314,9 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
 								
 		if (!hasChildConcepts(pCurrentConcept, pPartAttrib)) {		
 			if (pCurrentConcept->isContinuous()) {
-#ifdef _DEBUG_PRT_INFO
-				CTDContConcept*  pCurrContConcept = static_cast<CTDContConcept*> (pCurrentConcept);
-				cout << "==> Current cont concept [" << pCurrContConcept->m_lowerBound << "-" << pCurrContConcept->m_upperBound << "] has no children." << endl << endl;
-#endif
 				pPartAttrib->m_bCandidate = false;	
 			}
 			else {
-#ifdef _DEBUG_PRT_INFO
-				cout << "==> Current cat concept " << pCurrentConcept->m_conceptValue << " has no children." << endl << endl;
-#endif
 				pCurrentConcept->m_bCutCandidate = false;	// "true" by default.
 				pPartAttrib->m_bCandidate = false;
 			}
@@ -309,14 +328,28 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
             ASSERT(false);
             return false;
         }
+
+        if (pRootState && pRootState->m_supportCounts[a]) {
+            if (!pPartAttrib->addSupportCounts(*pRootState->m_supportCounts[a])) {
+                ASSERT(false);
+                return false;
+            }
+            bCounted.SetAt(a, true);
+        }
+        else
+            bScanRecords = true;
 	}
 
 	// Initialize the noisy class sum count
 	m_classNoisySums.SetSize(m_nClasses);
 
     for (int j = 0; j < m_nClasses; ++j)
-		m_classNoisySums.SetAt(j, 0);
+		m_classNoisySums.SetAt(j, pRootState ? pRootState->m_classSums[j] : 0);
 
+    if (!bScanRecords) {
+        trackMemory();
+        return true;
+    }
 
 	
     // Compute the support matrix
@@ -328,12 +361,14 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
     CTDRecord* pRec = NULL;
     int nRecs = getNumRecords();
     int classIdx = m_partAttribs.GetCount();
+    CTDProfiler::addCount(TD_COUNTER_RECORDS_SCANNED, nRecs);
     for (int r = 0; r < nRecs; ++r) {       
         pRec = getRecord(r);
         // Get the class concept
         pClassConcept = pRec->getValue(classIdx)->getCurrentConcept();  
 
-		++m_classNoisySums[pClassConcept->m_childIdx];
+		if (!pRootState)
+			++m_classNoisySums[pClassConcept->m_childIdx];
 		
         // Compute support counts for each attribute
         int aIdx = 0;
@@ -341,7 +376,7 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
             // The partition attribute
             pPartAttrib = m_partAttribs.GetNext(pos);
 			
-			if (!pPartAttrib->m_bCandidate)
+			if (!pPartAttrib->m_bCandidate || bCounted.GetAt(aIdx))
                 continue;
 		
             // Get the lower concept value
@@ -378,8 +413,113 @@ bool CTDPartition::constructSupportMatrix(double epsilon)
         }
     }
 
+    trackMemory();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Compute the parts of constructSupportMatrix on this root partition that
+// do not depend on the budget. The continuous candidates are sorted in
+// turn, as divideConcept sorts them when it splits their root concepts, and
+// the order after each sort is kept. The concepts and records are not
+// changed, only the order of the records of this partition.
+//---------------------------------------------------------------------------
+bool CTDPartition::buildRootState(CTDRootState& rootState)
+{
+    rootState.cleanup();
+    int nRecs = getNumRecords();
+    if (nRecs == 0 || m_nLevelCount != 0) {
+        cerr << _T("CTDPartition: Root state of an empty or non-root partition.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    rootState.m_nRecords = nRecs;
+    rootState.m_supportCounts.SetSize(m_partAttribs.GetCount());
+    rootState.m_sortedRecordIDs.SetSize(m_partAttribs.GetCount());
+    CTDRecord* pFirstRec = getRecord(0);
+    CTDPartAttrib* pPartAttrib = NULL;
+    CTDConcept* pRootConcept = NULL;
+    int a = 0;
+    for (POSITION pos = m_partAttribs.GetHeadPosition(); pos != NULL; ++a) {
+		pPartAttrib = m_partAttribs.GetNext(pos);
+        pRootConcept = pFirstRec->getValue(a)->getCurrentConcept();
+		if (pRootConcept->isContinuous()) {
+			// Same conditions as constructSupportMatrix and divideConcept.
+			CTDContConcept* pRootContConcept = static_cast<CTDContConcept*> (pRootConcept);
+			if (!pPartAttrib->getActualAttrib()->m_bVirtualAttrib ||
+                pRootContConcept->m_upperBound - pRootContConcept->m_lowerBound <= 1 ||
+                pRootContConcept->getNumChildConcepts() != 0 || nRecs <= 1)
+				continue;
+
+			if (!m_partRecords.sortByAttrib(pPartAttrib->getActualAttrib()->m_attribIdx))
+				return false;
+			CTDIntArray* pRecordIDs = new CTDIntArray();
+			pRecordIDs->SetSize(nRecs);
+			for (int r = 0; r < nRecs; ++r)
+				pRecordIDs->SetAt(r, getRecord(r)->getRecordID());
+			rootState.m_sortedRecordIDs.SetAt(a, pRecordIDs);
+		}
+		else if (pRootConcept->getNumChildConcepts() > 0) {
+			CTDIntArray* pCounts = new CTDIntArray();
+			pCounts->SetSize(pRootConcept->getNumChildConcepts() * m_nClasses);
+			for (int i = 0; i < pCounts->GetSize(); ++i)
+				pCounts->SetAt(i, 0);
+			rootState.m_supportCounts.SetAt(a, pCounts);
+		}
+	}
+
+	rootState.m_classSums.SetSize(m_nClasses);
+    for (int j = 0; j < m_nClasses; ++j)
+		rootState.m_classSums.SetAt(j, 0);
+
+    CTDRecord* pRec = NULL;
+    CTDConcept* pClassConcept = NULL;
+    CTDConcept* pLowerConcept = NULL;
+    int classIdx = m_partAttribs.GetCount();
+    for (int r = 0; r < nRecs; ++r) {
+        pRec = getRecord(r);
+        pClassConcept = pRec->getValue(classIdx)->getCurrentConcept();
+		++rootState.m_classSums[pClassConcept->m_childIdx];
+
+        int aIdx = 0;
+        for (POSITION pos = m_partAttribs.GetHeadPosition(); pos != NULL; ++aIdx) {
+            pPartAttrib = m_partAttribs.GetNext(pos);
+            CTDIntArray* pCounts = rootState.m_supportCounts[aIdx];
+            if (!pCounts)
+                continue;
+
+            pLowerConcept = pRec->getValue(aIdx)->getLowerConcept(pPartAttrib);
+            if (!pLowerConcept) {
+                ASSERT(false);
+                return false;
+            }
+            ++((*pCounts)[pLowerConcept->m_childIdx * m_nClasses + pClassConcept->m_childIdx]);
+        }
+    }
     return true;
 }
+
+//---------------------------------------------------------------------------
+// Report the growth of the record pointers and the matrices of this
+// partition since the last call, at its depth.
+//---------------------------------------------------------------------------
+void CTDPartition::trackMemory()
+{
+    if (!TD_bTRACK_MEMORY)
+        return;
+
+    LONGLONG recordBytes = LONGLONG(m_partRecords.GetSize()) * sizeof(CTDRecord*);
+    LONGLONG matrixBytes = 0;
+    for (POSITION pos = m_partAttribs.GetHeadPosition(); pos != NULL;)
+        matrixBytes += m_partAttribs.GetNext(pos)->getMatrixBytes();
+
+    CTDMemTracker::add(TD_MEM_PARTITION_RECORDS, recordBytes - m_recordBytes);
+    CTDMemTracker::addAtDepth(m_nLevelCount, recordBytes + matrixBytes - m_recordBytes - m_matrixBytes);
+    m_recordBytes = recordBytes;
+    m_matrixBytes = matrixBytes;
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 bool CTDPartition::addNoise(double epsilon)
@@ -457,6 +597,27 @@ bool CTDPartition::computeScore()
 // Pick a concept for specialization from current partition
 //---------------------------------------------------------------------------
 bool CTDPartition::pickSpecializeConcept(CTDAttrib*& pSelectedAttrib, CTDConcept*& pSelectedConcept, CTDPartAttrib*& pSelectedPartAttrib, double epsilon)
+{
+	switch (getScoreFunction()) {
+	case TD_SCORE_MAX:
+		return pickSpecializeConceptBy<TD_SCORE_MAX>(pSelectedAttrib, pSelectedConcept, pSelectedPartAttrib, epsilon);
+	case TD_SCORE_INFOGAIN:
+		return pickSpecializeConceptBy<TD_SCORE_INFOGAIN>(pSelectedAttrib, pSelectedConcept, pSelectedPartAttrib, epsilon);
+	case TD_SCORE_DISCERNIBILITY:
+		return pickSpecializeConceptBy<TD_SCORE_DISCERNIBILITY>(pSelectedAttrib, pSelectedConcept, pSelectedPartAttrib, epsilon);
+	case TD_SCORE_NCP:
+		return pickSpecializeConceptBy<TD_SCORE_NCP>(pSelectedAttrib, pSelectedConcept, pSelectedPartAttrib, epsilon);
+	default:
+		ASSERT(false);
+		return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+// pickSpecializeConcept for one score function.
+//---------------------------------------------------------------------------
+template <TDScoreFunction scoreFunction>
+bool CTDPartition::pickSpecializeConceptBy(CTDAttrib*& pSelectedAttrib, CTDConcept*& pSelectedConcept, CTDPartAttrib*& pSelectedPartAttrib, double epsilon)
 {
 	CTDRecord* pFirstRec = NULL;
 	if ( getNumRecords() == 0){
@@ -511,77 +672,20 @@ bool CTDPartition::pickSpecializeConcept(CTDAttrib*& pSelectedAttrib, CTDConcept
 
 		candidates.AddTail(pPartAttrib);
 		positions.Add(currPos);
-			
-#if defined(_TD_SCORE_FUNTION_MAX) 
-			weights.Add(pPartAttrib->m_max);
-#endif
-
-#if defined(_TD_SCORE_FUNCTION_INFOGAIN) 
-			weights.Add(pPartAttrib->m_infoGain);
-#endif
-
-#if defined(_TD_SCORE_FUNTION_DISCERNIBILITY)
-			long long discern = pPartAttrib->m_discern;
-			long double A = TD_DISCERN_UPPER_BOUND * 1.0;	// Supposed to be TD_DISCERN_LOWER_BOUND, but we want to favor lower discern values (lower discern implies better results) so now a large discern value will match to a low normalized value.
-			long double B = TD_DISCERN_LOWER_BOUND * 1.0;
-			long long   z = (discern - A) * (TD_NORM_UPPER_BOUND - TD_NORM_LOWER_BOUND);
-			long double norm_discern = TD_NORM_LOWER_BOUND + z / (B - A);
-			/*cout << "Normalized Discern: " << norm_discern << endl << endl;*/
-
-			weights.Add(norm_discern);	// Favors higher normalized discern values (which represent lower discern values)
-#endif
-
-#if defined(_TD_SCORE_FUNCTION_NCP)				
-			float normNCP = ((pPartAttrib->m_ncp) * -1) + getnTrainingRecs();
-
-	#ifdef _DEBUG_PRT_INFO
-			cout << "[" << std::setw(2) <<  std::left << pPartAttrib->getActualAttrib()->m_attribIdx << "] ";
-			cout << std::setw(15) <<  std::left << pPartAttrib->getActualAttrib()->m_attribName;
-			cout <<  " m_ncp : " ;
-			cout << std::fixed << std::setprecision(2) << std::setw(10) << std::left << pPartAttrib->m_ncp;
-			cout << "   normNCP : ";
-			cout << std::fixed << std::setprecision(2) << std::setw(10) << std::left << normNCP << endl;
-	#endif
-
-			weights.Add(normNCP);
-#endif
+		weights.Add(pPartAttrib->getCandidateWeight<scoreFunction>());
 
 	}
 	
 	// No concept is a candidate
-	if (weights.IsEmpty()) {
-#ifdef _DEBUG_PRT_INFO
-		cout << endl;
-		cout << endl;
-		cout << _T("* * * * * No valid split on current partition. * * * * *") << endl;
-#endif
-
+	if (weights.IsEmpty())
 		return true;
-	}
 
 	// Use exponential mechanism to select the candidate partAttrib
+    CTDProfiler::addCount(TD_COUNTER_SPLIT_CANDIDATES, weights.GetSize());
     idx = expoMech(epsilon, &weights);
 	pSelectedPartAttrib = candidates.GetAt(positions.GetAt(idx)); 
 	pSelectedAttrib = pSelectedPartAttrib->m_pActualAttrib;
 	pSelectedConcept = pFirstRec->getValue(pSelectedAttrib->m_attribIdx)->getCurrentConcept();
-
-
-#ifdef _DEBUG_PRT_INFO
-	cout << endl;
-    cout << endl;
-	cout << _T("* * * * * Selected split on current partition: ") << endl;
-    cout << _T("* * * * * [Selected splitting attribute index = ") << pSelectedAttrib->m_attribIdx << _T(", name = ") << pSelectedAttrib->m_attribName << _T("]") << endl;
-    cout << _T("* * * * * [Selected splitting concept flatten index = ") << pSelectedConcept->m_flattenIdx << _T(", name = ") << pSelectedConcept->m_conceptValue << _T("]") << endl;
-    cout << _T("* * * * * [Selected splitting concept's InfoGain = ") << pSelectedPartAttrib->m_infoGain << _T("]") << endl;
-	cout << _T("* * * * * [Selected splitting concept's Max = ") << pSelectedPartAttrib->m_max << _T("]") << endl;
-	cout << _T("* * * * * [Selected splitting concept's Discernibility = ") << pSelectedPartAttrib->m_discern << _T("]") << endl;
-	cout << _T("* * * * * [Selected splitting concept's NCP = ") << pSelectedPartAttrib->m_ncp << _T("]") << endl;
-	cout << endl;
-    cout << endl;
-
-
-#endif
-    
     return true;
 }
 
@@ -613,6 +717,24 @@ bool CTDPartition::hasChildConcepts(CTDConcept* pCurrConcept, CTDPartAttrib* pPa
 }
 
 
+//***************
+// CTDRootState *
+//***************
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDRootState::cleanup()
+{
+    for (int i = 0; i < m_supportCounts.GetSize(); ++i)
+        delete m_supportCounts[i];
+    for (int i = 0; i < m_sortedRecordIDs.GetSize(); ++i)
+        delete m_sortedRecordIDs[i];
+    m_supportCounts.RemoveAll();
+    m_sortedRecordIDs.RemoveAll();
+    m_classSums.RemoveAll();
+    m_nRecords = 0;
+}
+
 //****************
 // CTDPartitions *
 //****************
@@ -13,6 +13,31 @@
     #include "TDPartAttrib.h"
 #endif
 
+typedef CTypedPtrArray<CPtrArray, CTDIntArray*> CTDIntArrayPtrArray;
+
+//---------------------------------------------------------------------------
+// Raw counts and record orders of a root partition that depend neither on
+// the privacy budget nor on the noise: the class sums, the support counts
+// of the categorical candidates, and the order of the records after each
+// sort that splits a continuous candidate. They are computed once on the
+// records of a data set by CTDPartition::buildRootState and shared
+// read-only by the runs on copies of those records. The split points of
+// the continuous candidates and their support counts are drawn by each run.
+//---------------------------------------------------------------------------
+class CTDRootState
+{
+public:
+    CTDRootState() : m_nRecords(0) {};
+    virtual ~CTDRootState() { cleanup(); };
+    void cleanup();
+
+// Attributes
+    int                 m_nRecords;
+    CTDIntArray         m_classSums;        // Number of records by class.
+    CTDIntArrayPtrArray m_supportCounts;    // By partition attribute, [child * nClasses + class], or NULL if counted by the run.
+    CTDIntArrayPtrArray m_sortedRecordIDs;  // By partition attribute, record IDs after its sort, or NULL if not sorted.
+};
+
 class CTDPartition  
 {
 public:
@@ -40,15 +65,18 @@ public:
 	CTDRecords* getGenRecords() { return & m_genRecords; };
 
    
-    bool constructSupportMatrix(double epsilon);
+    bool constructSupportMatrix(double epsilon, const CTDRootState* pRootState = NULL);
+    bool buildRootState(CTDRootState& rootState);
 	bool addNoise(double epsilon);
     friend ostream& operator<<(ostream& os, const CTDPartition& partition);
 
 	
 	bool computeScore();
 	bool pickSpecializeConcept(CTDAttrib*& pSelectedAttrib, CTDConcept*& pSelectedConcept, CTDPartAttrib*& pSelectedPartAttrib, double epsilon);
+	template <TDScoreFunction scoreFunction> bool pickSpecializeConceptBy(CTDAttrib*& pSelectedAttrib, CTDConcept*& pSelectedConcept, CTDPartAttrib*& pSelectedPartAttrib, double epsilon);
 	bool hasChildConcepts(CTDConcept* pCurrConcept, CTDPartAttrib* pPartAttrib);
 	void makeMultiDimAttribs();
+	void trackMemory();
 
 
 	CTDIntArray m_classNoisySums;   // sum of classes	
@@ -58,6 +86,8 @@ public:
 	int			m_nLevelCount;		// Level number in the specialization tree. Root is at Level 0.
 	CStringArray m_path;	
 	int m_nLocalSpecializations;	// The share of nSpecializations from the parent partition for this partition.
+	int m_routeNodeIdx;				// Node of this partition in the test router.
+	LONGLONG m_sortNanos;			// Time spent sorting the records to split continuous concepts, if TD_bTRACE_PARTITIONS.
 
 
 protected:
@@ -66,6 +96,8 @@ protected:
    	CTDPartAttribs m_partAttribs;   // Pointers to attributes of this partition. Does not contain class attr.
     CTDRecords m_partRecords;       // Pointers to records of this partition.    
     int m_nClasses;                 // Number of classes.
+    LONGLONG m_recordBytes;         // Bytes of m_partRecords and of the matrices of m_partAttribs
+    LONGLONG m_matrixBytes;         // last reported to CTDMemTracker.
 	
 };
 
@@ -83,4 +115,6 @@ public:
     friend ostream& operator<<(ostream& os, const CTDPartitions& partitions);
 };
 
+typedef CTypedPtrArray<CPtrArray, CTDPartition*> CTDPartitionPtrArray;
+
 #endif
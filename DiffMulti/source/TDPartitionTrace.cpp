@@ -0,0 +1,354 @@
+// TDPartitionTrace.cpp: implementation of the CTDPartitionTrace class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDPARTITIONTRACE_H)
+    #include "TDPartitionTrace.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDPartitionTrace::CTDPartitionTrace()
+    : m_firstPartitionIdx(0),
+      m_startNanos(0)
+{
+}
+
+CTDPartitionTrace::~CTDPartitionTrace()
+{
+}
+
+//---------------------------------------------------------------------------
+// Clear the trace. The times are taken from now on.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::reset(int firstPartitionIdx)
+{
+    m_firstPartitionIdx = firstPartitionIdx;
+    m_partitions.RemoveAll();
+    m_events.RemoveAll();
+    m_startNanos = CTDProfiler::getNanos();
+}
+
+//---------------------------------------------------------------------------
+// Add a partition once its records are known.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::addPartition(CTDPartition* pPartition, int parentIdx)
+{
+    int pos = pPartition->getPartitionIdx() - m_firstPartitionIdx;
+    if (pos < 0) {
+        ASSERT(false);
+        return;
+    }
+
+    TDTracePartition partition;
+    partition.m_partitionIdx = pPartition->getPartitionIdx();
+    partition.m_parentIdx = parentIdx;
+    partition.m_depth = pPartition->m_nLevelCount;
+    partition.m_nRecords = pPartition->getNumRecords();
+    partition.m_bLeaf = false;
+    partition.m_nBudgetCount = pPartition->m_nBudgetCount;
+    partition.m_nSpecializations = 0;
+    for (int a = 0; a < TD_NUM_TRACE_ACTIVITIES; ++a)
+        partition.m_activityNanos[a] = 0;
+    partition.m_startNanos = -1;
+    partition.m_endNanos = -1;
+
+    // Partitions that are never added are skipped when writing.
+    int nPartitions = m_partitions.GetSize();
+    m_partitions.SetAtGrow(pos, partition);
+    for (int i = nPartitions; i < pos; ++i)
+        m_partitions[i].m_partitionIdx = -1;
+}
+
+//---------------------------------------------------------------------------
+// An activity from startNanos to endNanos, of which sortNanos were spent
+// sorting.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::addActivity(int partitionIdx, TDTraceActivity activity, LONGLONG startNanos, LONGLONG endNanos, LONGLONG sortNanos)
+{
+    TDTracePartition* pPartition = lookupPartition(partitionIdx);
+    if (!pPartition)
+        return;
+
+    pPartition->m_activityNanos[activity] += endNanos - startNanos - sortNanos;
+    pPartition->m_activityNanos[TD_TRACE_SORT] += sortNanos;
+
+    TDTraceEvent event;
+    event.m_partitionIdx = partitionIdx;
+    event.m_activity = activity;
+    event.m_startNanos = startNanos - m_startNanos;
+    event.m_endNanos = endNanos - m_startNanos;
+    event.m_sortNanos = sortNanos;
+    m_events.Add(event);
+}
+
+//---------------------------------------------------------------------------
+// The turn of a partition in the depth-first specialization.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::beginPartition(int partitionIdx)
+{
+    TDTracePartition* pPartition = lookupPartition(partitionIdx);
+    if (pPartition)
+        pPartition->m_startNanos = CTDProfiler::getNanos() - m_startNanos;
+}
+
+//---------------------------------------------------------------------------
+// The partition and its subtree are done.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::endPartition(int partitionIdx)
+{
+    TDTracePartition* pPartition = lookupPartition(partitionIdx);
+    if (pPartition)
+        pPartition->m_endNanos = CTDProfiler::getNanos() - m_startNanos;
+}
+
+//---------------------------------------------------------------------------
+// The partition is split on pSplitConcept of pSplitAttrib.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::setSplit(CTDPartition* pPartition, CTDAttrib* pSplitAttrib, CTDConcept* pSplitConcept, int nSpecializations)
+{
+    TDTracePartition* pTracePartition = lookupPartition(pPartition->getPartitionIdx());
+    if (!pTracePartition)
+        return;
+
+    pTracePartition->m_splitAttrib = pSplitAttrib->m_attribName;
+    pTracePartition->m_splitConcept = pSplitConcept->m_conceptValue;
+    pTracePartition->m_nBudgetCount = pPartition->m_nBudgetCount;
+    pTracePartition->m_nSpecializations = nSpecializations;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::setLeaf(CTDPartition* pPartition, int nSpecializations)
+{
+    TDTracePartition* pTracePartition = lookupPartition(pPartition->getPartitionIdx());
+    if (!pTracePartition)
+        return;
+
+    pTracePartition->m_bLeaf = true;
+    pTracePartition->m_nBudgetCount = pPartition->m_nBudgetCount;
+    pTracePartition->m_nSpecializations = nSpecializations;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+TDTracePartition* CTDPartitionTrace::lookupPartition(int partitionIdx)
+{
+    int pos = partitionIdx - m_firstPartitionIdx;
+    if (pos < 0 || pos >= m_partitions.GetSize() || m_partitions[pos].m_partitionIdx != partitionIdx) {
+        ASSERT(false);
+        return NULL;
+    }
+    return &m_partitions[pos];
+}
+
+//---------------------------------------------------------------------------
+// {"displayTimeUnit": "ns", "traceEvents": [
+//   {"name": "partition 0", "cat": "partition", "ph": "X", "pid": 1, "tid": 1,
+//    "ts": ..., "dur": ..., "args": {"parent": -1, ...}},
+//   {"name": "count", "cat": "activity", ..., "args": {"partition": 0, "sort_ns": ...}},
+//   ...]}
+// Loads in chrome://tracing and Perfetto. The times are in microseconds.
+//---------------------------------------------------------------------------
+bool CTDPartitionTrace::writeChromeTrace(LPCTSTR traceFile) const
+{
+    CTDByteBuffer buffer;
+    buffer.append(_T("{\"displayTimeUnit\": \"ns\", \"traceEvents\": ["));
+    bool bFirst = true;
+    for (int i = 0; i < m_partitions.GetSize(); ++i) {
+        const TDTracePartition& partition = m_partitions[i];
+        if (partition.m_partitionIdx < 0 || partition.m_startNanos < 0 || partition.m_endNanos < 0)
+            continue;
+
+        buffer.append(bFirst ? _T("\n") : _T(",\n"));
+        bFirst = false;
+        CString name;
+        name.Format(_T("partition %d"), partition.m_partitionIdx);
+        appendSpan(buffer, name, _T("partition"), partition.m_startNanos, partition.m_endNanos);
+        buffer.append(_T("\"parent\": "));
+        buffer.appendInt(partition.m_parentIdx);
+        buffer.append(_T(", \"depth\": "));
+        buffer.appendInt(partition.m_depth);
+        buffer.append(_T(", \"records\": "));
+        buffer.appendInt(partition.m_nRecords);
+        buffer.append(_T(", \"split_attribute\": "));
+        appendJSONString(buffer, partition.m_splitAttrib);
+        buffer.append(_T(", \"split_concept\": "));
+        appendJSONString(buffer, partition.m_splitConcept);
+        buffer.append(partition.m_bLeaf ? _T(", \"leaf\": true") : _T(", \"leaf\": false"));
+        buffer.append(_T(", \"budget_count\": "));
+        buffer.appendInt(partition.m_nBudgetCount);
+        buffer.append(_T(", \"specializations\": "));
+        buffer.appendInt(partition.m_nSpecializations);
+        for (int a = 0; a < TD_NUM_TRACE_ACTIVITIES; ++a) {
+            buffer.append(_T(", \""));
+            buffer.append(getActivityName(TDTraceActivity(a)));
+            buffer.append(_T("_ns\": "));
+            buffer.appendFloat(double(partition.m_activityNanos[a]), 0);
+        }
+        buffer.append(_T("}}"));
+    }
+
+    for (int e = 0; e < m_events.GetSize(); ++e) {
+        const TDTraceEvent& event = m_events[e];
+        buffer.append(bFirst ? _T("\n") : _T(",\n"));
+        bFirst = false;
+        appendSpan(buffer, getActivityName(event.m_activity), _T("activity"), event.m_startNanos, event.m_endNanos);
+        buffer.append(_T("\"partition\": "));
+        buffer.appendInt(event.m_partitionIdx);
+        if (event.m_activity == TD_TRACE_COUNT) {
+            buffer.append(_T(", \"sort_ns\": "));
+            buffer.appendFloat(double(event.m_sortNanos), 0);
+        }
+        buffer.append(_T("}}"));
+    }
+    buffer.append(_T("\n]}\n"));
+    return writeFile(traceFile, buffer);
+}
+
+//---------------------------------------------------------------------------
+// A complete event up to the opening brace of its arguments.
+//---------------------------------------------------------------------------
+void CTDPartitionTrace::appendSpan(CTDByteBuffer& buffer, LPCTSTR name, LPCTSTR category, LONGLONG startNanos, LONGLONG endNanos) const
+{
+    buffer.append(_T("{\"name\": \""));
+    buffer.append(name);
+    buffer.append(_T("\", \"cat\": \""));
+    buffer.append(category);
+    buffer.append(_T("\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": "));
+    buffer.appendFloat(startNanos / 1000.0, 3);
+    buffer.append(_T(", \"dur\": "));
+    buffer.appendFloat((endNanos - startNanos) / 1000.0, 3);
+    buffer.append(_T(", \"args\": {"));
+}
+
+//---------------------------------------------------------------------------
+// partition,parent,depth,records,split_attribute,split_concept,leaf,
+// budget_count,specializations,count_ns,sort_ns,score_ns,start_ns,end_ns
+//---------------------------------------------------------------------------
+bool CTDPartitionTrace::writeCSV(LPCTSTR csvFile) const
+{
+    CTDByteBuffer buffer;
+    buffer.append(_T("partition,parent,depth,records,split_attribute,split_concept,leaf,budget_count,specializations"));
+    for (int a = 0; a < TD_NUM_TRACE_ACTIVITIES; ++a) {
+        buffer.append(TCHAR(','));
+        buffer.append(getActivityName(TDTraceActivity(a)));
+        buffer.append(_T("_ns"));
+    }
+    buffer.append(_T(",start_ns,end_ns\n"));
+
+    for (int i = 0; i < m_partitions.GetSize(); ++i) {
+        const TDTracePartition& partition = m_partitions[i];
+        if (partition.m_partitionIdx < 0)
+            continue;
+
+        buffer.appendInt(partition.m_partitionIdx);
+        buffer.append(TCHAR(','));
+        buffer.appendInt(partition.m_parentIdx);
+        buffer.append(TCHAR(','));
+        buffer.appendInt(partition.m_depth);
+        buffer.append(TCHAR(','));
+        buffer.appendInt(partition.m_nRecords);
+        buffer.append(TCHAR(','));
+        appendCSVString(buffer, partition.m_splitAttrib);
+        buffer.append(TCHAR(','));
+        appendCSVString(buffer, partition.m_splitConcept);
+        buffer.append(partition.m_bLeaf ? _T(",1,") : _T(",0,"));
+        buffer.appendInt(partition.m_nBudgetCount);
+        buffer.append(TCHAR(','));
+        buffer.appendInt(partition.m_nSpecializations);
+        for (int a = 0; a < TD_NUM_TRACE_ACTIVITIES; ++a) {
+            buffer.append(TCHAR(','));
+            buffer.appendFloat(double(partition.m_activityNanos[a]), 0);
+        }
+        buffer.append(TCHAR(','));
+        buffer.appendFloat(double(partition.m_startNanos), 0);
+        buffer.append(TCHAR(','));
+        buffer.appendFloat(double(partition.m_endNanos), 0);
+        buffer.append(TCHAR('\n'));
+    }
+    return writeFile(csvFile, buffer);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+void CTDPartitionTrace::appendJSONString(CTDByteBuffer& buffer, const CString& str)
+{
+    buffer.append(TCHAR('"'));
+    for (int i = 0; i < str.GetLength(); ++i) {
+        TCHAR ch = str[i];
+        if (ch == TCHAR('"') || ch == TCHAR('\\'))
+            buffer.append(TCHAR('\\'));
+        buffer.append(ch);
+    }
+    buffer.append(TCHAR('"'));
+}
+
+//---------------------------------------------------------------------------
+// Quoted if the value has a delimiter or a quote.
+//---------------------------------------------------------------------------
+// static
+void CTDPartitionTrace::appendCSVString(CTDByteBuffer& buffer, const CString& str)
+{
+    if (str.FindOneOf(_T(",\"\n")) < 0) {
+        buffer.append(str);
+        return;
+    }
+
+    buffer.append(TCHAR('"'));
+    for (int i = 0; i < str.GetLength(); ++i) {
+        if (str[i] == TCHAR('"'))
+            buffer.append(TCHAR('"'));
+        buffer.append(str[i]);
+    }
+    buffer.append(TCHAR('"'));
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+bool CTDPartitionTrace::writeFile(LPCTSTR fileName, const CTDByteBuffer& buffer)
+{
+    try {
+        CFile file;
+        if (!file.Open(fileName, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDPartitionTrace: Failed to open file ") << fileName << endl;
+            return false;
+        }
+        file.Write(buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write trace file: ") << fileName << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+LPCTSTR CTDPartitionTrace::getActivityName(TDTraceActivity activity)
+{
+    switch (activity) {
+    case TD_TRACE_COUNT:
+        return _T("count");
+    case TD_TRACE_SORT:
+        return _T("sort");
+    case TD_TRACE_SCORE:
+        return _T("score");
+    default:
+        ASSERT(false);
+        return _T("");
+    }
+}
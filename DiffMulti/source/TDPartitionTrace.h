@@ -0,0 +1,102 @@
+// TDPartitionTrace.h: interface for the CTDPartitionTrace class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDPARTITIONTRACE_H)
+#define TDPARTITIONTRACE_H
+
+#if !defined(TDPARTITION_H)
+    #include "TDPartition.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+enum TDTraceActivity
+{
+    TD_TRACE_COUNT,                     // CTDPartition::constructSupportMatrix, without the sorting.
+    TD_TRACE_SORT,                      // Sorting the records to split a continuous concept.
+    TD_TRACE_SCORE,                     // CTDPartition::computeScore and pickSpecializeConcept.
+    TD_NUM_TRACE_ACTIVITIES
+};
+
+//---------------------------------------------------------------------------
+// One partition of the specialization tree.
+//---------------------------------------------------------------------------
+struct TDTracePartition
+{
+    int         m_partitionIdx;
+    int         m_parentIdx;                // -1 for the root.
+    int         m_depth;
+    int         m_nRecords;
+    CString     m_splitAttrib;              // Empty for a leaf.
+    CString     m_splitConcept;
+    bool        m_bLeaf;
+    int         m_nBudgetCount;
+    int         m_nSpecializations;         // Specializations left to this partition and its subtree.
+    LONGLONG    m_activityNanos[TD_NUM_TRACE_ACTIVITIES];
+    LONGLONG    m_startNanos;               // Turn of the partition and its subtree in the depth-first
+    LONGLONG    m_endNanos;                 // specialization, since the trace was reset.
+};
+
+//---------------------------------------------------------------------------
+// One timed activity of a partition.
+//---------------------------------------------------------------------------
+struct TDTraceEvent
+{
+    int             m_partitionIdx;
+    TDTraceActivity m_activity;
+    LONGLONG        m_startNanos;
+    LONGLONG        m_endNanos;
+    LONGLONG        m_sortNanos;            // Part of a count spent sorting.
+};
+
+typedef CArray<TDTracePartition, const TDTracePartition&> CTDTracePartitionArray;
+typedef CArray<TDTraceEvent, const TDTraceEvent&> CTDTraceEventArray;
+
+//---------------------------------------------------------------------------
+// Trace of the partition tree built by CTDPartitioner: the parent, split,
+// rows, budget and specializations of every partition, and the time of
+// its counting, sorting and scoring. The partitions are identified by
+// their indices, which are consecutive from the one given to reset.
+// The trace is written as Chrome trace events, with one span per
+// partition covering its subtree and one per activity, and as a CSV file
+// with one row per partition.
+//---------------------------------------------------------------------------
+class CTDPartitionTrace
+{
+public:
+    CTDPartitionTrace();
+    virtual ~CTDPartitionTrace();
+
+// Operations
+    void reset(int firstPartitionIdx);
+    void addPartition(CTDPartition* pPartition, int parentIdx);
+    void addActivity(int partitionIdx, TDTraceActivity activity, LONGLONG startNanos, LONGLONG endNanos, LONGLONG sortNanos = 0);
+    void beginPartition(int partitionIdx);
+    void endPartition(int partitionIdx);
+    void setSplit(CTDPartition* pPartition, CTDAttrib* pSplitAttrib, CTDConcept* pSplitConcept, int nSpecializations);
+    void setLeaf(CTDPartition* pPartition, int nSpecializations);
+    int getNumPartitions() const { return m_partitions.GetSize(); };
+    const TDTracePartition& getPartition(int idx) const { return m_partitions[idx]; };
+    bool writeChromeTrace(LPCTSTR traceFile) const;
+    bool writeCSV(LPCTSTR csvFile) const;
+
+    static LPCTSTR getActivityName(TDTraceActivity activity);
+
+protected:
+    TDTracePartition* lookupPartition(int partitionIdx);
+    void appendSpan(CTDByteBuffer& buffer, LPCTSTR name, LPCTSTR category, LONGLONG startNanos, LONGLONG endNanos) const;
+    static void appendJSONString(CTDByteBuffer& buffer, const CString& str);
+    static void appendCSVString(CTDByteBuffer& buffer, const CString& str);
+    static bool writeFile(LPCTSTR fileName, const CTDByteBuffer& buffer);
+
+// Attributes
+    int                     m_firstPartitionIdx;
+    LONGLONG                m_startNanos;
+    CTDTracePartitionArray  m_partitions;       // By partition index - m_firstPartitionIdx.
+    CTDTraceEventArray      m_events;
+};
+
+#endif
@@ -9,13 +9,6 @@
     #include "TDPartitioner.h"
 #endif
 
-
-static int gPartitionIndex = 0;
-static int gTestPartitionIndex = 0;
-static int q = 0;
-
-
-
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -23,12 +16,16 @@ static int q = 0;
 CTDPartitioner::CTDPartitioner(int nSpecialization, double pBudget, int nTraining) 
     : m_pAttribMgr(NULL),
 	  m_pDataMgr(NULL), 
+	  m_pProfiler(NULL),
+	  m_pRootState(NULL),
 	  m_nSpecialization(nSpecialization), 
 	  m_nMaxLevel(0),
       m_pBudget(pBudget),
 	  m_nTraining(nTraining),
 	  m_remainder(0.0f),
-	  m_workingBudget(-1)
+	  m_workingBudget(-1),
+	  m_nextPartitionIdx(0),
+	  m_nSpecialized(0)
 {
 }
 
@@ -36,20 +33,19 @@ CTDPartitioner::~CTDPartitioner()
 {
 	m_tempPartitions.cleanup();
     m_leafPartitions.cleanup();
-	m_testLeafPartitions.cleanup();
-	m_testTempPartitions.cleanup();
 }
 
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
-bool CTDPartitioner::initialize(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr)
+bool CTDPartitioner::initialize(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr, CTDProfiler* pProfiler)
 {
-    if (!pAttribMgr || !pDataMgr) {
+    if (!pAttribMgr || !pDataMgr || !pProfiler) {
         ASSERT(false);
         return false;
     }
     m_pAttribMgr = pAttribMgr;
     m_pDataMgr = pDataMgr;    
+    m_pProfiler = pProfiler;
     return true;
 }
 
@@ -72,11 +68,11 @@ bool CTDPartitioner::transformData()
 		return false;
 	}
 	
-	// We maintain a separate tree structure for test data to perform the same genearalization.
-	// Testing records.
-	CTDPartition* pTestRootPartition = initTestRootPartition();
-    if (!pTestRootPartition)
-        return false;
+	// Count the specializations of this run only.
+	m_nSpecialized = 0;
+
+	// The split decisions are recorded to route the test records afterwards.
+	pRootPartition->m_routeNodeIdx = m_testRouter.reset();
 
 	if(!initializeBudget()){
 		ASSERT(false);
@@ -86,14 +82,24 @@ bool CTDPartitioner::transformData()
 	// Budget used n times, n is the number of continuous attributes.
 	pRootPartition->m_nBudgetCount += m_pAttribMgr->getNumConAttribs();
 
+	// The trace starts with the root partition.
+	if (TD_bTRACE_PARTITIONS)
+		m_trace.reset(pRootPartition->getPartitionIdx());
+
 	// Construct raw counts of the partition.
-    if (!pRootPartition->constructSupportMatrix(m_workingBudget)) {
+	m_pProfiler->startPhase(TD_PHASE_ROOT_SUPPORT);
+    if (!countPartition(pRootPartition, -1, m_pRootState)) {
         delete pRootPartition;
         return false;
     }
+	m_pProfiler->stopPhase(TD_PHASE_ROOT_SUPPORT);
 	
+	m_pProfiler->startPhase(TD_PHASE_SPECIALIZATION);
+	if (TD_bTRACE_PARTITIONS)
+		m_trace.beginPartition(pRootPartition->getPartitionIdx());
+
     // Compute a score (e.g. Max) for each concept in the current partition.
-    if (!pRootPartition->computeScore()) {
+    if (!scorePartition(pRootPartition)) {
         delete pRootPartition;
         return false;
     }
@@ -103,41 +109,33 @@ bool CTDPartitioner::transformData()
     m_leafPartitions.cleanup();
 	pRootPartition->m_leafPos = m_tempPartitions.AddHead(pRootPartition);
     
-	
-	// Add testRoot partition to m_testTempPartitions.
-	m_testLeafPartitions.cleanup();
-	m_testTempPartitions.cleanup();
-	pTestRootPartition->m_leafPos = m_testTempPartitions.AddHead(pTestRootPartition);
-    
 
 	// Recursively perform m_nSpecialization specializations, depth-first.
-	if (!specializePartition(pRootPartition, pTestRootPartition, m_nSpecialization, m_remainder, m_nTraining)) {
+	if (!specializePartition(pRootPartition, m_nSpecialization, m_remainder, m_nTraining)) {
 		m_tempPartitions.cleanup();
 		m_leafPartitions.cleanup();	
-		m_testTempPartitions.cleanup();
-		m_testLeafPartitions.cleanup();
 		return false;
 	}
 
-	 // Delete empty test leaf partitions.
-    m_testLeafPartitions.deleteEmptyPartitions();
+	// Route the test records through the split decisions to the leaves.
+	if (!m_testRouter.routeRecords(m_pDataMgr->getTestRecords(), m_leafPartitions.GetSize()))
+		return false;
+	m_pProfiler->stopPhase(TD_PHASE_SPECIALIZATION);
+	CTDProfiler::addCount(TD_COUNTER_LEAVES, m_leafPartitions.GetSize());
 
 	// List of temporary partitions should be empty.
-	if (!m_tempPartitions.IsEmpty() || !m_testTempPartitions.IsEmpty()) { 
+	if (!m_tempPartitions.IsEmpty()) { 
 		cout << endl;
 		cout << "***" << endl;
 		cout << _T("CTDPartitioner::transformData(): Warning. List of temp Partitions should be empty.") << endl;
-		if (!m_tempPartitions.IsEmpty())
-			cout << "m_tempPartitions is not empty." << endl;
-		if (!m_testTempPartitions.IsEmpty())
-			cout << "m_testTempPartitions is not empty." << endl;
+		cout << "m_tempPartitions is not empty." << endl;
 		cout << "***";
 		cout << endl << endl;
 	}
 
     cout << _T("\nPartitioning data succeeded.") << endl;
 	cout << "Number of input specializations m_nSpecialization     : " << m_nSpecialization << endl;
-	cout << "Number of actual specializations q                    : " << q << endl << endl;
+	cout << "Number of actual specializations q                    : " << m_nSpecialized << endl << endl;
     
 	return true;
 }
@@ -157,9 +155,10 @@ bool CTDPartitioner::transformData()
 //					Case 3: Ignored.
 //					Case 4: h = 0.
 //---------------------------------------------------------------------------
-bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDPartition* pTestRootPartition, int nSpecializations, double& remainder, int nParentRecords)
+bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, int nSpecializations, double& remainder, int nParentRecords)
 {
 	double totalRemainder = remainder;	
+	int partitionIdx = pRootPartition->getPartitionIdx();
 
 	// Validate parameters
 	if(nSpecializations <= 0 || remainder < 0.0) {
@@ -175,8 +174,11 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 	CTDPartAttrib* pSelectedPartAttrib = NULL;
 
 	// Use expoMech() to select a concept from current partition for specialization
+	LONGLONG pickStart = TD_bTRACE_PARTITIONS ? CTDProfiler::getNanos() : 0;
 	if(!pRootPartition->pickSpecializeConcept(pSelectedAttrib, pSelectedConcept, pSelectedPartAttrib, m_workingBudget))
 		return false;
+	if (TD_bTRACE_PARTITIONS)
+		m_trace.addActivity(partitionIdx, TD_TRACE_SCORE, pickStart, CTDProfiler::getNanos());
 
 	// nSpecializations: Case 1
 	// Leaf partition: Case 1
@@ -184,10 +186,14 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 	// If specialization ended before h=0, remaining h is added to next path		<<======== This is a leaf partition.
 	if (!pSelectedAttrib || !pSelectedConcept || !pSelectedPartAttrib) {
 		remainder += nSpecializations;
+		m_testRouter.setLeaf(pRootPartition->m_routeNodeIdx, m_leafPartitions.GetSize());
 		pRootPartition->m_leafPos		= m_leafPartitions.AddTail(m_tempPartitions.RemoveHead());
 		pRootPartition->makeMultiDimAttribs();
-		pTestRootPartition->m_leafPos	= m_testLeafPartitions.AddTail(m_testTempPartitions.RemoveHead());
 		pRootPartition->m_path.Add("None");
+		if (TD_bTRACE_PARTITIONS) {
+			m_trace.setLeaf(pRootPartition, nSpecializations);
+			m_trace.endPartition(partitionIdx);
+		}
 		return true;
 	}
 
@@ -202,27 +208,22 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 
 	// Budget used once in splitPartitions() below to add Laplace noise to the number of records
 	pRootPartition->m_nBudgetCount += 1;
+
+	if (TD_bTRACE_PARTITIONS)
+		m_trace.setSplit(pRootPartition, pSelectedAttrib, pSelectedConcept, nSpecializations);
 		
 	// Split the parent partition based on the selected concept
 	int nChildPartitions = -1;
 	if (!splitPartitions(pRootPartition, pSelectedPartAttrib, pSelectedAttrib, pSelectedConcept, nChildPartitions, nSpecializations, m_workingBudget)) 
         return false;
-	
-	if (!splitTestPartitions(pTestRootPartition, pSelectedPartAttrib, pSelectedAttrib, pSelectedConcept)) 
-        return false;
    
 	// Remove parent partition from m_tempPartitions
 	m_tempPartitions.RemoveAt(pRootPartition->m_leafPos);
 	delete pRootPartition;
 	pRootPartition = NULL;
 
-	// Remove parent partition from testTempPartitions.
-    m_testTempPartitions.RemoveAt(pTestRootPartition->m_leafPos);
-    delete pTestRootPartition;
-    pTestRootPartition = NULL;
-
 	// A specialization counter
-	++q;
+	++m_nSpecialized;
 		
 	// nSpecializations: Case 3 IGNORED.
 	// If Case 2 is true but not all partitions of 
@@ -232,9 +233,8 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 	{
 		// Obtain partition from m_tempPartitions.
 		pRootPartition = getNextPartition();	
-		pTestRootPartition = getNextTestPartition();
 
-		if (!pRootPartition || !pTestRootPartition) {
+		if (!pRootPartition) {
 			cerr << _T("CTDPartitioner::specializePartition(): no next partition.") << endl;
 			ASSERT(false);
 			return false;
@@ -248,23 +248,30 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 		if (nLocalSpecializations < 0)
 			nLocalSpecializations = 0;
 
+		if (TD_bTRACE_PARTITIONS)
+			m_trace.beginPartition(pRootPartition->getPartitionIdx());
+
 		// nSpecializations: Case 4:
 		// Leaf partition: Case 3.													<<========= This is a leaf partition.
 		if ((nLocalSpecializations == 0) || (pRootPartition->m_nLevelCount >= m_nMaxLevel)) {     
+			m_testRouter.setLeaf(pRootPartition->m_routeNodeIdx, m_leafPartitions.GetSize());
 			pRootPartition->m_leafPos		= m_leafPartitions.AddTail(m_tempPartitions.RemoveHead());
 			pRootPartition->makeMultiDimAttribs();
-			pTestRootPartition->m_leafPos	= m_testLeafPartitions.AddTail(m_testTempPartitions.RemoveHead());
 			pRootPartition->m_path.Add("None");
+			if (TD_bTRACE_PARTITIONS) {
+				m_trace.setLeaf(pRootPartition, nLocalSpecializations);
+				m_trace.endPartition(pRootPartition->getPartitionIdx());
+			}
 			continue;
 		}
 
 
 		// If nSpecializations >= 1.
 		// Depth-first: compute score of each m_partAttrib in the next partition.
-		if (!pRootPartition->computeScore()) 
+		if (!scorePartition(pRootPartition)) 
 			return false; 
 
-		if (!specializePartition(pRootPartition, pTestRootPartition, nLocalSpecializations, totalRemainder, pRootPartition->getNumRecords())) {
+		if (!specializePartition(pRootPartition, nLocalSpecializations, totalRemainder, pRootPartition->getNumRecords())) {
 			cerr << _T("CTDPartitioner: Cannot specialize on partition.") << endl;
 			ASSERT(false);
 			return NULL;
@@ -273,42 +280,62 @@ bool CTDPartitioner::specializePartition(CTDPartition*& pRootPartition, CTDParti
 
 	remainder = totalRemainder;
 
+	if (TD_bTRACE_PARTITIONS)
+		m_trace.endPartition(partitionIdx);
 	return true;
 	
 }
 
 //---------------------------------------------------------------------------
-// Deapth-first
-// All partitions are kept in m_tempPartitions
+// Construct the support matrix of a partition, timed if the partition tree
+// is traced. pRootState is given for the root partition only.
 //---------------------------------------------------------------------------
-CTDPartition* CTDPartitioner::getNextPartition()
+bool CTDPartitioner::countPartition(CTDPartition* pPartition, int parentIdx, const CTDRootState* pRootState)
 {
-	CTDPartitions* pPartitions = NULL;
+	if (!TD_bTRACE_PARTITIONS)
+		return pPartition->constructSupportMatrix(m_workingBudget, pRootState);
 
-	// Size should be >= 1
-	if (m_tempPartitions.GetSize() < 1) {
-		cerr << _T("CTDPartitioner::getNextPartition(): Empty m_leafPartitions.") << endl;
-		return NULL;
-	}
+	m_trace.addPartition(pPartition, parentIdx);
+	pPartition->m_sortNanos = 0;
+	LONGLONG startNanos = CTDProfiler::getNanos();
+	if (!pPartition->constructSupportMatrix(m_workingBudget, pRootState))
+		return false;
 
-	return m_tempPartitions.GetHead();
+	m_trace.addActivity(pPartition->getPartitionIdx(), TD_TRACE_COUNT, startNanos, CTDProfiler::getNanos(), pPartition->m_sortNanos);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Compute the scores of a partition, timed if the partition tree is traced.
+//---------------------------------------------------------------------------
+bool CTDPartitioner::scorePartition(CTDPartition* pPartition)
+{
+	if (!TD_bTRACE_PARTITIONS)
+		return pPartition->computeScore();
+
+	LONGLONG startNanos = CTDProfiler::getNanos();
+	if (!pPartition->computeScore())
+		return false;
+
+	m_trace.addActivity(pPartition->getPartitionIdx(), TD_TRACE_SCORE, startNanos, CTDProfiler::getNanos());
+	return true;
 }
 
 //---------------------------------------------------------------------------
 // Deapth-first
-// All test partitions are kept in m_testTempPartitions
+// All partitions are kept in m_tempPartitions
 //---------------------------------------------------------------------------
-CTDPartition* CTDPartitioner::getNextTestPartition()
+CTDPartition* CTDPartitioner::getNextPartition()
 {
 	CTDPartitions* pPartitions = NULL;
 
 	// Size should be >= 1
-	if (m_testTempPartitions.GetSize() < 1) {
-		cerr << _T("CTDPartitioner::getNextPartition(): Empty m_testTempPartitions.") << endl;
+	if (m_tempPartitions.GetSize() < 1) {
+		cerr << _T("CTDPartitioner::getNextPartition(): Empty m_leafPartitions.") << endl;
 		return NULL;
 	}
 
-	return m_testTempPartitions.GetHead();
+	return m_tempPartitions.GetHead();
 }
 
 //---------------------------------------------------------------------------
@@ -345,7 +372,7 @@ bool CTDPartitioner::addNoise()
 	
 	cout << _T("The number of leaf partitions is ")<< m_leafPartitions.GetSize()<< endl;
 	cout << _T("Remaining privacy budget for leaf nodes: ")<< m_pBudget << endl;
-	cout << _T("Unused nSpecializations: ") << m_nSpecialization - q + m_remainder << endl << endl;
+	cout << _T("Unused nSpecializations: ") << m_nSpecialization - m_nSpecialized + m_remainder << endl << endl;
 
 	return true;
 }
@@ -356,7 +383,7 @@ bool CTDPartitioner::addNoise()
 //---------------------------------------------------------------------------
 CTDPartition* CTDPartitioner::initRootPartition()
 {
-    CTDPartition* pPartition = new CTDPartition(gPartitionIndex++, m_pAttribMgr->getAttributes());
+    CTDPartition* pPartition = new CTDPartition(m_nextPartitionIdx++, m_pAttribMgr->getAttributes());
     if (!pPartition)
         return NULL;
 
@@ -383,38 +410,6 @@ CTDPartition* CTDPartitioner::initRootPartition()
   
   return pPartition;
 }
-//---------------------------------------------------------------------------
-//---------------------------------------------------------------------------
-CTDPartition* CTDPartitioner::initTestRootPartition()
-{
-    CTDPartition* pPartition = new CTDPartition(gTestPartitionIndex++, m_pAttribMgr->getAttributes());
-    if (!pPartition)
-        return NULL;
-
-    CTDRecords* pRecs = m_pDataMgr->getTestRecords();
-    if (!pRecs) {
-        delete pPartition;
-        return NULL;
-    }
-
-    int nRecs = pRecs->GetSize();
-    for (int i = 0; i < nRecs; ++i) {
-        if (!pPartition->addRecord(pRecs->GetAt(i))) {
-            delete pPartition;
-            return NULL;
-        }
-    }
-
-    if (pPartition->getNumRecords() <= 0) {
-        cerr << _T("CTDPartitioner: Zero number of records in root test partition.") << endl;
-        delete pPartition;
-        ASSERT(false);
-        return NULL;
-    }
- 
-  return pPartition;
-}
-
 //---------------------------------------------------------------------------
 // Compute epsilon prime based on an estimation of the longest root-to-leaf path, m_nMaxLevel.
 // m_nMaxLevel is the level sum of all hierarchies.
@@ -451,10 +446,6 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
     CTDPartitions childPartitions;
     CTDPartition* pChildPartition = NULL;
     
-#ifdef _DEBUG_PRT_INFO                        
-        cout << _T("----------------------[Splitting Parent Partition]------------------------") << endl;
-        cout << *pParentPartition;
-#endif
 		
 	// Distribute records from parent paritition to child partitions
 	if (!distributeRecords(pParentPartition, pSplitPartAttrib, pSplitAttrib, pSplitConcept, childPartitions)) 
@@ -502,15 +493,6 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
 		else {
 			pChildPartition->m_nLocalSpecializations = 0; x = 0; }
 
-#ifdef _DEBUG_PRT_INFO
-		cout << "noise								: " << noises[i] << endl;
-		cout << "nSpecializations - 1				: " << nSpecializations - 1 << endl;
-		cout << "pChildPartition->getNumRecords()	: " << pChildPartition->getNumRecords() << endl;
-		cout << "pParentPartition->getNumRecords()	: " << pParentPartition->getNumRecords() << endl;
-		cout << "pChildPartition->m_nLocalSpecializations before noise: " << x << endl;
-		cout << "pChildPartition->m_nLocalSpecializations after noise : " << pChildPartition->m_nLocalSpecializations << endl;
-		cout << "Difference                                           : " << pChildPartition->m_nLocalSpecializations - x << endl << endl;
-#endif
 
 		nSpecSum += pChildPartition->m_nLocalSpecializations;
 
@@ -518,13 +500,9 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
 		// First-Input-Last-Output: child partitions added to the head of m_tempPartitions.
 		pChildPartition->m_leafPos = m_tempPartitions.AddHead(pChildPartition);
 
-#ifdef _DEBUG_PRT_INFO
-            cout << _T("------------------------[Splitted Child Partition]------------------------") << endl;
-            cout << *pChildPartition;
-#endif
 		// Compute support matrix
 		// Construct raw counts
-		if (!pChildPartition->constructSupportMatrix(m_workingBudget)) {
+		if (!countPartition(pChildPartition, pParentPartition->getPartitionIdx())) {
 			ASSERT(false);
 			return false;
 		}
@@ -537,18 +515,9 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
 	// Evenly distribute the remaining
 	if (nSpecializations - 1 > nSpecSum) {
 		int extra = nSpecializations - 1 - nSpecSum;
-#ifdef _DEBUG_PRT_INFO
-		cout << "\n";
-		cout << "Parent nSpec - 1     : " << nSpecializations - 1 << endl;
-		cout << "Num of child Partitions : " << nChildPartitions << endl;
-		cout << "extra = nSpecializations - 1 - nSpecSum = " << nSpecializations - 1 - nSpecSum << endl << endl;
-#endif
 		for (POSITION childPos = childPartitions.GetHeadPosition(); childPos != NULL;) {
 			pChildPartition = childPartitions.GetNext(childPos);
 			pChildPartition->m_nLocalSpecializations += 1;
-#ifdef _DEBUG_PRT_INFO
-			cout << "Adding to pChildPartition->m_nLocalSpecializations: " << pChildPartition->m_nLocalSpecializations << endl << endl;
-#endif
 			extra--;
 			if (extra == 0)
 				break;
@@ -562,21 +531,12 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
 	// Evenly reduce the extra
 	else if (nSpecSum > nSpecializations - 1) {
 		int extra = nSpecializations - 1 - nSpecSum;
-#ifdef _DEBUG_PRT_INFO
-		cout << "\n";
-		cout << "Parent nSpec - 1     : " << nSpecializations - 1 << endl;
-		cout << "Num of child Partitions : " << nChildPartitions << endl;
-		cout << "extra = nSpecializations - 1 - nSpecSum = " << nSpecializations - 1 - nSpecSum << endl << endl;
-#endif
 		for (POSITION childPos = childPartitions.GetHeadPosition(); childPos != NULL;) {
 			pChildPartition = childPartitions.GetNext(childPos);
 			// m_nLocalSpecializations should be >= 0.
 			if (pChildPartition->m_nLocalSpecializations <= 0)
 				continue;
 			pChildPartition->m_nLocalSpecializations -= 1;
-#ifdef _DEBUG_PRT_INFO
-			cout << "Subtracting from pChildPartition->m_nLocalSpecializations: " << pChildPartition->m_nLocalSpecializations << endl << endl;
-#endif
 			extra++;
 			if (extra == 0)
 				break;
@@ -592,45 +552,6 @@ bool CTDPartitioner::splitPartitions(CTDPartition* pParentPartition,
     return true;
 }
 
-//---------------------------------------------------------------------------
-// Spliting records among test partitions like the previous function
-//---------------------------------------------------------------------------
-bool CTDPartitioner::splitTestPartitions(CTDPartition* pParentPartition,
-										 CTDPartAttrib* pSelectedPartAttrib,
-										 CTDAttrib* pSplitAttrib,
-										 CTDConcept* pSplitConcept)
-{
-	ASSERT (pParentPartition && pSelectedPartAttrib && pSplitAttrib && pSplitConcept);
-
-    CTDPartitions childPartitions;
-    CTDPartition* pChildPartition = NULL;
-
-#ifdef _DEBUG_PRT_INFO                        
-        cout << _T("--------------------[Splitting Parent Test Partition]---------------------") << endl;
-        cout << *pParentPartition;
-#endif
-        
-    // Distribute records from parent paritition to child partitions.
-    if (!testDistributeRecords(pParentPartition, pSelectedPartAttrib, pSplitAttrib, pSplitConcept, childPartitions))
-        return false;
-
-	for (POSITION childPos = childPartitions.GetTailPosition(); childPos != NULL;) {
-		pChildPartition = childPartitions.GetPrev(childPos);
-		
-		// Add child partitions to m_testTempPartitions.
-		// First-Input-Last-Output: child partitions added to the head of m_testTempParitions.
-		pChildPartition->m_leafPos = m_testTempPartitions.AddHead(pChildPartition);
-
-		#ifdef _DEBUG_PRT_INFO
-            cout << _T("---------------------[Splitted Child Test Partition]----------------------") << endl;
-            cout << *pChildPartition;
-		#endif
-	}
-
-    return true;
-}
-
-
 //---------------------------------------------------------------------------
 // Distribute records from parent paritition to child partitions.
 //---------------------------------------------------------------------------
@@ -644,19 +565,22 @@ bool CTDPartitioner::distributeRecords(CTDPartition*  pParentPartition,
 
 	// Construct a partition for each child concept. 
 	if (pSplitAttrib->isContinuous()) {
-		CTDPartition* pPartition1 = new CTDPartition(gPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
+		CTDPartition* pPartition1 = new CTDPartition(m_nextPartitionIdx++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
 		pPartition1->m_leafPos = childPartitions.AddTail(pPartition1);
 
-		CTDPartition* pPartition2 = new CTDPartition(gPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
+		CTDPartition* pPartition2 = new CTDPartition(m_nextPartitionIdx++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
 		pPartition2->m_leafPos = childPartitions.AddTail(pPartition2);
 	}
 	else {
 		for (int childIdx = 0; childIdx < pSplitConcept->getNumChildConcepts(); ++childIdx)	{
-			CTDPartition* pPartition = new CTDPartition(gPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
+			CTDPartition* pPartition = new CTDPartition(m_nextPartitionIdx++, m_pAttribMgr->getAttributes(), pParentPartition, pSplitAttrib->m_attribIdx);
 			pPartition->m_leafPos = childPartitions.AddTail(pPartition);
 		}
 	}
 
+	// Record the split for routing the test records.
+	int firstRouteNode = m_testRouter.addSplit(pParentPartition->m_routeNodeIdx, pSplitAttrib, pSplitConcept, pSplitPartAttrib, childPartitions.GetCount());
+
     // Generate the generalized records for every child partition.
 	CTDPartition* pChildPartition = NULL;
 	int idx = 0;
@@ -664,6 +588,7 @@ bool CTDPartitioner::distributeRecords(CTDPartition*  pParentPartition,
         pChildPartition = childPartitions.GetNext(childPos);
 
 		pChildPartition->m_path.Add(pSplitAttrib->m_attribName);
+		pChildPartition->m_routeNodeIdx = firstRouteNode + idx;
 
 		if (!pChildPartition->genRecords(pParentPartition, pSplitAttrib, pSplitConcept, m_pAttribMgr->getAttributes(), idx)) {
             ASSERT(false);
@@ -711,71 +636,3 @@ bool CTDPartitioner::distributeRecords(CTDPartition*  pParentPartition,
 
     return true;
 }
-
-//---------------------------------------------------------------------------
-// Distribute records from parent paritition to child partitions
-//---------------------------------------------------------------------------
-bool CTDPartitioner::testDistributeRecords(	CTDPartition*  pParentPartition,
-											CTDPartAttrib* pSplitPartAttrib,
-											CTDAttrib*     pSplitAttrib, 
-											CTDConcept*    pSplitConcept, 
-											CTDPartitions& childPartitions) 
-{
-    childPartitions.RemoveAll();
-	int x = -1;
-
-	// Construct a partition for each child concept
-	if (pSplitAttrib->isContinuous()) {
-		CTDPartition* pPartition1 = new CTDPartition(gTestPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition);
-		pPartition1->m_leafPos = childPartitions.AddTail(pPartition1);
-		CTDPartition* pPartition2 = new CTDPartition(gTestPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition);
-		pPartition2->m_leafPos = childPartitions.AddTail(pPartition2);
-	}
-	else {
-		for (int childIdx = 0; childIdx < pSplitConcept->getNumChildConcepts(); ++childIdx)	{
-			CTDPartition* pPartition = new CTDPartition(gTestPartitionIndex++, m_pAttribMgr->getAttributes(), pParentPartition);
-			pPartition->m_leafPos = childPartitions.AddTail(pPartition);
-		}
-	}
-
-    
-
-    // Scan through each record in the parent partition and
-    // add records to the corresponding child partition based
-    // on the child concept
-    CTDRecord* pRec = NULL;
-    CTDValue* pSplitValue = NULL;
-    POSITION childPartitionPos = NULL;
-    int childConceptIdx = -1;
-    int splitIdx = pSplitAttrib->m_attribIdx;
-    int nRecs = pParentPartition->getNumRecords();
-    //ASSERT(nRecs > 0);
-    for (int r = 0; r < nRecs; ++r) {
-        pRec = pParentPartition->getRecord(r);
-        pSplitValue = pRec->getValue(splitIdx);
-
-        // Lower the concept by one level
-        if (!pSplitValue->lowerCurrentConcept(pSplitPartAttrib)) {
-            cerr << _T("CTDPartition: Should not specialize on this concept.");
-            childPartitions.cleanup();
-            ASSERT(false);
-            return false;
-        }
-
-        // Get the child concept of the current concept in this record
-        childConceptIdx = pSplitValue->getCurrentConcept()->m_childIdx;
-        ASSERT(childConceptIdx != -1);
-        childPartitionPos = childPartitions.FindIndex(childConceptIdx);
-        ASSERT(childPartitionPos);
-
-        // Add the record to this child partition
-        if (!childPartitions.GetAt(childPartitionPos)->addRecord(pRec)) {
-            childPartitions.cleanup();
-            ASSERT(false);                
-            return false;
-        }
-    }
-
-	// Empty partitions are deleted at the end
-    return true;
-}
@@ -17,6 +17,18 @@
     #include "TDPartition.h"
 #endif
 
+#if !defined(TDTESTROUTER_H)
+    #include "TDTestRouter.h"
+#endif
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+#if !defined(TDPARTITIONTRACE_H)
+    #include "TDPartitionTrace.h"
+#endif
+
 class CTDPartitioner  
 {
 public:
@@ -24,16 +36,17 @@ public:
     virtual ~CTDPartitioner();
 
 // operations
-    bool initialize(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr);
+    bool initialize(CTDAttribMgr* pAttribMgr, CTDDataMgr* pDataMgr, CTDProfiler* pProfiler);
     bool transformData();
 	bool addNoise();
     CTDPartitions* getLeafPartitions() { return &m_leafPartitions; };
-	CTDPartitions* getTestLeafPartitions() { return &m_testLeafPartitions; };
+	CTDTestRouter* getTestRouter() { return &m_testRouter; };
+	const CTDPartitionTrace* getTrace() const { return &m_trace; };
+	void setRootState(const CTDRootState* pRootState) { m_pRootState = pRootState; };
 
 
 protected:
     CTDPartition* initRootPartition();
-	CTDPartition* initTestRootPartition();
 	bool initializeBudget();
     bool splitPartitions(CTDPartition*	pParentPartition,
 						 CTDPartAttrib* pSelectedPartAttrib, 
@@ -43,43 +56,37 @@ protected:
 						 const int		nSpecializations,
 						 double			epsilon);
 
-	bool splitTestPartitions(CTDPartition*	pParentPartition,
-							 CTDPartAttrib* pSelectedPartAttrib, 
-							 CTDAttrib* pSplitAttrib, 
-							 CTDConcept* pSplitConcept);
-
     bool distributeRecords(CTDPartition*  pParentPartition, 
 						   CTDPartAttrib* pSplitPartAttrib,
                            CTDAttrib*     pSplitAttrib, 
                            CTDConcept*    pSplitConcept,
                            CTDPartitions& childPartitions);
 
-	bool testDistributeRecords(CTDPartition*  pParentPartition, 
-							   CTDPartAttrib* pSplitPartAttrib,
-							   CTDAttrib*	  pSplitAttrib, 
-							   CTDConcept*    pSplitConcept,
-                               CTDPartitions& childPartitions);
-
 	inline float log2f(float x) { return log10f(x) / log10f(2); };
-	bool specializePartition(CTDPartition*& pRootPartition, CTDPartition* pTestRootPartition, int nSpecializations, double& remainder, int nParentRecords);
+	bool specializePartition(CTDPartition*& pRootPartition, int nSpecializations, double& remainder, int nParentRecords);
 	CTDPartition* getNextPartition();
-	CTDPartition* getNextTestPartition();
+	bool countPartition(CTDPartition* pPartition, int parentIdx, const CTDRootState* pRootState = NULL);
+	bool scorePartition(CTDPartition* pPartition);
 	void makeMultiDimAttrib(CTDPartition* pPartition);
  
 
 // attributes
     CTDAttribMgr*		m_pAttribMgr;
     CTDDataMgr*			m_pDataMgr;
+    CTDProfiler*		m_pProfiler;
+	const CTDRootState*	m_pRootState;		// Counts of the root partition shared by runs, or NULL.
 	CTDPartitions		m_tempPartitions;	// For all partitions.
     CTDPartitions		m_leafPartitions;	// For leaf partitions only. 
-	CTDPartitions		m_testTempPartitions;
-	CTDPartitions		m_testLeafPartitions;
+	CTDTestRouter		m_testRouter;		// Split decisions for routing the test records.
+	CTDPartitionTrace	m_trace;			// Partition tree of the last run, if TD_bTRACE_PARTITIONS.
 	int		m_nSpecialization;
 	int		m_nMaxLevel;
 	int		m_nTraining;
 	double	m_remainder;
 	double	m_pBudget;
 	double	m_workingBudget; 
+	int		m_nextPartitionIdx;		// Index of the next partition, for debugging.
+	int		m_nSpecialized;			// Specializations performed so far.
 };
 
 #endif
@@ -0,0 +1,263 @@
+// TDProfiler.cpp: implementation of the CTDProfiler class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+__declspec(thread) CTDProfiler* CTDProfiler::m_pRunProfiler = NULL;
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDProfiler::CTDProfiler()
+    : m_startNanos(0),
+      m_totalNanos(0),
+      m_peakRSS(0)
+{
+    for (int p = 0; p < TD_NUM_PHASES; ++p) {
+        m_phaseStarts[p] = 0;
+        m_phaseNanos[p] = 0;
+    }
+    for (int c = 0; c < TD_NUM_COUNTERS; ++c)
+        m_counts[c] = 0;
+    CTDMemTracker::resetCounts(m_memCounts);
+}
+
+//---------------------------------------------------------------------------
+// A run that failed before stop leaves the profiler bound to its thread.
+//---------------------------------------------------------------------------
+CTDProfiler::~CTDProfiler()
+{
+    unbind();
+}
+
+//---------------------------------------------------------------------------
+// Begin a run on the calling thread: clear the phase times, counters and
+// memory counts, and bind them to the thread.
+//---------------------------------------------------------------------------
+void CTDProfiler::start()
+{
+    for (int p = 0; p < TD_NUM_PHASES; ++p) {
+        m_phaseStarts[p] = 0;
+        m_phaseNanos[p] = 0;
+    }
+    for (int c = 0; c < TD_NUM_COUNTERS; ++c)
+        m_counts[c] = 0;
+    CTDMemTracker::resetCounts(m_memCounts);
+    m_pRunProfiler = this;
+    CTDMemTracker::bind(&m_memCounts);
+    if (TD_MEM_SAMPLE_INTERVAL > 0)
+        m_memTracker.startSampling(TD_MEM_SAMPLE_INTERVAL);
+
+    m_totalNanos = 0;
+    m_startNanos = getNanos();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDProfiler::stop()
+{
+    m_totalNanos = getNanos() - m_startNanos;
+    unbind();
+    m_memTracker.stopSampling();
+    m_peakRSS = CTDMemTracker::getPeakRSS();
+}
+
+//---------------------------------------------------------------------------
+// Stop counting into this profiler if it is bound to the calling thread.
+//---------------------------------------------------------------------------
+void CTDProfiler::unbind()
+{
+    if (m_pRunProfiler != this)
+        return;
+    m_pRunProfiler = NULL;
+    CTDMemTracker::bind(NULL);
+}
+
+//---------------------------------------------------------------------------
+// A phase may be entered more than once; its times add up.
+//---------------------------------------------------------------------------
+void CTDProfiler::startPhase(TDPhase phase)
+{
+    m_phaseStarts[phase] = getNanos();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDProfiler::stopPhase(TDPhase phase)
+{
+    m_phaseNanos[phase] += getNanos() - m_phaseStarts[phase];
+}
+
+//---------------------------------------------------------------------------
+// Nanoseconds on the performance counter, which is monotonic. The whole
+// seconds and the remainder are scaled separately to avoid overflow.
+//---------------------------------------------------------------------------
+// static
+LONGLONG CTDProfiler::getNanos()
+{
+    static LONGLONG frequency = 0;
+    if (frequency == 0) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        frequency = freq.QuadPart;
+    }
+
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart / frequency * 1000000000LL + ticks.QuadPart % frequency * 1000000000LL / frequency;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+LPCTSTR CTDProfiler::getPhaseName(TDPhase phase)
+{
+    switch (phase) {
+    case TD_PHASE_READ_ATTRIBUTES:
+        return _T("read_attributes");
+    case TD_PHASE_READ_RECORDS:
+        return _T("read_records");
+    case TD_PHASE_ROOT_SUPPORT:
+        return _T("root_support_matrix");
+    case TD_PHASE_SPECIALIZATION:
+        return _T("specialization");
+    case TD_PHASE_NOISE:
+        return _T("noise");
+    case TD_PHASE_INDEX:
+        return _T("query_index");
+    case TD_PHASE_WRITE:
+        return _T("write");
+    case TD_PHASE_EVALUATION:
+        return _T("evaluation");
+    default:
+        ASSERT(false);
+        return _T("");
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+LPCTSTR CTDProfiler::getCounterName(TDCounter counter)
+{
+    switch (counter) {
+    case TD_COUNTER_RECORDS_SCANNED:
+        return _T("records_scanned");
+    case TD_COUNTER_SORTS:
+        return _T("sorts");
+    case TD_COUNTER_PARTITIONS:
+        return _T("partitions");
+    case TD_COUNTER_LEAVES:
+        return _T("leaves");
+    case TD_COUNTER_SPLIT_CANDIDATES:
+        return _T("split_candidates");
+    case TD_COUNTER_BYTES_WRITTEN:
+        return _T("bytes_written");
+    default:
+        ASSERT(false);
+        return _T("");
+    }
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDProfiler::printMemory() const
+{
+    cout << _T("Peak resident set size = ") << m_peakRSS / 1048576.0 << _T(" MB") << endl;
+    if (!TD_bTRACK_MEMORY)
+        return;
+
+    for (int m = 0; m < TD_NUM_MEM_CATEGORIES; ++m) {
+        cout << _T("    ") << CTDMemTracker::getCategoryName(TDMemCategory(m))
+             << _T(": peak = ") << m_memCounts.m_peakBytes[m] / 1048576.0 << _T(" MB")
+             << _T(", current = ") << m_memCounts.m_currentBytes[m] / 1048576.0 << _T(" MB") << endl;
+    }
+}
+
+//---------------------------------------------------------------------------
+// {"total_ns": ..., "phases_ns": {"read_attributes": ..., ...},
+//  "counters": {"records_scanned": ..., ...},
+//  "memory": {"peak_rss_bytes": ..., "current_bytes": {"records": ..., ...},
+//             "peak_bytes": {...}, "depth_peak_bytes": [...],
+//             "rss_samples": [[ns, bytes], ...]}}
+// The depths are listed up to the deepest one with a nonzero peak.
+//---------------------------------------------------------------------------
+bool CTDProfiler::writeJSON(LPCTSTR profileFile) const
+{
+    CTDByteBuffer buffer;
+    buffer.append(_T("{\n  \"total_ns\": "));
+    buffer.appendFloat(double(m_totalNanos), 0);
+    buffer.append(_T(",\n  \"phases_ns\": {"));
+    for (int p = 0; p < TD_NUM_PHASES; ++p) {
+        buffer.append(p == 0 ? _T("\n    \"") : _T(",\n    \""));
+        buffer.append(getPhaseName(TDPhase(p)));
+        buffer.append(_T("\": "));
+        buffer.appendFloat(double(m_phaseNanos[p]), 0);
+    }
+    buffer.append(_T("\n  },\n  \"counters\": {"));
+    for (int c = 0; c < TD_NUM_COUNTERS; ++c) {
+        buffer.append(c == 0 ? _T("\n    \"") : _T(",\n    \""));
+        buffer.append(getCounterName(TDCounter(c)));
+        buffer.append(_T("\": "));
+        buffer.appendFloat(double(m_counts[c]), 0);
+    }
+    buffer.append(_T("\n  },\n  \"memory\": {\n    \"peak_rss_bytes\": "));
+    buffer.appendFloat(double(m_peakRSS), 0);
+    for (int k = 0; k < 2; ++k) {
+        const LONGLONG* pBytes = (k == 0) ? m_memCounts.m_currentBytes : m_memCounts.m_peakBytes;
+        buffer.append(k == 0 ? _T(",\n    \"current_bytes\": {") : _T(",\n    \"peak_bytes\": {"));
+        for (int m = 0; m < TD_NUM_MEM_CATEGORIES; ++m) {
+            buffer.append(m == 0 ? _T("\"") : _T(", \""));
+            buffer.append(CTDMemTracker::getCategoryName(TDMemCategory(m)));
+            buffer.append(_T("\": "));
+            buffer.appendFloat(double(pBytes[m]), 0);
+        }
+        buffer.append(TCHAR('}'));
+    }
+
+    int nDepths = TD_MEM_MAX_DEPTH;
+    while (nDepths > 0 && m_memCounts.m_depthPeakBytes[nDepths - 1] == 0)
+        --nDepths;
+    buffer.append(_T(",\n    \"depth_peak_bytes\": ["));
+    for (int d = 0; d < nDepths; ++d) {
+        if (d > 0)
+            buffer.append(_T(", "));
+        buffer.appendFloat(double(m_memCounts.m_depthPeakBytes[d]), 0);
+    }
+
+    buffer.append(_T("],\n    \"rss_samples\": ["));
+    for (int i = 0; i < m_memTracker.getNumSamples(); ++i) {
+        buffer.append(i == 0 ? _T("[") : _T(", ["));
+        buffer.appendFloat(double(m_memTracker.getSampleNanos(i)), 0);
+        buffer.append(_T(", "));
+        buffer.appendFloat(double(m_memTracker.getSampleRSS(i)), 0);
+        buffer.append(TCHAR(']'));
+    }
+    buffer.append(_T("]\n  }\n}\n"));
+
+    try {
+        CFile file;
+        if (!file.Open(profileFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDProfiler: Failed to open file ") << profileFile << endl;
+            return false;
+        }
+        file.Write(buffer.getData(), buffer.getSize() * sizeof(TCHAR));
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write profile file: ") << profileFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+// TDProfiler.h: interface for the CTDProfiler class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDPROFILER_H)
+#define TDPROFILER_H
+
+#if !defined(TDMEMTRACKER_H)
+    #include "TDMemTracker.h"
+#endif
+
+enum TDPhase
+{
+    TD_PHASE_READ_ATTRIBUTES,
+    TD_PHASE_READ_RECORDS,
+    TD_PHASE_ROOT_SUPPORT,              // Support matrix of the root partition.
+    TD_PHASE_SPECIALIZATION,
+    TD_PHASE_NOISE,
+    TD_PHASE_INDEX,                     // Query index of the leaf partitions.
+    TD_PHASE_WRITE,
+    TD_PHASE_EVALUATION,
+    TD_NUM_PHASES
+};
+
+enum TDCounter
+{
+    TD_COUNTER_RECORDS_SCANNED,         // Records scanned by CTDPartition::constructSupportMatrix.
+    TD_COUNTER_SORTS,                   // Calls of CTDRecords::sortByAttrib.
+    TD_COUNTER_PARTITIONS,              // Partitions created.
+    TD_COUNTER_LEAVES,                  // Leaf partitions produced.
+    TD_COUNTER_SPLIT_CANDIDATES,        // Candidate concepts and split points scored.
+    TD_COUNTER_BYTES_WRITTEN,           // Bytes written to the output files, except the profile and trace written after the run.
+    TD_NUM_COUNTERS
+};
+
+//---------------------------------------------------------------------------
+// Wall-clock time of the phases of a run, in nanoseconds from the
+// monotonic performance counter, and the hot-path counters and memory
+// counts of the run. start binds the profiler and its memory counts to the
+// calling thread until stop; the engine adds to the counters of the
+// profiler bound to the thread it runs on through addCount, and to its
+// memory counts through CTDMemTracker. Runs on different threads, e.g.,
+// the concurrent trials of CTDExperiment, thus count separately. The peak
+// resident set size taken at stop is that of the process.
+//---------------------------------------------------------------------------
+class CTDProfiler
+{
+public:
+    CTDProfiler();
+    virtual ~CTDProfiler();
+
+// Operations
+    void start();
+    void stop();
+    void startPhase(TDPhase phase);
+    void stopPhase(TDPhase phase);
+    LONGLONG getPhaseNanos(TDPhase phase) const { return m_phaseNanos[phase]; };
+    double getPhaseSeconds(TDPhase phase) const { return m_phaseNanos[phase] / 1e9; };
+    LONGLONG getTotalNanos() const { return m_totalNanos; };
+    LONGLONG getCount(TDCounter counter) const { return m_counts[counter]; };
+    LONGLONG getMemCurrentBytes(TDMemCategory category) const { return m_memCounts.m_currentBytes[category]; };
+    LONGLONG getMemPeakBytes(TDMemCategory category) const { return m_memCounts.m_peakBytes[category]; };
+    LONGLONG getPeakRSS() const { return m_peakRSS; };
+    void printMemory() const;
+    bool writeJSON(LPCTSTR profileFile) const;
+
+    static void addCount(TDCounter counter, LONGLONG n) { if (m_pRunProfiler) m_pRunProfiler->m_counts[counter] += n; };
+    static LONGLONG getNanos();
+    static LPCTSTR getPhaseName(TDPhase phase);
+    static LPCTSTR getCounterName(TDCounter counter);
+
+protected:
+    void unbind();
+
+// Attributes
+    LONGLONG m_startNanos;
+    LONGLONG m_totalNanos;
+    LONGLONG m_phaseStarts[TD_NUM_PHASES];
+    LONGLONG m_phaseNanos[TD_NUM_PHASES];
+    LONGLONG m_counts[TD_NUM_COUNTERS];
+    TDMemCounts m_memCounts;
+    LONGLONG m_peakRSS;
+    CTDMemTracker m_memTracker;         // Samples the resident set size if TD_MEM_SAMPLE_INTERVAL > 0.
+
+    static __declspec(thread) CTDProfiler* m_pRunProfiler;    // Profiler of the run on the calling thread, or NULL.
+};
+
+#endif
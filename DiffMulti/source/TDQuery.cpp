@@ -0,0 +1,459 @@
+// TDQuery.cpp: implementation of the CTDQueryEngine class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDQUERY_H)
+    #include "TDQuery.h"
+#endif
+
+#if !defined(TDVALUE_H)
+    #include "TDValue.h"
+#endif
+
+//*************
+// CTDQuery
+//*************
+
+//---------------------------------------------------------------------------
+// Parse a query string into predicates on the attributes of pAttribMgr.
+//---------------------------------------------------------------------------
+bool CTDQuery::parse(LPCTSTR queryStr, CTDAttribMgr* pAttribMgr)
+{
+    reset();
+    int nAttribs = pAttribMgr->getNumAttributes();
+    int classAttribIdx = nAttribs - 1;
+    CString predicateStr, attribName, valueStr;
+    CBFStrParser strParser(queryStr, TD_RAWDATA_DELIMETER);
+    while (strParser.getNext(predicateStr)) {
+        CBFStrHelper::trim(predicateStr);
+        if (predicateStr.IsEmpty())
+            continue;
+
+        int sepPos = predicateStr.Find(TD_QUERY_ATTRIBSEP);
+        if (sepPos < 0) {
+            cerr << _T("CTDQuery: Failed to parse predicate ") << predicateStr << endl;
+            return false;
+        }
+        attribName = predicateStr.Left(sepPos);
+        valueStr = predicateStr.Mid(sepPos + 1);
+        CBFStrHelper::trim(attribName);
+        CBFStrHelper::trim(valueStr);
+
+        int attribIdx = 0;
+        while (attribIdx < nAttribs && pAttribMgr->getAttribute(attribIdx)->m_attribName.CompareNoCase(attribName) != 0)
+            ++attribIdx;
+        if (attribIdx == nAttribs) {
+            cerr << _T("CTDQuery: Unknown attribute ") << attribName << endl;
+            return false;
+        }
+        for (int p = 0; p < m_predicates.GetSize(); ++p) {
+            if (m_predicates[p].m_attribIdx == attribIdx) {
+                cerr << _T("CTDQuery: More than one predicate on attribute ") << attribName << endl;
+                return false;
+            }
+        }
+
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(attribIdx);
+        TDQueryPredicate predicate;
+        predicate.m_attribIdx = attribIdx;
+        predicate.m_pConcept = NULL;
+        predicate.m_lowerBound = predicate.m_upperBound = 0.0f;
+        if (pAttrib->isContinuous()) {
+            if (!CTDContConcept::parseLowerUpperBound(valueStr, predicate.m_lowerBound, predicate.m_upperBound))
+                return false;
+        }
+        else {
+            predicate.m_pConcept = CTDStringValue::matchRawConcept(valueStr, pAttrib->getFlattenConcepts());
+            if (!predicate.m_pConcept) {
+                cerr << _T("CTDQuery: Failed to match concept ") << valueStr << _T(" in attribute ") << attribName << endl;
+                return false;
+            }
+        }
+
+        if (attribIdx == classAttribIdx) {
+            // The class is the concept at level 1.
+            CTDConcept* pClassConcept = predicate.m_pConcept;
+            if (pClassConcept->m_depth > 1 || m_classIdx >= 0) {
+                cerr << _T("CTDQuery: Invalid class predicate ") << predicateStr << endl;
+                return false;
+            }
+            if (pClassConcept->m_depth == 1)
+                m_classIdx = pClassConcept->m_childIdx;
+            continue;
+        }
+        m_predicates.Add(predicate);
+    }
+    return true;
+}
+
+
+//*************
+// CTDQueryEngine
+//*************
+
+CTDQueryEngine::CTDQueryEngine()
+    : m_pAttribMgr(NULL),
+      m_nLeaves(0),
+      m_nAttribs(0),
+      m_nClasses(0)
+{
+}
+
+CTDQueryEngine::~CTDQueryEngine()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDQueryEngine::cleanup()
+{
+    for (int i = 0; i < m_indices.GetSize(); ++i)
+        delete m_indices.GetAt(i);
+    m_indices.RemoveAll();
+    m_leafConcepts.RemoveAll();
+    m_leafCounts.RemoveAll();
+    m_leafTotals.RemoveAll();
+    m_nLeaves = m_nAttribs = m_nClasses = 0;
+}
+
+//---------------------------------------------------------------------------
+// Copy the generalization and noisy counts of the leaf partitions and index
+// the leaves by every attribute.
+//---------------------------------------------------------------------------
+bool CTDQueryEngine::build(CTDAttribMgr* pAttribMgr, CTDPartitions* pLeafPartitions)
+{
+    cleanup();
+    m_pAttribMgr = pAttribMgr;
+    m_nLeaves = pLeafPartitions->GetCount();
+    m_nAttribs = pAttribMgr->getNumAttributes() - 1;
+    m_nClasses = pAttribMgr->getNumClasses();
+
+    m_leafConcepts.SetSize(m_nLeaves * m_nAttribs);
+    m_leafCounts.SetSize(m_nLeaves * m_nClasses);
+    m_leafTotals.SetSize(m_nLeaves);
+    int l = 0;
+    for (POSITION pos = pLeafPartitions->GetHeadPosition(); pos != NULL; ++l) {
+        CTDPartition* pPartition = pLeafPartitions->GetNext(pos);
+        CTDRecord* pGenRec = pPartition->getGenRecords()->GetAt(0);
+        for (int a = 0; a < m_nAttribs; ++a)
+            m_leafConcepts[l * m_nAttribs + a] = pGenRec->getValue(a)->getCurrentConcept();
+
+        int total = 0;
+        for (int j = 0; j < m_nClasses; ++j) {
+            int count = j < pPartition->m_classNoisySums.GetSize() ? pPartition->m_classNoisySums[j] : 0;
+            m_leafCounts[l * m_nClasses + j] = count;
+            total += count;
+        }
+        m_leafTotals[l] = total;
+    }
+
+    for (int a = 0; a < m_nAttribs; ++a) {
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(a);
+        CTDQueryIndex* pIndex = new CTDQueryIndex();
+        m_indices.Add(pIndex);
+        pIndex->m_leaves.SetSize(m_nLeaves);
+
+        if (pAttrib->isContinuous()) {
+            // Sort the leaves by lower bound.
+            CArray<TDQueryBound, const TDQueryBound&> bounds;
+            bounds.SetSize(m_nLeaves);
+            for (l = 0; l < m_nLeaves; ++l) {
+                bounds[l].m_lowerBound = static_cast<CTDContConcept*> (m_leafConcepts[l * m_nAttribs + a])->m_lowerBound;
+                bounds[l].m_leafIdx = l;
+            }
+            qsort(bounds.GetData(), m_nLeaves, sizeof(TDQueryBound), compareBounds);
+            pIndex->m_lowerBounds.SetSize(m_nLeaves);
+            pIndex->m_upperBounds.SetSize(m_nLeaves);
+            for (l = 0; l < m_nLeaves; ++l) {
+                pIndex->m_leaves[l] = bounds[l].m_leafIdx;
+                pIndex->m_lowerBounds[l] = bounds[l].m_lowerBound;
+                pIndex->m_upperBounds[l] = static_cast<CTDContConcept*> (m_leafConcepts[bounds[l].m_leafIdx * m_nAttribs + a])->m_upperBound;
+            }
+
+            pIndex->m_maxUpperBounds.SetSize(m_nLeaves);
+            buildMaxUpperBounds(pIndex, 0, m_nLeaves);
+            pIndex->m_sortedUpperBounds.Copy(pIndex->m_upperBounds);
+            qsort(pIndex->m_sortedUpperBounds.GetData(), m_nLeaves, sizeof(float), compareFloats);
+            continue;
+        }
+
+        // Group the leaves by concept with a counting sort.
+        int nConcepts = pAttrib->getFlattenConcepts()->GetSize();
+        pIndex->m_conceptStarts.SetSize(nConcepts + 1);
+        for (int c = 0; c <= nConcepts; ++c)
+            pIndex->m_conceptStarts[c] = 0;
+        for (l = 0; l < m_nLeaves; ++l)
+            ++pIndex->m_conceptStarts[m_leafConcepts[l * m_nAttribs + a]->m_flattenIdx + 1];
+        for (int c = 0; c < nConcepts; ++c)
+            pIndex->m_conceptStarts[c + 1] += pIndex->m_conceptStarts[c];
+
+        CTDIntArray nextPos;
+        nextPos.Copy(pIndex->m_conceptStarts);
+        for (l = 0; l < m_nLeaves; ++l)
+            pIndex->m_leaves[nextPos[m_leafConcepts[l * m_nAttribs + a]->m_flattenIdx]++] = l;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Only the leaves intersecting the most selective predicate are visited.
+//---------------------------------------------------------------------------
+bool CTDQueryEngine::answer(const CTDQuery& query, double& count) const
+{
+    count = 0.0;
+    if (!m_pAttribMgr) {
+        cerr << _T("CTDQueryEngine: No leaf partitions to query.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    int nPredicates = query.m_predicates.GetSize();
+    CTDIntArray candidates;
+    if (nPredicates == 0) {
+        candidates.SetSize(m_nLeaves);
+        for (int l = 0; l < m_nLeaves; ++l)
+            candidates[l] = l;
+    }
+    else {
+        int bestPredicate = 0;
+        int bestCount = INT_MAX;
+        for (int p = 0; p < nPredicates; ++p) {
+            int nCandidates = countCandidates(query.m_predicates[p]);
+            if (nCandidates < bestCount) {
+                bestCount = nCandidates;
+                bestPredicate = p;
+            }
+        }
+        if (bestCount == 0)
+            return true;
+        getCandidates(query.m_predicates[bestPredicate], candidates);
+    }
+
+    for (int i = 0; i < candidates.GetSize(); ++i) {
+        int l = candidates[i];
+        double fraction = 1.0;
+        for (int p = 0; p < nPredicates && fraction > 0.0; ++p)
+            fraction *= getFraction(query.m_predicates[p], l);
+        if (fraction <= 0.0)
+            continue;
+
+        if (query.m_classIdx >= 0)
+            count += fraction * m_leafCounts[l * m_nClasses + query.m_classIdx];
+        else
+            count += fraction * m_leafTotals[l];
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDQueryEngine::answer(LPCTSTR queryStr, double& count) const
+{
+    count = 0.0;
+    CTDQuery query;
+    if (!query.parse(queryStr, m_pAttribMgr))
+        return false;
+    return answer(query, count);
+}
+
+//---------------------------------------------------------------------------
+// Upper bound of the number of leaves intersecting the predicate.
+//---------------------------------------------------------------------------
+int CTDQueryEngine::countCandidates(const TDQueryPredicate& predicate) const
+{
+    const CTDQueryIndex* pIndex = m_indices[predicate.m_attribIdx];
+    if (!predicate.m_pConcept) {
+        // Leaves with a lower bound below the upper bound of the range, less
+        // those that end at or below its lower bound, which are among them.
+        if (predicate.m_upperBound <= predicate.m_lowerBound)
+            return 0;
+        return countBelow(pIndex->m_lowerBounds, predicate.m_upperBound) - countAtOrBelow(pIndex->m_sortedUpperBounds, predicate.m_lowerBound);
+    }
+    return countConceptCandidates(pIndex, predicate.m_pConcept);
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDQueryEngine::getCandidates(const TDQueryPredicate& predicate, CTDIntArray& candidates) const
+{
+    candidates.RemoveAll();
+    const CTDQueryIndex* pIndex = m_indices[predicate.m_attribIdx];
+    if (!predicate.m_pConcept) {
+        if (predicate.m_lowerBound < predicate.m_upperBound)
+            getRangeCandidates(pIndex, 0, m_nLeaves, predicate, candidates);
+        return;
+    }
+
+    // Leaves of the ancestors of the concept intersect it partially.
+    for (CTDConcept* pAncestor = predicate.m_pConcept->getParentConcept(); pAncestor; pAncestor = pAncestor->getParentConcept()) {
+        for (int i = pIndex->m_conceptStarts[pAncestor->m_flattenIdx]; i < pIndex->m_conceptStarts[pAncestor->m_flattenIdx + 1]; ++i)
+            candidates.Add(pIndex->m_leaves[i]);
+    }
+    getConceptCandidates(pIndex, predicate.m_pConcept, candidates);
+}
+
+//---------------------------------------------------------------------------
+// Add the leaves of the concept and its descendants.
+//---------------------------------------------------------------------------
+void CTDQueryEngine::getConceptCandidates(const CTDQueryIndex* pIndex, CTDConcept* pConcept, CTDIntArray& candidates) const
+{
+    for (int i = pIndex->m_conceptStarts[pConcept->m_flattenIdx]; i < pIndex->m_conceptStarts[pConcept->m_flattenIdx + 1]; ++i)
+        candidates.Add(pIndex->m_leaves[i]);
+    for (int c = 0; c < pConcept->getNumChildConcepts(); ++c)
+        getConceptCandidates(pIndex, pConcept->getChildConcept(c), candidates);
+}
+
+//---------------------------------------------------------------------------
+// Add the leaves of m_leaves[lo..hi) that intersect the range, in the order
+// of their lower bounds. Subtrees that end at or below the lower bound of
+// the range, or start at or above its upper bound, are not visited.
+//---------------------------------------------------------------------------
+void CTDQueryEngine::getRangeCandidates(const CTDQueryIndex* pIndex, int lo, int hi, const TDQueryPredicate& predicate, CTDIntArray& candidates) const
+{
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (pIndex->m_maxUpperBounds[mid] <= predicate.m_lowerBound)
+            return;
+
+        getRangeCandidates(pIndex, lo, mid, predicate, candidates);
+        if (pIndex->m_lowerBounds[mid] >= predicate.m_upperBound)
+            return;
+        if (pIndex->m_upperBounds[mid] > predicate.m_lowerBound)
+            candidates.Add(pIndex->m_leaves[mid]);
+        lo = mid + 1;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Fill m_maxUpperBounds for the subtree of m_leaves[lo..hi) and return its
+// largest upper bound.
+//---------------------------------------------------------------------------
+// static
+float CTDQueryEngine::buildMaxUpperBounds(CTDQueryIndex* pIndex, int lo, int hi)
+{
+    if (lo >= hi)
+        return -FLT_MAX;
+
+    int mid = (lo + hi) / 2;
+    float maxUpperBound = pIndex->m_upperBounds[mid];
+    maxUpperBound = max(maxUpperBound, buildMaxUpperBounds(pIndex, lo, mid));
+    maxUpperBound = max(maxUpperBound, buildMaxUpperBounds(pIndex, mid + 1, hi));
+    pIndex->m_maxUpperBounds[mid] = maxUpperBound;
+    return maxUpperBound;
+}
+
+//---------------------------------------------------------------------------
+// Number of values less than value.
+//---------------------------------------------------------------------------
+// static
+int CTDQueryEngine::countBelow(const CTDFloatArray& sortedValues, float value)
+{
+    int left = 0, right = sortedValues.GetSize();
+    while (left < right) {
+        int mid = (left + right) / 2;
+        if (sortedValues[mid] < value)
+            left = mid + 1;
+        else
+            right = mid;
+    }
+    return left;
+}
+
+//---------------------------------------------------------------------------
+// Number of values less than or equal to value.
+//---------------------------------------------------------------------------
+// static
+int CTDQueryEngine::countAtOrBelow(const CTDFloatArray& sortedValues, float value)
+{
+    int left = 0, right = sortedValues.GetSize();
+    while (left < right) {
+        int mid = (left + right) / 2;
+        if (sortedValues[mid] <= value)
+            left = mid + 1;
+        else
+            right = mid;
+    }
+    return left;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+int CTDQueryEngine::countConceptCandidates(const CTDQueryIndex* pIndex, CTDConcept* pConcept) const
+{
+    int nCandidates = 0;
+    for (CTDConcept* pAncestor = pConcept->getParentConcept(); pAncestor; pAncestor = pAncestor->getParentConcept())
+        nCandidates += pIndex->m_conceptStarts[pAncestor->m_flattenIdx + 1] - pIndex->m_conceptStarts[pAncestor->m_flattenIdx];
+
+    CTDConceptPtrArray stack;
+    stack.Add(pConcept);
+    while (stack.GetSize() > 0) {
+        CTDConcept* pCurr = stack[stack.GetSize() - 1];
+        stack.RemoveAt(stack.GetSize() - 1);
+        nCandidates += pIndex->m_conceptStarts[pCurr->m_flattenIdx + 1] - pIndex->m_conceptStarts[pCurr->m_flattenIdx];
+        for (int c = 0; c < pCurr->getNumChildConcepts(); ++c)
+            stack.Add(pCurr->getChildConcept(c));
+    }
+    return nCandidates;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+int CTDQueryEngine::compareBounds(const void* pBound1, const void* pBound2)
+{
+    const TDQueryBound* pB1 = (const TDQueryBound*) pBound1;
+    const TDQueryBound* pB2 = (const TDQueryBound*) pBound2;
+    if (pB1->m_lowerBound != pB2->m_lowerBound)
+        return pB1->m_lowerBound < pB2->m_lowerBound ? -1 : 1;
+    return pB1->m_leafIdx - pB2->m_leafIdx;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+int CTDQueryEngine::compareFloats(const void* pValue1, const void* pValue2)
+{
+    float value1 = *(const float*) pValue1;
+    float value2 = *(const float*) pValue2;
+    if (value1 != value2)
+        return value1 < value2 ? -1 : 1;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Fraction of the records of the leaf that satisfy the predicate.
+//---------------------------------------------------------------------------
+double CTDQueryEngine::getFraction(const TDQueryPredicate& predicate, int leafIdx) const
+{
+    CTDConcept* pLeafConcept = m_leafConcepts[leafIdx * m_nAttribs + predicate.m_attribIdx];
+    if (!predicate.m_pConcept) {
+        CTDContConcept* pLeafContConcept = static_cast<CTDContConcept*> (pLeafConcept);
+        float lowerBound = max(pLeafContConcept->m_lowerBound, predicate.m_lowerBound);
+        float upperBound = min(pLeafContConcept->m_upperBound, predicate.m_upperBound);
+        if (upperBound <= lowerBound)
+            return 0.0;
+        float width = pLeafContConcept->m_upperBound - pLeafContConcept->m_lowerBound;
+        if (width <= 0.0f)
+            return 1.0;
+        return double(upperBound - lowerBound) / width;
+    }
+
+    // The leaf concept is the query concept or below it.
+    CTDConcept* pQueryConcept = predicate.m_pConcept;
+    CTDConcept* pConcept = pLeafConcept;
+    while (pConcept && pConcept->m_depth > pQueryConcept->m_depth)
+        pConcept = pConcept->getParentConcept();
+    if (pConcept == pQueryConcept)
+        return 1.0;
+
+    // The leaf concept is above the query concept.
+    pConcept = pQueryConcept;
+    while (pConcept && pConcept->m_depth > pLeafConcept->m_depth)
+        pConcept = pConcept->getParentConcept();
+    if (pConcept == pLeafConcept)
+        return double(pQueryConcept->m_nLeafConcepts) / pLeafConcept->m_nLeafConcepts;
+    return 0.0;
+}
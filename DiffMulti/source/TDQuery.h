@@ -0,0 +1,129 @@
+// TDQuery.h: interface for the CTDQueryEngine class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDQUERY_H)
+#define TDQUERY_H
+
+#if !defined(TDATTRIBMGR_H)
+    #include "TDAttribMgr.h"
+#endif
+
+#if !defined(TDPARTITION_H)
+    #include "TDPartition.h"
+#endif
+
+//---------------------------------------------------------------------------
+// One conjunct of a count query: a concept of a categorical attribute, or a
+// range [m_lowerBound, m_upperBound) of a continuous attribute.
+//---------------------------------------------------------------------------
+struct TDQueryPredicate
+{
+    int         m_attribIdx;
+    CTDConcept* m_pConcept;         // Categorical attribute only.
+    float       m_lowerBound;       // Inclusive. Continuous attribute only.
+    float       m_upperBound;       // Exclusive.
+};
+
+typedef CArray<TDQueryPredicate, const TDQueryPredicate&> CTDQueryPredicateArray;
+
+//---------------------------------------------------------------------------
+// Conjunctive count query, e.g., "age:30-40, education:Bachelors, class:>50K".
+// Predicates are separated by TD_RAWDATA_DELIMETER; each is an attribute
+// name, TD_QUERY_ATTRIBSEP, and a concept or a range as in the hierarchy
+// file. A predicate on the class attribute restricts the class; its concept
+// must be a class value or the root.
+//---------------------------------------------------------------------------
+class CTDQuery
+{
+public:
+    CTDQuery() : m_classIdx(-1) {};
+    virtual ~CTDQuery() {};
+
+    bool parse(LPCTSTR queryStr, CTDAttribMgr* pAttribMgr);
+    void reset() { m_predicates.RemoveAll(); m_classIdx = -1; };
+
+// Attributes
+    CTDQueryPredicateArray m_predicates;    // At most one per attribute, excluding the class.
+    int                    m_classIdx;      // -1 for all classes.
+};
+
+//---------------------------------------------------------------------------
+// Leaves of one attribute grouped for finding the leaves that intersect a
+// predicate. Categorical: leaves grouped by the flattened index of their
+// concept, see CTDTestRouter. Continuous: an interval tree, i.e., leaves
+// sorted by lower bound and seen as the in-order traversal of a balanced
+// binary tree, in which the node of the range [lo, hi) is its middle
+// element and holds the largest upper bound of the range. The upper bounds
+// are also kept sorted, to count the intersecting leaves.
+//---------------------------------------------------------------------------
+class CTDQueryIndex
+{
+public:
+    CTDQueryIndex() {};
+    virtual ~CTDQueryIndex() {};
+
+// Attributes
+    CTDIntArray   m_conceptStarts;      // Leaves of concept c are m_leaves[m_conceptStarts[c]..m_conceptStarts[c + 1]).
+    CTDIntArray   m_leaves;
+    CTDFloatArray m_lowerBounds;        // Lower bound of m_leaves[i]. Continuous only.
+    CTDFloatArray m_upperBounds;        // Upper bound of m_leaves[i].
+    CTDFloatArray m_maxUpperBounds;     // Largest upper bound in the subtree of node i.
+    CTDFloatArray m_sortedUpperBounds;  // Upper bounds of all leaves in ascending order.
+};
+
+typedef CTypedPtrArray<CPtrArray, CTDQueryIndex*> CTDQueryIndexArray;
+
+struct TDQueryBound
+{
+    float m_lowerBound;
+    int   m_leafIdx;
+};
+
+//---------------------------------------------------------------------------
+// Answers count queries from the generalization and noisy class counts of
+// the leaf partitions, without expanding them into records. A leaf that
+// partially intersects a predicate contributes the intersecting fraction of
+// its counts, assuming its records are spread uniformly over the leaf values
+// of a concept or over an interval.
+//---------------------------------------------------------------------------
+class CTDQueryEngine
+{
+public:
+    CTDQueryEngine();
+    virtual ~CTDQueryEngine();
+
+// Operations
+    bool build(CTDAttribMgr* pAttribMgr, CTDPartitions* pLeafPartitions);
+    void cleanup();
+    bool answer(const CTDQuery& query, double& count) const;
+    bool answer(LPCTSTR queryStr, double& count) const;
+
+    int getNumLeaves() const { return m_nLeaves; };
+    CTDAttribMgr* getAttribMgr() const { return m_pAttribMgr; };
+
+protected:
+    int countCandidates(const TDQueryPredicate& predicate) const;
+    void getCandidates(const TDQueryPredicate& predicate, CTDIntArray& candidates) const;
+    void getConceptCandidates(const CTDQueryIndex* pIndex, CTDConcept* pConcept, CTDIntArray& candidates) const;
+    int countConceptCandidates(const CTDQueryIndex* pIndex, CTDConcept* pConcept) const;
+    void getRangeCandidates(const CTDQueryIndex* pIndex, int lo, int hi, const TDQueryPredicate& predicate, CTDIntArray& candidates) const;
+    static float buildMaxUpperBounds(CTDQueryIndex* pIndex, int lo, int hi);
+    static int countBelow(const CTDFloatArray& sortedValues, float value);
+    static int countAtOrBelow(const CTDFloatArray& sortedValues, float value);
+    double getFraction(const TDQueryPredicate& predicate, int leafIdx) const;
+    static int compareBounds(const void* pBound1, const void* pBound2);
+    static int compareFloats(const void* pValue1, const void* pValue2);
+
+// Attributes
+    CTDAttribMgr*      m_pAttribMgr;
+    int                m_nLeaves;
+    int                m_nAttribs;          // Excluding the class attribute.
+    int                m_nClasses;
+    CTDConceptPtrArray m_leafConcepts;      // Concept of leaf l and attribute a at l * m_nAttribs + a.
+    CTDIntArray        m_leafCounts;        // Noisy count of leaf l and class j at l * m_nClasses + j.
+    CTDIntArray        m_leafTotals;        // Noisy count of leaf l over all classes.
+    CTDQueryIndexArray m_indices;           // One per attribute, excluding the class attribute.
+};
+
+#endif
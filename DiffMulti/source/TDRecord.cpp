@@ -8,6 +8,10 @@
     #include "TDRecord.h"
 #endif
 
+#if !defined(TDPROFILER_H)
+    #include "TDProfiler.h"
+#endif
+
 //************
 // CTDRecord *
 //************
@@ -15,10 +19,12 @@
 CTDRecord::CTDRecord()
     : m_recordID(0)
 {
+    CTDMemTracker::add(TD_MEM_RECORDS, sizeof(CTDRecord));
 }
 
 CTDRecord::~CTDRecord() 
 {
+    CTDMemTracker::add(TD_MEM_RECORDS, -LONGLONG(sizeof(CTDRecord) + m_values.GetSize() * sizeof(CTDValue*)));
     m_values.cleanup();
 }
 
@@ -28,6 +34,7 @@ bool CTDRecord::addValue(CTDValue* pValue)
 {
     try {
         m_values.Add(pValue);
+        CTDMemTracker::add(TD_MEM_RECORDS, sizeof(CTDValue*));
         return true;
     }
     catch (CMemoryException&) {
@@ -36,6 +43,31 @@ bool CTDRecord::addValue(CTDValue* pValue)
     }
 }
 
+//---------------------------------------------------------------------------
+// Copy of this record, with the same ID, for pAttribs, copies of the
+// attributes of its values.
+//---------------------------------------------------------------------------
+CTDRecord* CTDRecord::clone(CTDAttribs* pAttribs)
+{
+    int nValues = m_values.GetSize();
+    if (nValues != pAttribs->GetSize()) {
+        ASSERT(false);
+        return NULL;
+    }
+
+    CTDRecord* pNewRecord = new CTDRecord();
+    pNewRecord->m_recordID = m_recordID;
+    pNewRecord->m_values.SetSize(0, nValues);
+    for (int v = 0; v < nValues; ++v) {
+        CTDValue* pNewValue = m_values.GetAt(v)->clone(pAttribs->GetAt(v));
+        if (!pNewValue || !pNewRecord->addValue(pNewValue)) {
+            delete pNewValue;
+            delete pNewRecord;
+            return NULL;
+        }
+    }
+    return pNewRecord;
+}
 
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
@@ -95,6 +127,7 @@ void CTDRecords::cleanup()
 //---------------------------------------------------------------------------
 bool CTDRecords::sortByAttrib(int attribIdx)
 {
+    CTDProfiler::addCount(TD_COUNTER_SORTS, 1);
     bool ret = quickSort(attribIdx, 0, GetSize() - 1);
 #if 0 //def _DEBUG_PRT_INFO
     for (int r = 0; r < GetSize(); ++r) {
@@ -104,6 +137,46 @@ bool CTDRecords::sortByAttrib(int attribIdx)
     return ret;
 }
 
+//---------------------------------------------------------------------------
+// Put the records in the order of recordIDs, which holds the ID of every
+// record once. The IDs must be 0 to GetSize() - 1, as those of the
+// training records of a root partition.
+//---------------------------------------------------------------------------
+bool CTDRecords::arrangeByRecordIDs(const CTDIntArray& recordIDs)
+{
+    int nRecs = GetSize();
+    if (recordIDs.GetSize() != nRecs) {
+        cerr << _T("CTDRecords: Number of record IDs does not match the records.") << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    CTDRecordArray byID;
+    byID.SetSize(nRecs);
+    int recID = 0;
+    for (int r = 0; r < nRecs; ++r) {
+        recID = GetAt(r)->getRecordID();
+        if (recID < 0 || recID >= nRecs || byID[recID]) {
+            cerr << _T("CTDRecords: Invalid record ID ") << recID << endl;
+            ASSERT(false);
+            return false;
+        }
+        byID[recID] = GetAt(r);
+    }
+
+    for (int r = 0; r < nRecs; ++r) {
+        recID = recordIDs[r];
+        if (recID < 0 || recID >= nRecs || !byID[recID]) {
+            cerr << _T("CTDRecords: Invalid record ID ") << recID << endl;
+            ASSERT(false);
+            return false;
+        }
+        SetAt(r, byID[recID]);
+        byID[recID] = NULL;
+    }
+    return true;
+}
+
 //---------------------------------------------------------------------------
 // Quick sort records by attrib index.
 //---------------------------------------------------------------------------
@@ -20,6 +20,7 @@ public:
     int getRecordID() { return m_recordID; };
 
     bool addValue(CTDValue* pValue);
+    CTDRecord* clone(CTDAttribs* pAttribs);
     int getNumValues() { return m_values.GetSize(); };
     CTDValue* getValue(int idx) { return m_values.GetAt(idx); };
 	CString toString(bool bRawValue) const;
@@ -39,6 +40,7 @@ public:
     virtual ~CTDRecords();
     void cleanup();
     bool sortByAttrib(int attribIdx);
+    bool arrangeByRecordIDs(const CTDIntArray& recordIDs);
     friend ostream& operator<<(ostream& os, const CTDRecords& records);
 
 protected:
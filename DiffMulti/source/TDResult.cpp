@@ -0,0 +1,50 @@
+// TDResult.cpp: implementation of the CTDResults class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDRESULT_H)
+    #include "TDResult.h"
+#endif
+
+//*************
+// CTDLeafResults
+//*************
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDLeafResults::cleanup()
+{
+    int nLeaves = GetSize();
+    for (int i = 0; i < nLeaves; ++i)
+        delete GetAt(i);
+
+    RemoveAll();
+}
+
+
+//*************
+// CTDResults
+//*************
+
+CTDResults::CTDResults()
+{
+}
+
+CTDResults::~CTDResults()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDResults::cleanup()
+{
+    m_attribNames.RemoveAll();
+    m_classValues.RemoveAll();
+    m_leaves.cleanup();
+    m_testLeaves.cleanup();
+    m_testRowLeaves.RemoveAll();
+    m_testRowClasses.RemoveAll();
+}
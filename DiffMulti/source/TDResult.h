@@ -0,0 +1,73 @@
+// TDResult.h: interface for the CTDResults class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDRESULT_H)
+#define TDRESULT_H
+
+//---------------------------------------------------------------------------
+// Generalized value of one attribute in a leaf partition.
+//---------------------------------------------------------------------------
+class CTDGenValue
+{
+public:
+    CTDGenValue() : m_bContinuous(false), m_flattenIdx(-1), m_lowerBound(0.0f), m_upperBound(0.0f) {};
+
+// Attributes
+    CString m_conceptValue;     // Generalized value in string format.
+    bool    m_bContinuous;
+    int     m_flattenIdx;       // Flattened index in the concept hierarchy.
+    float   m_lowerBound;       // Inclusive. Continuous attribute only.
+    float   m_upperBound;       // Exclusive. Continuous attribute only.
+};
+
+typedef CArray<CTDGenValue, const CTDGenValue&> CTDGenValueArray;
+
+//---------------------------------------------------------------------------
+// Generalization vector and per-class counts of one leaf partition.
+// The counts are noisy for training leaves and raw for test leaves.
+//---------------------------------------------------------------------------
+class CTDLeafResult
+{
+public:
+    CTDLeafResult() {};
+    virtual ~CTDLeafResult() {};
+
+// Attributes
+    CTDGenValueArray m_genValues;       // One value per attribute, excluding the class attribute.
+    CTDIntArray      m_classCounts;     // Indexed by class.
+};
+
+typedef CTypedPtrArray<CPtrArray, CTDLeafResult*> CTDLeafResultPtrArray;
+class CTDLeafResults : public CTDLeafResultPtrArray
+{
+public:
+    CTDLeafResults() {};
+    virtual ~CTDLeafResults() { cleanup(); };
+    void cleanup();
+};
+
+//---------------------------------------------------------------------------
+// In-memory results of an anonymization run.
+//---------------------------------------------------------------------------
+class CTDResults
+{
+public:
+    CTDResults();
+    virtual ~CTDResults();
+    void cleanup();
+
+    int getNumLeaves() const { return m_leaves.GetSize(); };
+    int getNumTestLeaves() const { return m_testLeaves.GetSize(); };
+    int getNumTestRows() const { return m_testRowLeaves.GetSize(); };
+
+// Attributes
+    CStringArray   m_attribNames;       // Attributes of the generalization vectors, in order.
+    CStringArray   m_classValues;       // Class values, indexed by class.
+    CTDLeafResults m_leaves;            // Noisy training leaf partitions.
+    CTDLeafResults m_testLeaves;        // Test leaf partitions.
+    CTDIntArray    m_testRowLeaves;     // Test leaf of each test record, in input order.
+    CTDIntArray    m_testRowClasses;    // Class of each test record, in input order.
+};
+
+#endif
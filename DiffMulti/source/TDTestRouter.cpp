@@ -0,0 +1,142 @@
+// TDTestRouter.cpp: implementation of the CTDTestRouter class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDTESTROUTER_H)
+    #include "TDTestRouter.h"
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTDTestRouter::CTDTestRouter()
+    : m_pRecords(NULL)
+{
+}
+
+CTDTestRouter::~CTDTestRouter()
+{
+}
+
+//---------------------------------------------------------------------------
+// Start a new tree with a root leaf. Returns the root node.
+//---------------------------------------------------------------------------
+int CTDTestRouter::reset()
+{
+    m_nodes.RemoveAll();
+    m_pRecords = NULL;
+    m_recordLeaves.RemoveAll();
+    m_leafStarts.RemoveAll();
+    m_leafRecords.RemoveAll();
+
+    TDRouteNode root;
+    memset(&root, 0, sizeof(root));
+    root.m_splitAttribIdx = -1;
+    root.m_leafIdx = -1;
+    return m_nodes.Add(root);
+}
+
+//---------------------------------------------------------------------------
+// Split node nodeIdx on the current concept of pSplitAttrib. Returns the
+// first of the nChildren new child nodes.
+//---------------------------------------------------------------------------
+int CTDTestRouter::addSplit(int nodeIdx, CTDAttrib* pSplitAttrib, CTDConcept* pSplitConcept, CTDPartAttrib* pSplitPartAttrib, int nChildren)
+{
+    TDRouteNode child;
+    memset(&child, 0, sizeof(child));
+    child.m_splitAttribIdx = -1;
+    child.m_leafIdx = -1;
+
+    int firstChild = m_nodes.GetSize();
+    for (int c = 0; c < nChildren; ++c)
+        m_nodes.Add(child);
+
+    TDRouteNode& node = m_nodes[nodeIdx];
+    node.m_splitAttribIdx = pSplitAttrib->m_attribIdx;
+    node.m_splitDepth = pSplitConcept->m_depth;
+    node.m_firstChild = firstChild;
+    node.m_nChildren = nChildren;
+    if (pSplitAttrib->isContinuous()) {
+        node.m_pLChildCon = pSplitPartAttrib->m_pLeftChildCon;
+        node.m_pRChildCon = pSplitPartAttrib->m_pRightChildCon;
+    }
+    return firstChild;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDTestRouter::setLeaf(int nodeIdx, int leafIdx)
+{
+    m_nodes[nodeIdx].m_leafIdx = leafIdx;
+}
+
+//---------------------------------------------------------------------------
+// Route every record to its leaf, then group the records by leaf with a
+// counting sort.
+//---------------------------------------------------------------------------
+bool CTDTestRouter::routeRecords(CTDRecords* pRecords, int nLeaves)
+{
+    m_pRecords = pRecords;
+    int nRecs = pRecords->GetSize();
+    m_recordLeaves.SetSize(nRecs);
+    m_leafStarts.SetSize(nLeaves + 1);
+    for (int l = 0; l <= nLeaves; ++l)
+        m_leafStarts[l] = 0;
+
+    int leafIdx = -1;
+    for (int r = 0; r < nRecs; ++r) {
+        if (!routeRecord(pRecords->GetAt(r), leafIdx))
+            return false;
+        if (leafIdx < 0 || leafIdx >= nLeaves) {
+            cerr << _T("CTDTestRouter: Record routed to an invalid leaf: ") << leafIdx << endl;
+            ASSERT(false);
+            return false;
+        }
+        m_recordLeaves[r] = leafIdx;
+        ++m_leafStarts[leafIdx + 1];
+    }
+
+    for (int l = 0; l < nLeaves; ++l)
+        m_leafStarts[l + 1] += m_leafStarts[l];
+
+    CTDIntArray nextPos;
+    nextPos.Copy(m_leafStarts);
+    m_leafRecords.SetSize(nRecs);
+    for (int r = 0; r < nRecs; ++r)
+        m_leafRecords[nextPos[m_recordLeaves[r]]++] = r;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Follow the split decisions from the root, lowering the current concept of
+// the split attribute by one level at each node.
+//---------------------------------------------------------------------------
+bool CTDTestRouter::routeRecord(CTDRecord* pRecord, int& leafIdx)
+{
+    int nodeIdx = 0;
+    while (m_nodes[nodeIdx].m_splitAttribIdx >= 0) {
+        const TDRouteNode& node = m_nodes[nodeIdx];
+        CTDValue* pSplitValue = pRecord->getValue(node.m_splitAttribIdx);
+        if (node.m_pLChildCon) {
+            CTDNumericValue* pNumValue = static_cast<CTDNumericValue*> (pSplitValue);
+            pNumValue->setCurConcept(pNumValue->getLowerConcept(node.m_pLChildCon, node.m_pRChildCon));
+        }
+        else if (!pSplitValue->lowerCurrentConcept(NULL)) {
+            cerr << _T("CTDTestRouter: Should not specialize on this concept.") << endl;
+            ASSERT(false);
+            return false;
+        }
+
+        int childIdx = pSplitValue->getCurrentConcept()->m_childIdx;
+        if (childIdx < 0 || childIdx >= node.m_nChildren) {
+            ASSERT(false);
+            return false;
+        }
+        nodeIdx = node.m_firstChild + childIdx;
+    }
+    leafIdx = m_nodes[nodeIdx].m_leafIdx;
+    return true;
+}
@@ -0,0 +1,65 @@
+// TDTestRouter.h: interface for the CTDTestRouter class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDTESTROUTER_H)
+#define TDTESTROUTER_H
+
+#if !defined(TDPARTATTRIB_H)
+    #include "TDPartAttrib.h"
+#endif
+
+//---------------------------------------------------------------------------
+// One split decision of the training run, or a leaf.
+// The children of a node are consecutive nodes, indexed by child concept.
+//---------------------------------------------------------------------------
+struct TDRouteNode
+{
+    int         m_splitAttribIdx;   // -1 for a leaf.
+    int         m_splitDepth;       // Depth of the split concept.
+    int         m_firstChild;
+    int         m_nChildren;
+    int         m_leafIdx;          // Index in the training leaf partitions. Leaf only.
+    CTDConcept* m_pLChildCon;       // Child concepts of a continuous split.
+    CTDConcept* m_pRChildCon;
+};
+
+typedef CArray<TDRouteNode, const TDRouteNode&> CTDRouteNodeArray;
+
+//---------------------------------------------------------------------------
+// Tree of the split decisions of the training run. After training, the test
+// records are routed through it in one pass and grouped by the training
+// leaf they fall into. Routing lowers the current concepts of the test
+// records along the path.
+//---------------------------------------------------------------------------
+class CTDTestRouter
+{
+public:
+    CTDTestRouter();
+    virtual ~CTDTestRouter();
+
+// Operations
+    int reset();
+    int addSplit(int nodeIdx, CTDAttrib* pSplitAttrib, CTDConcept* pSplitConcept, CTDPartAttrib* pSplitPartAttrib, int nChildren);
+    void setLeaf(int nodeIdx, int leafIdx);
+    bool routeRecords(CTDRecords* pRecords, int nLeaves);
+
+    int getNumNodes() const { return m_nodes.GetSize(); };
+    const TDRouteNode& getNode(int nodeIdx) const { return m_nodes[nodeIdx]; };
+    int getNumLeaves() const { return m_leafStarts.GetSize() - 1; };
+    int getNumLeafRecords(int leafIdx) const { return m_leafStarts[leafIdx + 1] - m_leafStarts[leafIdx]; };
+    CTDRecord* getLeafRecord(int leafIdx, int i) { return m_pRecords->GetAt(m_leafRecords[m_leafStarts[leafIdx] + i]); };
+    int getRecordLeaf(int recordIdx) const { return m_recordLeaves[recordIdx]; };
+
+protected:
+    bool routeRecord(CTDRecord* pRecord, int& leafIdx);
+
+// Attributes
+    CTDRouteNodeArray m_nodes;          // Root is node 0.
+    CTDRecords*       m_pRecords;       // Routed records.
+    CTDIntArray       m_recordLeaves;   // Leaf of each routed record.
+    CTDIntArray       m_leafStarts;     // Records of leaf l are m_leafRecords[m_leafStarts[l]..m_leafStarts[l + 1]).
+    CTDIntArray       m_leafRecords;    // Record indices grouped by leaf, in record order within a leaf.
+};
+
+#endif
@@ -80,6 +80,22 @@ bool CTDValue::assignGenClassValue(CTDAttrib* pAttrib,  int classInd)
 }
 
 
+//---------------------------------------------------------------------------
+// Take the concept of pAttrib, a copy of the attribute of pSrcValue, at
+// the flattened index of the current concept of pSrcValue.
+//---------------------------------------------------------------------------
+bool CTDValue::copyCurrentConcept(const CTDValue* pSrcValue, CTDAttrib* pAttrib)
+{
+    CTDConcepts* pFlatten = pAttrib->getFlattenConcepts();
+    int flattenIdx = pSrcValue->m_pCurrConcept->m_flattenIdx;
+    if (flattenIdx < 0 || flattenIdx >= pFlatten->GetSize()) {
+        ASSERT(false);
+        return false;
+    }
+    m_pCurrConcept = pFlatten->GetAt(flattenIdx);
+    return true;
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 bool CTDValue::lowerCurrentConcept(CTDPartAttrib* pPartAttrib) 
@@ -141,21 +157,11 @@ CTDConcept* CTDStringValue::getLowerConceptSupMode()
 //---------------------------------------------------------------------------
 CTDConcept* CTDStringValue::getLowerConceptGenMode(CTDConcept* pThisConcept)
 {   
-    CTDIntArray& reqBits = pThisConcept->getAttrib()->getReqBits();
-
-    // Shift bits to the next child idx.
-    UINT nextChildIdx = m_bitValue;
-    int d = 0;
-    for (d = 0; d < pThisConcept->m_depth; ++d)
-        nextChildIdx >>= reqBits[d];
-    
-    // The next couple of bits is for this level.
-    // Form the mask for the last n bits, e.g., 00000000 00000000 00000000 00000111
-    UINT mask = 0xFFFFFFFF;
-    mask >>= (sizeof(UINT) * CHAR_BIT - reqBits[d]);
+    CTDAttrib* pAttrib = pThisConcept->getAttrib();
+    int depth = pThisConcept->m_depth;
 
-    // Find the next child index.
-    nextChildIdx &= mask;
+    // Shift the bits of this level to the end and mask out the deeper levels.
+    TDBitValue nextChildIdx = (m_bitValue >> pAttrib->getBitShift(depth)) & pAttrib->getBitMask(depth);
     return pThisConcept->getChildConcept((int) nextChildIdx);
 }
 
@@ -179,30 +185,57 @@ bool CTDStringValue::assignRawConcept(CTDAttrib* pAttrib, int classInd)
 //---------------------------------------------------------------------------
 bool CTDStringValue::buildBitValue(const CString& rawVal, CTDAttrib* pAttrib)
 {
-    CTDConcepts conceptPath;
-    if (!buildConceptPath(rawVal, pAttrib->getFlattenConcepts(), conceptPath)) {
+    CTDConcept* pRawConcept = matchRawConcept(rawVal, pAttrib->getFlattenConcepts());
+    if (!pRawConcept) {
+        cerr << _T("CTDStringValue: Failed to match concept path: ") << rawVal << endl;
         ASSERT(false);
         return false;
     }
-    
-    // The first item is the raw concept.
-    m_pRawConcept = conceptPath.GetAt(0);
+    return buildBitValue(pRawConcept, pAttrib);
+}
+
+//---------------------------------------------------------------------------
+// Build the bit value from the path of the raw concept to the root.
+//---------------------------------------------------------------------------
+bool CTDStringValue::buildBitValue(CTDConcept* pRawConcept, CTDAttrib* pAttrib)
+{
+    if (!pRawConcept) {
+        ASSERT(false);
+        return false;
+    }
+    m_pRawConcept = pRawConcept;
+
+    // Depth 1 is at the low end.
+    int rawDepth = 0;
+    for (CTDConcept* pConcept = pRawConcept; pConcept->getParentConcept(); pConcept = pConcept->getParentConcept())
+        ++rawDepth;
 
-    // Build from top-down and shift bits.
-    // First form depth 1, then depth 2...
     m_bitValue = 0;
-    CTDIntArray& reqBits = pAttrib->getReqBits();
-    int chIdx = 0, rIdx = 0, nShiftBits = 0;
-    for (int c = conceptPath.GetUpperBound() - 1; c >= 0; --c) {
-        chIdx = conceptPath.GetAt(c)->m_childIdx;
-        chIdx <<= nShiftBits;
-        m_bitValue |= chIdx;
-        nShiftBits += reqBits[rIdx];
-        ++rIdx;
+    int rIdx = rawDepth - 1;
+    for (CTDConcept* pConcept = pRawConcept; pConcept->getParentConcept(); pConcept = pConcept->getParentConcept()) {
+        m_bitValue |= TDBitValue(pConcept->m_childIdx) << pAttrib->getBitShift(rIdx);
+        --rIdx;
     }
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Copy of this value for pAttrib, a copy of its attribute. The raw and the
+// current concepts are those at the same flattened indexes.
+//---------------------------------------------------------------------------
+CTDValue* CTDStringValue::clone(CTDAttrib* pAttrib)
+{
+    CTDStringValue* pNewValue = new CTDStringValue();
+    pNewValue->m_bitValue = m_bitValue;
+    if (m_pRawConcept)
+        pNewValue->m_pRawConcept = pAttrib->getFlattenConcepts()->GetAt(m_pRawConcept->m_flattenIdx);
+    if (!pNewValue->copyCurrentConcept(this, pAttrib)) {
+        delete pNewValue;
+        return NULL;
+    }
+    return pNewValue;
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 CString CTDStringValue::toString(bool bRawValue)
@@ -215,31 +248,22 @@ CString CTDStringValue::toString(bool bRawValue)
 
 
 //---------------------------------------------------------------------------
+// Find the concept of a raw value, searching the deepest concepts first.
 //---------------------------------------------------------------------------
 // static
-bool CTDStringValue::buildConceptPath(const CString& rawVal, CTDConcepts* pFlatten, CTDConcepts& conceptPath)
+CTDConcept* CTDStringValue::matchRawConcept(LPCTSTR rawVal, CTDConcepts* pFlatten)
 {
-    conceptPath.RemoveAll();
     CTDConcept* pConcept = NULL;
-    int nFlattenConcepts = pFlatten->GetSize();
-    for (int i = nFlattenConcepts - 1; i >= 0; --i) {
+    for (int i = pFlatten->GetSize() - 1; i >= 0; --i) {
         pConcept = pFlatten->GetAt(i);
         if (!pConcept) {
             ASSERT(false);
-            return false;
-        }
-
-        if (rawVal.CompareNoCase(pConcept->m_conceptValue) == 0) {
-            // Go up to its parent.
-            while (pConcept) {
-                conceptPath.Add(pConcept);
-                pConcept = pConcept->getParentConcept();
-            }
-            return true;
+            return NULL;
         }
+        if (_tcsicmp(rawVal, pConcept->m_conceptValue) == 0)
+            return pConcept;
     }
-    cerr << _T("CTDStringValue: Failed to match concept path: ") << rawVal << endl;
-    return false;
+    return NULL;
 }
 
 //******************
@@ -251,16 +275,32 @@ bool CTDStringValue::buildConceptPath(const CString& rawVal, CTDConcepts* pFlatt
 //---------------------------------------------------------------------------
 CTDConcept* CTDNumericValue::getLowerConcept(CTDPartAttrib* pPartAttrib)
 {   
-	CTDContConcept* pRConcept = NULL;
-	pRConcept = static_cast<CTDContConcept*> (pPartAttrib->m_pRightChildCon);
-
-	CTDContConcept* pLConcept = NULL;
-	pLConcept = static_cast<CTDContConcept*> (pPartAttrib->m_pLeftChildCon);
+	return getLowerConcept(pPartAttrib->m_pLeftChildCon, pPartAttrib->m_pRightChildCon);
+}
 
+//---------------------------------------------------------------------------
+// Get the child concept of a split that contains this value.
+//---------------------------------------------------------------------------
+CTDConcept* CTDNumericValue::getLowerConcept(CTDConcept* pLChildCon, CTDConcept* pRChildCon)
+{   
+	CTDContConcept* pLConcept = static_cast<CTDContConcept*> (pLChildCon);
 	if (m_numValue >= pLConcept->m_lowerBound && m_numValue < pLConcept->m_upperBound)
-		return pLConcept;
+		return pLChildCon;
 	else
-		return pRConcept;
+		return pRChildCon;
+}
+
+//---------------------------------------------------------------------------
+// Copy of this value for pAttrib, a copy of its attribute.
+//---------------------------------------------------------------------------
+CTDValue* CTDNumericValue::clone(CTDAttrib* pAttrib)
+{
+    CTDNumericValue* pNewValue = new CTDNumericValue(m_numValue);
+    if (!pNewValue->copyCurrentConcept(this, pAttrib)) {
+        delete pNewValue;
+        return NULL;
+    }
+    return pNewValue;
 }
 
 //---------------------------------------------------------------------------
@@ -13,6 +13,10 @@
     #include "TDConcept.h"
 #endif
 
+#if !defined(TDMEMTRACKER_H)
+    #include "TDMemTracker.h"
+#endif
+
 class CTDPartAttrib;
 
 class CTDValue
@@ -30,6 +34,7 @@ public:
 	bool lowerCurrentConcept(CTDPartAttrib* pPartAttrib);
 
     virtual CString toString(bool bRawValue) = 0;
+    virtual CTDValue* clone(CTDAttrib* pAttrib) = 0;
     virtual bool buildBitValue(const CString& rawVal, CTDAttrib* pAttrib) = 0;
 	virtual CTDConcept* getLowerConcept(CTDPartAttrib* pPartAttrib) = 0;
 	virtual bool assignRawConcept(CTDAttrib* pAttrib, int classInd) = 0;
@@ -39,6 +44,8 @@ public:
 	
 
 protected:
+    bool copyCurrentConcept(const CTDValue* pSrcValue, CTDAttrib* pAttrib);
+
 // attributes
     CTDConcept* m_pCurrConcept;				  // Pointer to the current concept.
 };
@@ -47,24 +54,27 @@ protected:
 class CTDStringValue : public CTDValue
 {
 public:
-    CTDStringValue() : m_bitValue(0), m_pRawConcept(NULL) {};
-    virtual ~CTDStringValue() {};
+    CTDStringValue() : m_bitValue(0), m_pRawConcept(NULL) { CTDMemTracker::add(TD_MEM_VALUES, sizeof(CTDStringValue)); };
+    virtual ~CTDStringValue() { CTDMemTracker::add(TD_MEM_VALUES, -LONGLONG(sizeof(CTDStringValue))); };
     
     virtual CString toString(bool bRawValue);
+    virtual CTDValue* clone(CTDAttrib* pAttrib);
     virtual bool buildBitValue(const CString& rawVal, CTDAttrib* pAttrib);
+    bool buildBitValue(CTDConcept* pRawConcept, CTDAttrib* pAttrib);
     virtual CTDConcept* getLowerConcept(CTDPartAttrib* pPartAttrib);    
     CTDConcept* getRawConcept();
+    TDBitValue getBitValue() const { return m_bitValue; };
 	virtual bool assignRawConcept(CTDAttrib* pAttrib, int classInd);
 
 // static functions
-    static bool buildConceptPath(const CString& rawVal, CTDConcepts* pFlatten, CTDConcepts& conceptPath);
+    static CTDConcept* matchRawConcept(LPCTSTR rawVal, CTDConcepts* pFlatten);
 
 protected:
     CTDConcept* getLowerConceptGenMode(CTDConcept* pThisConcept);
     CTDConcept* getLowerConceptSupMode();
 
 // attributes
-    UINT m_bitValue;                    // UINT to make sure shift in 0 in case cross-platform.
+    TDBitValue m_bitValue;              // Unsigned to make sure shift in 0 in case cross-platform.
     CTDConcept* m_pRawConcept;          // Pointer to the raw concept.
 };
 
@@ -72,15 +82,17 @@ protected:
 class CTDNumericValue : public CTDValue
 {
 public:
-    CTDNumericValue(float val) : m_numValue(val) {};
-    virtual ~CTDNumericValue() {};
+    CTDNumericValue(float val) : m_numValue(val) { CTDMemTracker::add(TD_MEM_VALUES, sizeof(CTDNumericValue)); };
+    virtual ~CTDNumericValue() { CTDMemTracker::add(TD_MEM_VALUES, -LONGLONG(sizeof(CTDNumericValue))); };
 
     float getRawValue() { return m_numValue; };
 	bool insertConcept(CTDContConcept* pConcept);
 
     virtual CString toString(bool bRawValue); 
+    virtual CTDValue* clone(CTDAttrib* pAttrib);
     virtual bool buildBitValue(const CString& rawVal, CTDAttrib* pAttrib) { return true; };
     virtual CTDConcept* getLowerConcept(CTDPartAttrib* pPartAttrib);
+    CTDConcept* getLowerConcept(CTDConcept* pLChildCon, CTDConcept* pRChildCon);
 	virtual bool assignRawConcept(CTDAttrib* pAttrib, int classInd) { return true; };
 
 	char  * FloatToStr (double value, Int16s nDecimals = 0);
@@ -0,0 +1,432 @@
+// TDWorkload.cpp: implementation of the CTDWorkload class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StdAfx.h"
+
+#if !defined(TDWORKLOAD_H)
+    #include "TDWorkload.h"
+#endif
+
+#if !defined(TDVALUE_H)
+    #include "TDValue.h"
+#endif
+
+CTDWorkload::CTDWorkload()
+    : m_pAttribMgr(NULL),
+      m_pQueryEngine(NULL),
+      m_sanityBound(1.0),
+      m_nRows(0)
+{
+}
+
+CTDWorkload::~CTDWorkload()
+{
+    cleanup();
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDWorkload::cleanup()
+{
+    for (int i = 0; i < m_queries.GetSize(); ++i)
+        delete m_queries.GetAt(i);
+    m_queries.RemoveAll();
+    m_queryStrs.RemoveAll();
+    m_trueCounts.RemoveAll();
+    m_noisyCounts.RemoveAll();
+}
+
+//---------------------------------------------------------------------------
+// Generate random queries with 1 to maxPredicates predicates on distinct
+// attributes: a non-root concept of a categorical attribute, or a random
+// range within the root interval of a continuous attribute. Half of the
+// queries also restrict the class.
+//---------------------------------------------------------------------------
+bool CTDWorkload::generate(int nQueries, int maxPredicates, CTDAttribMgr* pAttribMgr)
+{
+    cleanup();
+    int nAttribs = pAttribMgr->getNumAttributes() - 1;
+    if (nQueries < 0 || maxPredicates <= 0 || nAttribs <= 0) {
+        cerr << _T("CTDWorkload: Invalid workload parameters.") << endl;
+        ASSERT(false);
+        return false;
+    }
+    maxPredicates = min(maxPredicates, nAttribs);
+
+    CTDAttrib* pClassAttrib = pAttribMgr->getClassAttrib();
+    CTDIntArray attribIdxs;
+    attribIdxs.SetSize(nAttribs);
+    CString queryStr, valueStr;
+    for (int q = 0; q < nQueries; ++q) {
+        for (int a = 0; a < nAttribs; ++a)
+            attribIdxs[a] = a;
+
+        queryStr.Empty();
+        int nPredicates = 1 + rand() % maxPredicates;
+        for (int p = 0; p < nPredicates; ++p) {
+            // Partial shuffle, so that the attributes are distinct.
+            int i = p + rand() % (nAttribs - p);
+            int attribIdx = attribIdxs[i];
+            attribIdxs[i] = attribIdxs[p];
+            attribIdxs[p] = attribIdx;
+
+            CTDAttrib* pAttrib = pAttribMgr->getAttribute(attribIdx);
+            if (pAttrib->isContinuous()) {
+                CTDContConcept* pRoot = static_cast<CTDContConcept*> (pAttrib->getConceptRoot());
+                float lowerB = pRoot->m_lowerBound + float((pRoot->m_upperBound - pRoot->m_lowerBound) * rand() / RAND_MAX);
+                float upperB = lowerB + float((pRoot->m_upperBound - lowerB) * rand() / RAND_MAX);
+                if (upperB <= lowerB)
+                    upperB = pRoot->m_upperBound;
+                if (!CTDContConcept::makeRange(lowerB, upperB, valueStr))
+                    return false;
+            }
+            else {
+                CTDConcepts* pFlatten = pAttrib->getFlattenConcepts();
+                int conceptIdx = pFlatten->GetSize() > 1 ? 1 + rand() % (pFlatten->GetSize() - 1) : 0;
+                valueStr = pFlatten->GetAt(conceptIdx)->m_conceptValue;
+            }
+
+            if (!queryStr.IsEmpty())
+                queryStr += _T(", ");
+            queryStr += pAttrib->m_attribName + TD_QUERY_ATTRIBSEP + valueStr;
+        }
+
+        if (rand() % 2 == 1) {
+            CTDConcept* pClassRoot = pClassAttrib->getConceptRoot();
+            queryStr += _T(", ") + pClassAttrib->m_attribName + TD_QUERY_ATTRIBSEP
+                      + pClassRoot->getChildConcept(rand() % pClassRoot->getNumChildConcepts())->m_conceptValue;
+        }
+
+        if (!addQuery(queryStr, pAttribMgr))
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Read one query per line. Empty lines and comments are skipped.
+//---------------------------------------------------------------------------
+bool CTDWorkload::load(LPCTSTR workloadFile, CTDAttribMgr* pAttribMgr)
+{
+    cleanup();
+    try {
+        CStdioFile file;
+        if (!file.Open(workloadFile, CFile::modeRead)) {
+            cerr << _T("CTDWorkload: Failed to open file ") << workloadFile << endl;
+            return false;
+        }
+
+        CString lineStr;
+        while (file.ReadString(lineStr)) {
+            int commentCharPos = lineStr.Find(TD_CONHCHY_COMMENT);
+            if (commentCharPos >= 0)
+                lineStr = lineStr.Left(commentCharPos);
+            CBFStrHelper::trim(lineStr);
+            if (lineStr.IsEmpty())
+                continue;
+
+            if (!addQuery(lineStr, pAttribMgr))
+                return false;
+        }
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to read workload file: ") << workloadFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDWorkload::save(LPCTSTR workloadFile)
+{
+    try {
+        CStdioFile file;
+        if (!file.Open(workloadFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDWorkload: Failed to open file ") << workloadFile << endl;
+            return false;
+        }
+        for (int q = 0; q < m_queryStrs.GetSize(); ++q)
+            CTDOutputWriter::writeString(file, m_queryStrs.GetAt(q) + _T("\n"));
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write workload file: ") << workloadFile << endl;
+        ASSERT(false);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+bool CTDWorkload::addQuery(const CString& queryStr, CTDAttribMgr* pAttribMgr)
+{
+    CTDQuery* pQuery = new CTDQuery();
+    if (!pQuery->parse(queryStr, pAttribMgr)) {
+        cerr << _T("CTDWorkload: Invalid query ") << queryStr << endl;
+        delete pQuery;
+        return false;
+    }
+    m_queries.Add(pQuery);
+    m_queryStrs.Add(queryStr);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Store the raw values of the records column by column. The concepts of a
+// categorical attribute are ranked in preorder, so the subtree of a concept
+// is a range of ranks.
+//---------------------------------------------------------------------------
+bool CTDWorkload::encodeRecords(CTDAttribMgr* pAttribMgr, CTDRecords* pRecords)
+{
+    m_pAttribMgr = pAttribMgr;
+    m_nRows = pRecords->GetSize();
+    int nAttribs = pAttribMgr->getNumAttributes() - 1;
+    int nRankColumns = 0, nFloatColumns = 0, nRanks = 0;
+    m_columnIdx.SetSize(nAttribs);
+    m_rankOffsets.SetSize(nAttribs);
+    for (int a = 0; a < nAttribs; ++a) {
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(a);
+        m_rankOffsets[a] = nRanks;
+        if (pAttrib->isContinuous()) {
+            m_columnIdx[a] = nFloatColumns++;
+            continue;
+        }
+        m_columnIdx[a] = nRankColumns++;
+        nRanks += pAttrib->getFlattenConcepts()->GetSize();
+    }
+
+    m_conceptRanks.SetSize(nRanks);
+    m_conceptRankEnds.SetSize(nRanks);
+    for (int a = 0; a < nAttribs; ++a) {
+        CTDAttrib* pAttrib = pAttribMgr->getAttribute(a);
+        if (pAttrib->isContinuous())
+            continue;
+        int nextRank = 0;
+        rankConcepts(pAttrib->getConceptRoot(), m_rankOffsets[a], nextRank);
+    }
+
+    m_rankColumns.SetSize(nRankColumns * m_nRows);
+    m_floatColumns.SetSize(nFloatColumns * m_nRows);
+    m_classColumn.SetSize(m_nRows);
+    for (int r = 0; r < m_nRows; ++r) {
+        CTDRecord* pRec = pRecords->GetAt(r);
+        for (int a = 0; a < nAttribs; ++a) {
+            CTDValue* pValue = pRec->getValue(a);
+            int column = m_columnIdx[a] * m_nRows + r;
+            if (pAttribMgr->getAttribute(a)->isContinuous()) {
+                m_floatColumns[column] = static_cast<CTDNumericValue*> (pValue)->getRawValue();
+            }
+            else {
+                CTDConcept* pRawConcept = static_cast<CTDStringValue*> (pValue)->getRawConcept();
+                if (!pRawConcept) {
+                    cerr << _T("CTDWorkload: Record ") << r << _T(" has no raw value of ") << pAttribMgr->getAttribute(a)->m_attribName << endl;
+                    ASSERT(false);
+                    return false;
+                }
+                m_rankColumns[column] = m_conceptRanks[m_rankOffsets[a] + pRawConcept->m_flattenIdx];
+            }
+        }
+        m_classColumn[r] = pRec->getValue(nAttribs)->getCurrentConcept()->m_childIdx;
+    }
+
+    m_sanityBound = max(TD_WORKLOAD_SANITY_BOUND * m_nRows, 1.0);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDWorkload::rankConcepts(CTDConcept* pConcept, int rankOffset, int& nextRank)
+{
+    m_conceptRanks[rankOffset + pConcept->m_flattenIdx] = nextRank++;
+    for (int c = 0; c < pConcept->getNumChildConcepts(); ++c)
+        rankConcepts(pConcept->getChildConcept(c), rankOffset, nextRank);
+    m_conceptRankEnds[rankOffset + pConcept->m_flattenIdx] = nextRank;
+}
+
+//---------------------------------------------------------------------------
+// Answer every query on the encoded records and on the query engine, and
+// write the answers to resultFile.
+//---------------------------------------------------------------------------
+bool CTDWorkload::evaluate(const CTDQueryEngine* pQueryEngine, LPCTSTR resultFile, TDWorkloadStats& stats)
+{
+    cout << _T("Evaluating ") << getNumQueries() << _T(" queries...") << endl;
+    m_pQueryEngine = pQueryEngine;
+    m_trueCounts.SetSize(getNumQueries());
+    m_noisyCounts.SetSize(getNumQueries());
+    try {
+        CStdioFile file;
+        if (!file.Open(resultFile, CFile::modeCreate | CFile::modeWrite)) {
+            cerr << _T("CTDWorkload: Failed to open file ") << resultFile << endl;
+            return false;
+        }
+        CTDOutputWriter::writeString(file, _T("true,noisy,relative error,query\n"));
+
+        CFile* pFiles[] = { &file };
+        CTDOutputWriter writer(TD_OUTPUT_NUM_THREADS);
+        if (!writer.write(getNumQueries(), this, pFiles, 1))
+            return false;
+        file.Close();
+    }
+    catch (CFileException&) {
+        cerr << _T("Failed to write workload result file: ") << resultFile << endl;
+        ASSERT(false);
+        return false;
+    }
+
+    computeStats(stats);
+    cout << _T("Evaluating queries succeeded.") << endl << endl;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Answer one query. Each query is written to its own slots, so the worker
+// threads do not share any state.
+//---------------------------------------------------------------------------
+bool CTDWorkload::serializeItem(int itemIdx, CTDByteBuffer* pBuffers)
+{
+    const CTDQuery* pQuery = m_queries.GetAt(itemIdx);
+    double trueCount = countRecords(*pQuery);
+    double noisyCount = 0.0;
+    if (!m_pQueryEngine->answer(*pQuery, noisyCount))
+        return false;
+    m_trueCounts[itemIdx] = trueCount;
+    m_noisyCounts[itemIdx] = noisyCount;
+
+    CTDByteBuffer& buffer = pBuffers[0];
+    buffer.appendInt(int(trueCount));
+    buffer.append(TD_RAWDATA_DELIMETER);
+    buffer.appendFloat(noisyCount, TD_CONTVALUE_NUMDEC);
+    buffer.append(TD_RAWDATA_DELIMETER);
+    buffer.appendFloat(fabs(noisyCount - trueCount) / max(trueCount, m_sanityBound), 4);
+    buffer.append(TD_RAWDATA_DELIMETER);
+    buffer.append(TCHAR('"'));
+    buffer.append(m_queryStrs.GetAt(itemIdx));
+    buffer.append(TCHAR('"'));
+    buffer.append(TCHAR('\n'));
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Count the records that satisfy the query. Each block of records is
+// filtered by one predicate at a time into a list of selected records.
+//---------------------------------------------------------------------------
+int CTDWorkload::countRecords(const CTDQuery& query) const
+{
+    int selected[TD_WORKLOAD_ROW_BLOCK];
+    int nPredicates = query.m_predicates.GetSize();
+    const int* pClasses = m_classColumn.GetData();
+    int count = 0;
+    for (int blockStart = 0; blockStart < m_nRows; blockStart += TD_WORKLOAD_ROW_BLOCK) {
+        int blockEnd = min(blockStart + TD_WORKLOAD_ROW_BLOCK, m_nRows);
+        int nSelected = -1;
+        for (int p = 0; p < nPredicates && nSelected != 0; ++p)
+            nSelected = filterRange(query.m_predicates[p], blockStart, blockEnd, selected, nSelected);
+
+        if (query.m_classIdx < 0) {
+            count += nSelected < 0 ? blockEnd - blockStart : nSelected;
+        }
+        else if (nSelected < 0) {
+            for (int r = blockStart; r < blockEnd; ++r)
+                count += pClasses[r] == query.m_classIdx;
+        }
+        else {
+            for (int i = 0; i < nSelected; ++i)
+                count += pClasses[selected[i]] == query.m_classIdx;
+        }
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------------
+// Keep the selected records in the range of the predicate. nSelected < 0
+// selects all records of the block. Returns the number of records kept.
+//---------------------------------------------------------------------------
+int CTDWorkload::filterRange(const TDQueryPredicate& predicate, int blockStart, int blockEnd, int* pSelected, int nSelected) const
+{
+    int nKept = 0;
+    int column = m_columnIdx[predicate.m_attribIdx] * m_nRows;
+    if (!predicate.m_pConcept) {
+        const float* pValues = m_floatColumns.GetData() + column;
+        float lowerB = predicate.m_lowerBound, upperB = predicate.m_upperBound;
+        if (nSelected < 0) {
+            for (int r = blockStart; r < blockEnd; ++r) {
+                pSelected[nKept] = r;
+                nKept += pValues[r] >= lowerB && pValues[r] < upperB;
+            }
+        }
+        else {
+            for (int i = 0; i < nSelected; ++i) {
+                int r = pSelected[i];
+                pSelected[nKept] = r;
+                nKept += pValues[r] >= lowerB && pValues[r] < upperB;
+            }
+        }
+        return nKept;
+    }
+
+    const int* pRanks = m_rankColumns.GetData() + column;
+    int rankIdx = m_rankOffsets[predicate.m_attribIdx] + predicate.m_pConcept->m_flattenIdx;
+    int lowerRank = m_conceptRanks[rankIdx];
+    unsigned int nRanks = unsigned(m_conceptRankEnds[rankIdx] - lowerRank);
+    if (nSelected < 0) {
+        for (int r = blockStart; r < blockEnd; ++r) {
+            pSelected[nKept] = r;
+            nKept += unsigned(pRanks[r] - lowerRank) < nRanks;
+        }
+    }
+    else {
+        for (int i = 0; i < nSelected; ++i) {
+            int r = pSelected[i];
+            pSelected[nKept] = r;
+            nKept += unsigned(pRanks[r] - lowerRank) < nRanks;
+        }
+    }
+    return nKept;
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+void CTDWorkload::computeStats(TDWorkloadStats& stats)
+{
+    int nQueries = getNumQueries();
+    stats.m_nQueries = nQueries;
+    stats.m_sanityBound = m_sanityBound;
+    stats.m_meanRelError = stats.m_medianRelError = stats.m_p90RelError = 0.0;
+    stats.m_p95RelError = stats.m_maxRelError = stats.m_meanAbsError = 0.0;
+    if (nQueries == 0)
+        return;
+
+    CTDDoubleArray relErrors;
+    relErrors.SetSize(nQueries);
+    for (int q = 0; q < nQueries; ++q) {
+        double absError = fabs(m_noisyCounts[q] - m_trueCounts[q]);
+        relErrors[q] = absError / max(m_trueCounts[q], m_sanityBound);
+        stats.m_meanAbsError += absError;
+        stats.m_meanRelError += relErrors[q];
+    }
+    stats.m_meanAbsError /= nQueries;
+    stats.m_meanRelError /= nQueries;
+
+    qsort(relErrors.GetData(), nQueries, sizeof(double), compareErrors);
+    stats.m_medianRelError = relErrors[(nQueries - 1) / 2];
+    stats.m_p90RelError = relErrors[int(ceil(0.90 * nQueries)) - 1];
+    stats.m_p95RelError = relErrors[int(ceil(0.95 * nQueries)) - 1];
+    stats.m_maxRelError = relErrors[nQueries - 1];
+}
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// static
+int CTDWorkload::compareErrors(const void* pError1, const void* pError2)
+{
+    double error1 = *static_cast<const double*> (pError1);
+    double error2 = *static_cast<const double*> (pError2);
+    if (error1 < error2)
+        return -1;
+    return error1 > error2 ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// TDWorkload.h: interface for the CTDWorkload class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(TDWORKLOAD_H)
+#define TDWORKLOAD_H
+
+#if !defined(TDQUERY_H)
+    #include "TDQuery.h"
+#endif
+
+#if !defined(TDOUTPUTWRITER_H)
+    #include "TDOutputWriter.h"
+#endif
+
+#if !defined(TDRECORD_H)
+    #include "TDRecord.h"
+#endif
+
+typedef CTypedPtrArray<CPtrArray, CTDQuery*> CTDQueryArray;
+
+//---------------------------------------------------------------------------
+// Relative error of the noisy answers of a workload. The relative error of
+// a query is |noisy - true| / max(true, sanity bound), where the sanity
+// bound is TD_WORKLOAD_SANITY_BOUND of the number of records.
+//---------------------------------------------------------------------------
+struct TDWorkloadStats
+{
+    int    m_nQueries;
+    double m_sanityBound;
+    double m_meanRelError;
+    double m_medianRelError;
+    double m_p90RelError;
+    double m_p95RelError;
+    double m_maxRelError;
+    double m_meanAbsError;
+};
+
+//---------------------------------------------------------------------------
+// Workload of count queries for measuring the utility of a run. The true
+// answers come from a columnar scan over the raw training records; the
+// noisy answers from the query engine over the noisy leaf partitions.
+// The queries are evaluated on all processors by the output writer, which
+// also writes the answers of each query to the result file.
+// Each column holds one attribute of all records: the raw value of a
+// continuous attribute, or the preorder rank of the raw concept of a
+// categorical attribute, so that every predicate is a range of a column.
+//---------------------------------------------------------------------------
+class CTDWorkload : public CTDOutputSerializer
+{
+public:
+    CTDWorkload();
+    virtual ~CTDWorkload();
+
+// Operations
+    bool generate(int nQueries, int maxPredicates, CTDAttribMgr* pAttribMgr);
+    bool load(LPCTSTR workloadFile, CTDAttribMgr* pAttribMgr);
+    bool save(LPCTSTR workloadFile);
+    bool encodeRecords(CTDAttribMgr* pAttribMgr, CTDRecords* pRecords);
+    bool evaluate(const CTDQueryEngine* pQueryEngine, LPCTSTR resultFile, TDWorkloadStats& stats);
+    void cleanup();
+    virtual bool serializeItem(int itemIdx, CTDByteBuffer* pBuffers);
+
+    int getNumQueries() const { return m_queries.GetSize(); };
+    double getTrueCount(int queryIdx) const { return m_trueCounts[queryIdx]; };
+    double getNoisyCount(int queryIdx) const { return m_noisyCounts[queryIdx]; };
+
+protected:
+    bool addQuery(const CString& queryStr, CTDAttribMgr* pAttribMgr);
+    void rankConcepts(CTDConcept* pConcept, int rankOffset, int& nextRank);
+    int countRecords(const CTDQuery& query) const;
+    int filterRange(const TDQueryPredicate& predicate, int blockStart, int blockEnd, int* pSelected, int nSelected) const;
+    void computeStats(TDWorkloadStats& stats);
+    static int compareErrors(const void* pError1, const void* pError2);
+
+// Attributes
+    CTDAttribMgr*       m_pAttribMgr;
+    CStringArray        m_queryStrs;
+    CTDQueryArray       m_queries;
+    const CTDQueryEngine* m_pQueryEngine;
+    CTDDoubleArray      m_trueCounts;
+    CTDDoubleArray      m_noisyCounts;
+    double              m_sanityBound;
+
+    // Columns of the encoded records.
+    int                 m_nRows;
+    CTDIntArray         m_columnIdx;        // Column of attribute a in m_rankColumns or m_floatColumns.
+    CTDIntArray         m_rankColumns;      // Row r of column c at c * m_nRows + r.
+    CTDFloatArray       m_floatColumns;
+    CTDIntArray         m_classColumn;
+    CTDIntArray         m_rankOffsets;      // Ranks of attribute a start at m_rankOffsets[a] in the two arrays below.
+    CTDIntArray         m_conceptRanks;     // Preorder rank of a concept, by flattened index.
+    CTDIntArray         m_conceptRankEnds;  // One past the last rank in the subtree of a concept.
+};
+
+#endif